@@ -71,6 +71,72 @@ pk_alpm_disabled_repos_configure (PkBackend *backend, gboolean only_trusted, GEr
 	return TRUE;
 }
 
+static alpm_db_t *
+pk_alpm_find_syncdb (alpm_handle_t *alpm, const gchar *name)
+{
+	const alpm_list_t *i;
+
+	for (i = alpm_get_syncdbs (alpm); i != NULL; i = i->next) {
+		if (g_strcmp0 (alpm_db_get_name (i->data), name) == 0)
+			return i->data;
+	}
+	return NULL;
+}
+
+/*
+ * libalpm has no way to drop the package cache of a single database, so the
+ * changed syncdbs are unregistered and registered again. Databases after the
+ * first changed one are reloaded too, as registering appends and the order
+ * decides which repo wins.
+ */
+gboolean
+pk_alpm_reload_databases (PkBackend *backend, GHashTable *changed, GError **error)
+{
+	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+	const alpm_list_t *first = NULL;
+	const alpm_list_t *i;
+
+	for (i = priv->configured_repos; i != NULL; i = i->next) {
+		PkBackendRepo *repo = (PkBackendRepo *) i->data;
+		if (g_hash_table_contains (changed, repo->name)) {
+			first = i;
+			break;
+		}
+	}
+	if (first == NULL)
+		return TRUE;
+
+	for (i = first; i != NULL; i = i->next) {
+		PkBackendRepo *repo = (PkBackendRepo *) i->data;
+		alpm_db_t *db = pk_alpm_find_syncdb (priv->alpm, repo->name);
+
+		if (db != NULL && alpm_db_unregister (db) < 0) {
+			alpm_errno_t alpm_err = alpm_errno (priv->alpm);
+			g_set_error (error, PK_ALPM_ERROR, alpm_err, "[%s]: %s",
+				     repo->name, alpm_strerror (alpm_err));
+			return FALSE;
+		}
+	}
+
+	for (i = first; i != NULL; i = i->next) {
+		PkBackendRepo *repo = (PkBackendRepo *) i->data;
+		alpm_db_t *db;
+
+		g_debug ("reloading sync database %s", repo->name);
+		db = alpm_register_syncdb (priv->alpm, repo->name, repo->level);
+		if (db == NULL) {
+			alpm_errno_t alpm_err = alpm_errno (priv->alpm);
+			g_set_error (error, PK_ALPM_ERROR, alpm_err, "[%s]: %s",
+				     repo->name, alpm_strerror (alpm_err));
+			return FALSE;
+		}
+
+		alpm_db_set_servers (db, alpm_list_strdup (repo->servers));
+	}
+
+	return TRUE;
+}
+
 void
 pk_alpm_add_database (PkBackend *backend, const gchar *name, alpm_list_t *servers,
 			 alpm_siglevel_t level)
@@ -121,6 +187,7 @@ pk_alpm_destroy_databases (PkBackend *backend)
 		g_free (repo);
 	}
 	alpm_list_free (priv->configured_repos);
+	priv->configured_repos = NULL;
 }
 
 static gboolean
@@ -33,6 +33,10 @@ gboolean	 pk_alpm_disable_signatures		(PkBackend *backend, GError **error);
 
 gboolean	 pk_alpm_enable_signatures		(PkBackend *backend, GError **error);
 
+gboolean	 pk_alpm_reload_databases		(PkBackend *backend,
+							 GHashTable *changed,
+							 GError **error);
+
 gboolean	 pk_alpm_initialize_databases		(PkBackend *backend, GError **error);
 
 void		 pk_alpm_destroy_databases		(PkBackend *backend);
@@ -68,7 +68,8 @@ pk_alpm_error_emit (PkBackendJob *job, GError *error)
 		code = PK_ERROR_ENUM_FAILED_INITIALIZATION;
 		break;
 	case ALPM_ERR_HANDLE_LOCK:
-		code = PK_ERROR_ENUM_CANNOT_GET_LOCK;
+		/* the daemon retries when the lock file is removed */
+		code = PK_ERROR_ENUM_LOCK_REQUIRED;
 		break;
 	case ALPM_ERR_DB_OPEN:
 	case ALPM_ERR_DB_NOT_FOUND:
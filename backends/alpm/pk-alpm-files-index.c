@@ -0,0 +1,373 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 PackageKit contributors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * The files index maps the full path and the basename of every file in
+ * the local and sync databases to the packages owning it. It is written
+ * to disk as two hash tables sharing one entry and string table, so it
+ * can be used straight from a read-only mapping:
+ *
+ *   header | path buckets | basename buckets | entries | strings
+ *
+ * Buckets hold the index + 1 of the first entry of their chain, 0 if the
+ * chain is empty. The header records the mtimes of the databases it was
+ * built from and the index is ignored as soon as one of them changed.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "pk-alpm-error.h"
+#include "pk-alpm-files-index.h"
+
+#define PK_ALPM_FILES_INDEX_DIR		"/var/cache/PackageKit/alpm/"
+#define PK_ALPM_FILES_INDEX_FILE	PK_ALPM_FILES_INDEX_DIR "files.idx"
+#define PK_ALPM_FILES_INDEX_MAGIC	"PKALPMFI"
+#define PK_ALPM_FILES_INDEX_VERSION	1
+
+typedef struct {
+	gchar		magic[8];
+	guint32		version;
+	guint32		stamp;		/* string offset */
+	guint32		n_buckets;	/* per table */
+	guint32		n_entries;
+	guint32		buckets_offset;
+	guint32		entries_offset;
+	guint32		strings_offset;
+	guint32		strings_size;
+} PkAlpmFilesIndexHeader;
+
+typedef struct {
+	guint32		key;
+	guint32		db;
+	guint32		pkg;
+	guint32		next;
+} PkAlpmFilesIndexEntry;
+
+struct _PkAlpmFilesIndex {
+	GMappedFile			*mapped;
+	const PkAlpmFilesIndexHeader	*header;
+	const guint32			*buckets;
+	const PkAlpmFilesIndexEntry	*entries;
+	const gchar			*strings;
+};
+
+typedef struct {
+	GString		*strings;
+	GHashTable	*offsets;	/* string → offset + 1 */
+	GArray		*entries;	/* PkAlpmFilesIndexEntry */
+	GArray		*tables;	/* guint32 hash, high bit set for basenames */
+} PkAlpmFilesIndexBuilder;
+
+#define PK_ALPM_FILES_INDEX_BASENAME	0x80000000u
+
+/* FNV-1a, the on-disk format must not depend on the GLib version */
+static guint32
+pk_alpm_files_index_hash (const gchar *str)
+{
+	guint32 hash = 2166136261u;
+
+	for (; *str != '\0'; str++) {
+		hash ^= (guchar) *str;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static gchar *
+pk_alpm_files_index_build_stamp (alpm_handle_t *alpm)
+{
+	const gchar *dbpath = alpm_option_get_dbpath (alpm);
+	GString *stamp = g_string_new (NULL);
+	g_autofree gchar *local = NULL;
+	const alpm_list_t *i;
+	GStatBuf st;
+
+	local = g_build_filename (dbpath, "local", NULL);
+	if (g_stat (local, &st) == 0) {
+		g_string_append_printf (stamp, "local:%" G_GINT64_FORMAT ".%ld;",
+					(gint64) st.st_mtim.tv_sec, st.st_mtim.tv_nsec);
+	}
+
+	for (i = alpm_get_syncdbs (alpm); i != NULL; i = i->next) {
+		const gchar *name = alpm_db_get_name (i->data);
+		g_autofree gchar *filename = g_strconcat (name, ".db", NULL);
+		g_autofree gchar *path = g_build_filename (dbpath, "sync", filename, NULL);
+
+		if (g_stat (path, &st) != 0)
+			continue;
+		g_string_append_printf (stamp, "%s:%" G_GINT64_FORMAT ".%ld;", name,
+					(gint64) st.st_mtim.tv_sec, st.st_mtim.tv_nsec);
+	}
+
+	return g_string_free (stamp, FALSE);
+}
+
+static guint32
+pk_alpm_files_index_builder_intern (PkAlpmFilesIndexBuilder *builder, const gchar *str)
+{
+	guint32 offset = GPOINTER_TO_UINT (g_hash_table_lookup (builder->offsets, str));
+
+	if (offset > 0)
+		return offset - 1;
+
+	offset = builder->strings->len;
+	g_string_append_len (builder->strings, str, strlen (str) + 1);
+	g_hash_table_insert (builder->offsets, g_strdup (str), GUINT_TO_POINTER (offset + 1));
+	return offset;
+}
+
+static void
+pk_alpm_files_index_builder_add (PkAlpmFilesIndexBuilder *builder, const gchar *key,
+				 guint32 db, guint32 pkg, gboolean basename)
+{
+	PkAlpmFilesIndexEntry entry;
+	guint32 table;
+
+	entry.key = pk_alpm_files_index_builder_intern (builder, key);
+	entry.db = db;
+	entry.pkg = pkg;
+	entry.next = 0;
+	g_array_append_val (builder->entries, entry);
+
+	table = pk_alpm_files_index_hash (key) & ~PK_ALPM_FILES_INDEX_BASENAME;
+	if (basename)
+		table |= PK_ALPM_FILES_INDEX_BASENAME;
+	g_array_append_val (builder->tables, table);
+}
+
+static void
+pk_alpm_files_index_builder_add_db (PkAlpmFilesIndexBuilder *builder, alpm_db_t *db)
+{
+	guint32 db_offset = pk_alpm_files_index_builder_intern (builder, alpm_db_get_name (db));
+	const alpm_list_t *i;
+
+	for (i = alpm_db_get_pkgcache (db); i != NULL; i = i->next) {
+		alpm_filelist_t *files = alpm_pkg_get_files (i->data);
+		guint32 pkg_offset;
+
+		if (files == NULL || files->count == 0)
+			continue;
+
+		pkg_offset = pk_alpm_files_index_builder_intern (builder, alpm_pkg_get_name (i->data));
+		for (gsize j = 0; j < files->count; ++j) {
+			const gchar *file = files->files[j].name;
+			const gchar *name;
+
+			/* directories never match a search */
+			if (g_str_has_suffix (file, "/"))
+				continue;
+
+			pk_alpm_files_index_builder_add (builder, file, db_offset, pkg_offset, FALSE);
+
+			name = strrchr (file, G_DIR_SEPARATOR);
+			name = name == NULL ? file : name + 1;
+			pk_alpm_files_index_builder_add (builder, name, db_offset, pkg_offset, TRUE);
+		}
+	}
+}
+
+static gboolean
+pk_alpm_files_index_builder_write (PkAlpmFilesIndexBuilder *builder, const gchar *stamp, GError **error)
+{
+	PkAlpmFilesIndexHeader header;
+	PkAlpmFilesIndexEntry *entries = (PkAlpmFilesIndexEntry *) builder->entries->data;
+	g_autofree guint32 *buckets = NULL;
+	g_autoptr(GString) data = NULL;
+	guint32 n_buckets = 1;
+	guint32 n_entries = builder->entries->len;
+
+	header.stamp = pk_alpm_files_index_builder_intern (builder, stamp);
+
+	while (n_buckets < n_entries / 2)
+		n_buckets <<= 1;
+
+	/* chain the entries, walking backwards keeps them in database order */
+	buckets = g_new0 (guint32, 2 * n_buckets);
+	for (guint32 i = n_entries; i > 0; --i) {
+		guint32 table = g_array_index (builder->tables, guint32, i - 1);
+		guint32 bucket = table & (n_buckets - 1);
+
+		if (table & PK_ALPM_FILES_INDEX_BASENAME)
+			bucket += n_buckets;
+		entries[i - 1].next = buckets[bucket];
+		buckets[bucket] = i;
+	}
+
+	memcpy (header.magic, PK_ALPM_FILES_INDEX_MAGIC, sizeof (header.magic));
+	header.version = PK_ALPM_FILES_INDEX_VERSION;
+	header.n_buckets = n_buckets;
+	header.n_entries = n_entries;
+	header.buckets_offset = sizeof (header);
+	header.entries_offset = header.buckets_offset + 2 * n_buckets * sizeof (guint32);
+	header.strings_offset = header.entries_offset + n_entries * sizeof (PkAlpmFilesIndexEntry);
+	header.strings_size = builder->strings->len;
+
+	data = g_string_sized_new (header.strings_offset + header.strings_size);
+	g_string_append_len (data, (const gchar *) &header, sizeof (header));
+	g_string_append_len (data, (const gchar *) buckets, 2 * n_buckets * sizeof (guint32));
+	g_string_append_len (data, (const gchar *) entries, n_entries * sizeof (PkAlpmFilesIndexEntry));
+	g_string_append_len (data, builder->strings->str, builder->strings->len);
+
+	if (g_mkdir_with_parents (PK_ALPM_FILES_INDEX_DIR, 0755) < 0) {
+		g_set_error_literal (error, PK_ALPM_ERROR, errno, strerror (errno));
+		return FALSE;
+	}
+
+	return g_file_set_contents (PK_ALPM_FILES_INDEX_FILE, data->str, data->len, error);
+}
+
+gboolean
+pk_alpm_files_index_update (alpm_handle_t *alpm, GError **error)
+{
+	g_autoptr(PkAlpmFilesIndex) index = NULL;
+	g_autofree gchar *stamp = NULL;
+	PkAlpmFilesIndexBuilder builder;
+	const alpm_list_t *i;
+	gboolean ret;
+
+	g_return_val_if_fail (alpm != NULL, FALSE);
+
+	/* nothing changed since the index was written */
+	index = pk_alpm_files_index_open (alpm);
+	if (index != NULL)
+		return TRUE;
+
+	/* take the stamp first, so changes while we read make it stale */
+	stamp = pk_alpm_files_index_build_stamp (alpm);
+
+	builder.strings = g_string_new (NULL);
+	builder.offsets = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	builder.entries = g_array_new (FALSE, FALSE, sizeof (PkAlpmFilesIndexEntry));
+	builder.tables = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+	pk_alpm_files_index_builder_add_db (&builder, alpm_get_localdb (alpm));
+	for (i = alpm_get_syncdbs (alpm); i != NULL; i = i->next)
+		pk_alpm_files_index_builder_add_db (&builder, i->data);
+
+	g_debug ("writing files index with %u entries", builder.entries->len);
+	ret = pk_alpm_files_index_builder_write (&builder, stamp, error);
+
+	g_string_free (builder.strings, TRUE);
+	g_hash_table_unref (builder.offsets);
+	g_array_unref (builder.entries);
+	g_array_unref (builder.tables);
+	return ret;
+}
+
+PkAlpmFilesIndex *
+pk_alpm_files_index_open (alpm_handle_t *alpm)
+{
+	g_autoptr(PkAlpmFilesIndex) index = NULL;
+	g_autofree gchar *stamp = NULL;
+	const PkAlpmFilesIndexHeader *header;
+	const gchar *contents;
+	gsize length;
+
+	g_return_val_if_fail (alpm != NULL, NULL);
+
+	index = g_new0 (PkAlpmFilesIndex, 1);
+	index->mapped = g_mapped_file_new (PK_ALPM_FILES_INDEX_FILE, FALSE, NULL);
+	if (index->mapped == NULL)
+		return NULL;
+
+	contents = g_mapped_file_get_contents (index->mapped);
+	length = g_mapped_file_get_length (index->mapped);
+	if (length < sizeof (PkAlpmFilesIndexHeader))
+		return NULL;
+
+	header = (const PkAlpmFilesIndexHeader *) contents;
+	if (memcmp (header->magic, PK_ALPM_FILES_INDEX_MAGIC, sizeof (header->magic)) != 0 ||
+	    header->version != PK_ALPM_FILES_INDEX_VERSION ||
+	    header->n_buckets == 0 ||
+	    (header->n_buckets & (header->n_buckets - 1)) != 0 ||
+	    header->strings_size == 0 ||
+	    (gsize) header->strings_offset + header->strings_size != length ||
+	    header->entries_offset + (gsize) header->n_entries * sizeof (PkAlpmFilesIndexEntry) != header->strings_offset ||
+	    header->buckets_offset + (gsize) header->n_buckets * 2 * sizeof (guint32) != header->entries_offset ||
+	    contents[length - 1] != '\0' ||
+	    header->stamp >= header->strings_size) {
+		g_debug ("ignoring invalid files index %s", PK_ALPM_FILES_INDEX_FILE);
+		return NULL;
+	}
+
+	index->header = header;
+	index->buckets = (const guint32 *) (contents + header->buckets_offset);
+	index->entries = (const PkAlpmFilesIndexEntry *) (contents + header->entries_offset);
+	index->strings = contents + header->strings_offset;
+
+	stamp = pk_alpm_files_index_build_stamp (alpm);
+	if (g_strcmp0 (stamp, index->strings + header->stamp) != 0) {
+		g_debug ("files index is outdated");
+		return NULL;
+	}
+
+	return g_steal_pointer (&index);
+}
+
+GArray *
+pk_alpm_files_index_lookup (PkAlpmFilesIndex *index, const gchar *needle)
+{
+	const PkAlpmFilesIndexHeader *header = index->header;
+	GArray *matches = g_array_new (FALSE, FALSE, sizeof (PkAlpmFilesIndexMatch));
+	guint32 bucket, i;
+
+	g_return_val_if_fail (needle != NULL, matches);
+
+	/* full paths are stored without the leading slash */
+	if (G_IS_DIR_SEPARATOR (*needle)) {
+		needle++;
+		bucket = pk_alpm_files_index_hash (needle) & (header->n_buckets - 1);
+	} else {
+		bucket = header->n_buckets + (pk_alpm_files_index_hash (needle) & (header->n_buckets - 1));
+	}
+
+	for (i = index->buckets[bucket]; i != 0 && i <= header->n_entries; i = index->entries[i - 1].next) {
+		const PkAlpmFilesIndexEntry *entry = &index->entries[i - 1];
+		PkAlpmFilesIndexMatch match;
+
+		/* chains only ever point forward, anything else is corrupt */
+		if (entry->key >= header->strings_size ||
+		    entry->db >= header->strings_size ||
+		    entry->pkg >= header->strings_size ||
+		    (entry->next != 0 && entry->next <= i))
+			break;
+		if (strcmp (index->strings + entry->key, needle) != 0)
+			continue;
+
+		match.db = index->strings + entry->db;
+		match.pkg = index->strings + entry->pkg;
+		g_array_append_val (matches, match);
+	}
+
+	return matches;
+}
+
+void
+pk_alpm_files_index_free (PkAlpmFilesIndex *index)
+{
+	if (index == NULL)
+		return;
+	if (index->mapped != NULL)
+		g_mapped_file_unref (index->mapped);
+	g_free (index);
+}
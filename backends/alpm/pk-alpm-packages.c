@@ -62,6 +62,22 @@ pk_alpm_pkg_emit (PkBackendJob *job, alpm_pkg_t *pkg, PkInfoEnum info)
 	g_free (package);
 }
 
+PkPackage *
+pk_alpm_pkg_new (alpm_pkg_t *pkg, PkInfoEnum info)
+{
+	g_autofree gchar *package_id = NULL;
+	PkPackage *package;
+
+	g_return_val_if_fail (pkg != NULL, NULL);
+
+	package_id = pk_alpm_pkg_build_id (pkg);
+	package = pk_package_new ();
+	pk_package_set_id (package, package_id, NULL);
+	pk_package_set_info (package, info);
+	pk_package_set_summary (package, alpm_pkg_get_desc (pkg));
+	return package;
+}
+
 alpm_pkg_t *
 pk_alpm_find_pkg (PkBackendJob *job, const gchar *package_id, GError **error)
 {
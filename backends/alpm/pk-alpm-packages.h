@@ -28,6 +28,8 @@ gchar		*pk_alpm_pkg_build_id	(alpm_pkg_t *pkg);
 
 void		 pk_alpm_pkg_emit (PkBackendJob *job, alpm_pkg_t *pkg, PkInfoEnum info);
 
+PkPackage	*pk_alpm_pkg_new (alpm_pkg_t *pkg, PkInfoEnum info);
+
 alpm_pkg_t	*pk_alpm_find_pkg (PkBackendJob *job,
 					 const gchar *package_id,
 					 GError **error);
@@ -26,6 +26,7 @@
 #include <string.h>
 
 #include "pk-backend-alpm.h"
+#include "pk-alpm-files-index.h"
 #include "pk-alpm-groups.h"
 #include "pk-alpm-packages.h"
 
@@ -235,47 +236,83 @@ static MatchFunc match_funcs[] = {
 	pk_alpm_pkg_match_provides
 };
 
+typedef struct {
+	const gchar	*version;
+	const gchar	*arch;
+} PkAlpmLocalPkg;
+
+typedef struct {
+	PkBackendJob		*job;
+	alpm_db_t		*localdb;
+	MatchFunc		 match;
+	const alpm_list_t	*patterns;
+	PkBitfield		 filters;
+	GRegex			*application;
+	GHashTable		*local_pkgs;	/* name → PkAlpmLocalPkg */
+} PkAlpmSearch;
+
+static GHashTable *
+pk_alpm_search_build_local_pkgs (alpm_db_t *localdb)
+{
+	GHashTable *local_pkgs;
+	const alpm_list_t *i;
+
+	local_pkgs = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_free);
+	for (i = alpm_db_get_pkgcache (localdb); i != NULL; i = i->next) {
+		PkAlpmLocalPkg *local = g_new0 (PkAlpmLocalPkg, 1);
+
+		/* looked up once, rather than in localdb for every sync match */
+		local->version = alpm_pkg_get_version (i->data);
+		local->arch = alpm_pkg_get_arch (i->data);
+		g_hash_table_insert (local_pkgs, (gpointer) alpm_pkg_get_name (i->data), local);
+	}
+
+	return local_pkgs;
+}
+
 static gboolean
-pk_alpm_pkg_is_local (PkBackendJob *job, alpm_pkg_t *pkg)
+pk_alpm_pkg_is_local (PkAlpmSearch *search, alpm_pkg_t *pkg)
 {
-	PkBackend *backend = pk_backend_job_get_backend (job);
-	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
-	alpm_pkg_t *local;
+	PkAlpmLocalPkg *local = NULL;
+	PkAlpmLocalPkg tmp;
 
 	g_return_val_if_fail (pkg != NULL, FALSE);
 
 	/* find an installed package with the same name */
-	local = alpm_db_get_pkg (priv->localdb, alpm_pkg_get_name (pkg));
+	if (search->local_pkgs != NULL) {
+		local = g_hash_table_lookup (search->local_pkgs, alpm_pkg_get_name (pkg));
+	} else {
+		alpm_pkg_t *localpkg = alpm_db_get_pkg (search->localdb, alpm_pkg_get_name (pkg));
+
+		if (localpkg != NULL) {
+			tmp.version = alpm_pkg_get_version (localpkg);
+			tmp.arch = alpm_pkg_get_arch (localpkg);
+			local = &tmp;
+		}
+	}
 	if (local == NULL)
 		return FALSE;
 
 	/* make sure the installed version is the same */
-	if (alpm_pkg_vercmp (alpm_pkg_get_version (local),
-			     alpm_pkg_get_version (pkg)) != 0) {
+	if (alpm_pkg_vercmp (local->version, alpm_pkg_get_version (pkg)) != 0)
 		return FALSE;
-	}
 
 	/* make sure the installed arch is the same */
-	if (g_strcmp0 (alpm_pkg_get_arch (local),
-		       alpm_pkg_get_arch (pkg)) != 0) {
+	if (g_strcmp0 (local->arch, alpm_pkg_get_arch (pkg)) != 0)
 		return FALSE;
-	}
 
 	return TRUE;
 }
 
 static gboolean
-pk_alpm_search_is_application (alpm_pkg_t *pkg) {
+pk_alpm_search_is_application (PkAlpmSearch *search, alpm_pkg_t *pkg) {
 	guint i;
 	alpm_filelist_t *filelist;
-	g_autoptr(GRegex) regex = NULL;
 
 	filelist = alpm_pkg_get_files (pkg);
-	regex = g_regex_new ("^usr/share/applications/.*\\.desktop$", 0, 0, NULL);
-
 	for (i = 0; i < filelist->count; i++) {
 		const alpm_file_t *file = filelist->files + i;
-		if (g_regex_match (regex, file->name, 0, NULL)) {
+		if (g_regex_match (search->application, file->name, 0, NULL)) {
 			return TRUE;
 		}
 	}
@@ -283,23 +320,21 @@ pk_alpm_search_is_application (alpm_pkg_t *pkg) {
 }
 
 static void
-pk_backend_search_db (PkBackendJob *job, alpm_db_t *db, MatchFunc match,
-		      const alpm_list_t *patterns, PkBitfield filters)
+pk_backend_search_pkgs (PkAlpmSearch *search, alpm_db_t *db, const alpm_list_t *pkgs, GPtrArray *packages)
 {
-	PkBackend *backend = pk_backend_job_get_backend (job);
-	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+	PkBitfield filters = search->filters;
 	const alpm_list_t *i, *j;
 
 	g_return_if_fail (db != NULL);
-	g_return_if_fail (match != NULL);
+	g_return_if_fail (search->match != NULL);
 
-	/* emit packages that match all search terms */
-	for (i = alpm_db_get_pkgcache (db); i != NULL; i = i->next) {
-		if (pk_backend_job_is_cancelled (job))
+	/* collect packages that match all search terms */
+	for (i = pkgs; i != NULL; i = i->next) {
+		if (pk_backend_job_is_cancelled (search->job))
 			break;
 
-		for (j = patterns; j != NULL; j = j->next) {
-			if (!match (i->data, j->data))
+		for (j = search->patterns; j != NULL; j = j->next) {
+			if (!search->match (i->data, j->data))
 				break;
 		}
 
@@ -308,21 +343,123 @@ pk_backend_search_db (PkBackendJob *job, alpm_db_t *db, MatchFunc match,
 			continue;
 
 		/* want applications */
-		if (pk_bitfield_contain (filters, PK_FILTER_ENUM_APPLICATION) && !pk_alpm_search_is_application (i->data))
+		if (pk_bitfield_contain (filters, PK_FILTER_ENUM_APPLICATION) && !pk_alpm_search_is_application (search, i->data))
 			continue;
 
 		/* don't want applications */
-		if (pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_APPLICATION) && pk_alpm_search_is_application (i->data))
+		if (pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_APPLICATION) && pk_alpm_search_is_application (search, i->data))
 			continue;
 
-		if (db == priv->localdb) {
-			pk_alpm_pkg_emit (job, i->data, PK_INFO_ENUM_INSTALLED);
-		} else if (!pk_alpm_pkg_is_local (job, i->data)) {
-			pk_alpm_pkg_emit (job, i->data, PK_INFO_ENUM_AVAILABLE);
+		if (db == search->localdb) {
+			g_ptr_array_add (packages, pk_alpm_pkg_new (i->data, PK_INFO_ENUM_INSTALLED));
+		} else if (!pk_alpm_pkg_is_local (search, i->data)) {
+			g_ptr_array_add (packages, pk_alpm_pkg_new (i->data, PK_INFO_ENUM_AVAILABLE));
 		}
 	}
 }
 
+static void
+pk_backend_search_db (PkAlpmSearch *search, alpm_db_t *db, GPtrArray *packages)
+{
+	pk_backend_search_pkgs (search, db, alpm_db_get_pkgcache (db), packages);
+}
+
+/* only the packages the index knows for the first file are checked
+ * against all search terms, returns FALSE if there is no usable index */
+static gboolean
+pk_backend_search_files_index (PkAlpmSearch *search, alpm_handle_t *alpm,
+			       gboolean skip_local, gboolean skip_remote)
+{
+	g_autoptr(PkAlpmFilesIndex) index = NULL;
+	g_autoptr(GArray) matches = NULL;
+	g_autoptr(GError) error = NULL;
+	const alpm_list_t *i;
+	alpm_list_t *candidates = NULL;
+
+	if (search->patterns == NULL)
+		return FALSE;
+
+	if (!pk_alpm_files_index_update (alpm, &error)) {
+		g_warning ("failed to update files index: %s", error->message);
+		return FALSE;
+	}
+	index = pk_alpm_files_index_open (alpm);
+	if (index == NULL)
+		return FALSE;
+
+	matches = pk_alpm_files_index_lookup (index, search->patterns->data);
+
+	if (!skip_local) {
+		g_autoptr(GPtrArray) packages = g_ptr_array_new_with_free_func (g_object_unref);
+
+		for (guint j = 0; j < matches->len; j++) {
+			PkAlpmFilesIndexMatch *match = &g_array_index (matches, PkAlpmFilesIndexMatch, j);
+			alpm_pkg_t *pkg;
+
+			if (g_strcmp0 (match->db, alpm_db_get_name (search->localdb)) != 0)
+				continue;
+			pkg = alpm_db_get_pkg (search->localdb, match->pkg);
+			if (pkg != NULL)
+				candidates = alpm_list_add (candidates, pkg);
+		}
+		pk_backend_search_pkgs (search, search->localdb, candidates, packages);
+		alpm_list_free (candidates);
+		candidates = NULL;
+
+		if (packages->len > 0)
+			pk_backend_job_packages (search->job, packages);
+	}
+
+	if (skip_remote)
+		return TRUE;
+
+	for (i = alpm_get_syncdbs (alpm); i != NULL; i = i->next) {
+		g_autoptr(GPtrArray) packages = g_ptr_array_new_with_free_func (g_object_unref);
+
+		if (pk_backend_job_is_cancelled (search->job))
+			break;
+
+		for (guint j = 0; j < matches->len; j++) {
+			PkAlpmFilesIndexMatch *match = &g_array_index (matches, PkAlpmFilesIndexMatch, j);
+			alpm_pkg_t *pkg;
+
+			if (g_strcmp0 (match->db, alpm_db_get_name (i->data)) != 0)
+				continue;
+			pkg = alpm_db_get_pkg (i->data, match->pkg);
+			if (pkg != NULL)
+				candidates = alpm_list_add (candidates, pkg);
+		}
+		pk_backend_search_pkgs (search, i->data, candidates, packages);
+		alpm_list_free (candidates);
+		candidates = NULL;
+
+		if (packages->len > 0)
+			pk_backend_job_packages (search->job, packages);
+	}
+
+	return TRUE;
+}
+
+/* libalpm is not thread safe, so the databases are searched one after
+ * another in the job thread */
+static void
+pk_backend_search_syncdbs (PkAlpmSearch *search, const alpm_list_t *syncdbs)
+{
+	const alpm_list_t *i;
+
+	for (i = syncdbs; i != NULL; i = i->next) {
+		g_autoptr(GPtrArray) packages = g_ptr_array_new_with_free_func (g_object_unref);
+
+		if (pk_backend_job_is_cancelled (search->job))
+			break;
+
+		/* one batch per database, in repository order */
+		pk_backend_search_db (search, i->data, packages);
+		if (packages->len > 0)
+			pk_backend_job_packages (search->job, packages);
+	}
+}
+
 static void
 pk_backend_search_thread (PkBackendJob *job, GVariant* params, gpointer p)
 {
@@ -333,14 +470,13 @@ pk_backend_search_thread (PkBackendJob *job, GVariant* params, gpointer p)
 
 	PatternFunc pattern_func;
 	GDestroyNotify pattern_free;
-	MatchFunc match_func;
 
 	PkRoleEnum role;
 	PkBitfield filters = 0;
 	gboolean skip_local, skip_remote;
 
-	const alpm_list_t *i;
 	alpm_list_t *patterns = NULL;
+	PkAlpmSearch search = { 0 };
 	g_autoptr(GError) error = NULL;
 
 	g_return_if_fail (p == NULL);
@@ -386,10 +522,14 @@ pk_backend_search_thread (PkBackendJob *job, GVariant* params, gpointer p)
 
 	pattern_func = pattern_funcs[type];
 	pattern_free = pattern_frees[type];
-	match_func = match_funcs[type];
+
+	search.job = job;
+	search.localdb = priv->localdb;
+	search.match = match_funcs[type];
+	search.filters = filters;
 
 	g_return_if_fail (pattern_func != NULL);
-	g_return_if_fail (match_func != NULL);
+	g_return_if_fail (search.match != NULL);
 
 	skip_local = pk_bitfield_contain (filters,
 					  PK_FILTER_ENUM_NOT_INSTALLED);
@@ -406,21 +546,34 @@ pk_backend_search_thread (PkBackendJob *job, GVariant* params, gpointer p)
 			patterns = alpm_list_add (patterns, pattern);
 		}
 	}
+	search.patterns = patterns;
+	search.application = g_regex_new ("^usr/share/applications/.*\\.desktop$", 0, 0, NULL);
 
-	/* find installed packages first */
-	if (!skip_local)
-		pk_backend_search_db (job, priv->localdb, match_func, patterns, filters);
-
-	if (skip_remote)
+	/* look up files in the index instead of every package's file list */
+	if (type == SEARCH_TYPE_FILES &&
+	    pk_backend_search_files_index (&search, priv->alpm_check ? priv->alpm_check : priv->alpm,
+					   skip_local, skip_remote))
 		goto out;
 
-	for (i = alpm_get_syncdbs (priv->alpm_check ? priv->alpm_check : priv->alpm); i != NULL; i = i->next) {
-		if (pk_backend_job_is_cancelled (job))
-			break;
+	/* find installed packages first */
+	if (!skip_local) {
+		g_autoptr(GPtrArray) packages = g_ptr_array_new_with_free_func (g_object_unref);
 
-		pk_backend_search_db (job, i->data, match_func, patterns, filters);
+		pk_backend_search_db (&search, priv->localdb, packages);
+		if (packages->len > 0)
+			pk_backend_job_packages (job, packages);
 	}
+
+	if (skip_remote || pk_backend_job_is_cancelled (job))
+		goto out;
+
+	search.local_pkgs = pk_alpm_search_build_local_pkgs (priv->localdb);
+	pk_backend_search_syncdbs (&search, alpm_get_syncdbs (priv->alpm_check ? priv->alpm_check : priv->alpm));
 out:
+	if (search.local_pkgs != NULL)
+		g_hash_table_unref (search.local_pkgs);
+	if (search.application != NULL)
+		g_regex_unref (search.application);
 	if (pattern_free != NULL)
 		alpm_list_free_inner (patterns, pattern_free);
 	alpm_list_free (patterns);
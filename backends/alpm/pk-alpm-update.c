@@ -35,6 +35,7 @@
 #include "pk-backend-alpm.h"
 #include "pk-alpm-config.h"
 #include "pk-alpm-error.h"
+#include "pk-alpm-files-index.h"
 #include "pk-alpm-packages.h"
 #include "pk-alpm-transaction.h"
 #include "pk-alpm-update.h"
@@ -253,6 +254,7 @@ pk_alpm_refresh_databases (PkBackendJob *job, gint force, alpm_list_t *dbs, GErr
 {
 	PkBackend *backend = pk_backend_job_get_backend (job);
 	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+	g_autoptr(GError) error_local = NULL;
 	gint result;
 	alpm_list_t *i;
 
@@ -276,6 +278,11 @@ pk_alpm_refresh_databases (PkBackendJob *job, gint force, alpm_list_t *dbs, GErr
 			return FALSE;
 		}
 	}
+
+	/* rebuild the files index now rather than in the next SearchFile */
+	if (!pk_alpm_files_index_update (priv->alpm, &error_local))
+		g_warning ("failed to update files index: %s", error_local->message);
+
 	return TRUE;
 }
 
@@ -25,6 +25,7 @@
 
 #include <glib/gstdio.h>
 #include <glib/gthread.h>
+#include <string.h>
 #include <syslog.h>
 #include <pk-backend.h>
 
@@ -89,6 +90,11 @@ pk_alpm_initialize (PkBackend *backend, GError **error)
 	priv->alpm_check = NULL;
 	alpm_option_set_logcb (priv->alpm, pk_alpm_logcb, NULL);
 
+	/* the handle is replaced when the local database changes, but
+	 * always with the same configuration */
+	if (priv->lock_file == NULL)
+		priv->lock_file = g_strdup (alpm_option_get_lockfile (priv->alpm));
+
 	priv->localdb = alpm_get_localdb (priv->alpm);
 	if (priv->localdb == NULL) {
 		alpm_errno_t alpm_err = alpm_errno (priv->alpm);
@@ -99,39 +105,214 @@ pk_alpm_initialize (PkBackend *backend, GError **error)
 	return TRUE;
 }
 
+static void
+pk_alpm_release (PkBackend *backend)
+{
+	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+
+	pk_alpm_destroy_databases (backend);
+
+	if (priv->alpm != NULL) {
+		if (alpm_trans_get_flags (priv->alpm) < 0)
+			alpm_trans_release (priv->alpm);
+		alpm_release (priv->alpm);
+		priv->alpm = NULL;
+	}
+	priv->localdb = NULL;
+}
+
+static gpointer
+pk_alpm_warm_thread (gpointer user_data)
+{
+	PkBackend *backend = user_data;
+	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+	const alpm_list_t *i;
+
+	/* libalpm reads the databases lazily, do it now rather than in
+	 * the first job, which stops us before it touches the handle */
+	if (priv->localdb != NULL)
+		alpm_db_get_pkgcache (priv->localdb);
+	for (i = alpm_get_syncdbs (priv->alpm); i != NULL; i = i->next) {
+		if (g_atomic_int_get (&priv->warm_cancel))
+			break;
+		alpm_db_get_pkgcache (i->data);
+	}
+
+	return NULL;
+}
+
+static void
+pk_alpm_warm_stop (PkBackend *backend)
+{
+	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+
+	if (priv->warm_thread == NULL)
+		return;
+
+	g_atomic_int_set (&priv->warm_cancel, TRUE);
+	g_thread_join (priv->warm_thread);
+	priv->warm_thread = NULL;
+}
+
+static void
+pk_alpm_warm_start (PkBackend *backend)
+{
+	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+
+	pk_alpm_warm_stop (backend);
+
+	g_atomic_int_set (&priv->warm_cancel, FALSE);
+	priv->warm_thread = g_thread_new ("pk-alpm-warm", pk_alpm_warm_thread, backend);
+}
+
+/* must only be called from the main thread while no job thread is using
+ * the handle; on failure the databases stay marked as changed and are reloaded again
+ * before the next job */
+static gboolean
+pk_alpm_invalidate (PkBackend *backend, GError **error)
+{
+	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+
+	if (!priv->localdb_changed && g_hash_table_size (priv->syncdbs_changed) == 0)
+		return TRUE;
+
+	pk_alpm_warm_stop (backend);
+
+	if (priv->localdb_changed) {
+		/* the local database can only be reloaded with a new handle */
+		g_debug ("local database changed, reloading alpm");
+		pk_alpm_release (backend);
+		if (!pk_alpm_initialize (backend, error)) {
+			g_prefix_error (error, "Failed to initialize alpm: ");
+			return FALSE;
+		}
+		if (!pk_alpm_initialize_databases (backend, error)) {
+			g_prefix_error (error, "Failed to initialize databases: ");
+			return FALSE;
+		}
+		pk_backend_installed_db_changed (backend);
+	} else if (!pk_alpm_reload_databases (backend, priv->syncdbs_changed, error)) {
+		g_prefix_error (error, "Failed to reload databases: ");
+		return FALSE;
+	}
+
+	priv->localdb_changed = FALSE;
+	g_hash_table_remove_all (priv->syncdbs_changed);
+
+	pk_alpm_warm_start (backend);
+	return TRUE;
+}
+
+/* for the monitors, which have nobody to report the error to */
+static void
+pk_alpm_invalidate_or_warn (PkBackend *backend)
+{
+	g_autoptr(GError) error = NULL;
+
+	if (!pk_alpm_invalidate (backend, &error))
+		g_warning ("%s", error->message);
+}
+
+static gboolean
+pk_alpm_invalidate_timeout_cb (gpointer user_data)
+{
+	PkBackend *backend = user_data;
+	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+
+	priv->invalidate_id = 0;
+
+	/* retried from pk_backend_stop_job() */
+	if (priv->jobs_running == 0)
+		pk_alpm_invalidate_or_warn (backend);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+pk_alpm_invalidate_schedule (PkBackend *backend)
+{
+	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+
+	/* wait until pacman is done writing */
+	if (priv->invalidate_id != 0)
+		g_source_remove (priv->invalidate_id);
+	priv->invalidate_id = g_timeout_add_seconds (1, pk_alpm_invalidate_timeout_cb, backend);
+}
+
 static void
 pk_backend_context_invalidate_cb (GFileMonitor *monitor, GFile *file, GFile *other_file, GFileMonitorEvent event_type, PkBackend *backend)
 {
 	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
 	if (!pk_backend_is_transaction_inhibited (backend)) {
 		priv->localdb_changed = TRUE;
+		pk_alpm_invalidate_schedule (backend);
 	}
 }
 
+static void
+pk_backend_sync_invalidate_cb (GFileMonitor *monitor, GFile *file, GFile *other_file, GFileMonitorEvent event_type, PkBackend *backend)
+{
+	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+	g_autofree gchar *basename = NULL;
+
+	if (pk_backend_is_transaction_inhibited (backend))
+		return;
+
+	/* ignore signatures, partial downloads and the files index */
+	basename = g_file_get_basename (file);
+	if (!g_str_has_suffix (basename, ".db"))
+		return;
+
+	basename[strlen (basename) - 3] = '\0';
+	g_hash_table_add (priv->syncdbs_changed, g_steal_pointer (&basename));
+	pk_alpm_invalidate_schedule (backend);
+}
+
 static void
 pk_alpm_destroy_monitor (PkBackend *backend)
 {
 	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
 	g_object_unref (priv->monitor);
+	g_object_unref (priv->sync_monitor);
 }
 
-static gboolean
-pk_alpm_initialize_monitor (PkBackend *backend, GError **error)
+static GFileMonitor *
+pk_alpm_monitor_directory (PkBackend *backend, const gchar *name, GCallback callback, GError **error)
 {
 	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+	GFileMonitor *monitor;
 
 	g_autofree gchar * path = NULL;
 	g_autoptr(GFile) directory = NULL;
 
-	path = g_strconcat (alpm_option_get_dbpath (priv->alpm) ,"/local", NULL);
+	path = g_strconcat (alpm_option_get_dbpath (priv->alpm), "/", name, NULL);
 	directory = g_file_new_for_path (path);
 
-	priv->monitor = g_file_monitor_directory (directory, 0, NULL, error);
+	monitor = g_file_monitor_directory (directory, 0, NULL, error);
+	if (monitor == NULL)
+		return NULL;
+
+	g_signal_connect (monitor, "changed", callback, backend);
+	return monitor;
+}
+
+static gboolean
+pk_alpm_initialize_monitor (PkBackend *backend, GError **error)
+{
+	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+
+	priv->monitor = pk_alpm_monitor_directory (backend, "local",
+						   G_CALLBACK (pk_backend_context_invalidate_cb),
+						   error);
 	if (priv->monitor == NULL)
 		return FALSE;
 
-	g_signal_connect (priv->monitor, "changed",
-		G_CALLBACK (pk_backend_context_invalidate_cb), backend);
+	priv->sync_monitor = pk_alpm_monitor_directory (backend, "sync",
+							G_CALLBACK (pk_backend_sync_invalidate_cb),
+							error);
+	if (priv->sync_monitor == NULL)
+		return FALSE;
+
 	return TRUE;
 }
 
@@ -145,6 +326,8 @@ pk_backend_initialize (GKeyFile *conf, PkBackend *backend)
 	priv = g_new0 (PkBackendAlpmPrivate, 1);
 	pk_backend_set_user_data (backend, priv);
 
+	priv->syncdbs_changed = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
 	if (!pk_alpm_initialize (backend, &error))
 		g_error ("Failed to initialize alpm: %s", error->message);
 	if (!pk_alpm_initialize_databases (backend, &error))
@@ -156,24 +339,27 @@ pk_backend_initialize (GKeyFile *conf, PkBackend *backend)
 		g_error ("Failed to initialize monitor: %s", error->message);
 
 	priv->localdb_changed = FALSE;
+
+	pk_alpm_warm_start (backend);
 }
 
 void
 pk_backend_destroy (PkBackend *backend)
 {
 	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+
+	if (priv->invalidate_id != 0)
+		g_source_remove (priv->invalidate_id);
+	pk_alpm_warm_stop (backend);
+
 	pk_alpm_groups_destroy (backend);
-	pk_alpm_destroy_databases (backend);
 	pk_alpm_destroy_monitor (backend);
-
-	if (priv->alpm != NULL) {
-		if (alpm_trans_get_flags (priv->alpm) < 0)
-			alpm_trans_release (priv->alpm);
-		alpm_release (priv->alpm);
-	}
+	pk_alpm_release (backend);
 
 	FREELIST (priv->syncfirsts);
 	FREELIST (priv->holdpkgs);
+	g_hash_table_unref (priv->syncdbs_changed);
+	g_free (priv->lock_file);
 	g_free (priv);
 }
 
@@ -194,19 +380,75 @@ pk_backend_get_mime_types (PkBackend *backend)
 	return g_strdupv ((gchar **) mime_types);
 }
 
+const gchar *
+pk_backend_get_lock_file (PkBackend *backend)
+{
+	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+
+	/* db.lck, which pacman creates for the length of a transaction */
+	return priv->lock_file;
+}
+
+gboolean
+pk_backend_is_lock_held (PkBackend *backend)
+{
+	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+	const gchar *lock_file = priv->lock_file;
+	const gchar *pid;
+	g_autoptr(GDir) proc = NULL;
+
+	if (lock_file == NULL)
+		return TRUE;
+
+	/* libalpm keeps db.lck open for as long as it holds the lock, one
+	 * that nobody has open was left behind by a crashed pacman; it is
+	 * not an fcntl() lock, so there is no cheaper way to find out, but
+	 * this runs in a thread and never touches the alpm handle */
+	proc = g_dir_open ("/proc", 0, NULL);
+	if (proc == NULL)
+		return TRUE;
+	while ((pid = g_dir_read_name (proc)) != NULL) {
+		g_autofree gchar *fd_dir = NULL;
+		g_autoptr(GDir) fds = NULL;
+		const gchar *fd;
+
+		if (!g_ascii_isdigit (pid[0]))
+			continue;
+		fd_dir = g_build_filename ("/proc", pid, "fd", NULL);
+		fds = g_dir_open (fd_dir, 0, NULL);
+		if (fds == NULL)
+			continue;
+		while ((fd = g_dir_read_name (fds)) != NULL) {
+			g_autofree gchar *link = g_build_filename (fd_dir, fd, NULL);
+			g_autofree gchar *target = g_file_read_link (link, NULL);
+			if (g_strcmp0 (target, lock_file) == 0)
+				return TRUE;
+		}
+	}
+	return FALSE;
+}
+
 void
 pk_alpm_run (PkBackendJob *job, PkStatusEnum status, PkBackendJobThreadFunc func, gpointer data)
 {
 	PkBackend *backend = pk_backend_job_get_backend (job);
 	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+	g_autoptr(GError) error = NULL;
+
 	g_return_if_fail (func != NULL);
 
-	if (priv->localdb_changed) {
-		pk_backend_destroy (backend);
-		pk_backend_initialize (NULL, backend);
-		pk_backend_installed_db_changed (backend);
+	/* changes that arrived since the last job but not yet handled; this
+	 * job is already counted, but its thread hasn't started yet */
+	if (priv->jobs_running <= 1 && !pk_alpm_invalidate (backend, &error)) {
+		pk_alpm_error_emit (job, error);
+		pk_backend_job_finished (job);
+		return;
 	}
 
+	/* the background warm-up must be done with the handle before the
+	 * job thread uses it, the job loads whatever it didn't get to */
+	pk_alpm_warm_stop (backend);
+
 	pk_backend_job_set_allow_cancel (job, TRUE);
 	pk_backend_job_set_status (job, status);
 	pk_backend_job_thread_create (job, func, data, NULL);
@@ -223,5 +465,20 @@ pk_alpm_finish (PkBackendJob *job, GError *error)
 void
 pk_backend_start_job (PkBackend *backend, PkBackendJob *job)
 {
+	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+
+	priv->jobs_running++;
 	pk_alpm_environment_initialize (job);
 }
+
+void
+pk_backend_stop_job (PkBackend *backend, PkBackendJob *job)
+{
+	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+
+	priv->jobs_running--;
+
+	/* the monitors fired while the job was using the handle */
+	if (priv->jobs_running == 0 && priv->invalidate_id == 0)
+		pk_alpm_invalidate_or_warn (backend);
+}
@@ -32,8 +32,15 @@ typedef struct {
 	alpm_handle_t	*alpm;
 	alpm_handle_t	*alpm_check;
 	GFileMonitor    *monitor;
+	GFileMonitor	*sync_monitor;
 	alpm_list_t     *configured_repos; /* list of configured repos */
 	gboolean	localdb_changed;
+	GHashTable	*syncdbs_changed; /* names of changed sync dbs */
+	guint		invalidate_id;
+	guint		jobs_running;
+	GThread		*warm_thread;
+	gint		warm_cancel;
+	gchar		*lock_file; /* never changes, read from any thread */
 } PkBackendAlpmPrivate;
 
 void		 pk_alpm_run		(PkBackendJob *job, PkStatusEnum status,
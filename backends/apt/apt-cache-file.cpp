@@ -23,6 +23,8 @@
 
 #include <sstream>
 #include <cstdio>
+#include <atomic>
+#include <mutex>
 #include <apt-pkg/algorithms.h>
 #include <apt-pkg/progress.h>
 #include <apt-pkg/upgrade.h>
@@ -32,6 +34,14 @@
 
 using namespace APT;
 
+// invalidateShared() is called from the main loop, it only bumps the
+// generation and the outdated cache is dropped by the next job thread
+static std::atomic<guint> shared_cache_generation(0);
+static std::mutex shared_cache_mutex;
+static AptCacheFile *shared_cache = nullptr;
+static guint shared_cache_opened_generation = 0;
+static bool shared_cache_in_use = false;
+
 AptCacheFile::AptCacheFile(PkBackendJob *job) :
     m_packageRecords(0),
     m_job(job)
@@ -43,6 +53,86 @@ AptCacheFile::~AptCacheFile()
     Close();
 }
 
+AptCacheFile* AptCacheFile::acquireShared(PkBackendJob *job)
+{
+    std::lock_guard<std::mutex> lock(shared_cache_mutex);
+
+    if (shared_cache_in_use) {
+        return nullptr;
+    }
+
+    if (shared_cache != nullptr && shared_cache_opened_generation != shared_cache_generation) {
+        g_debug("Shared APT cache is outdated, reopening");
+        delete shared_cache;
+        shared_cache = nullptr;
+    }
+
+    if (shared_cache == nullptr) {
+        AptCacheFile *cache = new AptCacheFile(job);
+        // take the generation before opening, so changes done
+        // while we read the cache invalidate it again
+        guint generation = shared_cache_generation;
+        if (!cache->Open(false)) {
+            delete cache;
+            return nullptr;
+        }
+        shared_cache = cache;
+        shared_cache_opened_generation = generation;
+    } else {
+        shared_cache->setJob(job);
+    }
+
+    shared_cache_in_use = true;
+    return shared_cache;
+}
+
+void AptCacheFile::releaseShared(AptCacheFile *cache, bool resetDepCache)
+{
+    std::lock_guard<std::mutex> lock(shared_cache_mutex);
+
+    if (cache != shared_cache) {
+        delete cache;
+        return;
+    }
+
+    // The pkgcache and policy are never modified by jobs, only the
+    // marks in the dependency cache need to be thrown away
+    pkgDepCache *depCache = cache->DCache;
+    if (depCache != nullptr &&
+        (resetDepCache || depCache->InstCount() != 0 || depCache->DelCount() != 0)) {
+        OpProgress progress;
+        if (!depCache->Init(&progress)) {
+            _error->Discard();
+            shared_cache_generation++;
+        }
+    }
+
+    cache->setJob(nullptr);
+    shared_cache_in_use = false;
+}
+
+void AptCacheFile::invalidateShared()
+{
+    shared_cache_generation++;
+}
+
+void AptCacheFile::destroyShared()
+{
+    std::lock_guard<std::mutex> lock(shared_cache_mutex);
+
+    // a job still using it deletes it in releaseShared()
+    if (!shared_cache_in_use) {
+        delete shared_cache;
+    }
+    shared_cache = nullptr;
+    shared_cache_in_use = false;
+}
+
+void AptCacheFile::setJob(PkBackendJob *job)
+{
+    m_job = job;
+}
+
 bool AptCacheFile::Open(bool withLock)
 {
     OpPackageKitProgress progress(m_job);
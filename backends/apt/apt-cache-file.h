@@ -36,6 +36,34 @@ public:
     AptCacheFile(PkBackendJob *job);
     ~AptCacheFile();
 
+    /**
+      * Returns the read-only cache shared between jobs, opening it
+      * first if it was never opened or was invalidated since.
+      * @returns nullptr if the cache could not be opened or is in use
+      */
+    static AptCacheFile* acquireShared(PkBackendJob *job);
+
+    /**
+      * Hands the shared cache back after a job finished with it
+      * @param resetDepCache drop the marks the job left in the dependency cache
+      */
+    static void releaseShared(AptCacheFile *cache, bool resetDepCache);
+
+    /**
+      * Drops the shared cache, the next job will open a fresh one
+      */
+    static void invalidateShared();
+
+    /**
+      * Frees the shared cache when the backend is unloaded
+      */
+    static void destroyShared();
+
+    /**
+      * Sets the job progress and errors are reported to
+      */
+    void setJob(PkBackendJob *job);
+
     /**
       * Inits the package cache returning false if it can't open
       */
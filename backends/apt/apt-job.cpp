@@ -56,6 +56,7 @@
 #include "apt-messages.h"
 #include "acqpkitstatus.h"
 #include "deb-file.h"
+#include "dpkg-file-index.h"
 
 using namespace APT;
 
@@ -63,6 +64,7 @@ using namespace APT;
 
 AptJob::AptJob(PkBackendJob *job) :
     m_cache(nullptr),
+    m_sharedCache(false),
     m_job(job),
     m_cancel(false),
     m_lastSubProgress(0),
@@ -94,7 +96,49 @@ AptJob::AptJob(PkBackendJob *job) :
 
 AptJob::~AptJob()
 {
-    delete m_cache;
+    if (m_sharedCache) {
+        // Only pure queries leave the dependency cache untouched
+        PkRoleEnum role = pk_backend_job_get_role(m_job);
+        bool resetDepCache = role == PK_ROLE_ENUM_GET_UPDATES ||
+                             role == PK_ROLE_ENUM_INSTALL_PACKAGES ||
+                             role == PK_ROLE_ENUM_REMOVE_PACKAGES ||
+                             role == PK_ROLE_ENUM_UPDATE_PACKAGES;
+        AptCacheFile::releaseShared(m_cache, resetDepCache);
+    } else if (m_cache) {
+        delete m_cache;
+
+        // Jobs with a private cache may have changed the system or the
+        // package lists, don't wait for the file monitors to notice
+        AptCacheFile::invalidateShared();
+    }
+}
+
+bool AptJob::canUseSharedCache(PkRoleEnum role, bool simulate)
+{
+    switch (role) {
+    case PK_ROLE_ENUM_DEPENDS_ON:
+    case PK_ROLE_ENUM_REQUIRED_BY:
+    case PK_ROLE_ENUM_GET_DETAILS:
+    case PK_ROLE_ENUM_GET_FILES:
+    case PK_ROLE_ENUM_GET_PACKAGES:
+    case PK_ROLE_ENUM_GET_UPDATES:
+    case PK_ROLE_ENUM_GET_UPDATE_DETAIL:
+    case PK_ROLE_ENUM_RESOLVE:
+    case PK_ROLE_ENUM_SEARCH_DETAILS:
+    case PK_ROLE_ENUM_SEARCH_FILE:
+    case PK_ROLE_ENUM_SEARCH_GROUP:
+    case PK_ROLE_ENUM_SEARCH_NAME:
+    case PK_ROLE_ENUM_WHAT_PROVIDES:
+        return true;
+    case PK_ROLE_ENUM_INSTALL_PACKAGES:
+    case PK_ROLE_ENUM_REMOVE_PACKAGES:
+    case PK_ROLE_ENUM_UPDATE_PACKAGES:
+        // simulations only touch the dependency cache marks,
+        // which are reset when the job releases the cache
+        return simulate;
+    default:
+        return false;
+    }
 }
 
 bool AptJob::init(gchar **localDebs)
@@ -129,8 +173,16 @@ bool AptJob::init(gchar **localDebs)
         withLock = !simulate;
     }
 
+    // Reuse the cache of previous jobs if nothing changed since
+    if (localDebs == nullptr && canUseSharedCache(role, simulate)) {
+        m_cache = AptCacheFile::acquireShared(m_job);
+        m_sharedCache = m_cache != nullptr;
+    }
+
     // Create the AptCacheFile class to search for packages
-    m_cache = new AptCacheFile(m_job);
+    if (m_cache == nullptr) {
+        m_cache = new AptCacheFile(m_job);
+    }
     if (localDebs) {
         PkBitfield flags = pk_backend_job_get_transaction_flags(m_job);
         if (pk_bitfield_contain(flags, PK_TRANSACTION_FLAG_ENUM_ONLY_TRUSTED)) {
@@ -148,7 +200,13 @@ bool AptJob::init(gchar **localDebs)
 
     int timeout = 10;
     // TODO test this
-    while (m_cache->Open(withLock) == false) {
+    while (!m_sharedCache && m_cache->Open(withLock) == false) {
+        if (withLock && utilDpkgLockIsHeld()) {
+            // Someone else is using dpkg, the daemon retries as soon as
+            // they release the lock
+            show_errors(m_job, PK_ERROR_ENUM_LOCK_REQUIRED);
+            return false;
+        }
         if (withLock == false || (timeout <= 0)) {
             show_errors(m_job, PK_ERROR_ENUM_CANNOT_GET_LOCK);
             return false;
@@ -1264,68 +1322,13 @@ PkgList AptJob::searchPackageDetails(const vector<string> &queries)
 PkgList AptJob::searchPackageFiles(gchar **values)
 {
     PkgList output;
-    vector<string> packages;
-    string search;
-    regex_t re;
-
-    for (uint i = 0; i < g_strv_length(values); ++i) {
-        gchar *value = values[i];
-        if (strlen(value) < 1) {
-            continue;
-        }
-
-        if (!search.empty()) {
-            search.append("|");
-        }
+    DpkgFileIndex *index = DpkgFileIndex::instance();
 
-        if (value[0] == '/') {
-            search.append("^");
-            search.append(value);
-            search.append("$");
-        } else {
-            search.append(value);
-            search.append("$");
-        }
-    }
-
-    if(regcomp(&re, search.c_str(), REG_NOSUB) != 0) {
-        g_debug("Regex compilation error");
+    if (!index->update(&m_cancel) || m_cancel) {
         return output;
     }
 
-    DIR *dp;
-    struct dirent *dirp;
-    if (!(dp = opendir("/var/lib/dpkg/info/"))) {
-        g_debug ("Error opening /var/lib/dpkg/info/\n");
-        regfree(&re);
-        return output;
-    }
-
-    string line;
-    while ((dirp = readdir(dp)) != NULL) {
-        if (m_cancel) {
-            break;
-        }
-
-        if (ends_with(dirp->d_name, ".list")) {
-            string file(dirp->d_name);
-            string f = "/var/lib/dpkg/info/" + file;
-            ifstream in(f.c_str());
-            if (!in != 0) {
-                continue;
-            }
-
-            while (!in.eof()) {
-                getline(in, line);
-                if (regexec(&re, line.c_str(), (size_t)0, NULL, 0) == 0) {
-                    packages.push_back(file.erase(file.size() - 5, file.size()));
-                    break;
-                }
-            }
-        }
-    }
-    closedir(dp);
-    regfree(&re);
+    const vector<string> packages = index->search(values);
 
     // Resolve the package names now
     for (const string &name : packages) {
@@ -1791,42 +1794,194 @@ pkgCache::VerIterator AptJob::findTransactionPackage(const std::string &name)
     return candidateVer;
 }
 
-void AptJob::updateInterface(int fd, int writeFd, bool *errorEmitted)
+void AptJob::processStatusLine(const DpkgStatusLine &line, int writeFd, bool *errorEmitted)
 {
-    char buf[2];
-    static char line[1024] = "";
-
-    while (1) {
-        // This algorithm should be improved (it's the same as the rpm one ;)
-        int len = read(fd, buf, 1);
-
-        // nothing was read
-        if(len < 1)
-            break;
+    const std::string pkg(line.package);
+    const std::string str(line.message);
 
-        // update the time we last saw some action
-        m_lastTermAction = time(NULL);
-
-        if (buf[0] == '\n') {
-            if (m_cancel)
-                kill(m_child_pid, SIGTERM);
-
-            //cout << "got line: " << line << endl;
-
-            g_auto(GStrv) split   = g_strsplit(line, ":",5);
-            const gchar *status   = g_strstrip(split[0]);
-            const gchar *pkg      = g_strstrip(split[1]);
-            const gchar *percent  = g_strstrip(split[2]);
-            const std::string str = g_strstrip(split[3]);
+    // Since PackageKit doesn't emulate finished anymore
+    // we need to manually do it here, as at this point
+    // dpkg doesn't process two packages at the same time
+    if (!m_lastPackage.empty() && m_lastPackage != pkg) {
+        const pkgCache::VerIterator &ver = findTransactionPackage(m_lastPackage);
+        if (!ver.end()) {
+            emitPackage(ver, PK_INFO_ENUM_FINISHED);
+        }
+        m_lastSubProgress = 0;
+    }
 
-            // major problem here, we got unexpected input. should _never_ happen
-            if(pkg == nullptr && status == nullptr)
-                continue;
+    // first check for errors and conf-file prompts
+    if (line.status == "pmerror") {
+        // error from dpkg
+        pk_backend_job_error_code(m_job,
+                                  PK_ERROR_ENUM_PACKAGE_FAILED_TO_INSTALL,
+                                  "Error while installing package: %s",
+                                  str.c_str());
+        if (errorEmitted != nullptr)
+            *errorEmitted = true;
+    } else if (line.status == "pmconffile") {
+        // conffile-request from dpkg, needs to be parsed different
+        int i = 0;
+        string orig_file, new_file;
+
+        // go to first ' and read until the end
+        for(;str[i] != '\'' || str[i] == 0; i++)
+            /*nothing*/
+            ;
+        i++;
+        for(;str[i] != '\'' || str[i] == 0; i++)
+            orig_file.append(1, str[i]);
+        i++;
+
+        // same for second ' and read until the end
+        for(;str[i] != '\'' || str[i] == 0; i++)
+            /*nothing*/
+            ;
+        i++;
+        for(;str[i] != '\'' || str[i] == 0; i++)
+            new_file.append(1, str[i]);
+        i++;
+
+        gchar *filename;
+        filename = g_build_filename(DATADIR, "PackageKit", "helpers", "apt", "pkconffile", NULL);
+        gchar **argv;
+        gchar **envp;
+        GError *error = NULL;
+        argv = (gchar **) g_malloc(5 * sizeof(gchar *));
+        argv[0] = filename;
+        argv[1] = g_strdup(m_lastPackage.c_str());
+        argv[2] = g_strdup(orig_file.c_str());
+        argv[3] = g_strdup(new_file.c_str());
+        argv[4] = NULL;
 
-            // Since PackageKit doesn't emulate finished anymore
-            // we need to manually do it here, as at this point
-            // dpkg doesn't process two packages at the same time
-            if (!m_lastPackage.empty() && m_lastPackage.compare(pkg) != 0) {
+        const gchar *socket = pk_backend_job_get_frontend_socket(m_job);
+        if ((m_interactive) && (socket != NULL)) {
+            envp = (gchar **) g_malloc(3 * sizeof(gchar *));
+            envp[0] = g_strdup("DEBIAN_FRONTEND=passthrough");
+            envp[1] = g_strdup_printf("DEBCONF_PIPE=%s", socket);
+            envp[2] = NULL;
+        } else {
+            // we don't have a socket set or are non-interactive. Use the noninteractive frontend.
+            envp = (gchar **) g_malloc(2 * sizeof(gchar *));
+            envp[0] = g_strdup("DEBIAN_FRONTEND=noninteractive");
+            envp[1] = NULL;
+        }
+
+        gboolean ret;
+        gint exitStatus;
+        ret = g_spawn_sync(NULL, // working dir
+                           argv, // argv
+                           envp, // envp
+                           G_SPAWN_LEAVE_DESCRIPTORS_OPEN,
+                           NULL, // child_setup
+                           NULL, // user_data
+                           NULL, // standard_output
+                           NULL, // standard_error
+                           &exitStatus,
+                           &error);
+
+        int exit_code = WEXITSTATUS(exitStatus);
+        cout << filename << " " << exit_code << " ret: "<< ret << endl;
+
+        g_strfreev(argv);
+        g_strfreev(envp);
+
+        if (exit_code == 10) {
+            // 1 means the user wants the package config
+            if (write(writeFd, "Y\n", 2) != 2) {
+                // TODO we need a DPKG patch to use debconf
+                g_debug("Failed to write");
+            }
+        } else if (exit_code == 20) {
+            // 2 means the user wants to keep the current config
+            if (write(writeFd, "N\n", 2) != 2) {
+                // TODO we need a DPKG patch to use debconf
+                g_debug("Failed to write");
+            }
+        } else {
+            // either the user didn't choose an option or the front end failed'
+            //                     pk_backend_job_message(m_job,
+            //                                            PK_MESSAGE_ENUM_CONFIG_FILES_CHANGED,
+            //                                            "The configuration file '%s' "
+            //                                            "(modified by you or a script) "
+            //                                            "has a newer version '%s'.\n"
+            //                                            "Please verify your changes and update it manually.",
+            //                                            orig_file.c_str(),
+            //                                            new_file.c_str());
+            // fall back to keep the current config file
+            if (write(writeFd, "N\n", 2) != 2) {
+                // TODO we need a DPKG patch to use debconf
+                g_debug("Failed to write");
+            }
+        }
+    } else if (line.status == "pmstatus") {
+        // INSTALL & UPDATE
+        // - Running dpkg
+        // loops ALL
+        // -  0 Installing pkg (sometimes this is skiped)
+        // - 25 Preparing pkg
+        // - 50 Unpacking pkg
+        // - 75 Preparing to configure pkg
+        //   ** Some pkgs have
+        //   - Running post-installation
+        //   - Running dpkg
+        // reloops all
+        // -   0 Configuring pkg
+        // - +25 Configuring pkg (SOMETIMES)
+        // - 100 Installed pkg
+        // after all
+        // - Running post-installation
+
+        // REMOVE
+        // - Running dpkg
+        // loops
+        // - 25  Removing pkg
+        // - 50  Preparing for removal of pkg
+        // - 75  Removing pkg
+        // - 100 Removed pkg
+        // after all
+        // - Running post-installation
+
+        // Let's start parsing the status:
+        if (starts_with(str, "Preparing to configure")) {
+            // Preparing to Install/configure
+            // cout << "Found Preparing to configure! " << line << endl;
+            // The next item might be Configuring so better it be 100
+            m_lastSubProgress = 100;
+            const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
+            if (!ver.end()) {
+                emitPackage(ver, PK_INFO_ENUM_PREPARING);
+                emitPackageProgress(ver, PK_STATUS_ENUM_SETUP, 75);
+            }
+        } else if (starts_with(str, "Preparing for removal")) {
+            // Preparing to Install/configure
+            // cout << "Found Preparing for removal! " << line << endl;
+            m_lastSubProgress = 50;
+            const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
+            if (!ver.end()) {
+                emitPackage(ver, PK_INFO_ENUM_REMOVING);
+                emitPackageProgress(ver, PK_STATUS_ENUM_SETUP, m_lastSubProgress);
+            }
+        } else if (starts_with(str, "Preparing")) {
+            // Preparing to Install/configure
+            // cout << "Found Preparing! " << line << endl;
+            const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
+            if (!ver.end()) {
+                emitPackage(ver, PK_INFO_ENUM_PREPARING);
+                emitPackageProgress(ver, PK_STATUS_ENUM_SETUP, 25);
+            }
+        } else if (starts_with(str, "Unpacking")) {
+            // cout << "Found Unpacking! " << line << endl;
+            const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
+            if (!ver.end()) {
+                emitPackage(ver, PK_INFO_ENUM_DECOMPRESSING);
+                emitPackageProgress(ver, PK_STATUS_ENUM_INSTALL, 50);
+            }
+        } else if (starts_with(str, "Configuring")) {
+            // Installing Package
+            // cout << "Found Configuring! " << line << endl;
+            if (m_lastSubProgress >= 100 && !m_lastPackage.empty()) {
+                // cout << "FINISH the last package: " << m_lastPackage << endl;
                 const pkgCache::VerIterator &ver = findTransactionPackage(m_lastPackage);
                 if (!ver.end()) {
                     emitPackage(ver, PK_INFO_ENUM_FINISHED);
@@ -1834,261 +1989,86 @@ void AptJob::updateInterface(int fd, int writeFd, bool *errorEmitted)
                 m_lastSubProgress = 0;
             }
 
-            // first check for errors and conf-file prompts
-            if (strstr(status, "pmerror") != NULL) {
-                // error from dpkg
-                pk_backend_job_error_code(m_job,
-                                          PK_ERROR_ENUM_PACKAGE_FAILED_TO_INSTALL,
-                                          "Error while installing package: %s",
-                                          str.c_str());
-                if (errorEmitted != nullptr)
-                    *errorEmitted = true;
-            } else if (strstr(status, "pmconffile") != NULL) {
-                // conffile-request from dpkg, needs to be parsed different
-                int i = 0;
-                string orig_file, new_file;
-
-                // go to first ' and read until the end
-                for(;str[i] != '\'' || str[i] == 0; i++)
-                    /*nothing*/
-                    ;
-                i++;
-                for(;str[i] != '\'' || str[i] == 0; i++)
-                    orig_file.append(1, str[i]);
-                i++;
-
-                // same for second ' and read until the end
-                for(;str[i] != '\'' || str[i] == 0; i++)
-                    /*nothing*/
-                    ;
-                i++;
-                for(;str[i] != '\'' || str[i] == 0; i++)
-                    new_file.append(1, str[i]);
-                i++;
-
-                gchar *filename;
-                filename = g_build_filename(DATADIR, "PackageKit", "helpers", "apt", "pkconffile", NULL);
-                gchar **argv;
-                gchar **envp;
-                GError *error = NULL;
-                argv = (gchar **) g_malloc(5 * sizeof(gchar *));
-                argv[0] = filename;
-                argv[1] = g_strdup(m_lastPackage.c_str());
-                argv[2] = g_strdup(orig_file.c_str());
-                argv[3] = g_strdup(new_file.c_str());
-                argv[4] = NULL;
-
-                const gchar *socket = pk_backend_job_get_frontend_socket(m_job);
-                if ((m_interactive) && (socket != NULL)) {
-                    envp = (gchar **) g_malloc(3 * sizeof(gchar *));
-                    envp[0] = g_strdup("DEBIAN_FRONTEND=passthrough");
-                    envp[1] = g_strdup_printf("DEBCONF_PIPE=%s", socket);
-                    envp[2] = NULL;
-                } else {
-                    // we don't have a socket set or are non-interactive. Use the noninteractive frontend.
-                    envp = (gchar **) g_malloc(2 * sizeof(gchar *));
-                    envp[0] = g_strdup("DEBIAN_FRONTEND=noninteractive");
-                    envp[1] = NULL;
-                }
-
-                gboolean ret;
-                gint exitStatus;
-                ret = g_spawn_sync(NULL, // working dir
-                                   argv, // argv
-                                   envp, // envp
-                                   G_SPAWN_LEAVE_DESCRIPTORS_OPEN,
-                                   NULL, // child_setup
-                                   NULL, // user_data
-                                   NULL, // standard_output
-                                   NULL, // standard_error
-                                   &exitStatus,
-                                   &error);
-
-                int exit_code = WEXITSTATUS(exitStatus);
-                cout << filename << " " << exit_code << " ret: "<< ret << endl;
-
-                g_strfreev(argv);
-                g_strfreev(envp);
-
-                if (exit_code == 10) {
-                    // 1 means the user wants the package config
-                    if (write(writeFd, "Y\n", 2) != 2) {
-                        // TODO we need a DPKG patch to use debconf
-                        g_debug("Failed to write");
-                    }
-                } else if (exit_code == 20) {
-                    // 2 means the user wants to keep the current config
-                    if (write(writeFd, "N\n", 2) != 2) {
-                        // TODO we need a DPKG patch to use debconf
-                        g_debug("Failed to write");
-                    }
-                } else {
-                    // either the user didn't choose an option or the front end failed'
-                    //                     pk_backend_job_message(m_job,
-                    //                                            PK_MESSAGE_ENUM_CONFIG_FILES_CHANGED,
-                    //                                            "The configuration file '%s' "
-                    //                                            "(modified by you or a script) "
-                    //                                            "has a newer version '%s'.\n"
-                    //                                            "Please verify your changes and update it manually.",
-                    //                                            orig_file.c_str(),
-                    //                                            new_file.c_str());
-                    // fall back to keep the current config file
-                    if (write(writeFd, "N\n", 2) != 2) {
-                        // TODO we need a DPKG patch to use debconf
-                        g_debug("Failed to write");
-                    }
-                }
-            } else if (strstr(status, "pmstatus") != NULL) {
-                // INSTALL & UPDATE
-                // - Running dpkg
-                // loops ALL
-                // -  0 Installing pkg (sometimes this is skiped)
-                // - 25 Preparing pkg
-                // - 50 Unpacking pkg
-                // - 75 Preparing to configure pkg
-                //   ** Some pkgs have
-                //   - Running post-installation
-                //   - Running dpkg
-                // reloops all
-                // -   0 Configuring pkg
-                // - +25 Configuring pkg (SOMETIMES)
-                // - 100 Installed pkg
-                // after all
-                // - Running post-installation
-
-                // REMOVE
-                // - Running dpkg
-                // loops
-                // - 25  Removing pkg
-                // - 50  Preparing for removal of pkg
-                // - 75  Removing pkg
-                // - 100 Removed pkg
-                // after all
-                // - Running post-installation
-
-                // Let's start parsing the status:
-                if (starts_with(str, "Preparing to configure")) {
-                    // Preparing to Install/configure
-                    // cout << "Found Preparing to configure! " << line << endl;
-                    // The next item might be Configuring so better it be 100
-                    m_lastSubProgress = 100;
-                    const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
-                    if (!ver.end()) {
-                        emitPackage(ver, PK_INFO_ENUM_PREPARING);
-                        emitPackageProgress(ver, PK_STATUS_ENUM_SETUP, 75);
-                    }
-                } else if (starts_with(str, "Preparing for removal")) {
-                    // Preparing to Install/configure
-                    // cout << "Found Preparing for removal! " << line << endl;
-                    m_lastSubProgress = 50;
-                    const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
-                    if (!ver.end()) {
-                        emitPackage(ver, PK_INFO_ENUM_REMOVING);
-                        emitPackageProgress(ver, PK_STATUS_ENUM_SETUP, m_lastSubProgress);
-                    }
-                } else if (starts_with(str, "Preparing")) {
-                    // Preparing to Install/configure
-                    // cout << "Found Preparing! " << line << endl;
-                    const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
-                    if (!ver.end()) {
-                        emitPackage(ver, PK_INFO_ENUM_PREPARING);
-                        emitPackageProgress(ver, PK_STATUS_ENUM_SETUP, 25);
-                    }
-                } else if (starts_with(str, "Unpacking")) {
-                    // cout << "Found Unpacking! " << line << endl;
-                    const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
-                    if (!ver.end()) {
-                        emitPackage(ver, PK_INFO_ENUM_DECOMPRESSING);
-                        emitPackageProgress(ver, PK_STATUS_ENUM_INSTALL, 50);
-                    }
-                } else if (starts_with(str, "Configuring")) {
-                    // Installing Package
-                    // cout << "Found Configuring! " << line << endl;
-                    if (m_lastSubProgress >= 100 && !m_lastPackage.empty()) {
-                        // cout << "FINISH the last package: " << m_lastPackage << endl;
-                        const pkgCache::VerIterator &ver = findTransactionPackage(m_lastPackage);
-                        if (!ver.end()) {
-                            emitPackage(ver, PK_INFO_ENUM_FINISHED);
-                        }
-                        m_lastSubProgress = 0;
-                    }
-
-                    const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
-                    if (!ver.end()) {
-                        emitPackage(ver, PK_INFO_ENUM_INSTALLING);
-                        emitPackageProgress(ver, PK_STATUS_ENUM_INSTALL, m_lastSubProgress);
-                    }
-                    m_lastSubProgress += 25;
-                } else if (starts_with(str, "Running dpkg")) {
-                    // cout << "Found Running dpkg! " << line << endl;
-                } else if (starts_with(str, "Running")) {
-                    // cout << "Found Running! " << line << endl;
-                    pk_backend_job_set_status (m_job, PK_STATUS_ENUM_COMMIT);
-                } else if (starts_with(str, "Installing")) {
-                    // cout << "Found Installing! " << line << endl;
-                    // FINISH the last package
-                    if (!m_lastPackage.empty()) {
-                        // cout << "FINISH the last package: " << m_lastPackage << endl;
-                        const pkgCache::VerIterator &ver = findTransactionPackage(m_lastPackage);
-                        if (!ver.end()) {
-                            emitPackage(ver, PK_INFO_ENUM_FINISHED);
-                        }
-                    }
-                    m_lastSubProgress = 0;
-                    const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
-                    if (!ver.end()) {
-                        emitPackage(ver, PK_INFO_ENUM_INSTALLING);
-                        emitPackageProgress(ver, PK_STATUS_ENUM_INSTALL, m_lastSubProgress);
-                    }
-                } else if (starts_with(str, "Removing")) {
-                    // cout << "Found Removing! " << line << endl;
-                    if (m_lastSubProgress >= 100 && !m_lastPackage.empty()) {
-                        // cout << "FINISH the last package: " << m_lastPackage << endl;
-                        const pkgCache::VerIterator &ver = findTransactionPackage(m_lastPackage);
-                        if (!ver.end()) {
-                            emitPackage(ver, PK_INFO_ENUM_FINISHED);
-                        }
-                    }
-                    m_lastSubProgress += 25;
-
-                    const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
-                    if (!ver.end()) {
-                        emitPackage(ver, PK_INFO_ENUM_REMOVING);
-                        emitPackageProgress(ver, PK_STATUS_ENUM_REMOVE, m_lastSubProgress);
-                    }
-                } else if (starts_with(str, "Installed") ||
-                           starts_with(str, "Removed")) {
-                    // cout << "Found FINISHED! " << line << endl;
-                    m_lastSubProgress = 100;
-                    const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
-                    if (!ver.end()) {
-                        emitPackage(ver, PK_INFO_ENUM_FINISHED);
-                        //                         emitPackageProgress(ver, m_lastSubProgress);
-                    }
-                } else {
-                    g_debug("apt-backend: >>>Unmaped dpkg status value: %s", line);
+            const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
+            if (!ver.end()) {
+                emitPackage(ver, PK_INFO_ENUM_INSTALLING);
+                emitPackageProgress(ver, PK_STATUS_ENUM_INSTALL, m_lastSubProgress);
+            }
+            m_lastSubProgress += 25;
+        } else if (starts_with(str, "Running dpkg")) {
+            // cout << "Found Running dpkg! " << line << endl;
+        } else if (starts_with(str, "Running")) {
+            // cout << "Found Running! " << line << endl;
+            pk_backend_job_set_status (m_job, PK_STATUS_ENUM_COMMIT);
+        } else if (starts_with(str, "Installing")) {
+            // cout << "Found Installing! " << line << endl;
+            // FINISH the last package
+            if (!m_lastPackage.empty()) {
+                // cout << "FINISH the last package: " << m_lastPackage << endl;
+                const pkgCache::VerIterator &ver = findTransactionPackage(m_lastPackage);
+                if (!ver.end()) {
+                    emitPackage(ver, PK_INFO_ENUM_FINISHED);
                 }
-
-                if (!starts_with(str, "Running")) {
-                    m_lastPackage = pkg;
+            }
+            m_lastSubProgress = 0;
+            const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
+            if (!ver.end()) {
+                emitPackage(ver, PK_INFO_ENUM_INSTALLING);
+                emitPackageProgress(ver, PK_STATUS_ENUM_INSTALL, m_lastSubProgress);
+            }
+        } else if (starts_with(str, "Removing")) {
+            // cout << "Found Removing! " << line << endl;
+            if (m_lastSubProgress >= 100 && !m_lastPackage.empty()) {
+                // cout << "FINISH the last package: " << m_lastPackage << endl;
+                const pkgCache::VerIterator &ver = findTransactionPackage(m_lastPackage);
+                if (!ver.end()) {
+                    emitPackage(ver, PK_INFO_ENUM_FINISHED);
                 }
-                m_startCounting = true;
-            } else {
-                m_startCounting = true;
             }
+            m_lastSubProgress += 25;
 
-            int val = atoi(percent);
-            //cout << "progress: " << val << endl;
-            pk_backend_job_set_percentage(m_job, val);
-
-            // clean-up
-            line[0] = 0;
+            const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
+            if (!ver.end()) {
+                emitPackage(ver, PK_INFO_ENUM_REMOVING);
+                emitPackageProgress(ver, PK_STATUS_ENUM_REMOVE, m_lastSubProgress);
+            }
+        } else if (starts_with(str, "Installed") ||
+                   starts_with(str, "Removed")) {
+            // cout << "Found FINISHED! " << line << endl;
+            m_lastSubProgress = 100;
+            const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
+            if (!ver.end()) {
+                emitPackage(ver, PK_INFO_ENUM_FINISHED);
+                //                         emitPackageProgress(ver, m_lastSubProgress);
+            }
         } else {
-            buf[1] = 0;
-            strcat(line, buf);
+            g_debug("apt-backend: >>>Unmaped dpkg status value: %s", str.c_str());
         }
+
+        if (!starts_with(str, "Running")) {
+            m_lastPackage = pkg;
+        }
+        m_startCounting = true;
+    } else {
+        m_startCounting = true;
     }
 
+    pk_backend_job_set_percentage(m_job, line.percentage());
+}
+
+void AptJob::updateInterface(int fd, int writeFd, bool *errorEmitted)
+{
+    size_t len = m_statusReader.read(fd, [&](const DpkgStatusLine &line) {
+        if (m_cancel)
+            kill(m_child_pid, SIGTERM);
+
+        processStatusLine(line, writeFd, errorEmitted);
+    });
+
+    // update the time we last saw some action
+    if (len > 0)
+        m_lastTermAction = time(NULL);
+
     time_t now = time(NULL);
 
     if (!m_startCounting) {
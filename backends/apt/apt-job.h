@@ -33,6 +33,7 @@
 
 #include "pkg-list.h"
 #include "apt-sourceslist.h"
+#include "dpkg-status-reader.h"
 
 #define REBOOT_REQUIRED_FILE    "/run/reboot-required"
 
@@ -248,6 +249,7 @@ private:
     bool isApplication(const pkgCache::VerIterator &verIter);
     bool matchesQueries(const vector<string> &queries, string s);
     bool dpkgHasForceConfFileSet();
+    static bool canUseSharedCache(PkRoleEnum role, bool simulate);
     PkInfoEnum packageStateFromVer(const pkgCache::VerIterator &ver) const;
     void stagePackageForEmit(GPtrArray *array, const pkgCache::VerIterator &ver,
                              PkInfoEnum state = PK_INFO_ENUM_UNKNOWN,
@@ -258,10 +260,12 @@ private:
      *  interprets dpkg status fd
      */
     void updateInterface(int readFd, int writeFd, bool *errorEmitted = nullptr);
+    void processStatusLine(const DpkgStatusLine &line, int writeFd, bool *errorEmitted);
     PkgList checkChangedPackages(bool emitChanged);
     pkgCache::VerIterator findTransactionPackage(const std::string &name);
 
     AptCacheFile *m_cache;
+    bool m_sharedCache;
     PkBackendJob *m_job;
     bool       m_cancel;
     struct stat m_restartStat;
@@ -270,6 +274,7 @@ private:
     PkgList m_pkgs;
     PkgList m_restartPackages;
 
+    DpkgStatusReader m_statusReader;
     time_t     m_lastTermAction;
     string     m_lastPackage;
     uint       m_lastSubProgress;
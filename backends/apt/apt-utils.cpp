@@ -21,6 +21,7 @@
 
 #include "apt-utils.h"
 
+#include <apt-pkg/configuration.h>
 #include <apt-pkg/fileutl.h>
 #include <apt-pkg/error.h>
 #include <apt-pkg/pkgsystem.h>
@@ -28,6 +29,9 @@
 #include <apt-pkg/acquire-item.h>
 #include <glib/gstdio.h>
 
+#include <fcntl.h>
+#include <unistd.h>
+
 #include <fstream>
 #include <regex>
 
@@ -393,6 +397,29 @@ bool utilRestartRequired(const string &packageName)
     return false;
 }
 
+string utilDpkgLockFile()
+{
+    return flNotFile(_config->FindFile("Dir::State::status")) + "lock-frontend";
+}
+
+bool utilDpkgLockIsHeld()
+{
+    struct flock fl = {};
+    bool held;
+    int fd;
+
+    fd = open(utilDpkgLockFile().c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    // ask who would prevent us from taking the lock, without taking it
+    fl.l_type = F_WRLCK;
+    fl.l_whence = SEEK_SET;
+    held = fcntl(fd, F_GETLK, &fl) == 0 && fl.l_type != F_UNLCK;
+    close(fd);
+    return held;
+}
+
 string utilBuildPackageOriginId(pkgCache::VerFileIterator vf)
 {
     if (vf.File().Origin() == nullptr)
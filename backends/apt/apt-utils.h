@@ -71,6 +71,16 @@ bool starts_with(const string &str, const char *end);
   */
 bool utilRestartRequired(const string &packageName);
 
+/**
+  * Return the path of the lock dpkg frontends take while changing the system
+  */
+string utilDpkgLockFile();
+
+/**
+  * Return true if another process holds the dpkg frontend lock
+  */
+bool utilDpkgLockIsHeld();
+
 /**
  * Build a unique repository origin, in the form of
  * {distro}-{suite}-{component}
@@ -0,0 +1,347 @@
+/* dpkg-file-index.cpp - Index of the files owned by installed packages
+ *
+ * Copyright (c) 2026 PackageKit contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "dpkg-file-index.h"
+
+#include <glib/gstdio.h>
+
+#include <sys/stat.h>
+#include <dirent.h>
+#include <string.h>
+#include <errno.h>
+
+#include <algorithm>
+#include <unordered_set>
+
+#include "apt-utils.h"
+
+#define DPKG_INFO_DIR           "/var/lib/dpkg/info"
+#define DPKG_FILE_INDEX_MAGIC   "PackageKit dpkg file index 1"
+
+static gint64 stat_mtime(const struct stat &st)
+{
+    return (gint64) st.st_mtim.tv_sec * G_USEC_PER_SEC + st.st_mtim.tv_nsec / 1000;
+}
+
+static string path_basename(const string &path)
+{
+    size_t pos = path.rfind('/');
+    return pos == string::npos ? path : path.substr(pos + 1);
+}
+
+DpkgFileIndex::DpkgFileIndex(const string &infoDir, const string &cacheFile) :
+    m_infoDir(infoDir),
+    m_cacheFile(cacheFile),
+    m_infoDirMtime(0),
+    m_loaded(false)
+{
+}
+
+DpkgFileIndex *DpkgFileIndex::instance()
+{
+    static DpkgFileIndex *index = nullptr;
+    static std::once_flag once;
+
+    std::call_once(once, [] {
+        g_autofree gchar *cacheFile = g_build_filename(LOCALSTATEDIR, "cache", "PackageKit",
+                                                       "apt-file-index", NULL);
+        index = new DpkgFileIndex(DPKG_INFO_DIR, cacheFile);
+    });
+    return index;
+}
+
+void DpkgFileIndex::addPackage(const string &name, ListEntry &&entry)
+{
+    for (const string &path : entry.files) {
+        vector<string> &owners = m_pathOwners[path];
+        if (owners.empty()) {
+            m_basenames[path_basename(path)].push_back(path);
+        }
+        owners.push_back(name);
+    }
+    m_packages[name] = std::move(entry);
+}
+
+void DpkgFileIndex::removePackage(const string &name)
+{
+    auto it = m_packages.find(name);
+    if (it == m_packages.end()) {
+        return;
+    }
+
+    for (const string &path : it->second.files) {
+        auto owners = m_pathOwners.find(path);
+        if (owners == m_pathOwners.end()) {
+            continue;
+        }
+
+        owners->second.erase(std::remove(owners->second.begin(), owners->second.end(), name),
+                             owners->second.end());
+        if (!owners->second.empty()) {
+            continue;
+        }
+        m_pathOwners.erase(owners);
+
+        auto paths = m_basenames.find(path_basename(path));
+        if (paths != m_basenames.end()) {
+            paths->second.erase(std::remove(paths->second.begin(), paths->second.end(), path),
+                                paths->second.end());
+            if (paths->second.empty()) {
+                m_basenames.erase(paths);
+            }
+        }
+    }
+    m_packages.erase(it);
+}
+
+bool DpkgFileIndex::readListFile(const string &filename, vector<string> &files) const
+{
+    g_autofree gchar *contents = nullptr;
+    gsize length = 0;
+
+    if (!g_file_get_contents(filename.c_str(), &contents, &length, nullptr)) {
+        return false;
+    }
+
+    const gchar *line = contents;
+    const gchar *end = contents + length;
+    while (line < end) {
+        const gchar *eol = static_cast<const gchar*>(memchr(line, '\n', end - line));
+        if (eol == nullptr) {
+            eol = end;
+        }
+        if (eol > line) {
+            files.emplace_back(line, eol - line);
+        }
+        line = eol + 1;
+    }
+    return true;
+}
+
+bool DpkgFileIndex::load()
+{
+    g_autofree gchar *contents = nullptr;
+    gsize length = 0;
+
+    if (!g_file_get_contents(m_cacheFile.c_str(), &contents, &length, nullptr)) {
+        return false;
+    }
+
+    // The format is a header line followed by one record per package:
+    //   <name> \t <mtime> \t <number of files> \n
+    //   <path> \n ...
+    const gchar *pos = contents;
+    const gchar *end = contents + length;
+    auto nextLine = [&pos, end](string &out) {
+        if (pos >= end) {
+            return false;
+        }
+        const gchar *eol = static_cast<const gchar*>(memchr(pos, '\n', end - pos));
+        if (eol == nullptr) {
+            return false;
+        }
+        out.assign(pos, eol - pos);
+        pos = eol + 1;
+        return true;
+    };
+
+    string line;
+    if (!nextLine(line) || line != DPKG_FILE_INDEX_MAGIC) {
+        g_debug("Ignoring file index %s with unknown format", m_cacheFile.c_str());
+        return false;
+    }
+
+    while (nextLine(line)) {
+        g_auto(GStrv) fields = g_strsplit(line.c_str(), "\t", 3);
+        if (g_strv_length(fields) != 3) {
+            g_warning("Corrupt file index %s", m_cacheFile.c_str());
+            m_packages.clear();
+            m_pathOwners.clear();
+            m_basenames.clear();
+            return false;
+        }
+
+        ListEntry entry;
+        entry.mtime = g_ascii_strtoll(fields[1], nullptr, 10);
+        guint64 count = g_ascii_strtoull(fields[2], nullptr, 10);
+        entry.files.reserve(count);
+        for (guint64 i = 0; i < count && nextLine(line); ++i) {
+            entry.files.push_back(line);
+        }
+        addPackage(fields[0], std::move(entry));
+    }
+
+    return true;
+}
+
+bool DpkgFileIndex::save() const
+{
+    g_autoptr(GError) error = nullptr;
+    g_autofree gchar *dirname = g_path_get_dirname(m_cacheFile.c_str());
+    string data;
+
+    data.append(DPKG_FILE_INDEX_MAGIC "\n");
+    for (const auto &pkg : m_packages) {
+        data.append(pkg.first);
+        data.append("\t");
+        data.append(std::to_string(pkg.second.mtime));
+        data.append("\t");
+        data.append(std::to_string(pkg.second.files.size()));
+        data.append("\n");
+        for (const string &path : pkg.second.files) {
+            data.append(path);
+            data.append("\n");
+        }
+    }
+
+    if (g_mkdir_with_parents(dirname, 0755) < 0 ||
+        !g_file_set_contents(m_cacheFile.c_str(), data.c_str(), data.size(), &error)) {
+        g_warning("Failed to write file index %s: %s",
+                  m_cacheFile.c_str(),
+                  error ? error->message : g_strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+bool DpkgFileIndex::update(const bool *cancel)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    struct stat st;
+
+    if (!m_loaded) {
+        load();
+        m_loaded = true;
+    }
+
+    // dpkg replaces .list files by renaming them into place, so the
+    // directory mtime tells us whether anything changed at all
+    if (g_stat(m_infoDir.c_str(), &st) != 0) {
+        g_debug("Error opening %s", m_infoDir.c_str());
+        return false;
+    }
+    const gint64 infoDirMtime = stat_mtime(st);
+    if (m_infoDirMtime != 0 && infoDirMtime == m_infoDirMtime) {
+        return true;
+    }
+
+    DIR *dp = opendir(m_infoDir.c_str());
+    if (dp == nullptr) {
+        g_debug("Error opening %s", m_infoDir.c_str());
+        return false;
+    }
+
+    unordered_set<string> seen;
+    bool changed = false;
+    struct dirent *dirp;
+    while ((dirp = readdir(dp)) != nullptr) {
+        if (cancel != nullptr && *cancel) {
+            closedir(dp);
+            return true;
+        }
+
+        string file(dirp->d_name);
+        if (!ends_with(file, ".list")) {
+            continue;
+        }
+
+        string name = file.substr(0, file.size() - 5);
+        string filename = m_infoDir + "/" + file;
+        if (g_stat(filename.c_str(), &st) != 0) {
+            continue;
+        }
+        seen.insert(name);
+
+        auto it = m_packages.find(name);
+        if (it != m_packages.end() && it->second.mtime == stat_mtime(st)) {
+            continue;
+        }
+
+        ListEntry entry;
+        entry.mtime = stat_mtime(st);
+        if (!readListFile(filename, entry.files)) {
+            continue;
+        }
+        removePackage(name);
+        addPackage(name, std::move(entry));
+        changed = true;
+    }
+    closedir(dp);
+
+    // drop packages which were removed since the last update
+    for (auto it = m_packages.begin(); it != m_packages.end();) {
+        if (seen.count(it->first) == 0) {
+            string name = it->first;
+            ++it;
+            removePackage(name);
+            changed = true;
+        } else {
+            ++it;
+        }
+    }
+
+    m_infoDirMtime = infoDirMtime;
+
+    if (changed) {
+        save();
+    }
+    return true;
+}
+
+vector<string> DpkgFileIndex::search(gchar **values)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    unordered_set<string> found;
+    vector<string> packages;
+
+    auto addOwners = [&](const string &path) {
+        auto owners = m_pathOwners.find(path);
+        if (owners == m_pathOwners.end()) {
+            return;
+        }
+        for (const string &name : owners->second) {
+            if (found.insert(name).second) {
+                packages.push_back(name);
+            }
+        }
+    };
+
+    for (uint i = 0; i < g_strv_length(values); ++i) {
+        const gchar *value = values[i];
+        if (value[0] == '\0') {
+            continue;
+        }
+
+        if (value[0] == '/') {
+            addOwners(value);
+            continue;
+        }
+
+        auto paths = m_basenames.find(value);
+        if (paths == m_basenames.end()) {
+            continue;
+        }
+        for (const string &path : paths->second) {
+            addOwners(path);
+        }
+    }
+
+    return packages;
+}
@@ -0,0 +1,94 @@
+/* dpkg-file-index.h - Index of the files owned by installed packages
+ *
+ * Copyright (c) 2026 PackageKit contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef DPKG_FILE_INDEX_H
+#define DPKG_FILE_INDEX_H
+
+#include <glib.h>
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Maps the files listed in dpkg's /var/lib/dpkg/info/<pkg>.list
+ * files to the packages owning them.
+ *
+ * The index is kept in memory for the lifetime of the backend and
+ * persisted to disk, so a fresh daemon does not need to read every
+ * .list file again. Only the .list files whose mtime changed since
+ * the last run are re-read.
+ */
+class DpkgFileIndex
+{
+public:
+    /**
+     * Returns the process-wide index instance
+     */
+    static DpkgFileIndex *instance();
+
+    /**
+     * Brings the index up to date with the dpkg database, reading
+     * only the .list files that were added or changed.
+     * @param cancel is polled while reading and aborts the update
+     * @returns false if the dpkg info directory could not be read
+     */
+    bool update(const bool *cancel = nullptr);
+
+    /**
+     * Returns the names of the packages owning any of the given files.
+     * Values starting with '/' must match a full path, other values
+     * are matched against the file's basename.
+     */
+    vector<string> search(gchar **values);
+
+private:
+    struct ListEntry {
+        gint64 mtime = 0;
+        vector<string> files;
+    };
+
+    DpkgFileIndex(const string &infoDir, const string &cacheFile);
+
+    bool load();
+    bool save() const;
+    void addPackage(const string &name, ListEntry &&entry);
+    void removePackage(const string &name);
+    bool readListFile(const string &filename, vector<string> &files) const;
+
+    string m_infoDir;
+    string m_cacheFile;
+    gint64 m_infoDirMtime;
+    bool m_loaded;
+
+    // package name -> .list file contents
+    unordered_map<string, ListEntry> m_packages;
+    // full path -> owning packages (directories are shared)
+    unordered_map<string, vector<string>> m_pathOwners;
+    // basename -> full paths
+    unordered_map<string, vector<string>> m_basenames;
+
+    std::mutex m_mutex;
+};
+
+#endif // DPKG_FILE_INDEX_H
@@ -0,0 +1,119 @@
+/* dpkg-status-reader.cpp - Reads the APT/dpkg status file descriptor
+ *
+ * Copyright (c) 2026 PackageKit contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "dpkg-status-reader.h"
+
+#include <unistd.h>
+#include <string.h>
+
+#define DPKG_STATUS_CHUNK_SIZE  4096
+
+static std::string_view strip(std::string_view str)
+{
+    const char *whitespace = " \t\r\n";
+    size_t start = str.find_first_not_of(whitespace);
+    if (start == std::string_view::npos) {
+        return std::string_view();
+    }
+    size_t end = str.find_last_not_of(whitespace);
+    return str.substr(start, end - start + 1);
+}
+
+// Splits off the next ':' separated field, the last field takes the rest
+static std::string_view next_field(std::string_view &line, bool last = false)
+{
+    size_t pos = last ? std::string_view::npos : line.find(':');
+    std::string_view field = line.substr(0, pos);
+    line = pos == std::string_view::npos ? std::string_view() : line.substr(pos + 1);
+    return strip(field);
+}
+
+int DpkgStatusLine::percentage() const
+{
+    int value = 0;
+    for (char c : percent) {
+        if (c < '0' || c > '9') {
+            break;
+        }
+        value = value * 10 + (c - '0');
+    }
+    return value;
+}
+
+DpkgStatusReader::DpkgStatusReader()
+{
+    m_buffer.reserve(DPKG_STATUS_CHUNK_SIZE);
+}
+
+bool DpkgStatusReader::parseLine(std::string_view line, DpkgStatusLine &parsed)
+{
+    parsed.status = next_field(line);
+    parsed.package = next_field(line);
+    parsed.percent = next_field(line);
+    parsed.message = next_field(line, true);
+
+    return !parsed.package.empty();
+}
+
+void DpkgStatusReader::feed(const char *data, size_t length, const LineCallback &callback)
+{
+    DpkgStatusLine parsed;
+    const char *end = data + length;
+
+    while (data < end) {
+        const char *eol = static_cast<const char*>(memchr(data, '\n', end - data));
+        if (eol == nullptr) {
+            // keep the partial line for the next chunk
+            m_buffer.append(data, end - data);
+            return;
+        }
+
+        std::string_view line;
+        if (m_buffer.empty()) {
+            line = std::string_view(data, eol - data);
+        } else {
+            m_buffer.append(data, eol - data);
+            line = m_buffer;
+        }
+
+        if (parseLine(line, parsed)) {
+            callback(parsed);
+        }
+        m_buffer.clear();
+        data = eol + 1;
+    }
+}
+
+size_t DpkgStatusReader::read(int fd, const LineCallback &callback)
+{
+    char chunk[DPKG_STATUS_CHUNK_SIZE];
+    size_t total = 0;
+
+    while (true) {
+        ssize_t len = ::read(fd, chunk, sizeof(chunk));
+        if (len < 1) {
+            break;
+        }
+        total += len;
+        feed(chunk, len, callback);
+    }
+
+    return total;
+}
@@ -0,0 +1,81 @@
+/* dpkg-status-reader.h - Reads the APT/dpkg status file descriptor
+ *
+ * Copyright (c) 2026 PackageKit contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef DPKG_STATUS_READER_H
+#define DPKG_STATUS_READER_H
+
+#include <functional>
+#include <string>
+#include <string_view>
+
+/**
+ * One line of the status fd, in the form
+ * <status>:<package>:<percent>:<message>
+ *
+ * The fields point into the reader's buffer and are only valid
+ * while the line callback runs.
+ */
+struct DpkgStatusLine
+{
+    std::string_view status;
+    std::string_view package;
+    std::string_view percent;
+    std::string_view message;
+
+    /**
+     * Returns the integer part of the percent field
+     */
+    int percentage() const;
+};
+
+/**
+ * Reads the status fd in chunks and splits it into lines,
+ * keeping incomplete lines around for the next read.
+ */
+class DpkgStatusReader
+{
+public:
+    typedef std::function<void(const DpkgStatusLine &line)> LineCallback;
+
+    DpkgStatusReader();
+
+    /**
+     * Reads everything currently available on the (non-blocking) fd and
+     * calls the callback for every complete line.
+     * @returns the number of bytes read
+     */
+    size_t read(int fd, const LineCallback &callback);
+
+    /**
+     * Feeds already read data, calling the callback for every complete line
+     */
+    void feed(const char *data, size_t length, const LineCallback &callback);
+
+    /**
+     * Splits a line into its fields
+     * @returns false if the line has no package field
+     */
+    static bool parseLine(std::string_view line, DpkgStatusLine &parsed);
+
+private:
+    std::string m_buffer;
+};
+
+#endif // DPKG_STATUS_READER_H
@@ -39,7 +39,10 @@
 #include "apt-messages.h"
 #include "acqpkitstatus.h"
 #include "apt-sourceslist.h"
+#include "apt-utils.h"
 
+/* monitors invalidating the APT cache shared between jobs */
+static GPtrArray *cache_monitors = nullptr;
 
 const gchar* pk_backend_get_description(PkBackend *backend)
 {
@@ -59,6 +62,54 @@ pk_backend_supports_parallelization (PkBackend *backend)
     return FALSE;
 }
 
+const gchar *
+pk_backend_get_lock_file (PkBackend *backend)
+{
+    static const string lockFile = utilDpkgLockFile();
+    return lockFile.c_str();
+}
+
+gboolean
+pk_backend_is_lock_held (PkBackend *backend)
+{
+    return utilDpkgLockIsHeld();
+}
+
+static void pk_backend_apt_cache_changed_cb(GFileMonitor *monitor,
+                                            GFile *file,
+                                            GFile *other_file,
+                                            GFileMonitorEvent event_type,
+                                            PkBackend *backend)
+{
+    if (event_type == G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT ||
+        event_type == G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED) {
+        return;
+    }
+
+    g_debug("APT cache source changed, dropping shared cache");
+    AptCacheFile::invalidateShared();
+}
+
+static void pk_backend_apt_monitor_cache(PkBackend *backend, const string &path, bool directory)
+{
+    g_autoptr(GError) error = nullptr;
+    g_autoptr(GFile) file = g_file_new_for_path(path.c_str());
+    GFileMonitor *monitor;
+
+    if (directory)
+        monitor = g_file_monitor_directory(file, G_FILE_MONITOR_NONE, nullptr, &error);
+    else
+        monitor = g_file_monitor_file(file, G_FILE_MONITOR_NONE, nullptr, &error);
+    if (monitor == nullptr) {
+        g_warning("Failed to monitor %s: %s", path.c_str(), error->message);
+        return;
+    }
+
+    g_signal_connect(monitor, "changed",
+                     G_CALLBACK(pk_backend_apt_cache_changed_cb), backend);
+    g_ptr_array_add(cache_monitors, monitor);
+}
+
 void pk_backend_initialize(GKeyFile *conf, PkBackend *backend)
 {
     /* use logging */
@@ -85,11 +136,22 @@ void pk_backend_initialize(GKeyFile *conf, PkBackend *backend)
     if (!pkgInitSystem(*_config, _system)) {
         g_debug("ERROR initializing backend system");
     }
+
+    // read-only jobs share one cache until dpkg or the package lists change
+    cache_monitors = g_ptr_array_new_with_free_func(g_object_unref);
+    pk_backend_apt_monitor_cache(backend, _config->FindFile("Dir::State::status"), false);
+    pk_backend_apt_monitor_cache(backend, _config->FindDir("Dir::State::lists"), true);
+    pk_backend_apt_monitor_cache(backend, _config->FindFile("Dir::Etc::sourcelist"), false);
+    pk_backend_apt_monitor_cache(backend, _config->FindDir("Dir::Etc::sourceparts"), true);
+    pk_backend_apt_monitor_cache(backend, _config->FindDir("Dir::Etc::preferencesparts"), true);
 }
 
 void pk_backend_destroy(PkBackend *backend)
 {
     g_debug("APT backend being destroyed");
+
+    g_clear_pointer(&cache_monitors, g_ptr_array_unref);
+    AptCacheFile::destroyShared();
 }
 
 PkBitfield pk_backend_get_groups(PkBackend *backend)
@@ -0,0 +1,105 @@
+#include <glib.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "dpkg-status-reader.h"
+
+struct RecordedLine
+{
+    std::string status;
+    std::string package;
+    std::string message;
+    int percentage;
+};
+
+static std::vector<RecordedLine>
+replay_recording(const gchar *filename, gsize chunk_size)
+{
+    g_autofree gchar *path = g_build_filename(TESTDATADIR, filename, NULL);
+    g_autofree gchar *contents = NULL;
+    gsize length;
+    int fds[2];
+    DpkgStatusReader reader;
+    std::vector<RecordedLine> lines;
+
+    g_assert_true(g_file_get_contents(path, &contents, &length, NULL));
+    g_assert_cmpint(pipe(fds), ==, 0);
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+
+    // hand the recording to the reader in chunks that split lines
+    for (gsize offset = 0; offset < length; offset += chunk_size) {
+        gsize len = MIN(chunk_size, length - offset);
+        g_assert_cmpint(write(fds[1], contents + offset, len), ==, (gssize) len);
+
+        g_assert_cmpuint(reader.read(fds[0], [&lines](const DpkgStatusLine &line) {
+            lines.push_back({ std::string(line.status),
+                              std::string(line.package),
+                              std::string(line.message),
+                              line.percentage() });
+        }), ==, len);
+    }
+
+    close(fds[0]);
+    close(fds[1]);
+    return lines;
+}
+
+static void
+apt_test_dpkg_status_reader_parse_line()
+{
+    DpkgStatusLine line;
+
+    g_assert_true(DpkgStatusReader::parseLine("pmstatus:openssl:27.7778:Preparing to configure openssl", line));
+    g_assert_true(line.status == "pmstatus");
+    g_assert_true(line.package == "openssl");
+    g_assert_true(line.message == "Preparing to configure openssl");
+    g_assert_cmpint(line.percentage(), ==, 27);
+
+    // the message is the remainder of the line, colons included
+    g_assert_true(DpkgStatusReader::parseLine("pmerror:foo:1:subprocess returned: 1", line));
+    g_assert_true(line.message == "subprocess returned: 1");
+
+    g_assert_false(DpkgStatusReader::parseLine("garbage", line));
+    g_assert_false(DpkgStatusReader::parseLine("", line));
+}
+
+static void
+apt_test_dpkg_status_reader_replay()
+{
+    const std::vector<RecordedLine> expected = replay_recording("dpkg-status-upgrade.txt", 4096);
+
+    g_assert_cmpuint(expected.size(), ==, 19);
+    g_assert_cmpstr(expected[0].package.c_str(), ==, "dpkg-exec");
+    g_assert_cmpstr(expected[7].status.c_str(), ==, "pmconffile");
+    g_assert_cmpstr(expected[7].message.c_str(), ==,
+                    "'/etc/ssl/openssl.cnf' '/etc/ssl/openssl.cnf.dpkg-new' 1 1");
+    g_assert_cmpstr(expected[15].status.c_str(), ==, "pmerror");
+    g_assert_true(g_str_has_suffix(expected[15].message.c_str(), "exit status 1: see log"));
+    g_assert_cmpint(expected[18].percentage, ==, 100);
+
+    for (gsize chunk_size : { 1, 7, 64 }) {
+        const std::vector<RecordedLine> lines = replay_recording("dpkg-status-upgrade.txt", chunk_size);
+
+        g_assert_cmpuint(lines.size(), ==, expected.size());
+        for (gsize i = 0; i < lines.size(); i++) {
+            g_assert_cmpstr(lines[i].status.c_str(), ==, expected[i].status.c_str());
+            g_assert_cmpstr(lines[i].package.c_str(), ==, expected[i].package.c_str());
+            g_assert_cmpstr(lines[i].message.c_str(), ==, expected[i].message.c_str());
+            g_assert_cmpint(lines[i].percentage, ==, expected[i].percentage);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/apt/dpkg-status-reader/parse-line", apt_test_dpkg_status_reader_parse_line);
+    g_test_add_func("/apt/dpkg-status-reader/replay", apt_test_dpkg_status_reader_replay);
+
+    return g_test_run();
+}
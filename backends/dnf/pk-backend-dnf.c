@@ -46,10 +46,14 @@
 #include "dnf-backend-vendor.h"
 #include "dnf-backend.h"
 
+/* how long the repos refreshed by an interrupted forced refresh are kept */
+#define PK_DNF_REFRESH_CHECKPOINT_AGE	3600 /* s */
+
 typedef struct {
 	DnfSack		*sack;
 	gboolean	 valid;
 	gchar		*key;
+	gint64		 metadata_time;	/* when the oldest repo metadata was downloaded */
 } DnfSackCacheItem;
 
 typedef struct {
@@ -59,6 +63,8 @@ typedef struct {
 	GMutex		 sack_mutex;
 	GTimer		*repos_timer;
 	gchar		*release_ver;
+	GHashTable	*refresh_checkpoint;	/* repo IDs done by an interrupted forced refresh */
+	gint64		 refresh_checkpoint_time;
 } PkBackendDnfPrivate;
 
 typedef struct {
@@ -68,8 +74,15 @@ typedef struct {
 	PkBackend	*backend;
 	PkBitfield	 transaction_flags;
 	HyGoal		 goal;
+	DnfSack		*goal_sack;
+	gboolean	 goal_solved;
 } PkBackendDnfJobData;
 
+typedef struct {
+	DnfSack		*sack;
+	HyGoal		 goal;
+} PkBackendDnfSolvedPlan;
+
 static GPtrArray * pk_backend_find_refresh_repos (PkBackendJob *job,
 						  DnfState     *state,
 						  GPtrArray    *repos,
@@ -88,6 +101,11 @@ pk_backend_get_author (PkBackend *backend)
 	return "Richard Hughes <richard@hughsie.com>";
 }
 
+/*
+ * This must stay FALSE, and pk_backend_get_parallel_roles() must not be
+ * exported either: jobs share the cached sacks, and
+ * dnf_utils_sack_set_role() enables and disables repos on them in place.
+ */
 gboolean
 pk_backend_supports_parallelization (PkBackend *backend)
 {
@@ -317,6 +335,7 @@ pk_backend_initialize (GKeyFile *conf, PkBackend *backend)
 						  g_str_equal,
 						  g_free,
 						  (GDestroyNotify) dnf_sack_cache_item_free);
+	priv->refresh_checkpoint = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 
 	if (!pk_backend_ensure_default_dnf_context (backend, &error))
 		g_warning ("failed to setup context: %s", error->message);
@@ -333,6 +352,7 @@ pk_backend_destroy (PkBackend *backend)
 	g_timer_destroy (priv->repos_timer);
 	g_mutex_clear (&priv->sack_mutex);
 	g_hash_table_unref (priv->sack_cache);
+	g_hash_table_unref (priv->refresh_checkpoint);
 	g_free (priv->release_ver);
 	g_free (priv);
 }
@@ -523,6 +543,8 @@ pk_backend_stop_job (PkBackend *backend, PkBackendJob *job)
 		g_object_unref (job_data->context);
 	if (job_data->goal != NULL)
 		hy_goal_free (job_data->goal);
+	if (job_data->goal_sack != NULL)
+		g_object_unref (job_data->goal_sack);
 	g_free (job_data);
 	pk_backend_job_set_user_data (job, NULL);
 }
@@ -648,6 +670,80 @@ dnf_utils_create_cache_key (const gchar *release_ver, DnfSackAddFlags flags)
 	return g_string_free (key, FALSE);
 }
 
+/*
+ * When the metadata of the enabled remote repos were downloaded, i.e. the
+ * mtime of the oldest repomd.xml, or 0 if that is unknown. This is the age
+ * dnf_repo_check() compares to the cache-age hint.
+ */
+static gint64
+dnf_utils_get_metadata_time (DnfContext *context)
+{
+	GPtrArray *repos = dnf_context_get_repos (context);
+	gint64 metadata_time = G_MAXINT64;
+
+	for (guint i = 0; repos != NULL && i < repos->len; i++) {
+		DnfRepo *repo = g_ptr_array_index (repos, i);
+		GStatBuf buf;
+		g_autofree gchar *repomd = NULL;
+
+		if (dnf_repo_get_enabled (repo) == DNF_REPO_ENABLED_NONE ||
+		    dnf_repo_is_local (repo))
+			continue;
+		repomd = g_build_filename (dnf_repo_get_location (repo),
+					   "repodata", "repomd.xml", NULL);
+		if (g_stat (repomd, &buf) != 0)
+			return 0;
+		metadata_time = MIN (metadata_time, (gint64) buf.st_mtime);
+	}
+	return metadata_time;
+}
+
+/* the sack is fresh enough if none of its metadata is older than cache_age */
+static gboolean
+dnf_sack_cache_item_is_fresh (DnfSackCacheItem *cache_item, guint cache_age)
+{
+	gint64 now = g_get_real_time () / G_USEC_PER_SEC;
+
+	if (cache_age == G_MAXUINT)
+		return TRUE;
+	if (cache_item->metadata_time == 0)
+		return FALSE;
+	return now - cache_item->metadata_time <= (gint64) cache_age;
+}
+
+/*
+ * The shared sack includes the repos that only have their metadata
+ * enabled, which only queries may see. Every other role gets them
+ * disabled before using the sack.
+ */
+static void
+dnf_utils_sack_set_role (DnfSack *sack, DnfContext *context, PkRoleEnum role)
+{
+	GPtrArray *repos = dnf_context_get_repos (context);
+	gboolean enabled;
+
+	switch (role) {
+	case PK_ROLE_ENUM_RESOLVE:
+	case PK_ROLE_ENUM_SEARCH_NAME:
+	case PK_ROLE_ENUM_SEARCH_DETAILS:
+	case PK_ROLE_ENUM_SEARCH_FILE:
+	case PK_ROLE_ENUM_GET_DETAILS:
+	case PK_ROLE_ENUM_WHAT_PROVIDES:
+		enabled = TRUE;
+		break;
+	default:
+		enabled = FALSE;
+		break;
+	}
+
+	for (guint i = 0; repos != NULL && i < repos->len; i++) {
+		DnfRepo *repo = g_ptr_array_index (repos, i);
+		if (dnf_repo_get_enabled (repo) != DNF_REPO_ENABLED_METADATA)
+			continue;
+		dnf_sack_repo_enabled (sack, dnf_repo_get_id (repo), enabled);
+	}
+}
+
 static gchar *
 dnf_utils_real_path (const gchar *path)
 {
@@ -686,27 +782,12 @@ dnf_utils_create_sack_for_filters (PkBackendJob *job,
 	g_autofree gchar *solv_dir = NULL;
 	g_autoptr(DnfSack) sack = NULL;
 
-	/* don't add if we're going to filter out anyway */
-	if (!pk_bitfield_contain (filters, PK_FILTER_ENUM_INSTALLED))
-		flags |= DNF_SACK_ADD_FLAG_REMOTE;
-
-	/* only load updateinfo when required */
-	if (pk_backend_job_get_role (job) == PK_ROLE_ENUM_GET_UPDATE_DETAIL ||
-	    pk_backend_job_get_role (job) == PK_ROLE_ENUM_GET_UPDATES)
-		flags |= DNF_SACK_ADD_FLAG_UPDATEINFO;
-
-	/* only use unavailble packages for queries */
-	switch (pk_backend_job_get_role (job)) {
-	case PK_ROLE_ENUM_RESOLVE:
-	case PK_ROLE_ENUM_SEARCH_NAME:
-	case PK_ROLE_ENUM_SEARCH_DETAILS:
-	case PK_ROLE_ENUM_SEARCH_FILE:
-	case PK_ROLE_ENUM_GET_DETAILS:
-	case PK_ROLE_ENUM_WHAT_PROVIDES:
-		flags |= DNF_SACK_ADD_FLAG_UNAVAILABLE;
-		break;
-	default:
-		break;
+	/* don't add if we're going to filter out anyway, otherwise load
+	 * everything any role needs so that they can all share one sack */
+	if (!pk_bitfield_contain (filters, PK_FILTER_ENUM_INSTALLED)) {
+		flags |= DNF_SACK_ADD_FLAG_REMOTE |
+			 DNF_SACK_ADD_FLAG_UPDATEINFO |
+			 DNF_SACK_ADD_FLAG_UNAVAILABLE;
 	}
 
 	/* media repos could disappear at any time */
@@ -718,21 +799,18 @@ dnf_utils_create_sack_for_filters (PkBackendJob *job,
 	}
 	g_timer_reset (priv->repos_timer);
 
-	/* if we've specified a specific cache-age then do not use the cache */
-	if ((flags & DNF_SACK_ADD_FLAG_REMOTE) > 0 &&
-	    pk_backend_job_get_cache_age (job) != G_MAXUINT) {
-		g_debug ("not reusing sack specific cache age requested");
-		create_flags &= ~DNF_CREATE_SACK_FLAG_USE_CACHE;
-	}
-
 	/* do we have anything in the cache */
 	cache_key = dnf_utils_create_cache_key (dnf_context_get_release_ver (job_data->context), flags);
 	if ((create_flags & DNF_CREATE_SACK_FLAG_USE_CACHE) > 0) {
 		g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->sack_mutex);
 		cache_item = g_hash_table_lookup (priv->sack_cache, cache_key);
 		if (cache_item != NULL && cache_item->sack != NULL) {
-			if (cache_item->valid) {
+			if (cache_item->valid &&
+			    ((flags & DNF_SACK_ADD_FLAG_REMOTE) == 0 ||
+			     dnf_sack_cache_item_is_fresh (cache_item, pk_backend_job_get_cache_age (job)))) {
 				g_debug ("using cached sack %s", cache_key);
+				dnf_utils_sack_set_role (cache_item->sack, job_data->context,
+							 pk_backend_job_get_role (job));
 				return g_object_ref (cache_item->sack);
 			} else {
 				/* we have to do this now rather than rely on the
@@ -800,15 +878,19 @@ dnf_utils_create_sack_for_filters (PkBackendJob *job,
 	dnf_sack_filter_modules (sack, dnf_context_get_repos (job_data->context), install_root, NULL);
 
 	/* save in cache */
-	g_mutex_lock (&priv->sack_mutex);
 	cache_item = g_slice_new (DnfSackCacheItem);
 	cache_item->key = g_strdup (cache_key);
 	cache_item->sack = g_object_ref (sack);
 	cache_item->valid = TRUE;
+	cache_item->metadata_time = dnf_utils_get_metadata_time (job_data->context);
+	g_mutex_lock (&priv->sack_mutex);
 	g_debug ("created cached sack %s", cache_item->key);
 	g_hash_table_insert (priv->sack_cache, g_strdup (cache_key), cache_item);
 	g_mutex_unlock (&priv->sack_mutex);
 
+	if ((flags & DNF_SACK_ADD_FLAG_REMOTE) > 0)
+		dnf_utils_sack_set_role (sack, job_data->context, pk_backend_job_get_role (job));
+
 	return g_steal_pointer (&sack);
 }
 
@@ -1745,6 +1827,32 @@ pk_backend_find_refresh_repos (PkBackendJob *job,
 	return g_steal_pointer (&refresh_repos);
 }
 
+/*
+ * Build the sack every query shares while the refresh job still runs, so
+ * the first query afterwards doesn't have to load all of libsolv itself.
+ */
+static void
+pk_backend_refresh_cache_prebuild_sack (PkBackendJob *job, DnfCreateSackFlags create_flags)
+{
+	PkBackendDnfJobData *job_data = pk_backend_job_get_user_data (job);
+	DnfState *state_local;
+	g_autoptr(DnfSack) sack = NULL;
+	g_autoptr(GError) error = NULL;
+
+	state_local = dnf_state_get_child (job_data->state);
+	sack = dnf_utils_create_sack_for_filters (job, 0,
+						  create_flags,
+						  state_local, &error);
+	if (sack == NULL) {
+		pk_backend_job_error_code (job, error->code, "%s", error->message);
+		return;
+	}
+
+	/* done */
+	if (!dnf_state_done (job_data->state, &error))
+		pk_backend_job_error_code (job, error->code, "%s", error->message);
+}
+
 static void
 pk_backend_refresh_cache_thread (PkBackendJob *job,
 				 GVariant *params,
@@ -1752,13 +1860,14 @@ pk_backend_refresh_cache_thread (PkBackendJob *job,
 {
 	PkBackendDnfJobData *job_data = pk_backend_job_get_user_data (job);
 	PkBackend *backend = pk_backend_job_get_backend (job);
+	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
 	DnfRepo *repo;
 	DnfState *state_local;
 	DnfState *state_loop;
 	gboolean force;
 	gboolean ret;
 	guint i;
-	g_autoptr(DnfSack) sack = NULL;
+	guint refreshed = 0;
 	g_autoptr(GError) error = NULL;
 	g_autoptr(GPtrArray) refresh_repos = NULL;
 	g_autoptr(GPtrArray) repos = NULL;
@@ -1772,6 +1881,9 @@ pk_backend_refresh_cache_thread (PkBackendJob *job,
 
 	g_variant_get (params, "(b)", &force);
 
+	/* we stop between repos if asked to */
+	pk_backend_job_set_pausable (job, TRUE);
+
 	/* kick subscription-manager if it exists */
 	pk_backend_refresh_subman (job);
 
@@ -1793,42 +1905,74 @@ pk_backend_refresh_cache_thread (PkBackendJob *job,
 
 	/* is everything up to date? */
 	if (refresh_repos->len == 0) {
-		if (!dnf_state_finished (job_data->state, &error))
+		if (!dnf_state_done (job_data->state, &error)) {
 			pk_backend_job_error_code (job, error->code, "%s", error->message);
+			return;
+		}
+		pk_backend_refresh_cache_prebuild_sack (job, DNF_CREATE_SACK_FLAG_USE_CACHE);
 		return;
 	}
 
+	/* a forced refresh that was interrupted recently already got these;
+	 * refresh jobs never run in parallel, so no locking is needed */
+	if (!force || g_get_monotonic_time () - priv->refresh_checkpoint_time >
+		      PK_DNF_REFRESH_CHECKPOINT_AGE * G_USEC_PER_SEC)
+		g_hash_table_remove_all (priv->refresh_checkpoint);
+
 	/* refresh each repo */
 	state_local = dnf_state_get_child (job_data->state);
 	dnf_state_set_number_steps (state_local, refresh_repos->len);
 	for (i = 0; i < refresh_repos->len; i++) {
 		repo = g_ptr_array_index (refresh_repos, i);
 
+		/* a foreground query may want to run first */
+		if (!pk_backend_job_wait_while_paused (job))
+			break;
+
+		if (g_hash_table_contains (priv->refresh_checkpoint, dnf_repo_get_id (repo))) {
+			g_debug ("%s was refreshed before the last refresh was interrupted",
+				 dnf_repo_get_id (repo));
+			if (!dnf_state_done (state_local, &error))
+				break;
+			continue;
+		}
+
 		/* delete content even if up to date */
 		if (force) {
 			g_debug ("Deleting contents of %s as forced", dnf_repo_get_id (repo));
 			ret = dnf_repo_clean (repo, &error);
-			if (!ret) {
-				pk_backend_job_error_code (job, error->code, "%s", error->message);
-				return;
-			}
+			if (!ret)
+				break;
 		}
 
 		/* check and download */
 		state_loop = dnf_state_get_child (state_local);
 		ret = pk_backend_refresh_repo (job, repo, state_loop, &error);
-		if (!ret) {
-			pk_backend_job_error_code (job, error->code, "%s", error->message);
-			return;
+		if (!ret)
+			break;
+		refreshed++;
+
+		/* remember in case we get cancelled */
+		if (force) {
+			g_hash_table_add (priv->refresh_checkpoint, g_strdup (dnf_repo_get_id (repo)));
+			priv->refresh_checkpoint_time = g_get_monotonic_time ();
 		}
 
 		/* done */
 		ret = dnf_state_done (state_local, &error);
-		if (!ret) {
+		if (!ret)
+			break;
+	}
+
+	/* cancelled or failed, but keep what we already downloaded */
+	if (i < refresh_repos->len) {
+		if (refreshed > 0)
+			pk_backend_sack_cache_invalidate (backend, "downloaded some new metadata");
+		if (error != NULL)
 			pk_backend_job_error_code (job, error->code, "%s", error->message);
-			return;
-		}
+		return;
 	}
+	g_hash_table_remove_all (priv->refresh_checkpoint);
 
 	/* done */
 	ret = dnf_state_done (job_data->state, &error);
@@ -1841,21 +1985,7 @@ pk_backend_refresh_cache_thread (PkBackendJob *job,
 	pk_backend_sack_cache_invalidate (backend, "downloaded new metadata");
 
 	/* regenerate the libsolv metadata */
-	state_local = dnf_state_get_child (job_data->state);
-	sack = dnf_utils_create_sack_for_filters (job, 0,
-						  DNF_CREATE_SACK_FLAG_NONE,
-						  state_local, &error);
-	if (sack == NULL) {
-		pk_backend_job_error_code (job, error->code, "%s", error->message);
-		return;
-	}
-
-	/* done */
-	ret = dnf_state_done (job_data->state, &error);
-	if (!ret) {
-		pk_backend_job_error_code (job, error->code, "%s", error->message);
-		return;
-	}
+	pk_backend_refresh_cache_prebuild_sack (job, DNF_CREATE_SACK_FLAG_NONE);
 }
 
 void
@@ -2637,6 +2767,42 @@ pk_backend_get_download_rpms (HyGoal goal)
 	return g_steal_pointer (&download_rpms);
 }
 
+static void
+pk_backend_dnf_solved_plan_free (PkBackendDnfSolvedPlan *plan)
+{
+	if (plan->goal != NULL)
+		hy_goal_free (plan->goal);
+	g_object_unref (plan->sack);
+	g_free (plan);
+}
+
+/*
+ * pk_backend_create_goal:
+ *
+ * Sets up the goal for the job. If the daemon handed us the goal that was
+ * solved when simulating the same transaction, and the sack it refers to
+ * is still the one we would use now, then that goal is used as-is.
+ *
+ * Returns: %FALSE if the goal is already solved and must not be changed
+ */
+static gboolean
+pk_backend_create_goal (PkBackendJob *job, DnfSack *sack)
+{
+	PkBackendDnfJobData *job_data = pk_backend_job_get_user_data (job);
+	PkBackendDnfSolvedPlan *plan = pk_backend_job_get_solved_plan (job);
+
+	job_data->goal_sack = g_object_ref (sack);
+	if (plan != NULL && plan->sack == sack && plan->goal != NULL) {
+		g_debug ("reusing the goal solved by the simulation");
+		job_data->goal = plan->goal;
+		job_data->goal_solved = TRUE;
+		plan->goal = NULL;
+		return FALSE;
+	}
+	job_data->goal = hy_goal_create (sack);
+	return TRUE;
+}
+
 static gboolean
 pk_backend_transaction_run (PkBackendJob *job,
 			    DnfState *state,
@@ -2677,9 +2843,11 @@ pk_backend_transaction_run (PkBackendJob *job,
 	dnf_transaction_set_dont_solve_goal (job_data->transaction, TRUE);
 	if (!dnf_context_get_install_weak_deps ())
 		dnf_flags |= DNF_IGNORE_WEAK_DEPS;
-	ret = dnf_goal_depsolve (job_data->goal, dnf_flags, error);
-	if (!ret)
-		return FALSE;
+	if (!job_data->goal_solved) {
+		ret = dnf_goal_depsolve (job_data->goal, dnf_flags, error);
+		if (!ret)
+			return FALSE;
+	}
 
 	ret = dnf_transaction_depsolve (job_data->transaction,
 					job_data->goal,
@@ -2701,6 +2869,16 @@ pk_backend_transaction_run (PkBackendJob *job,
 						       error);
 		if (!ret)
 			return FALSE;
+
+		/* the real transaction can skip the depsolve */
+		if (job_data->goal_sack != NULL) {
+			PkBackendDnfSolvedPlan *plan = g_new0 (PkBackendDnfSolvedPlan, 1);
+			plan->sack = g_object_ref (job_data->goal_sack);
+			plan->goal = job_data->goal;
+			job_data->goal = NULL;
+			pk_backend_job_set_solved_plan (job, plan,
+							(GDestroyNotify) pk_backend_dnf_solved_plan_free);
+		}
 		return dnf_state_done (state, error);
 	}
 
@@ -3056,19 +3234,20 @@ pk_backend_remove_packages_thread (PkBackendJob *job, GVariant *params, gpointer
 	}
 
 	/* remove packages */
-	job_data->goal = hy_goal_create (sack);
-	for (i = 0; package_ids[i] != NULL; i++) {
-		pkg = g_hash_table_lookup (hash, package_ids[i]);
-		if (pkg == NULL) {
-			pk_backend_job_error_code (job,
-						   PK_ERROR_ENUM_PACKAGE_NOT_FOUND,
-						   "Failed to find %s", package_ids[i]);
-			return;
-		}
-		if (autoremove) {
-			hy_goal_erase_flags (job_data->goal, pkg, HY_CLEAN_DEPS);
-		} else {
-			hy_goal_erase (job_data->goal, pkg);
+	if (pk_backend_create_goal (job, sack)) {
+		for (i = 0; package_ids[i] != NULL; i++) {
+			pkg = g_hash_table_lookup (hash, package_ids[i]);
+			if (pkg == NULL) {
+				pk_backend_job_error_code (job,
+							   PK_ERROR_ENUM_PACKAGE_NOT_FOUND,
+							   "Failed to find %s", package_ids[i]);
+				return;
+			}
+			if (autoremove) {
+				hy_goal_erase_flags (job_data->goal, pkg, HY_CLEAN_DEPS);
+			} else {
+				hy_goal_erase (job_data->goal, pkg);
+			}
 		}
 	}
 
@@ -3248,19 +3427,20 @@ pk_backend_install_packages_thread (PkBackendJob *job, GVariant *params, gpointe
 	}
 
 	/* install packages */
-	job_data->goal = hy_goal_create (sack);
-	for (i = 0; package_ids[i] != NULL; i++) {
-		pkg = g_hash_table_lookup (hash, package_ids[i]);
-		if (pkg == NULL) {
-			pk_backend_job_error_code (job,
-						   PK_ERROR_ENUM_PACKAGE_NOT_FOUND,
-						   "Failed to find %s", package_ids[i]);
-			return;
-		}
-		if (relations[i] == HY_EQ) {
-			dnf_package_set_action (pkg, DNF_STATE_ACTION_REINSTALL);
+	if (pk_backend_create_goal (job, sack)) {
+		for (i = 0; package_ids[i] != NULL; i++) {
+			pkg = g_hash_table_lookup (hash, package_ids[i]);
+			if (pkg == NULL) {
+				pk_backend_job_error_code (job,
+							   PK_ERROR_ENUM_PACKAGE_NOT_FOUND,
+							   "Failed to find %s", package_ids[i]);
+				return;
+			}
+			if (relations[i] == HY_EQ) {
+				dnf_package_set_action (pkg, DNF_STATE_ACTION_REINSTALL);
+			}
+			hy_goal_install (job_data->goal, pkg);
 		}
-		hy_goal_install (job_data->goal, pkg);
 	}
 
 	/* run transaction */
@@ -3473,21 +3653,22 @@ pk_backend_update_packages_thread (PkBackendJob *job, GVariant *params, gpointer
 	}
 
 	/* install packages */
-	job_data->goal = hy_goal_create (sack);
-	for (i = 0; package_ids[i] != NULL; i++) {
-		pkg = g_hash_table_lookup (hash, package_ids[i]);
-		if (pkg == NULL) {
-			pk_backend_job_error_code (job,
-						   PK_ERROR_ENUM_PACKAGE_NOT_FOUND,
-						   "Failed to find %s", package_ids[i]);
-			return;
-		}
+	if (pk_backend_create_goal (job, sack)) {
+		for (i = 0; package_ids[i] != NULL; i++) {
+			pkg = g_hash_table_lookup (hash, package_ids[i]);
+			if (pkg == NULL) {
+				pk_backend_job_error_code (job,
+							   PK_ERROR_ENUM_PACKAGE_NOT_FOUND,
+							   "Failed to find %s", package_ids[i]);
+				return;
+			}
 
-		/* allow some packages to have multiple versions installed */
-		if (dnf_package_is_installonly (pkg))
-			hy_goal_install (job_data->goal, pkg);
-		else
-			hy_goal_upgrade_to (job_data->goal, pkg);
+			/* allow some packages to have multiple versions installed */
+			if (dnf_package_is_installonly (pkg))
+				hy_goal_install (job_data->goal, pkg);
+			else
+				hy_goal_upgrade_to (job_data->goal, pkg);
+		}
 	}
 
 	/* run transaction */
@@ -709,6 +709,14 @@ pk_backend_refresh_cache_thread (PkBackendJob *job, GVariant *params, gpointer u
 		if (job_data->progress_percentage == 100)
 			break;
 
+		/* foreground queries can run while we wait here */
+		if (!pk_backend_job_wait_while_paused (job)) {
+			pk_backend_job_error_code (job,
+						   PK_ERROR_ENUM_TRANSACTION_CANCELLED,
+						   "The task was stopped successfully");
+			break;
+		}
+
 		if (job_data->progress_percentage == 80)
 			pk_backend_job_set_allow_cancel (job, FALSE);
 		job_data->progress_percentage += 10;
@@ -749,6 +757,7 @@ pk_backend_refresh_cache (PkBackend *backend, PkBackendJob *job, gboolean force)
 	priv->fake_db_locked = TRUE;
 	pk_backend_job_set_locked (job, TRUE);
 
+	pk_backend_job_set_pausable (job, TRUE);
 	pk_backend_job_thread_create (job, pk_backend_refresh_cache_thread, NULL, NULL);
 }
 
@@ -0,0 +1,117 @@
+/* -*- Mode: C; tab-width: 8; indent-tab-modes: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 PackageKit contributors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Times the search matchers against std::regex over a search index, which
+ * after a refresh holds every derivation of nixpkgs:
+ *
+ *   nix-search-bench [INDEX]
+ *
+ * Without an argument the index in the PackageKit cache is used. Exits
+ * with 77 (skipped) if there is none.
+ */
+
+#include <regex>
+#include <stdio.h>
+
+#include "nix-search-index.hh"
+#include "nix-search-matcher.hh"
+
+#define NIX_SEARCH_BENCH_DIR	LOCALSTATEDIR "/cache/PackageKit/nix"
+
+static const gchar *terms[] = {
+	"firefox", "python3", "lib", "GTK", "text editor", "qt6",
+	"^python3[0-9]*-", "vim|emacs", "lib.*-dev",
+};
+
+static std::string
+nix_search_bench_find_index ()
+{
+	g_autoptr(GDir) dir = g_dir_open (NIX_SEARCH_BENCH_DIR, 0, NULL);
+	const gchar *name;
+
+	while (dir != NULL && (name = g_dir_read_name (dir)) != NULL) {
+		if (g_str_has_prefix (name, "search-"))
+			return std::string (NIX_SEARCH_BENCH_DIR "/") + name;
+	}
+	return "";
+}
+
+/* counts the entries matching on the name and on the description */
+template <typename Match>
+static double
+nix_search_bench_run (const NixSearchIndex & index, Match match, guint *names, guint *details)
+{
+	g_autoptr(GTimer) timer = g_timer_new ();
+
+	*names = 0;
+	*details = 0;
+	for (const auto & entry : index.entries) {
+		if (match (entry.pname) || match (entry.attrPath))
+			(*names)++;
+		if (match (entry.description))
+			(*details)++;
+	}
+
+	return g_timer_elapsed (timer, NULL) * 1000;
+}
+
+int
+main (int argc, char *argv[])
+{
+	std::string path = argc > 1 ? argv[1] : nix_search_bench_find_index ();
+	int ret = 0;
+
+	auto index = path.empty () ? nullptr : NixSearchIndex::loadFile (path);
+	if (!index) {
+		g_print ("no search index to benchmark, refresh the cache first\n");
+		return 77;
+	}
+
+	g_print ("%s: %zu derivations\n\n", path.c_str (), index->entries.size ());
+	g_print ("%-20s %8s %8s %12s %12s\n", "term", "names", "details", "std::regex", "matcher");
+
+	for (const gchar *term : terms) {
+		guint regexNames, regexDetails, names, details;
+
+		std::regex regex (term, std::regex::extended | std::regex::icase);
+		double regexTime = nix_search_bench_run (*index, [&] (const std::string & haystack) {
+			return std::regex_search (haystack, regex);
+		}, &regexNames, &regexDetails);
+
+		NixSearchMatcher matcher (term);
+		double matcherTime = nix_search_bench_run (*index, [&] (const std::string & haystack) {
+			return matcher.matches (haystack);
+		}, &names, &details);
+
+		g_print ("%-20s %8u %8u %10.1fms %10.1fms%s\n",
+			 term, names, details, regexTime, matcherTime,
+			 matcher.isLiteral () ? "" : " (regex)");
+
+		/* pattern dialects differ slightly, literal terms must agree */
+		if (matcher.isLiteral () && (names != regexNames || details != regexDetails)) {
+			g_printerr ("'%s' matched %u/%u entries with std::regex\n", term, regexNames, regexDetails);
+			ret = 1;
+		}
+	}
+
+	return ret;
+}
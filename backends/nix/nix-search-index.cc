@@ -0,0 +1,168 @@
+/* -*- Mode: C; tab-width: 8; indent-tab-modes: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 PackageKit contributors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <glib/gstdio.h>
+
+#include <string.h>
+#include <string_view>
+
+#include "nix-search-index.hh"
+
+#define NIX_SEARCH_INDEX_DIR	LOCALSTATEDIR "/cache/PackageKit/nix"
+#define NIX_SEARCH_INDEX_PREFIX	"search-"
+#define NIX_SEARCH_INDEX_MAGIC	"PackageKit-Nix search index 1"
+
+/*
+ * The file is a header line followed by one line per derivation:
+ *   attrPath \t pname \t version \t system \t available \t description
+ * Tabs and newlines are flattened to spaces when writing, so nothing
+ * needs escaping.
+ */
+
+static std::string
+nix_search_index_get_path (const std::string & fingerprint)
+{
+	return NIX_SEARCH_INDEX_DIR "/" NIX_SEARCH_INDEX_PREFIX + fingerprint;
+}
+
+static void
+nix_search_index_append_field (std::string & out, const std::string & field, char sep)
+{
+	size_t start = out.size ();
+	out += field;
+	for (size_t i = start; i < out.size (); i++) {
+		if (out[i] == '\t' || out[i] == '\n')
+			out[i] = ' ';
+	}
+	out += sep;
+}
+
+static std::string_view
+nix_search_index_next_field (std::string_view & line)
+{
+	size_t pos = line.find ('\t');
+	std::string_view field = line.substr (0, pos);
+	line = pos == std::string_view::npos ? std::string_view () : line.substr (pos + 1);
+	return field;
+}
+
+NixSearchIndex::NixSearchIndex (std::string fingerprint)
+	: fingerprint (std::move (fingerprint))
+{
+}
+
+std::shared_ptr<NixSearchIndex>
+NixSearchIndex::load (const std::string & fingerprint)
+{
+	auto index = loadFile (nix_search_index_get_path (fingerprint));
+
+	if (index && index->fingerprint != fingerprint) {
+		g_debug ("ignoring search index for %s", index->fingerprint.c_str ());
+		return nullptr;
+	}
+
+	return index;
+}
+
+std::shared_ptr<NixSearchIndex>
+NixSearchIndex::loadFile (const std::string & path)
+{
+	g_autofree gchar *contents = NULL;
+	gsize length;
+
+	if (!g_file_get_contents (path.c_str (), &contents, &length, NULL))
+		return nullptr;
+
+	std::string_view data (contents, length);
+	std::string_view magic = NIX_SEARCH_INDEX_MAGIC "\t";
+	size_t eol = data.find ('\n');
+	if (eol == std::string_view::npos || data.substr (0, magic.size ()) != magic) {
+		g_debug ("ignoring search index %s with a different header", path.c_str ());
+		return nullptr;
+	}
+
+	auto index = std::make_shared<NixSearchIndex> (std::string (data.substr (magic.size (), eol - magic.size ())));
+	data.remove_prefix (eol + 1);
+
+	while (!data.empty ()) {
+		eol = data.find ('\n');
+		if (eol == std::string_view::npos) {
+			/* a truncated file is as good as none */
+			g_debug ("search index %s is truncated", path.c_str ());
+			return nullptr;
+		}
+		std::string_view line = data.substr (0, eol);
+		data.remove_prefix (eol + 1);
+
+		NixSearchEntry entry;
+		entry.attrPath = nix_search_index_next_field (line);
+		entry.pname = nix_search_index_next_field (line);
+		entry.version = nix_search_index_next_field (line);
+		entry.system = nix_search_index_next_field (line);
+		entry.available = nix_search_index_next_field (line) == "1";
+		entry.description = line;
+		index->entries.push_back (std::move (entry));
+	}
+
+	return index;
+}
+
+gboolean
+NixSearchIndex::save (GError **error) const
+{
+	std::string contents = NIX_SEARCH_INDEX_MAGIC "\t" + fingerprint + "\n";
+	std::string path = nix_search_index_get_path (fingerprint);
+	g_autoptr(GDir) dir = NULL;
+	const gchar *name;
+
+	for (const auto & entry : entries) {
+		nix_search_index_append_field (contents, entry.attrPath, '\t');
+		nix_search_index_append_field (contents, entry.pname, '\t');
+		nix_search_index_append_field (contents, entry.version, '\t');
+		nix_search_index_append_field (contents, entry.system, '\t');
+		contents += entry.available ? "1\t" : "0\t";
+		nix_search_index_append_field (contents, entry.description, '\n');
+	}
+
+	if (g_mkdir_with_parents (NIX_SEARCH_INDEX_DIR, 0755) < 0) {
+		g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+			     "failed to create %s: %s", NIX_SEARCH_INDEX_DIR, g_strerror (errno));
+		return FALSE;
+	}
+
+	if (!g_file_set_contents (path.c_str (), contents.data (), contents.size (), error))
+		return FALSE;
+
+	/* indexes of previous locks will never be hit again */
+	dir = g_dir_open (NIX_SEARCH_INDEX_DIR, 0, NULL);
+	while (dir != NULL && (name = g_dir_read_name (dir)) != NULL) {
+		g_autofree gchar *filename = NULL;
+
+		if (!g_str_has_prefix (name, NIX_SEARCH_INDEX_PREFIX)
+		    || fingerprint == name + strlen (NIX_SEARCH_INDEX_PREFIX))
+			continue;
+
+		filename = g_build_filename (NIX_SEARCH_INDEX_DIR, name, NULL);
+		g_unlink (filename);
+	}
+
+	return TRUE;
+}
@@ -0,0 +1,64 @@
+/* -*- Mode: C; tab-width: 8; indent-tab-modes: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 PackageKit contributors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+struct NixSearchEntry {
+	std::string attrPath;
+	std::string pname;
+	std::string version;
+	std::string system;
+	std::string description;
+	bool available;
+};
+
+/*
+ * Every derivation below legacyPackages.<system> of a locked flake, as
+ * found by walking the eval cache once. The index is stored on disk under
+ * the fingerprint of the lock, so it stays valid until the flake input is
+ * updated and a different lock misses it.
+ */
+class NixSearchIndex {
+public:
+	explicit NixSearchIndex (std::string fingerprint);
+
+	const std::string & getFingerprint () const { return fingerprint; }
+
+	std::vector<NixSearchEntry> entries;
+
+	/* returns nullptr if there is no usable index for this lock */
+	static std::shared_ptr<NixSearchIndex> load (const std::string & fingerprint);
+
+	/* loads an index file whatever lock it belongs to */
+	static std::shared_ptr<NixSearchIndex> loadFile (const std::string & path);
+
+	/* writes the index and removes the ones of older locks */
+	gboolean save (GError **error) const;
+
+private:
+	std::string fingerprint;
+};
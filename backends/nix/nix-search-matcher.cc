@@ -0,0 +1,178 @@
+/* -*- Mode: C; tab-width: 8; indent-tab-modes: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 PackageKit contributors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "nix-search-matcher.hh"
+
+/* {n}, {n,} or {n,m} at the start of @s */
+static size_t
+intervalLength (std::string_view s)
+{
+	size_t i = 1;
+	size_t digits = 0;
+
+	for (; i < s.size () && g_ascii_isdigit (s[i]); i++)
+		digits++;
+	if (digits == 0)
+		return 0;
+	if (i < s.size () && s[i] == ',')
+		for (i++; i < s.size () && g_ascii_isdigit (s[i]); i++);
+	if (i < s.size () && s[i] == '}')
+		return i + 1;
+	return 0;
+}
+
+std::string
+NixSearchMatcher::toPcre (std::string_view ere)
+{
+	std::string pattern;
+	bool canRepeat = false;
+
+	pattern.reserve (ere.size () * 2);
+	for (size_t i = 0; i < ere.size (); i++) {
+		char c = ere[i];
+
+		switch (c) {
+		case '[': {
+			/* a backslash is not special in an ERE bracket expression */
+			size_t j = i + 1;
+			pattern += c;
+			if (j < ere.size () && ere[j] == '^')
+				pattern += ere[j++];
+			if (j < ere.size () && ere[j] == ']')
+				pattern += ere[j++];
+			for (; j < ere.size () && ere[j] != ']'; j++) {
+				if (ere[j] == '[' && j + 1 < ere.size () &&
+				    (ere[j + 1] == ':' || ere[j + 1] == '.' || ere[j + 1] == '=')) {
+					size_t end = ere.find (std::string {ere[j + 1], ']'}, j + 2);
+					if (end != std::string_view::npos) {
+						pattern.append (ere.substr (j, end + 2 - j));
+						j = end + 1;
+						continue;
+					}
+				}
+				if (ere[j] == '\\')
+					pattern += '\\';
+				pattern += ere[j];
+			}
+			if (j < ere.size ())
+				pattern += ']';
+			i = j;
+			canRepeat = true;
+			break;
+		}
+		case '\\':
+			pattern += c;
+			if (i + 1 < ere.size ())
+				pattern += ere[++i];
+			canRepeat = true;
+			break;
+		case '*':
+		case '+':
+		case '?':
+			/* PCRE would read the second + of c++ as possessive */
+			if (!canRepeat)
+				pattern += '\\';
+			pattern += c;
+			canRepeat = !canRepeat;
+			break;
+		case '{': {
+			size_t len = canRepeat ? intervalLength (ere.substr (i)) : 0;
+			if (len > 0) {
+				pattern.append (ere.substr (i, len));
+				i += len - 1;
+				canRepeat = false;
+			} else {
+				pattern += "\\{";
+				canRepeat = true;
+			}
+			break;
+		}
+		case '}':
+			pattern += "\\}";
+			canRepeat = true;
+			break;
+		case '(':
+		case '|':
+		case '^':
+		case '$':
+			pattern += c;
+			canRepeat = false;
+			break;
+		default:
+			pattern += c;
+			canRepeat = true;
+			break;
+		}
+	}
+	return pattern;
+}
+
+NixSearchMatcher::NixSearchMatcher (std::string_view term)
+{
+	if (!isLiteralTerm (term)) {
+		g_autoptr(GError) error = NULL;
+		std::string pattern = toPcre (term);
+		GRegex *compiled = g_regex_new (pattern.c_str (),
+						(GRegexCompileFlags) (G_REGEX_CASELESS | G_REGEX_DOLLAR_ENDONLY | G_REGEX_OPTIMIZE),
+						(GRegexMatchFlags) 0,
+						&error);
+		if (compiled) {
+			regex = std::shared_ptr<GRegex> (compiled, g_regex_unref);
+			return;
+		}
+
+		/* std::regex used to throw here, a literal match is more useful */
+		g_debug ("matching invalid pattern '%s' literally: %s", pattern.c_str (), error->message);
+	}
+
+	needle.reserve (term.size ());
+	for (char c : term)
+		needle += g_ascii_tolower (c);
+}
+
+bool
+NixSearchMatcher::isLiteralTerm (std::string_view term)
+{
+	return term.find_first_of ("\\.[]()*+?{}|^$") == std::string_view::npos;
+}
+
+bool
+NixSearchMatcher::matches (std::string_view haystack) const
+{
+	if (regex)
+		return g_regex_match_full (regex.get (), haystack.data (), haystack.size (), 0,
+					   (GRegexMatchFlags) 0, NULL, NULL);
+
+	if (needle.empty ())
+		return true;
+	if (haystack.size () < needle.size ())
+		return false;
+
+	/* fold into a per thread buffer so memmem can do the actual search */
+	thread_local std::string folded;
+	folded.resize (haystack.size ());
+	for (size_t i = 0; i < haystack.size (); i++)
+		folded[i] = g_ascii_tolower (haystack[i]);
+
+	return memmem (folded.data (), folded.size (), needle.data (), needle.size ()) != NULL;
+}
@@ -0,0 +1,53 @@
+/* -*- Mode: C; tab-width: 8; indent-tab-modes: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 PackageKit contributors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+/*
+ * Case insensitive matcher for one search term. Terms without any
+ * regular expression syntax, which is what clients send nearly always,
+ * are matched as ASCII case-folded substrings. Anything else is compiled
+ * once as a caseless GRegex, after translating it from the POSIX ERE
+ * syntax terms always used: a quantifier where ERE allows none, like the
+ * second + of c++, and a { that doesn't start an interval are literal.
+ */
+class NixSearchMatcher {
+public:
+	explicit NixSearchMatcher (std::string_view term);
+
+	bool matches (std::string_view haystack) const;
+
+	bool isLiteral () const { return !regex; }
+
+	static bool isLiteralTerm (std::string_view term);
+
+	static std::string toPcre (std::string_view ere);
+
+private:
+	std::string needle;
+	std::shared_ptr<GRegex> regex;
+};
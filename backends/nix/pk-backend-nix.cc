@@ -36,9 +36,12 @@
 #include <nix/installables.hh>
 
 #include <pwd.h>
-#include <regex>
+#include <mutex>
+#include <unordered_map>
 
 #include "nix-lib-plus.hh"
+#include "nix-search-index.hh"
+#include "nix-search-matcher.hh"
 
 typedef struct {
 	nix::ref<nix::EvalState> state;
@@ -46,6 +49,10 @@ typedef struct {
 } PkBackendNixPrivate;
 static PkBackendNixPrivate* priv;
 
+static std::mutex searchIndexLock;
+static std::mutex searchIndexBuildLock;
+static std::shared_ptr<const NixSearchIndex> searchIndex;
+
 void
 pk_backend_initialize (GKeyFile* conf, PkBackend* backend)
 {
@@ -134,17 +141,27 @@ pk_backend_get_mime_types (PkBackend* backend)
 	return g_strdupv ((gchar **) mime_types);
 }
 
-static nix::OrSuggestions<nix::ref<nix::eval_cache::AttrCursor>>
-nix_get_attr_or_suggestions (nix::EvalState & state, std::string flake, std::string attrPath)
+static std::shared_ptr<nix::flake::LockedFlake>
+nix_lock_flake (nix::EvalState & state, std::string flake)
 {
 	nix::flake::LockFlags lockFlags;
-	auto lockedFlake = std::make_shared<nix::flake::LockedFlake> (nix::flake::lockFlake (state, nix::parseFlakeRef(flake), lockFlags));
+	return std::make_shared<nix::flake::LockedFlake> (nix::flake::lockFlake (state, nix::parseFlakeRef(flake), lockFlags));
+}
 
+static nix::OrSuggestions<nix::ref<nix::eval_cache::AttrCursor>>
+nix_get_attr_or_suggestions (nix::EvalState & state, std::shared_ptr<nix::flake::LockedFlake> lockedFlake, std::string attrPath)
+{
 	auto evalCache = nix::openEvalCache (state, lockedFlake);
 
 	return evalCache->getRoot()->findAlongAttrPath (nix::parseAttrPath (state, attrPath));
 }
 
+static nix::OrSuggestions<nix::ref<nix::eval_cache::AttrCursor>>
+nix_get_attr_or_suggestions (nix::EvalState & state, std::string flake, std::string attrPath)
+{
+	return nix_get_attr_or_suggestions (state, nix_lock_flake (state, flake), attrPath);
+}
+
 static void
 pk_backend_get_details_thread (PkBackendJob* job, GVariant* params, gpointer p)
 {
@@ -225,11 +242,142 @@ nix_get_user_profile (PkBackendJob* job)
 	return std::string(uid_ent->pw_dir) + "/.nix-profile";
 }
 
+#define NIX_PACKAGES_BATCH_SIZE		1000
+
+static void
+nix_search_index_visit (PkBackendJob* job,
+			nix::EvalState & state,
+			nix::eval_cache::AttrCursor & cursor,
+			const std::vector<nix::Symbol> & attrPath,
+			std::vector<NixSearchEntry> & entries)
+{
+	try {
+		if (pk_backend_job_is_cancelled (job))
+			return;
+
+		if (cursor.isDerivation ()) {
+			nix::DrvName name (cursor.getAttr ("name")->getString());
+
+			auto aMeta = cursor.maybeGetAttr ("meta");
+			auto aDescription = aMeta ? aMeta->maybeGetAttr ("description") : NULL;
+			auto available = aMeta ? aMeta->maybeGetAttr ("available") : NULL;
+
+			NixSearchEntry entry;
+			entry.attrPath = concatStringsSep (".", state.symbols.resolve(attrPath));
+			entry.pname = name.name;
+			entry.version = name.version;
+			entry.system = cursor.getAttr ("system")->getString();
+			entry.description = aDescription ? aDescription->getString() : "";
+			std::replace (entry.description.begin (), entry.description.end (), '\n', ' ');
+			entry.available = available ? available->getBool () : true;
+
+			entries.push_back (std::move (entry));
+			return;
+		}
+
+		auto recurse = cursor.maybeGetAttr(state.sRecurseForDerivations);
+		if (!recurse || !recurse->getBool())
+			return;
+
+		for (const auto & attr : cursor.getAttrs ()) {
+			auto cursor2 = cursor.getAttr (attr);
+			auto attrPath2 (attrPath);
+			attrPath2.push_back (attr);
+			nix_search_index_visit (job, state, *cursor2, attrPath2, entries);
+		}
+	} catch (nix::EvalError & e) {
+	}
+}
+
+/*
+ * Walks legacyPackages.<system> once, returns nullptr if the job got
+ * cancelled or failed.
+ *
+ * The walk stays on one thread: an EvalState can't be used from several
+ * threads, and giving every thread its own EvalState means evaluating
+ * nixpkgs once per thread and fighting over the write lock of the one
+ * eval cache database, which is slower than a single walk on a cold cache.
+ */
+static std::shared_ptr<NixSearchIndex>
+nix_build_search_index (PkBackendJob* job, std::shared_ptr<nix::flake::LockedFlake> lockedFlake, const std::string & fingerprint)
+{
+	auto index = std::make_shared<NixSearchIndex> (fingerprint);
+
+	try {
+		std::string attrPath = "legacyPackages." + nix::settings.thisSystem.get () + ".";
+		auto attrOrSuggestions = nix_get_attr_or_suggestions (*priv->state, lockedFlake, attrPath);
+		auto root = *attrOrSuggestions;
+
+		auto attrs = root->getAttrs ();
+		guint done = 0;
+		for (const auto & attr : attrs) {
+			if (pk_backend_job_is_cancelled (job))
+				return nullptr;
+
+			auto cursor = root->maybeGetAttr (attr);
+			if (cursor)
+				nix_search_index_visit (job, *priv->state, *cursor, {attr}, index->entries);
+
+			pk_backend_job_set_percentage (job, 100 * ++done / attrs.size ());
+		}
+	} catch (nix::Error & e) {
+		pk_backend_job_error_code (job, PK_ERROR_ENUM_INTERNAL_ERROR, "%s", e.what ());
+		return nullptr;
+	}
+
+	if (pk_backend_job_is_cancelled (job))
+		return nullptr;
+
+	return index;
+}
+
+/*
+ * Returns the search index of the currently locked default flake, loading
+ * it from disk or building it when the lock changed. Returns nullptr if the
+ * job got cancelled while building.
+ */
+static std::shared_ptr<const NixSearchIndex>
+nix_get_search_index (PkBackendJob* job)
+{
+	auto lockedFlake = nix_lock_flake (*priv->state, priv->defaultFlake);
+	auto fingerprint = lockedFlake->getFingerprint ().to_string (nix::Base16, false);
+
+	{
+		std::lock_guard<std::mutex> lock (searchIndexLock);
+		if (searchIndex && searchIndex->getFingerprint () == fingerprint)
+			return searchIndex;
+	}
+
+	/* only one job builds the index, the others wait for it */
+	std::lock_guard<std::mutex> buildLock (searchIndexBuildLock);
+	{
+		std::lock_guard<std::mutex> lock (searchIndexLock);
+		if (searchIndex && searchIndex->getFingerprint () == fingerprint)
+			return searchIndex;
+	}
+
+	std::shared_ptr<NixSearchIndex> index = NixSearchIndex::load (fingerprint);
+	if (!index) {
+		g_debug ("building search index for %s", fingerprint.c_str ());
+		index = nix_build_search_index (job, lockedFlake, fingerprint);
+		if (!index)
+			return nullptr;
+
+		g_autoptr(GError) error = NULL;
+		if (!index->save (&error))
+			g_warning ("failed to save search index: %s", error->message);
+	}
+
+	std::lock_guard<std::mutex> lock (searchIndexLock);
+	searchIndex = index;
+	return searchIndex;
+}
+
 static void
 nix_search_thread (PkBackendJob* job, GVariant* params, gpointer p)
 {
-	const gchar **search;
-	PkBitfield filters;
+	const gchar **search = NULL;
+	PkBitfield filters = 0;
 
 	PkRoleEnum role = pk_backend_job_get_role (job);
 
@@ -246,22 +394,21 @@ nix_search_thread (PkBackendJob* job, GVariant* params, gpointer p)
 		break;
 	}
 
-	std::string attrPath = "legacyPackages." + nix::settings.thisSystem.get () + ".";
-	auto attrOrSuggestions = nix_get_attr_or_suggestions (*priv->state, priv->defaultFlake, attrPath);
-	auto cursor = *attrOrSuggestions;
-
-	if (pk_backend_job_is_cancelled (job))
+	auto index = nix_get_search_index (job);
+	if (!index)
 		return;
 
-	std::vector<std::regex> regexes;
+	std::vector<NixSearchMatcher> matchers;
 	if (search)
 		for (; *search != NULL; search++)
-			regexes.push_back (std::regex (*search, std::regex::extended | std::regex::icase));
+			matchers.push_back (NixSearchMatcher (*search));
 
-	nix::DrvInfos installedDrvs;
+	/* installed names mapped to their versions */
+	std::unordered_multimap<std::string, std::string> installedNames;
 
 	if (pk_bitfield_contain (filters, PK_FILTER_ENUM_INSTALLED)
 		|| pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_INSTALLED)) {
+		nix::DrvInfos installedDrvs;
 		std::optional<nix::PathSet> oldAllowedPaths = priv->state->allowedPaths;
 		priv->state->allowedPaths = std::nullopt;
 
@@ -282,127 +429,92 @@ nix_search_thread (PkBackendJob* job, GVariant* params, gpointer p)
 		}
 
 		priv->state->allowedPaths = oldAllowedPaths;
-	}
-
-	int totalDrvs = 0;
-	int foundDrvs = 0;
-
-	std::function<void(nix::eval_cache::AttrCursor & cursor, const std::vector<nix::Symbol> & attrPath)> visit;
-	visit = [&](nix::eval_cache::AttrCursor & cursor, const std::vector<nix::Symbol> & attrPath) {
-		try {
-		     if (pk_backend_job_is_cancelled (job))
-			     return;
-
-			auto recurse = [&] () {
-				auto attrs = cursor.getAttrs ();
-
-				totalDrvs += attrs.size();
-				if (totalDrvs > 0)
-					pk_backend_job_set_percentage (job, 100 * foundDrvs / totalDrvs);
-
-				for (const auto & attr : attrs) {
-					auto cursor2 = cursor.getAttr (attr);
-					auto attrPath2 (attrPath);
-					attrPath2.push_back (attr);
-					visit (*cursor2, attrPath2);
-				}
-			};
-
-			if (cursor.isDerivation ()) {
-				foundDrvs++;
 
-				size_t found = 0;
+		for (auto & drv : installedDrvs) {
+			nix::DrvName name (drv.queryName ());
+			installedNames.emplace (name.name, name.version);
+		}
+	}
 
-				nix::DrvName name (cursor.getAttr ("name")->getString());
+	g_autoptr(GPtrArray) packages = g_ptr_array_new_with_free_func (g_object_unref);
 
-				auto aMeta = cursor.maybeGetAttr ("meta");
-				auto aDescription = aMeta ? aMeta->maybeGetAttr ("description") : NULL;
+	for (const auto & entry : index->entries) {
+		if (pk_backend_job_is_cancelled (job))
+			return;
 
-				auto description = aDescription ? aDescription->getString() : "";
-				std::replace (description.begin (), description.end (), '\n', ' ');
-
-				auto attrPath2 = concatStringsSep (".", priv->state->symbols.resolve(attrPath));
-
-				for (auto & regex : regexes) {
-					switch (role) {
-					case PK_ROLE_ENUM_SEARCH_NAME:
-					case PK_ROLE_ENUM_RESOLVE: {
-						std::smatch nameMatch;
-						std::regex_search (name.name, nameMatch, regex);
-						std::smatch attrMatch;
-						std::regex_search (attrPath2, attrMatch, regex);
-						if (!nameMatch.empty () || !attrMatch.empty())
-							found++;
-						break;
-					}
-					case PK_ROLE_ENUM_SEARCH_DETAILS: {
-						std::smatch descriptionMatch;
-						std::regex_search (description, descriptionMatch, regex);
-						if (!descriptionMatch.empty ())
-							found++;
-						break;
-					}
-					default:
-						found++;
-						break;
-					}
-				}
+		size_t found = 0;
 
-				if (found == regexes.size () || regexes.empty ()) {
-					bool isInstalled = false;
-					for (auto drv : installedDrvs) {
-						if (nix::DrvName (drv.queryName ()).matches(name)) {
-							isInstalled = true;
-							break;
-						}
-					}
-
-					if (pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_INSTALLED) && isInstalled)
-						return;
-					if (pk_bitfield_contain (filters, PK_FILTER_ENUM_INSTALLED) && !isInstalled)
-						return;
-
-					auto available = aMeta ? aMeta->maybeGetAttr ("available") : NULL;
-					bool isSupported = available ? available->getBool () : true;
-
-					if (pk_bitfield_contain (filters, PK_FILTER_ENUM_SUPPORTED) && !isSupported)
-						return;
-					if (pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_SUPPORTED) && isSupported)
-						return;
-
-					std::string system = cursor.getAttr ("system")->getString();
-
-					PkInfoEnum info = PK_INFO_ENUM_UNKNOWN;
-					if (isSupported)
-						info = PK_INFO_ENUM_AVAILABLE;
-					if (isInstalled)
-						info = PK_INFO_ENUM_INSTALLED;
-
-					if (totalDrvs > 0)
-						pk_backend_job_set_percentage (job, 100 * foundDrvs / totalDrvs);
-
-					pk_backend_job_package (job,
-								info,
-								pk_package_id_build (attrPath2.c_str (),
-										     name.version.c_str (),
-										     system.c_str (),
-										     priv->defaultFlake.c_str ()),
-								description.c_str());
-				}
+		for (auto & matcher : matchers) {
+			switch (role) {
+			case PK_ROLE_ENUM_SEARCH_NAME:
+			case PK_ROLE_ENUM_RESOLVE:
+				if (matcher.matches (entry.pname) || matcher.matches (entry.attrPath))
+					found++;
+				break;
+			case PK_ROLE_ENUM_SEARCH_DETAILS:
+				if (matcher.matches (entry.description))
+					found++;
+				break;
+			default:
+				found++;
+				break;
 			}
+		}
 
-			else if (attrPath.size() == 0)
-				recurse();
+		if (found != matchers.size ())
+			continue;
 
-			else if (attrPath.size() >= 1) {
-				auto attr = cursor.maybeGetAttr(priv->state->sRecurseForDerivations);
-				if (attr && attr->getBool())
-					recurse();
+		bool isInstalled = false;
+		auto range = installedNames.equal_range (entry.pname);
+		for (auto it = range.first; it != range.second; it++) {
+			if (it->second.empty () || it->second == entry.version) {
+				isInstalled = true;
+				break;
 			}
-		} catch (nix::EvalError & e) {
 		}
-        };
-	visit(*cursor, {});
+
+		if (pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_INSTALLED) && isInstalled)
+			continue;
+		if (pk_bitfield_contain (filters, PK_FILTER_ENUM_INSTALLED) && !isInstalled)
+			continue;
+
+		if (pk_bitfield_contain (filters, PK_FILTER_ENUM_SUPPORTED) && !entry.available)
+			continue;
+		if (pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_SUPPORTED) && entry.available)
+			continue;
+
+		PkInfoEnum info = PK_INFO_ENUM_UNKNOWN;
+		if (entry.available)
+			info = PK_INFO_ENUM_AVAILABLE;
+		if (isInstalled)
+			info = PK_INFO_ENUM_INSTALLED;
+
+		g_autofree gchar *package_id = pk_package_id_build (entry.attrPath.c_str (),
+								    entry.version.c_str (),
+								    entry.system.c_str (),
+								    priv->defaultFlake.c_str ());
+		g_autoptr(PkPackage) package = pk_package_new ();
+		g_autoptr(GError) error = NULL;
+		if (!pk_package_set_id (package, package_id, &error)) {
+			g_warning ("package_id %s invalid and cannot be processed: %s",
+				   package_id, error->message);
+			continue;
+		}
+		pk_package_set_info (package, info);
+		pk_package_set_summary (package, entry.description.c_str ());
+		g_ptr_array_add (packages, g_steal_pointer (&package));
+
+		if (packages->len >= NIX_PACKAGES_BATCH_SIZE) {
+			/* the job keeps a reference to the array until it's emitted */
+			pk_backend_job_packages (job, packages);
+			g_ptr_array_unref (packages);
+			packages = g_ptr_array_new_with_free_func (g_object_unref);
+		}
+	}
+
+	if (packages->len > 0)
+		pk_backend_job_packages (job, packages);
+
 	pk_backend_job_set_percentage (job, 100);
 }
 
@@ -436,8 +548,9 @@ pk_backend_resolve(PkBackend* self, PkBackendJob* job, PkBitfield filters, gchar
 static void
 nix_refresh_thread (PkBackendJob* job, GVariant* params, gpointer p)
 {
+	/* relock against the latest nixpkgs, the index is only rebuilt if that changed the lock */
 	nix::settings.tarballTtl = 0;
-	nix_search_thread (job, params, p);
+	nix_get_search_index (job);
 	nix::settings.tarballTtl = 60 * 60;
 
 	pk_backend_job_set_percentage (job, 100);
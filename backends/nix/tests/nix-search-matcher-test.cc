@@ -0,0 +1,111 @@
+#include <glib.h>
+
+#include "nix-search-matcher.hh"
+
+static void
+nix_test_search_matcher_literal (void)
+{
+	NixSearchMatcher matcher ("FireFox");
+
+	g_assert_true (matcher.isLiteral ());
+	g_assert_true (matcher.matches ("firefox-esr"));
+	g_assert_true (matcher.matches ("Mozilla Firefox"));
+	g_assert_false (matcher.matches ("fire"));
+}
+
+static void
+nix_test_search_matcher_plus (void)
+{
+	/* ERE: one or more k, so the name with and without the + */
+	NixSearchMatcher gtk ("gtk+");
+	g_assert_false (gtk.isLiteral ());
+	g_assert_true (gtk.matches ("gtk+3"));
+	g_assert_true (gtk.matches ("GTK2"));
+	g_assert_false (gtk.matches ("gt"));
+
+	/* the second + is literal, not a PCRE possessive quantifier */
+	NixSearchMatcher cxx ("libsigc++");
+	g_assert_true (cxx.matches ("libsigc++-2.0"));
+	g_assert_false (cxx.matches ("libsigc"));
+
+	NixSearchMatcher gxx ("g++");
+	g_assert_true (gxx.matches ("g++"));
+	g_assert_false (gxx.matches ("gcc"));
+}
+
+static void
+nix_test_search_matcher_brace (void)
+{
+	/* a { that doesn't start an interval is literal */
+	NixSearchMatcher brace ("foo{bar}");
+	g_assert_true (brace.matches ("foo{bar}"));
+	g_assert_false (brace.matches ("foobar"));
+
+	NixSearchMatcher open ("a{");
+	g_assert_true (open.matches ("a{"));
+	g_assert_false (open.matches ("a"));
+
+	/* but an interval still repeats */
+	NixSearchMatcher interval ("^x{2}$");
+	g_assert_true (interval.matches ("xx"));
+	g_assert_false (interval.matches ("x"));
+	g_assert_false (interval.matches ("xxx"));
+}
+
+static void
+nix_test_search_matcher_ere (void)
+{
+	/* backslashes are not special in bracket expressions */
+	NixSearchMatcher bracket ("^[\\d]$");
+	g_assert_true (bracket.matches ("d"));
+	g_assert_true (bracket.matches ("\\"));
+	g_assert_false (bracket.matches ("1"));
+
+	NixSearchMatcher klass ("^[[:digit:]]+$");
+	g_assert_true (klass.matches ("42"));
+	g_assert_false (klass.matches ("4a"));
+
+	/* $ only matches at the very end */
+	NixSearchMatcher end ("fox$");
+	g_assert_true (end.matches ("firefox"));
+	g_assert_false (end.matches ("firefox\n"));
+
+	NixSearchMatcher alternation ("^(vim|emacs)$");
+	g_assert_true (alternation.matches ("Emacs"));
+	g_assert_false (alternation.matches ("neovim"));
+}
+
+static void
+nix_test_search_matcher_invalid (void)
+{
+	/* std::regex threw on these, they are matched literally now */
+	NixSearchMatcher paren ("foo(");
+	g_assert_true (paren.isLiteral ());
+	g_assert_true (paren.matches ("foo(bar"));
+	g_assert_false (paren.matches ("foobar"));
+}
+
+static void
+nix_test_search_matcher_to_pcre (void)
+{
+	g_assert_cmpstr (NixSearchMatcher::toPcre ("c++").c_str (), ==, "c+\\+");
+	g_assert_cmpstr (NixSearchMatcher::toPcre ("gtk+").c_str (), ==, "gtk+");
+	g_assert_cmpstr (NixSearchMatcher::toPcre ("a{2,3}").c_str (), ==, "a{2,3}");
+	g_assert_cmpstr (NixSearchMatcher::toPcre ("a{x}").c_str (), ==, "a\\{x\\}");
+	g_assert_cmpstr (NixSearchMatcher::toPcre ("(?i)").c_str (), ==, "(\\?i)");
+	g_assert_cmpstr (NixSearchMatcher::toPcre ("[\\]").c_str (), ==, "[\\\\]");
+}
+
+int main(int argc, char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/nix/search-matcher/literal", nix_test_search_matcher_literal);
+	g_test_add_func ("/nix/search-matcher/plus", nix_test_search_matcher_plus);
+	g_test_add_func ("/nix/search-matcher/brace", nix_test_search_matcher_brace);
+	g_test_add_func ("/nix/search-matcher/ere", nix_test_search_matcher_ere);
+	g_test_add_func ("/nix/search-matcher/invalid", nix_test_search_matcher_invalid);
+	g_test_add_func ("/nix/search-matcher/to-pcre", nix_test_search_matcher_to_pcre);
+
+	return g_test_run ();
+}
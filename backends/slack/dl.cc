@@ -9,16 +9,16 @@ namespace slack {
  * slack::Dl::collect_cache_info:
  * @tmpl: temporary directory for downloading the files.
  *
- * Download files needed to get the information like the list of packages
+ * Lists files needed to get the information like the list of packages
  * in available repositories, updates, package descriptions and so on.
  *
  * Returns: List of files needed for building the cache.
  **/
-GSList *
+std::vector<CacheFile>
 Dl::collect_cache_info (const gchar *tmpl) noexcept
 {
-	CURL *curl = NULL;
-	GSList *file_list = NULL;
+	std::vector<CacheFile> files;
+	gchar *dest;
 	GFile *tmp_dir, *repo_tmp_dir;
 
 	/* Create the temporary directory for the repository */
@@ -27,35 +27,22 @@ Dl::collect_cache_info (const gchar *tmpl) noexcept
 	g_file_make_directory(repo_tmp_dir, NULL, NULL);
 
 	/* There is no ChangeLog yet to check if there are updates or not. Just mark the index file for download */
-	auto source_dest = static_cast<gchar **> (g_malloc_n(3, sizeof(gchar *)));
-	source_dest[0] = g_strdup(this->index_file);
-	source_dest[1] = g_build_filename(tmpl,
-	                                  this->get_name (),
-	                                  "IndexFile",
-	                                  NULL);
-	source_dest[2] = NULL;
-	/* Check if the remote file can be found */
-	if (get_file(&curl, source_dest[0], NULL))
-	{
-		g_strfreev(source_dest);
-	}
-	else
-	{
-		file_list = g_slist_append(file_list, source_dest);
-	}
+	dest = g_build_filename(tmpl,
+	                        this->get_name (),
+	                        "IndexFile",
+	                        NULL);
+	files.push_back({ this->index_file, dest, true });
+	g_free(dest);
+
 	g_object_unref(repo_tmp_dir);
 	g_object_unref(tmp_dir);
 
-	if (curl)
-	{
-		curl_easy_cleanup(curl);
-	}
-	return file_list;
+	return files;
 }
 
 /**
  * slack::Dl::generate_cache:
- * @job: A #PkBackendJob.
+ * @db: database to write the cache to.
  * @tmpl: temporary directory for downloading the files.
  *
  * Download files needed to get the information like the list of packages
@@ -64,7 +51,7 @@ Dl::collect_cache_info (const gchar *tmpl) noexcept
  * Returns: List of files needed for building the cache.
  **/
 void
-Dl::generate_cache(PkBackendJob *job, const gchar *tmpl) noexcept
+Dl::generate_cache(sqlite3 *db, const gchar *tmpl) noexcept
 {
 	gchar **line_tokens, **pkg_tokens, *line, *collection_name = NULL, *list_filename;
 	gboolean skip = FALSE;
@@ -72,7 +59,6 @@ Dl::generate_cache(PkBackendJob *job, const gchar *tmpl) noexcept
 	GFileInputStream *fin;
 	GDataInputStream *data_in = NULL;
 	sqlite3_stmt *stmt = NULL;
-	auto job_data = static_cast<JobData *> (pk_backend_job_get_user_data(job));
 
 	/* Check if the temporary directory for this repository exists. If so the file metadata have to be generated */
 	list_filename = g_build_filename(tmpl,
@@ -87,7 +73,7 @@ Dl::generate_cache(PkBackendJob *job, const gchar *tmpl) noexcept
 	data_in = g_data_input_stream_new(G_INPUT_STREAM(fin));
 
 	/* Remove the old entries from this repository */
-	if (sqlite3_prepare_v2(job_data->db,
+	if (sqlite3_prepare_v2(db,
 						   "DELETE FROM repos WHERE repo LIKE @repo",
 						   -1,
 						   &stmt,
@@ -96,7 +82,7 @@ Dl::generate_cache(PkBackendJob *job, const gchar *tmpl) noexcept
 		sqlite3_step(stmt);
 		sqlite3_finalize(stmt);
 	}
-	if (sqlite3_prepare_v2(job_data->db,
+	if (sqlite3_prepare_v2(db,
 	                       "INSERT INTO repos (repo_order, repo) VALUES (@repo_order, @repo)",
 	                       -1,
 	                       &stmt,
@@ -113,7 +99,7 @@ Dl::generate_cache(PkBackendJob *job, const gchar *tmpl) noexcept
 	}
 
 	/* Insert new records */
-	if ((sqlite3_prepare_v2(job_data->db,
+	if ((sqlite3_prepare_v2(db,
 	                        "INSERT INTO pkglist (full_name, name, ver, arch, "
 	                        "summary, desc, compressed, uncompressed, cat, repo_order, ext) "
 	                        "VALUES (@full_name, @name, @ver, @arch, @summary, "
@@ -124,7 +110,7 @@ Dl::generate_cache(PkBackendJob *job, const gchar *tmpl) noexcept
 	{
 		goto out;
 	}
-	sqlite3_exec(job_data->db, "BEGIN TRANSACTION", NULL, NULL, NULL);
+	sqlite3_exec(db, "BEGIN TRANSACTION", NULL, NULL, NULL);
 
 	while ((line = g_data_input_stream_read_line(data_in, NULL, NULL, NULL)))
 	{
@@ -187,7 +173,7 @@ Dl::generate_cache(PkBackendJob *job, const gchar *tmpl) noexcept
 
 	/* Create a collection entry */
 	if (collection_name && g_seekable_seek(G_SEEKABLE(data_in), 0, G_SEEK_SET, NULL, NULL)
-	 && (sqlite3_prepare_v2(job_data->db,
+	 && (sqlite3_prepare_v2(db,
 	                        "INSERT INTO collections (name, repo_order, collection_pkg) "
 	                        "VALUES (@name, @repo_order, @collection_pkg)",
 	                        -1,
@@ -221,7 +207,7 @@ Dl::generate_cache(PkBackendJob *job, const gchar *tmpl) noexcept
 	}
 	g_free(collection_name);
 
-	sqlite3_exec(job_data->db, "END TRANSACTION", NULL, NULL, NULL);
+	sqlite3_exec(db, "END TRANSACTION", NULL, NULL, NULL);
 
 out:
 	if (data_in)
@@ -12,8 +12,8 @@ public:
 		guint8 order, const gchar *blacklist, gchar *index_file) noexcept;
 	~Dl () noexcept;
 
-	GSList *collect_cache_info (const gchar *tmpl) noexcept;
-	void generate_cache (PkBackendJob *job, const gchar *tmpl) noexcept;
+	std::vector<CacheFile> collect_cache_info (const gchar *tmpl) noexcept;
+	void generate_cache (sqlite3 *db, const gchar *tmpl) noexcept;
 
 private:
 	gchar *index_file;
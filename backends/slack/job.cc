@@ -1,6 +1,5 @@
 #include "job.h"
 
-#include <string>
 #include "utils.h"
 
 namespace slack {
@@ -20,19 +19,120 @@ filter_package (PkBitfield filters, bool is_installed)
 	return false;
 }
 
-static std::string
-generate_query(PkBitfield filters)
+/**
+ * Returns true if the metadata database has the full-text index
+ * used by the name and details search.
+ */
+bool
+has_search_index (sqlite3 *db)
+{
+	sqlite3_stmt *stmt;
+	bool ret = false;
+
+	if (sqlite3_prepare_v2 (db,
+				"SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'pkglist_fts'",
+				-1, &stmt, NULL) == SQLITE_OK)
+	{
+		ret = sqlite3_step (stmt) == SQLITE_ROW;
+		sqlite3_finalize (stmt);
+	}
+	return ret;
+}
+
+/**
+ * Creates the full-text index over the package names, summaries and
+ * descriptions if it doesn't exist yet. The trigram tokenizer lets the
+ * index answer the same substring LIKE patterns the search always used.
+ *
+ * Returns false if SQLite was built without FTS5 or the trigram tokenizer,
+ * in which case the search falls back to scanning pkglist.
+ */
+bool
+create_search_index (sqlite3 *db)
+{
+	gchar *db_err = NULL;
+
+	if (has_search_index (db))
+	{
+		return true;
+	}
+
+	if (sqlite3_exec (db,
+				"CREATE VIRTUAL TABLE pkglist_fts USING fts5(name, summary, \"desc\", "
+				"content = 'pkglist', content_rowid = 'rowid', tokenize = 'trigram')",
+				NULL, NULL, &db_err) != SQLITE_OK)
+	{
+		g_debug ("Not using a full-text search index: %s", db_err);
+		sqlite3_free (db_err);
+		return false;
+	}
+	return rebuild_search_index (db);
+}
+
+/**
+ * The index is an external content table over pkglist, so it has to be
+ * rebuilt whenever pkglist changes. The refresh does that inside each merge
+ * transaction, this is for filling a newly created index.
+ */
+bool
+rebuild_search_index (sqlite3 *db)
+{
+	gchar *db_err = NULL;
+
+	if (!has_search_index (db))
+	{
+		return false;
+	}
+
+	if (sqlite3_exec (db, "INSERT INTO pkglist_fts(pkglist_fts) VALUES('rebuild')",
+				NULL, NULL, &db_err) != SQLITE_OK)
+	{
+		g_warning ("Failed to rebuild the search index: %s", db_err);
+		sqlite3_free (db_err);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Returns the search query as a format string taking the column and the
+ * search pattern. With use_index the name and desc columns are matched
+ * through pkglist_fts instead of scanning pkglist.
+ */
+std::string
+generate_query (PkBitfield filters, bool use_index)
 {
 	std::string query(
 			"SELECT (p1.name || ';' || p1.ver || ';' || p1.arch || ';' || r.repo), p1.summary, "
-			"p1.full_name FROM pkglist AS p1 NATURAL JOIN repos AS r "
-			"WHERE p1.%s LIKE '%%%q%%' AND p1.ext NOT LIKE 'obsolete' AND p1.repo_order = "
-			"(SELECT MIN(p2.repo_order) FROM pkglist AS p2 WHERE p2.name = p1.name GROUP BY p2.name)");
+			"p1.full_name ");
+
+	if (use_index)
+	{
+		query.append(
+				"FROM pkglist_fts AS f "
+				"JOIN pkglist AS p1 ON p1.rowid = f.rowid "
+				"JOIN repos AS r ON r.repo_order = p1.repo_order "
+				"WHERE f.%s LIKE '%%%q%%'");
+	}
+	else
+	{
+		query.append(
+				"FROM pkglist AS p1 "
+				"JOIN repos AS r ON r.repo_order = p1.repo_order "
+				"WHERE p1.%s LIKE '%%%q%%'");
+	}
+
+	/* Only the package from the repository with the lowest order,
+	 * looked up through the (name, repo_order) primary key */
+	query.append(
+			" AND p1.ext NOT LIKE 'obsolete' AND NOT EXISTS "
+			"(SELECT 1 FROM pkglist AS p2 WHERE p2.name = p1.name AND p2.repo_order < p1.repo_order)");
 
+	/* filelist is keyed by (full_name, filename) */
 	if (pk_bitfield_contain (filters, PK_FILTER_ENUM_APPLICATION))
 	{
 		query.append(
-				" AND EXISTS (SELECT filelist.full_name "
+				" AND EXISTS (SELECT 1 "
 				"FROM filelist "
 				"WHERE filelist.full_name = p1.full_name "
 				"AND filelist.filename LIKE 'usr/share/applications/%%.desktop')");
@@ -40,7 +140,7 @@ generate_query(PkBitfield filters)
 	else if (pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_APPLICATION))
 	{
 		query.append(
-				" AND NOT EXISTS (SELECT filelist.full_name "
+				" AND NOT EXISTS (SELECT 1 "
 				"FROM filelist "
 				"WHERE filelist.full_name = p1.full_name "
 				"AND filelist.filename LIKE 'usr/share/applications/%%.desktop')");
@@ -63,16 +163,21 @@ pk_backend_search_thread (PkBackendJob *job, GVariant *params, gpointer user_dat
 	g_variant_get (params, "(t^a&s)", &filters, &vals);
 	gchar *search = g_strjoinv ("%", vals);
 
-	gchar *query = sqlite3_mprintf (slack::generate_query(filters).c_str(),
+	/* The index only covers the name, summary and desc columns */
+	bool use_index = g_strcmp0 (static_cast<const gchar *> (user_data), "cat") != 0
+		&& slack::has_search_index (job_data->db);
+	gchar *query = sqlite3_mprintf (slack::generate_query(filters, use_index).c_str(),
 			user_data, search);
 
 	sqlite3_stmt *stmt;
 	if ((sqlite3_prepare_v2 (job_data->db, query, -1, &stmt, NULL) == SQLITE_OK))
 	{
+		auto installed = slack::InstalledPackages::get ();
+
 		/* Now we're ready to output all packages */
 		while (sqlite3_step (stmt) == SQLITE_ROW)
 		{
-			PkInfoEnum info = slack::is_installed (
+			PkInfoEnum info = installed->is_installed (
 					reinterpret_cast<const gchar *> (sqlite3_column_text (stmt, 2)));
 
 			if ((info == PK_INFO_ENUM_INSTALLED || info == PK_INFO_ENUM_UPDATING)
@@ -3,11 +3,20 @@
 
 #include <pk-backend.h>
 #include <sqlite3.h>
+#include <string>
 
 namespace slack {
 
 bool filter_package (PkBitfield filters, bool is_installed);
 
+bool has_search_index (sqlite3 *db);
+
+bool create_search_index (sqlite3 *db);
+
+bool rebuild_search_index (sqlite3 *db);
+
+std::string generate_query (PkBitfield filters, bool use_index);
+
 }
 
 extern "C" {
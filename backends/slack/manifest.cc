@@ -0,0 +1,224 @@
+#include <string.h>
+#include "manifest.h"
+
+namespace slack {
+
+/**
+ * slack::ManifestReader::parse_package:
+ * @line: A line of the manifest.
+ * @len: Line length.
+ * @full_name: Set to the package name without the extension.
+ *
+ * Parses the package header, "||   Package:  ./a/aaa_base-15.0-x86_64-4.txz".
+ * full_name is cleared if the file isn't a package.
+ *
+ * Returns: true if the line is a package header, false otherwise.
+ **/
+bool
+ManifestReader::parse_package (const gchar *line, gsize len, std::string &full_name)
+{
+	const gchar *end = line + len;
+	const gchar *p = line + 2;
+	const gchar *name;
+
+	if (len < 2 || line[0] != '|' || line[1] != '|')
+	{
+		return false;
+	}
+
+	if (p == end || (*p != ' ' && *p != '\t'))
+	{
+		return false;
+	}
+	while (p != end && (*p == ' ' || *p == '\t'))
+	{
+		++p;
+	}
+	if (end - p < 8 || strncmp (p, "Package:", 8) != 0)
+	{
+		return false;
+	}
+	p += 8;
+	if (p == end || (*p != ' ' && *p != '\t'))
+	{
+		return false;
+	}
+	while (p != end && (*p == ' ' || *p == '\t'))
+	{
+		++p;
+	}
+
+	full_name.clear ();
+
+	/* Only packages in a directory with a .tbz, .tlz, .txz or .tgz extension */
+	name = static_cast<const gchar *> (memrchr (p, '/', end - p));
+	if (name == NULL || name == p || end - name < 6
+	 || end[-4] != '.' || end[-3] != 't' || end[-1] != 'z'
+	 || (end[-2] != 'b' && end[-2] != 'l' && end[-2] != 'x' && end[-2] != 'g'))
+	{
+		return true;
+	}
+	++name;
+	full_name.assign (name, end - 4 - name);
+
+	return true;
+}
+
+/**
+ * slack::ManifestReader::parse_file:
+ * @line: A line of the manifest.
+ * @len: Line length.
+ * @filename: Set to the file path in the package.
+ * @filename_len: Set to the file path length.
+ *
+ * Parses an ls-style tar listing line,
+ * "-rw-r--r-- root/root       186 2021-06-14 20:52 etc/HOSTNAME.new".
+ * Directories are listed too, but the package root ("./") and the install
+ * scripts are skipped.
+ *
+ * Returns: true if the line lists a package file, false otherwise.
+ **/
+bool
+ManifestReader::parse_file (const gchar *line, gsize len,
+		const gchar **filename, gsize *filename_len)
+{
+	static const gchar *const mode[] = {
+		"-bcdlps", "-r", "-w", "-xsS", "-r", "-w", "-xsS", "-r", "-w", "-xtT"
+	};
+	const gchar *end = line + len;
+	const gchar *p = line;
+	const gchar *start;
+
+	if (len < 11)
+	{
+		return false;
+	}
+	for (guint i = 0; i < G_N_ELEMENTS (mode); i++, p++)
+	{
+		if (*p == '\0' || strchr (mode[i], *p) == NULL)
+		{
+			return false;
+		}
+	}
+	if (!g_ascii_isspace (*p++))
+	{
+		return false;
+	}
+
+	/* Owner */
+	for (start = p; p != end && !g_ascii_isspace (*p); ++p);
+	if (p == start)
+	{
+		return false;
+	}
+	for (start = p; p != end && g_ascii_isspace (*p); ++p);
+	if (p == start)
+	{
+		return false;
+	}
+
+	/* Size */
+	for (start = p; p != end && g_ascii_isdigit (*p); ++p);
+	if (p == start || p == end || !g_ascii_isspace (*p++))
+	{
+		return false;
+	}
+
+	/* Date */
+	for (start = p; p != end && (g_ascii_isdigit (*p) || *p == '-'); ++p);
+	if (p == start || p == end || !g_ascii_isspace (*p++))
+	{
+		return false;
+	}
+
+	/* Time */
+	for (start = p; p != end && (g_ascii_isdigit (*p) || *p == ':'); ++p);
+	if (p == start || p == end || !g_ascii_isspace (*p++))
+	{
+		return false;
+	}
+
+	if ((p != end && *p == '.')
+	 || (end - p >= 8 && strncmp (p, "install/", 8) == 0))
+	{
+		return false;
+	}
+
+	*filename = p;
+	*filename_len = end - p;
+
+	return true;
+}
+
+void
+ManifestReader::parse_line (const gchar *line, gsize len, const FileCallback &callback)
+{
+	const gchar *filename;
+	gsize filename_len;
+
+	if (parse_package (line, len, this->full_name))
+	{
+		return;
+	}
+	if (!this->full_name.empty ()
+	 && parse_file (line, len, &filename, &filename_len))
+	{
+		callback (this->full_name, filename, filename_len);
+	}
+}
+
+/**
+ * slack::ManifestReader::feed:
+ * @data: Next chunk of the manifest.
+ * @length: Chunk length.
+ * @callback: Called for every file of a package.
+ *
+ * Parses all complete lines of the chunk, the rest is kept for the next one.
+ **/
+void
+ManifestReader::feed (const gchar *data, gsize length, const FileCallback &callback)
+{
+	const gchar *end = data + length;
+
+	while (data < end)
+	{
+		auto eol = static_cast<const gchar *> (memchr (data, '\n', end - data));
+
+		if (eol == NULL)
+		{
+			this->buffer.append (data, end - data);
+			return;
+		}
+
+		if (this->buffer.empty ())
+		{
+			this->parse_line (data, eol - data, callback);
+		}
+		else
+		{
+			this->buffer.append (data, eol - data);
+			this->parse_line (this->buffer.data (), this->buffer.size (), callback);
+			this->buffer.clear ();
+		}
+		data = eol + 1;
+	}
+}
+
+/**
+ * slack::ManifestReader::finish:
+ * @callback: Called for every file of a package.
+ *
+ * Parses the last line if it wasn't terminated.
+ **/
+void
+ManifestReader::finish (const FileCallback &callback)
+{
+	if (!this->buffer.empty ())
+	{
+		this->parse_line (this->buffer.data (), this->buffer.size (), callback);
+		this->buffer.clear ();
+	}
+	this->full_name.clear ();
+}
+
+}
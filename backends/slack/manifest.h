@@ -0,0 +1,37 @@
+#ifndef __SLACK_MANIFEST_H
+#define __SLACK_MANIFEST_H
+
+#include <functional>
+#include <string>
+#include <glib.h>
+
+namespace slack {
+
+/**
+ * slack::ManifestReader:
+ * Splits a MANIFEST, the tar listings of all packages of a directory, into
+ * the files of each package. The text can be fed in chunks of any size.
+ **/
+class ManifestReader
+{
+public:
+	typedef std::function<void(const std::string &full_name,
+			const gchar *filename, gsize filename_len)> FileCallback;
+
+	void feed (const gchar *data, gsize length, const FileCallback &callback);
+	void finish (const FileCallback &callback);
+
+	static bool parse_package (const gchar *line, gsize len, std::string &full_name);
+	static bool parse_file (const gchar *line, gsize len,
+			const gchar **filename, gsize *filename_len);
+
+private:
+	std::string buffer;
+	std::string full_name;
+
+	void parse_line (const gchar *line, gsize len, const FileCallback &callback);
+};
+
+}
+
+#endif /* __SLACK_MANIFEST_H */
@@ -3,6 +3,8 @@
 #include <packagekit-glib2/pk-debug.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <memory>
+#include <vector>
 #include <zlib.h>
 #include <curl/curl.h>
 #include <pk-backend.h>
@@ -15,6 +17,9 @@
 
 using namespace slack;
 
+/* How long queries wait for a refresh to commit to the metadata database */
+#define SLACK_DB_BUSY_TIMEOUT 10000 /* ms */
+
 static GSList *repos = NULL;
 
 void pk_backend_initialize(GKeyFile *conf, PkBackend *backend)
@@ -84,6 +89,15 @@ void pk_backend_initialize(GKeyFile *conf, PkBackend *backend)
 		g_error("Failed to update database: %s", path);
 	}
 
+	if (sqlite3_exec(db,
+	                 "CREATE TABLE IF NOT EXISTS http_cache "
+	                 "(url TEXT PRIMARY KEY, etag TEXT, last_modified TEXT)",
+	                 NULL, NULL, NULL) != SQLITE_OK)
+	{
+		g_error("Failed to update database: %s", sqlite3_errmsg(db));
+	}
+	create_search_index(db);
+
 	g_object_unref(file_info);
 	g_object_unref(conf_file);
 	sqlite3_close_v2(db);
@@ -157,6 +171,21 @@ pk_backend_supports_parallelization(PkBackend *backend)
 	return FALSE;
 }
 
+/* Every job opens its own connection to the metadata database and the
+ * installed packages are read from an immutable snapshot, so the queries
+ * can run while another job installs packages or refreshes the cache */
+PkBitfield
+pk_backend_get_parallel_roles(PkBackend *backend)
+{
+	return pk_bitfield_from_enums(PK_ROLE_ENUM_GET_DETAILS,
+	                              PK_ROLE_ENUM_RESOLVE,
+	                              PK_ROLE_ENUM_SEARCH_DETAILS,
+	                              PK_ROLE_ENUM_SEARCH_FILE,
+	                              PK_ROLE_ENUM_SEARCH_GROUP,
+	                              PK_ROLE_ENUM_SEARCH_NAME,
+	                              -1);
+}
+
 const gchar *
 pk_backend_get_description(PkBackend* backend)
 {
@@ -202,6 +231,7 @@ pk_backend_start_job(PkBackend *backend, PkBackendJob *job)
 	db_filename = g_build_filename(LOCALSTATEDIR, "cache", "PackageKit", "metadata", "metadata.db", NULL);
 	if (sqlite3_open(db_filename, &job_data->db) == SQLITE_OK) { /* Some SQLite settings */
 		sqlite3_exec(job_data->db, "PRAGMA foreign_keys = ON", NULL, NULL, NULL);
+		sqlite3_busy_timeout(job_data->db, SLACK_DB_BUSY_TIMEOUT);
 	}
 	else
 	{
@@ -234,6 +264,13 @@ pk_backend_stop_job(PkBackend *backend, PkBackendJob *job)
 	pk_backend_job_set_user_data(job, NULL);
 }
 
+void
+pk_backend_cancel(PkBackend *backend, PkBackendJob *job)
+{
+	/* The daemon cancels the job's cancellable, the jobs that allow
+	 * cancelling check it */
+}
+
 void
 pk_backend_search_names(PkBackend *backend, PkBackendJob *job, PkBitfield filters, gchar **values)
 {
@@ -273,10 +310,12 @@ pk_backend_search_files_thread(PkBackendJob *job, GVariant *params, gpointer use
 
 	if ((sqlite3_prepare_v2(job_data->db, query, -1, &stmt, NULL) == SQLITE_OK))
 	{
+		auto installed = InstalledPackages::get();
+
 		/* Now we're ready to output all packages */
 		while (sqlite3_step(stmt) == SQLITE_ROW)
 		{
-			ret = is_installed((gchar*) sqlite3_column_text(stmt, 2));
+			ret = installed->is_installed((gchar*) sqlite3_column_text(stmt, 2));
 			if ((ret == PK_INFO_ENUM_INSTALLED) || (ret == PK_INFO_ENUM_UPDATING))
 			{
 				pk_backend_job_package(job, PK_INFO_ENUM_INSTALLED,
@@ -418,6 +457,8 @@ pk_backend_resolve_thread(PkBackendJob *job, GVariant *params, gpointer user_dat
 							-1,
 							&stmt,
 							NULL) == SQLITE_OK)) {
+		auto installed = InstalledPackages::get();
+
 		/* Output packages matching each pattern */
 		for (val = vals; *val; val++)
 		{
@@ -425,7 +466,7 @@ pk_backend_resolve_thread(PkBackendJob *job, GVariant *params, gpointer user_dat
 
 			while (sqlite3_step(stmt) == SQLITE_ROW)
 			{
-				ret = is_installed((gchar*) sqlite3_column_text(stmt, 2));
+				ret = installed->is_installed((gchar*) sqlite3_column_text(stmt, 2));
 				if ((ret == PK_INFO_ENUM_INSTALLED) || (ret == PK_INFO_ENUM_UPDATING))
 				{
 					pk_backend_job_package(job, PK_INFO_ENUM_INSTALLED,
@@ -529,6 +570,7 @@ pk_backend_install_packages_thread(PkBackendJob *job, GVariant *params, gpointer
 	sqlite3_stmt *pkglist_stmt = NULL, *collection_stmt = NULL;
     PkBitfield transaction_flags = 0;
 	PkInfoEnum ret;
+	std::shared_ptr<const InstalledPackages> installed;
 	auto job_data = static_cast<JobData *> (pk_backend_job_get_user_data(job));
 
 	g_variant_get(params, "(t^a&s)", &transaction_flags, &pkg_ids);
@@ -554,6 +596,8 @@ pk_backend_install_packages_thread(PkBackendJob *job, GVariant *params, gpointer
 		goto out;
 	}
 
+	installed = InstalledPackages::get();
+
 	for (i = 0; pkg_ids[i]; i++)
 	{
 		gchar **tokens = pk_package_id_split(pkg_ids[i]);
@@ -585,7 +629,7 @@ pk_backend_install_packages_thread(PkBackendJob *job, GVariant *params, gpointer
 
 				while (sqlite3_step(collection_stmt) == SQLITE_ROW)
 				{
-					ret = is_installed((gchar*) sqlite3_column_text(collection_stmt, 2));
+					ret = installed->is_installed((gchar*) sqlite3_column_text(collection_stmt, 2));
 					if ((ret == PK_INFO_ENUM_INSTALLING) || (ret == PK_INFO_ENUM_UPDATING))
 					{
 						if ((pk_bitfield_contain(transaction_flags, PK_TRANSACTION_FLAG_ENUM_SIMULATE)) &&
@@ -741,10 +785,7 @@ pk_backend_get_updates_thread(PkBackendJob *job, GVariant *params, gpointer user
 {
 	gchar *pkg_id, *full_name, *desc;
 	const gchar *pkg_metadata_filename;
-	GFile *pkg_metadata_dir;
-	GFileEnumerator *pkg_metadata_enumerator;
-	GFileInfo *pkg_metadata_file_info;
-	GError *err = NULL;
+	std::shared_ptr<const InstalledPackages> installed;
 	sqlite3_stmt *stmt;
 	auto job_data = static_cast<JobData *> (pk_backend_job_get_user_data(job));
 
@@ -763,29 +804,17 @@ pk_backend_get_updates_thread(PkBackendJob *job, GVariant *params, gpointer user
 		goto out;
 	}
 
-	/* Read the package metadata directory and comprare all installed packages with ones in the cache */
-	pkg_metadata_dir = g_file_new_for_path("/var/log/packages");
-	pkg_metadata_enumerator = g_file_enumerate_children(pkg_metadata_dir, "standard::name",
-														 G_FILE_QUERY_INFO_NONE,
-														 NULL,
-														 &err);
-	g_object_unref(pkg_metadata_dir);
-	if (err)
-	{
-		pk_backend_job_error_code(job, PK_ERROR_ENUM_NO_CACHE, "/var/log/packages: %s", err->message);
-		g_error_free(err);
-		goto out;
-	}
-
-	while ((pkg_metadata_file_info = g_file_enumerator_next_file(pkg_metadata_enumerator, NULL, NULL)))
+	/* Compare all installed packages with ones in the cache */
+	installed = InstalledPackages::get();
+	for (const auto &pkg : installed->get_packages())
 	{
 		gchar **tokens;
 
-		pkg_metadata_filename = g_file_info_get_name(pkg_metadata_file_info);
+		pkg_metadata_filename = pkg.second.c_str();
 		tokens = split_package_name(pkg_metadata_filename);
 
 		/* Select the package from the database */
-		sqlite3_bind_text(stmt, 1, tokens[0], -1, SQLITE_TRANSIENT);
+		sqlite3_bind_text(stmt, 1, pkg.first.c_str(), -1, SQLITE_TRANSIENT);
 
 		/* If there are more packages with the same name, remember the one from the
 		 * repository with the lowest order. */
@@ -832,9 +861,7 @@ pk_backend_get_updates_thread(PkBackendJob *job, GVariant *params, gpointer user
 		sqlite3_reset(stmt);
 
 		g_strfreev(tokens);
-		g_object_unref(pkg_metadata_file_info);
 	}
-	g_object_unref(pkg_metadata_enumerator);
 
 out:
 	sqlite3_finalize(stmt);
@@ -917,20 +944,211 @@ pk_backend_update_packages(PkBackend *backend,
 	pk_backend_job_thread_create(job, pk_backend_update_packages_thread, NULL, NULL);
 }
 
+/* The cache of one repository, generated into its own staging database */
+struct RepoRefresh
+{
+	Pkgtools *repo;
+	std::vector<CacheFile> files;
+	gsize first_download, n_downloads;
+	gboolean unchanged;
+	gchar *staging;
+	const gchar *tmpl;
+	const gchar *schema;
+	GCancellable *cancellable;
+	GThread *thread;
+};
+
+/* Staging databases generated at the same time */
+#define SLACK_MAX_STAGING_THREADS 4
+
+/* Tables the repositories write to, created in every staging database */
+static gchar *
+get_staging_schema(sqlite3 *db)
+{
+	sqlite3_stmt *stmt;
+	GString *schema = g_string_new(NULL);
+
+	if (sqlite3_prepare_v2(db,
+	                       "SELECT sql FROM sqlite_master WHERE type = 'table' "
+	                       "AND name IN ('repos', 'pkglist', 'collections', 'filelist')",
+	                       -1,
+	                       &stmt,
+	                       NULL) == SQLITE_OK)
+	{
+		while (sqlite3_step(stmt) == SQLITE_ROW)
+		{
+			g_string_append_printf(schema, "%s;\n", sqlite3_column_text(stmt, 0));
+		}
+		sqlite3_finalize(stmt);
+	}
+	return g_string_free(schema, FALSE);
+}
+
+/* Interrupts the statements of a staging database once the job is cancelled */
+static gint
+staging_cache_progress_cb(gpointer data)
+{
+	return g_cancellable_is_cancelled(static_cast<GCancellable *> (data));
+}
+
+static gpointer
+generate_staging_cache_thread(gpointer data)
+{
+	auto refresh = static_cast<RepoRefresh *> (data);
+	sqlite3 *db;
+
+	if (sqlite3_open(refresh->staging, &db) == SQLITE_OK
+	 && sqlite3_exec(db, "PRAGMA journal_mode = OFF; PRAGMA synchronous = OFF", NULL, NULL, NULL) == SQLITE_OK
+	 && sqlite3_exec(db, refresh->schema, NULL, NULL, NULL) == SQLITE_OK)
+	{
+		sqlite3_progress_handler(db, 1000, staging_cache_progress_cb, refresh->cancellable);
+		refresh->repo->generate_cache(db, refresh->tmpl);
+	}
+	sqlite3_close(db);
+
+	return NULL;
+}
+
+/* Replaces the repository in the metadata database with the staged one,
+ * unless nothing was staged. @cleanup is run in the same transaction, so
+ * readers never see the metadata database emptied by a forced refresh.
+ * The search index has no triggers on pkglist, so it is rebuilt in the
+ * same transaction as well and never lags behind the merged packages */
+static gboolean
+merge_staging_cache(sqlite3 *db, RepoRefresh *refresh, const gchar *cleanup, gchar **db_err)
+{
+	gchar *query;
+	gint ret;
+
+	query = sqlite3_mprintf("ATTACH DATABASE %Q AS staging", refresh->staging);
+	ret = sqlite3_exec(db, query, NULL, NULL, db_err);
+	sqlite3_free(query);
+	if (ret != SQLITE_OK)
+	{
+		return FALSE;
+	}
+
+	query = sqlite3_mprintf("BEGIN TRANSACTION;"
+	                        "%s;"
+	                        "DELETE FROM main.repos WHERE repo LIKE %Q "
+	                        "AND EXISTS (SELECT 1 FROM staging.repos);"
+	                        "INSERT OR REPLACE INTO main.repos SELECT * FROM staging.repos;"
+	                        "INSERT OR REPLACE INTO main.pkglist SELECT * FROM staging.pkglist;"
+	                        /* Rows of packages that weren't staged, e.g. blacklisted,
+	                         * would fail the foreign keys and the whole merge */
+	                        "INSERT OR REPLACE INTO main.collections SELECT c.* FROM staging.collections AS c "
+	                        "WHERE EXISTS (SELECT 1 FROM main.pkglist AS p "
+	                        "WHERE p.name = c.name AND p.repo_order = c.repo_order);"
+	                        "INSERT OR REPLACE INTO main.filelist SELECT f.* FROM staging.filelist AS f "
+	                        "WHERE EXISTS (SELECT 1 FROM main.pkglist AS p WHERE p.full_name = f.full_name);"
+	                        "%s"
+	                        "COMMIT",
+	                        cleanup ? cleanup : "",
+	                        refresh->repo->get_name(),
+	                        has_search_index(db) ? "INSERT INTO main.pkglist_fts(pkglist_fts) VALUES('rebuild');" : "");
+	ret = sqlite3_exec(db, query, NULL, NULL, db_err);
+	sqlite3_free(query);
+	if (ret != SQLITE_OK)
+	{
+		sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+	}
+	sqlite3_exec(db, "DETACH DATABASE staging", NULL, NULL, NULL);
+
+	return ret == SQLITE_OK;
+}
+
+/* Sets the validators of the last download, if the repository is still in the cache */
+static void
+load_validators(sqlite3 *db, RepoRefresh *refresh, std::vector<FileDownload> &downloads)
+{
+	sqlite3_stmt *stmt;
+
+	if (sqlite3_prepare_v2(db,
+	                       "SELECT h.etag, h.last_modified FROM http_cache AS h "
+	                       "WHERE h.url = @url AND EXISTS (SELECT 1 FROM repos WHERE repo LIKE @repo)",
+	                       -1,
+	                       &stmt,
+	                       NULL) != SQLITE_OK)
+	{
+		return;
+	}
+	for (gsize i = refresh->first_download; i < refresh->first_download + refresh->n_downloads; i++)
+	{
+		sqlite3_bind_text(stmt, 1, downloads[i].url.c_str(), -1, SQLITE_TRANSIENT);
+		sqlite3_bind_text(stmt, 2, refresh->repo->get_name(), -1, SQLITE_TRANSIENT);
+		if (sqlite3_step(stmt) == SQLITE_ROW)
+		{
+			if (sqlite3_column_text(stmt, 0))
+			{
+				downloads[i].etag = (const gchar *) sqlite3_column_text(stmt, 0);
+			}
+			if (sqlite3_column_text(stmt, 1))
+			{
+				downloads[i].last_modified = (const gchar *) sqlite3_column_text(stmt, 1);
+			}
+		}
+		sqlite3_clear_bindings(stmt);
+		sqlite3_reset(stmt);
+	}
+	sqlite3_finalize(stmt);
+}
+
+/* Stores the validators of the files transferred in full. Unchanged and
+ * failed downloads keep the stored ones */
+static void
+save_validators(sqlite3 *db, RepoRefresh *refresh, std::vector<FileDownload> &downloads)
+{
+	sqlite3_stmt *stmt;
+
+	if (sqlite3_prepare_v2(db,
+	                       "INSERT OR REPLACE INTO http_cache (url, etag, last_modified) "
+	                       "VALUES (@url, @etag, @last_modified)",
+	                       -1,
+	                       &stmt,
+	                       NULL) != SQLITE_OK)
+	{
+		return;
+	}
+	for (gsize i = refresh->first_download; i < refresh->first_download + refresh->n_downloads; i++)
+	{
+		if (downloads[i].result != CURLE_OK || downloads[i].response_code != 200)
+		{
+			continue;
+		}
+		sqlite3_bind_text(stmt, 1, downloads[i].url.c_str(), -1, SQLITE_TRANSIENT);
+		if (!downloads[i].etag.empty())
+		{
+			sqlite3_bind_text(stmt, 2, downloads[i].etag.c_str(), -1, SQLITE_TRANSIENT);
+		}
+		if (!downloads[i].last_modified.empty())
+		{
+			sqlite3_bind_text(stmt, 3, downloads[i].last_modified.c_str(), -1, SQLITE_TRANSIENT);
+		}
+		sqlite3_step(stmt);
+		sqlite3_clear_bindings(stmt);
+		sqlite3_reset(stmt);
+	}
+	sqlite3_finalize(stmt);
+}
+
 static void
 pk_backend_refresh_cache_thread(PkBackendJob *job, GVariant *params, gpointer user_data)
 {
-	gchar *tmp_dir_name, *db_err, *path = NULL;
+	gchar *tmp_dir_name, *db_err, *path = NULL, *schema = NULL, *cleanup = NULL;
 	gint ret;
 	gboolean force;
-	GSList *file_list = NULL;
+	gsize n_probes = 0, n_started = 0;
 	GFile *db_file = NULL;
 	GFileInfo *file_info = NULL;
 	GError *err = NULL;
 	sqlite3_stmt *stmt = NULL;
+	std::vector<RepoRefresh> refreshes;
+	std::vector<FileDownload> probes, downloads, retries;
 	auto job_data = static_cast<JobData *> (pk_backend_job_get_user_data(job));
+	GCancellable *cancellable = pk_backend_job_get_cancellable(job);
 
 	pk_backend_job_set_status(job, PK_STATUS_ENUM_DOWNLOAD_CHANGELOG);
+	pk_backend_job_set_allow_cancel(job, TRUE);
 
 	/* Create temporary directory */
 	tmp_dir_name = g_dir_make_tmp("PackageKit.XXXXXX", &err);
@@ -974,42 +1192,200 @@ pk_backend_refresh_cache_thread(PkBackendJob *job, GVariant *params, gpointer us
 			force = TRUE;
 		}
 	}
-	if (force) /* It should empty all tables */
+	if (force) /* Drop the repositories that aren't configured anymore and all validators */
 	{
-		if (sqlite3_exec(job_data->db, "DELETE FROM repos", NULL, 0, &db_err) != SQLITE_OK)
+		GString *names = g_string_new("DELETE FROM main.repos WHERE repo NOT IN (''");
+
+		for (GSList *l = repos; l; l = g_slist_next(l))
 		{
-			pk_backend_job_error_code(job, PK_ERROR_ENUM_INTERNAL_ERROR, "%s", db_err);
-			sqlite3_free(db_err);
-			goto out;
+			gchar *name = sqlite3_mprintf(", %Q", static_cast<Pkgtools *> (l->data)->get_name());
+
+			g_string_append(names, name);
+			sqlite3_free(name);
 		}
+		g_string_append(names, "); DELETE FROM main.http_cache");
+		cleanup = g_string_free(names, FALSE);
 	}
 
-	// Get list of files that should be downloaded.
+	/* Get list of files that should be downloaded and check, all at once,
+	 * that they can be found */
 	for (GSList *l = repos; l; l = g_slist_next(l))
 	{
-		file_list = g_slist_concat(file_list,
-				static_cast<Pkgtools *> (l->data)->collect_cache_info (tmp_dir_name));
+		RepoRefresh refresh = {};
+
+		refresh.repo = static_cast<Pkgtools *> (l->data);
+		refresh.files = refresh.repo->collect_cache_info(tmp_dir_name);
+		for (const auto &file : refresh.files)
+		{
+			FileDownload probe;
+
+			probe.url = file.url;
+			probe.dest = file.dest;
+			probe.probe = true;
+			probes.push_back(probe);
+		}
+		refreshes.push_back(refresh);
+	}
+	get_files(probes, cancellable);
+
+	for (auto &refresh : refreshes)
+	{
+		gboolean found = TRUE;
+
+		for (gsize i = 0; i < refresh.files.size(); i++)
+		{
+			if (refresh.files[i].required && !probes[n_probes + i].is_downloaded())
+			{
+				g_debug("%s: %s couldn't be found", refresh.repo->get_name(), refresh.files[i].url.c_str());
+				found = FALSE;
+			}
+		}
+
+		refresh.first_download = downloads.size();
+		for (gsize i = 0; found && i < refresh.files.size(); i++)
+		{
+			if (probes[n_probes + i].is_downloaded())
+			{
+				FileDownload download;
+
+				download.url = refresh.files[i].url;
+				download.dest = refresh.files[i].dest;
+				downloads.push_back(download);
+			}
+		}
+		n_probes += refresh.files.size();
+		refresh.n_downloads = downloads.size() - refresh.first_download;
+
+		if (!force)
+		{
+			load_validators(job_data->db, &refresh, downloads);
+		}
 	}
 
 	/* Download repository */
 	pk_backend_job_set_status(job, PK_STATUS_ENUM_DOWNLOAD_REPOSITORY);
 
-	for (GSList *l = file_list; l; l = g_slist_next(l))
+	get_files(downloads, cancellable);
+
+	/* A repository is skipped only if none of its files changed. Otherwise
+	 * the unchanged files are missing, so download all of them again to
+	 * keep the order of the files sharing a destination */
+	for (auto &refresh : refreshes)
 	{
-		get_file(&job_data->curl, static_cast<gchar **> (l->data)[0],
-				static_cast<gchar **> (l->data)[1]);
+		gsize n_unchanged = 0;
+
+		for (gsize i = refresh.first_download; i < refresh.first_download + refresh.n_downloads; i++)
+		{
+			n_unchanged += downloads[i].is_unchanged();
+		}
+		refresh.unchanged = refresh.n_downloads > 0 && n_unchanged == refresh.n_downloads;
+
+		if (n_unchanged == 0 || refresh.unchanged)
+		{
+			continue;
+		}
+		for (gsize i = refresh.first_download; i < refresh.first_download + refresh.n_downloads; i++)
+		{
+			g_unlink(downloads[i].dest.c_str());
+		}
+		for (gsize i = refresh.first_download; i < refresh.first_download + refresh.n_downloads; i++)
+		{
+			FileDownload download;
+
+			download.url = downloads[i].url;
+			download.dest = downloads[i].dest;
+			retries.push_back(download);
+		}
+	}
+	if (!retries.empty())
+	{
+		get_files(retries, cancellable);
+
+		for (const auto &retry : retries)
+		{
+			for (auto &download : downloads)
+			{
+				if (download.url == retry.url)
+				{
+					download = retry;
+				}
+			}
+		}
+	}
+
+	if (g_cancellable_is_cancelled(cancellable))
+	{
+		pk_backend_job_error_code(job, PK_ERROR_ENUM_TRANSACTION_CANCELLED, "The refresh was cancelled");
+		goto out;
 	}
-	g_slist_free_full(file_list, (GDestroyNotify)g_strfreev);
 
 	/* Refresh cache */
 	pk_backend_job_set_status(job, PK_STATUS_ENUM_REFRESH_CACHE);
 
-	for (GSList *l = repos; l; l = g_slist_next(l))
+	schema = get_staging_schema(job_data->db);
+	for (gsize i = 0; i < refreshes.size(); i++)
+	{
+		RepoRefresh &refresh = refreshes[i];
+
+		/* Staged ahead of the merges, a few repositories at a time */
+		for (; n_started < refreshes.size() && n_started < i + SLACK_MAX_STAGING_THREADS; n_started++)
+		{
+			RepoRefresh &next = refreshes[n_started];
+
+			if (next.unchanged)
+			{
+				g_debug("%s is up to date", next.repo->get_name());
+				continue;
+			}
+			if (g_cancellable_is_cancelled(cancellable))
+			{
+				continue;
+			}
+			next.staging = g_strconcat(tmp_dir_name, "/", next.repo->get_name(), ".db", NULL);
+			next.tmpl = tmp_dir_name;
+			next.schema = schema;
+			next.cancellable = cancellable;
+			next.thread = g_thread_new("slack-cache", generate_staging_cache_thread, &next);
+		}
+
+		if (refresh.thread == NULL)
+		{
+			continue;
+		}
+		g_thread_join(refresh.thread);
+
+		/* The staging database of a cancelled job is incomplete */
+		if (g_cancellable_is_cancelled(cancellable))
+		{
+			continue;
+		}
+
+		/* Merged in repository order, later repositories win as before */
+		if (merge_staging_cache(job_data->db, &refresh, cleanup, &db_err))
+		{
+			g_free(cleanup);
+			cleanup = NULL;
+			save_validators(job_data->db, &refresh, downloads);
+		}
+		else
+		{
+			g_warning("%s: %s", refresh.repo->get_name(), db_err);
+			sqlite3_free(db_err);
+		}
+	}
+
+	if (g_cancellable_is_cancelled(cancellable))
 	{
-		static_cast<Pkgtools *> (l->data)->generate_cache (job, tmp_dir_name);
+		pk_backend_job_error_code(job, PK_ERROR_ENUM_TRANSACTION_CANCELLED, "The refresh was cancelled");
 	}
 
 out:
+	for (auto &refresh : refreshes)
+	{
+		g_free(refresh.staging);
+	}
+	g_free(schema);
+	g_free(cleanup);
 	sqlite3_finalize(stmt);
 	if (file_info)
 	{
@@ -3,9 +3,24 @@
 
 #include <glib-object.h>
 #include <pk-backend.h>
+#include <sqlite3.h>
+#include <string>
+#include <vector>
 
 namespace slack {
 
+/**
+ * slack::CacheFile:
+ * A file needed for building the cache of a repository. The repository isn't
+ * refreshed if one of its required files can't be found on the mirror.
+ **/
+struct CacheFile
+{
+	std::string url;
+	std::string dest;
+	bool required;
+};
+
 class Pkgtools
 {
 public:
@@ -20,8 +35,8 @@ public:
 			gchar *dest_dir_name, gchar *pkg_name) noexcept;
 	void install (PkBackendJob *job, gchar *pkg_name) noexcept;
 
-	virtual GSList *collect_cache_info (const gchar *tmpl) noexcept = 0;
-	virtual void generate_cache (PkBackendJob *job,
+	virtual std::vector<CacheFile> collect_cache_info (const gchar *tmpl) noexcept = 0;
+	virtual void generate_cache (sqlite3 *db,
 			const gchar *tmpl) noexcept = 0;
 
 protected:
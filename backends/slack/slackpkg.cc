@@ -2,6 +2,10 @@
 #include <sqlite3.h>
 #include <stdlib.h>
 #include <string.h>
+#include <string>
+#include <utility>
+#include <vector>
+#include "manifest.h"
 #include "slackpkg.h"
 #include "utils.h"
 
@@ -9,29 +13,77 @@ namespace slack {
 
 GHashTable *Slackpkg::cat_map = NULL;
 
+/* Rows per INSERT into filelist, two parameters each */
+#define SLACK_FILELIST_BATCH 256
+
+static sqlite3_stmt *
+prepare_filelist_insert (sqlite3 *db, gsize rows)
+{
+	sqlite3_stmt *statement = NULL;
+	std::string query("INSERT OR IGNORE INTO filelist (full_name, filename) VALUES (?, ?)");
+
+	for (gsize i = 1; i < rows; i++)
+	{
+		query.append(", (?, ?)");
+	}
+	if (sqlite3_prepare_v2(db, query.c_str(), -1, &statement, NULL) != SQLITE_OK)
+	{
+		return NULL;
+	}
+	return statement;
+}
+
+static void
+insert_filelist_rows (sqlite3 *db, sqlite3_stmt *statement,
+		const std::vector<std::pair<std::string, std::string>> &rows)
+{
+	int param = 1;
+
+	if (rows.size() < SLACK_FILELIST_BATCH)
+	{ /* The rest after the last full batch */
+		statement = prepare_filelist_insert(db, rows.size());
+		if (statement == NULL)
+		{
+			return;
+		}
+	}
+	for (const auto &row : rows)
+	{
+		sqlite3_bind_text(statement, param++, row.first.c_str(), row.first.size(), SQLITE_STATIC);
+		sqlite3_bind_text(statement, param++, row.second.c_str(), row.second.size(), SQLITE_STATIC);
+	}
+	sqlite3_step(statement);
+
+	if (rows.size() < SLACK_FILELIST_BATCH)
+	{
+		sqlite3_finalize(statement);
+	}
+	else
+	{
+		sqlite3_clear_bindings(statement);
+		sqlite3_reset(statement);
+	}
+}
+
 /*
  * slack::Slackpkg::manifest:
- * @job:      a #PkBackendJob.
+ * @db:       database to write the file list to.
  * @tmpl:     temporary directory.
  * @filename: manifest filename
  *
  * Parse the manifest file and save the file list in the database.
  */
 void
-Slackpkg::manifest (PkBackendJob *job,
+Slackpkg::manifest (sqlite3 *db,
 		const gchar *tmpl, gchar *filename) noexcept
 {
 	FILE *manifest;
 	gint err, read_len;
-	guint pos;
-	gchar buf[max_buf_size], *path, *pkg_filename, *rest = NULL, *start;
-	gchar *full_name = NULL;
-	gchar **line, **lines;
+	gchar *path, *buf = NULL;
 	BZFILE *manifest_bz2;
-	GRegex *pkg_expr = NULL, *file_expr = NULL;
-	GMatchInfo *match_info;
+	ManifestReader reader;
+	std::vector<std::pair<std::string, std::string>> rows;
 	sqlite3_stmt *statement = NULL;
-	auto job_data = static_cast<JobData *> (pk_backend_job_get_user_data(job));
 
 	path = g_build_filename(tmpl,
 	                        this->get_name (),
@@ -44,108 +96,55 @@ Slackpkg::manifest (PkBackendJob *job,
 	{
 		return;
 	}
+	setvbuf(manifest, NULL, _IOFBF, max_buf_size);
 	if (!(manifest_bz2 = BZ2_bzReadOpen(&err, manifest, 0, 0, NULL, 0)))
 	{
 		goto out;
 	}
 
-	/* Prepare regular expressions */
-	pkg_expr = g_regex_new("^\\|\\|[[:blank:]]+Package:[[:blank:]]+.+\\/(.+)\\.(t[blxg]z$)?",
-	                       static_cast<GRegexCompileFlags> (G_REGEX_OPTIMIZE | G_REGEX_DUPNAMES),
-	                       static_cast<GRegexMatchFlags> (0),
-	                       NULL);
-	file_expr = g_regex_new("^[-bcdlps][-r][-w][-xsS][-r][-w][-xsS][-r][-w]"
-	                        "[-xtT][[:space:]][^[:space:]]+[[:space:]]+"
-	                        "[[:digit:]]+[[:space:]][[:digit:]-]+[[:space:]]"
-	                        "[[:digit:]:]+[[:space:]](?!install\\/|\\.)(.*)",
-	                        static_cast<GRegexCompileFlags> (G_REGEX_OPTIMIZE | G_REGEX_DUPNAMES),
-	                        static_cast<GRegexMatchFlags> (0),
-	                        NULL);
-	if (!(file_expr) || !(pkg_expr))
-	{
-		goto out;
-	}
-
 	/* Prepare SQL statements */
-	if (sqlite3_prepare_v2(job_data->db,
-						   "INSERT INTO filelist (full_name, filename) VALUES (@full_name, @filename)",
-						   -1,
-						   &statement,
-						   NULL) != SQLITE_OK)
+	if (!(statement = prepare_filelist_insert(db, SLACK_FILELIST_BATCH)))
 	{
+		BZ2_bzReadClose(&err, manifest_bz2);
 		goto out;
 	}
+	rows.reserve(SLACK_FILELIST_BATCH);
+	buf = static_cast<gchar *> (g_malloc(max_buf_size));
 
-	sqlite3_exec(job_data->db, "BEGIN TRANSACTION", NULL, NULL, NULL);
-	while ((read_len = BZ2_bzRead(&err, manifest_bz2, buf, max_buf_size - 1)))
+	sqlite3_exec(db, "BEGIN TRANSACTION", NULL, NULL, NULL);
+	do
 	{
+		read_len = BZ2_bzRead(&err, manifest_bz2, buf, max_buf_size);
 		if ((err != BZ_OK) && (err != BZ_STREAM_END))
 		{
 			break;
 		}
-		buf[read_len] = '\0';
-
-		/* Split the read text into lines */
-		lines = g_strsplit(buf, "\n", 0);
-		if (rest)
-		{ /* Add to the first line rest characters from the previous read operation */
-			start = lines[0];
-			lines[0] = g_strconcat(rest, lines[0], NULL);
-			g_free(start);
-			g_free(rest);
-		}
-		if (err != BZ_STREAM_END) /* The last line can be incomplete */
-		{
-			pos = g_strv_length(lines) - 1;
-			rest = lines[pos];
-			lines[pos] = NULL;
-		}
-		for (line = lines; *line; line++)
-		{
-			if (g_regex_match(pkg_expr, *line, static_cast<GRegexMatchFlags> (0), &match_info))
-			{
-				if (g_match_info_get_match_count(match_info) > 2)
-				{ /* If the extension matches */
-					g_free(full_name);
-					full_name = g_match_info_fetch(match_info, 1);
-				}
-				else
-				{
-					full_name = NULL;
-				}
-			}
-			g_match_info_free(match_info);
-
-			match_info = NULL;
-			if (full_name && g_regex_match(file_expr, *line, static_cast<GRegexMatchFlags> (0), &match_info))
+		reader.feed(buf, read_len, [&](const std::string &full_name,
+					const gchar *pkg_filename, gsize pkg_filename_len) {
+			rows.emplace_back(full_name, std::string(pkg_filename, pkg_filename_len));
+			if (rows.size() == SLACK_FILELIST_BATCH)
 			{
-				pkg_filename = g_match_info_fetch(match_info, 1);
-				sqlite3_bind_text(statement, 1, full_name, -1, SQLITE_TRANSIENT);
-				sqlite3_bind_text(statement, 2, pkg_filename, -1, SQLITE_TRANSIENT);
-				sqlite3_step(statement);
-				sqlite3_clear_bindings(statement);
-				sqlite3_reset(statement);
-				g_free(pkg_filename);
+				insert_filelist_rows(db, statement, rows);
+				rows.clear();
 			}
-			g_match_info_free(match_info);
-		}
-		g_strfreev(lines);
+		});
+	}
+	while (err == BZ_OK);
+	reader.finish([&](const std::string &full_name,
+				const gchar *pkg_filename, gsize pkg_filename_len) {
+		rows.emplace_back(full_name, std::string(pkg_filename, pkg_filename_len));
+	});
+	if (!rows.empty())
+	{
+		insert_filelist_rows(db, statement, rows);
 	}
 
-	sqlite3_exec(job_data->db, "END TRANSACTION", NULL, NULL, NULL);
-	g_free(full_name);
+	sqlite3_exec(db, "END TRANSACTION", NULL, NULL, NULL);
 	BZ2_bzReadClose(&err, manifest_bz2);
 
 out:
+	g_free(buf);
 	sqlite3_finalize(statement);
-	if (file_expr)
-	{
-		g_regex_unref(file_expr);
-	}
-	if (pkg_expr)
-	{
-		g_regex_unref(pkg_expr);
-	}
 	fclose(manifest);
 }
 
@@ -153,17 +152,16 @@ out:
  * slack::Slackpkg::collect_cache_info:
  * @tmpl: temporary directory for downloading the files.
  *
- * Download files needed to get the information like the list of packages
+ * Lists files needed to get the information like the list of packages
  * in available repositories, updates, package descriptions and so on.
  *
  * Returns: List of files needed for building the cache.
  **/
-GSList *
+std::vector<CacheFile>
 Slackpkg::collect_cache_info (const gchar *tmpl) noexcept
 {
-	CURL *curl = NULL;
-	gchar **source_dest;
-	GSList *file_list = NULL;
+	std::vector<CacheFile> files;
+	gchar *source, *dest;
 	GFile *tmp_dir, *repo_tmp_dir;
 
 	/* Create the temporary directory for the repository */
@@ -171,65 +169,44 @@ Slackpkg::collect_cache_info (const gchar *tmpl) noexcept
 	repo_tmp_dir = g_file_get_child(tmp_dir, this->get_name ());
 	g_file_make_directory(repo_tmp_dir, NULL, NULL);
 
-	/* Download PACKAGES.TXT. These files are most important, break if some of them couldn't be found */
+	/* The files are prepended, so PACKAGES.TXT of the last priority is read first */
 	for (gchar **cur_priority = this->priority; *cur_priority; cur_priority++)
 	{
-		source_dest = static_cast<gchar **> (g_malloc_n(3, sizeof(gchar *)));
-		source_dest[0] = g_strconcat(this->get_mirror (),
-									 *cur_priority,
-									 "/PACKAGES.TXT",
-									 NULL);
-		source_dest[1] = g_build_filename(tmpl,
-		                                  this->get_name (),
-		                                  "PACKAGES.TXT",
-		                                  NULL);
-		source_dest[2] = NULL;
-
-		if (get_file(&curl, source_dest[0], NULL) == CURLE_OK)
-		{
-			file_list = g_slist_prepend(file_list, source_dest);
-		}
-		else
-		{
-			g_strfreev(source_dest);
-			g_slist_free_full(file_list, (GDestroyNotify)g_strfreev);
-			goto out;
-		}
+		/* PACKAGES.TXT are most important, skip the repository if some of them couldn't be found */
+		source = g_strconcat(this->get_mirror (),
+		                     *cur_priority,
+		                     "/PACKAGES.TXT",
+		                     NULL);
+		dest = g_build_filename(tmpl,
+		                        this->get_name (),
+		                        "PACKAGES.TXT",
+		                        NULL);
+		files.insert(files.begin(), { source, dest, true });
+		g_free(source);
+		g_free(dest);
 
 		/* Download file lists if available */
-		source_dest = static_cast<gchar **> (g_malloc_n(3, sizeof(gchar *)));
-		source_dest[0] = g_strconcat(this->get_mirror (),
-		                             *cur_priority,
-		                             "/MANIFEST.bz2",
-		                             NULL);
-		source_dest[1] = g_strconcat(tmpl,
-		                             "/", this->get_name (),
-		                             "/", *cur_priority, "-MANIFEST.bz2",
-		                             NULL);
-		source_dest[2] = NULL;
-		if (get_file(&curl, source_dest[0], NULL) == CURLE_OK)
-		{
-			file_list = g_slist_prepend(file_list, source_dest);
-		}
-		else
-		{
-			g_strfreev(source_dest);
-		}
+		source = g_strconcat(this->get_mirror (),
+		                     *cur_priority,
+		                     "/MANIFEST.bz2",
+		                     NULL);
+		dest = g_strconcat(tmpl,
+		                   "/", this->get_name (),
+		                   "/", *cur_priority, "-MANIFEST.bz2",
+		                   NULL);
+		files.insert(files.begin(), { source, dest, false });
+		g_free(source);
+		g_free(dest);
 	}
-out:
 	g_object_unref(repo_tmp_dir);
 	g_object_unref(tmp_dir);
 
-	if (curl)
-	{
-		curl_easy_cleanup(curl);
-	}
-	return file_list;
+	return files;
 }
 
 /**
  * slack::Slackpkg::generate_cache:
- * @job: A #PkBackendJob.
+ * @db: database to write the cache to.
  * @tmpl: temporary directory for downloading the files.
  *
  * Download files needed to get the information like the list of packages
@@ -238,7 +215,7 @@ out:
  * Returns: List of files needed for building the cache.
  **/
 void
-Slackpkg::generate_cache (PkBackendJob *job, const gchar *tmpl) noexcept
+Slackpkg::generate_cache (sqlite3 *db, const gchar *tmpl) noexcept
 {
 	gchar **pkg_tokens = NULL;
 	gchar *query = NULL, *filename = NULL, *location = NULL, *summary = NULL, *line, *packages_txt;
@@ -249,7 +226,6 @@ Slackpkg::generate_cache (PkBackendJob *job, const gchar *tmpl) noexcept
 	GFileInputStream *fin = NULL;
 	GDataInputStream *data_in = NULL;
 	sqlite3_stmt *insert_statement = NULL, *update_statement = NULL, *insert_default_statement = NULL, *statement;
-	auto job_data = static_cast<JobData *> (pk_backend_job_get_user_data(job));
 
 	/* Check if the temporary directory for this repository exists, then the file metadata have to be generated */
 	packages_txt = g_build_filename(tmpl,
@@ -265,7 +241,7 @@ Slackpkg::generate_cache (PkBackendJob *job, const gchar *tmpl) noexcept
 		goto out;
 	}
 	/* Remove the old entries from this repository */
-	if (sqlite3_prepare_v2(job_data->db,
+	if (sqlite3_prepare_v2(db,
 	                       "DELETE FROM repos WHERE repo LIKE @repo",
 	                       -1,
 	                       &statement,
@@ -279,7 +255,7 @@ Slackpkg::generate_cache (PkBackendJob *job, const gchar *tmpl) noexcept
 		sqlite3_step(statement);
 		sqlite3_finalize(statement);
 	}
-	if (sqlite3_prepare_v2(job_data->db,
+	if (sqlite3_prepare_v2(db,
 	                       "INSERT INTO repos (repo_order, repo) VALUES (@repo_order, @repo)",
 	                       -1,
 	                       &statement,
@@ -297,7 +273,7 @@ Slackpkg::generate_cache (PkBackendJob *job, const gchar *tmpl) noexcept
 	sqlite3_finalize(statement);
 
 	/* Insert new records */
-	if ((sqlite3_prepare_v2(job_data->db,
+	if ((sqlite3_prepare_v2(db,
 	                        "INSERT OR REPLACE INTO pkglist (full_name, ver, arch, ext, location, "
 	                        "summary, desc, compressed, uncompressed, name, repo_order, cat) "
 	                        "VALUES (@full_name, @ver, @arch, @ext, @location, @summary, "
@@ -305,7 +281,7 @@ Slackpkg::generate_cache (PkBackendJob *job, const gchar *tmpl) noexcept
 	                        -1,
 	                        &insert_statement,
 	                        NULL) != SQLITE_OK)
-	 || (sqlite3_prepare_v2(job_data->db,
+	 || (sqlite3_prepare_v2(db,
 	                    "INSERT OR REPLACE INTO pkglist (full_name, ver, arch, ext, location, "
 	                    "summary, desc, compressed, uncompressed, name, repo_order) "
 	                    "VALUES (@full_name, @ver, @arch, @ext, @location, @summary, "
@@ -321,7 +297,7 @@ Slackpkg::generate_cache (PkBackendJob *job, const gchar *tmpl) noexcept
 	                        "desc = @desc, compressed = @compressed, uncompressed = @uncompressed "
 	                        "WHERE name LIKE @name AND repo_order = %u",
 	                        this->get_order ());
-	if (sqlite3_prepare_v2(job_data->db, query, -1, &update_statement, NULL) != SQLITE_OK)
+	if (sqlite3_prepare_v2(db, query, -1, &update_statement, NULL) != SQLITE_OK)
 	{
 		goto out;
 	}
@@ -329,7 +305,7 @@ Slackpkg::generate_cache (PkBackendJob *job, const gchar *tmpl) noexcept
 	data_in = g_data_input_stream_new(G_INPUT_STREAM(fin));
 	desc = g_string_new("");
 
-	sqlite3_exec(job_data->db, "BEGIN TRANSACTION", NULL, NULL, NULL);
+	sqlite3_exec(db, "BEGIN TRANSACTION", NULL, NULL, NULL);
 
 	while ((line = g_data_input_stream_read_line(data_in, NULL, NULL, NULL)))
 	{
@@ -424,7 +400,7 @@ Slackpkg::generate_cache (PkBackendJob *job, const gchar *tmpl) noexcept
 		}
 		g_free(line);
 	}
-	sqlite3_exec(job_data->db, "END TRANSACTION", NULL, NULL, NULL);
+	sqlite3_exec(db, "END TRANSACTION", NULL, NULL, NULL);
 
 	g_string_free(desc, TRUE);
 	g_object_unref(data_in);
@@ -433,7 +409,7 @@ Slackpkg::generate_cache (PkBackendJob *job, const gchar *tmpl) noexcept
 	for (gchar **p = this->priority; *p; p++)
 	{
 		filename = g_strconcat(*p, "-MANIFEST.bz2", NULL);
-		manifest (job, tmpl, filename);
+		manifest (db, tmpl, filename);
 		g_free(filename);
 	}
 out:
@@ -13,15 +13,15 @@ public:
 			guint8 order, const gchar *blacklist, gchar **priority) noexcept;
 	~Slackpkg () noexcept;
 
-	GSList *collect_cache_info (const gchar *tmpl) noexcept;
-	void generate_cache (PkBackendJob *job, const gchar *tmpl) noexcept;
+	std::vector<CacheFile> collect_cache_info (const gchar *tmpl) noexcept;
+	void generate_cache (sqlite3 *db, const gchar *tmpl) noexcept;
 
 private:
 	static GHashTable *cat_map;
-	static const std::size_t max_buf_size = 8192;
+	static const std::size_t max_buf_size = 1024 * 1024;
 	gchar **priority = NULL;
 
-	void manifest (PkBackendJob *job,
+	void manifest (sqlite3 *db,
 			const gchar *tmpl, gchar *filename) noexcept;
 };
 
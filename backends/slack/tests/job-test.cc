@@ -26,6 +26,74 @@ test_filter_package_none ()
 	g_assert_true (filter_package (filters, true));
 }
 
+static guint
+count_search_results (sqlite3 *db, const gchar *column, const gchar *search, bool use_index)
+{
+	sqlite3_stmt *stmt;
+	guint rows = 0;
+	gchar *query = sqlite3_mprintf (generate_query (pk_bitfield_value (PK_FILTER_ENUM_NONE), use_index).c_str (),
+			column, search);
+
+	g_assert_cmpint (sqlite3_prepare_v2 (db, query, -1, &stmt, NULL), ==, SQLITE_OK);
+	while (sqlite3_step (stmt) == SQLITE_ROW)
+	{
+		rows++;
+	}
+	sqlite3_finalize (stmt);
+	sqlite3_free (query);
+
+	return rows;
+}
+
+static void
+test_search_index ()
+{
+	sqlite3 *db;
+
+	g_assert_cmpint (sqlite3_open (":memory:", &db), ==, SQLITE_OK);
+	g_assert_cmpint (sqlite3_exec (db,
+				"CREATE TABLE repos (repo_order INTEGER PRIMARY KEY AUTOINCREMENT, repo VARCHAR NOT NULL);"
+				"CREATE TABLE pkglist (full_name VARCHAR NOT NULL UNIQUE, name VARCHAR NOT NULL, "
+				"ver VARCHAR NOT NULL, arch VARCHAR DEFAULT NULL, ext VARCHAR DEFAULT NULL, "
+				"summary VARCHAR DEFAULT '', desc TEXT DEFAULT '', repo_order INTEGER, "
+				"PRIMARY KEY (name, repo_order));"
+				"CREATE TABLE filelist (full_name VARCHAR NOT NULL, filename VARCHAR NOT NULL, "
+				"PRIMARY KEY (full_name, filename));"
+				"INSERT INTO repos VALUES (1, 'slackware'), (2, 'extra');"
+				"INSERT INTO pkglist (full_name, name, ver, arch, ext, summary, desc, repo_order) VALUES "
+				"('vim-9.0-x86_64-1', 'vim', '9.0', 'x86_64', 'txz', 'vim', 'text editor', 1), "
+				"('vim-8.2-x86_64-1', 'vim', '8.2', 'x86_64', 'txz', 'vim', 'text editor', 2), "
+				"('gvim-9.0-x86_64-1', 'gvim', '9.0', 'x86_64', 'txz', 'gvim', 'graphical editor', 2), "
+				"('bash-5.2-x86_64-1', 'bash', '5.2', 'x86_64', 'txz', 'bash', 'shell', 1)",
+				NULL, NULL, NULL), ==, SQLITE_OK);
+
+	g_assert_false (has_search_index (db));
+	g_assert_cmpuint (count_search_results (db, "name", "vim", false), ==, 2);
+
+	if (!create_search_index (db))
+	{
+		g_test_skip ("SQLite has no FTS5 trigram tokenizer");
+		sqlite3_close (db);
+		return;
+	}
+	g_assert_true (has_search_index (db));
+
+	/* The index matches substrings case-insensitively, like LIKE */
+	g_assert_cmpuint (count_search_results (db, "name", "VIM", true), ==, 2);
+	g_assert_cmpuint (count_search_results (db, "desc", "editor", true), ==, 2);
+	g_assert_cmpuint (count_search_results (db, "name", "sh", true), ==, 1);
+
+	/* New rows are found after the rebuild */
+	g_assert_cmpint (sqlite3_exec (db,
+				"INSERT INTO pkglist (full_name, name, ver, arch, ext, summary, desc, repo_order) "
+				"VALUES ('neovim-0.9-x86_64-1', 'neovim', '0.9', 'x86_64', 'txz', 'neovim', 'editor', 2)",
+				NULL, NULL, NULL), ==, SQLITE_OK);
+	g_assert_true (rebuild_search_index (db));
+	g_assert_cmpuint (count_search_results (db, "name", "vim", true), ==, 3);
+
+	sqlite3_close (db);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -34,6 +102,7 @@ main (int argc, char *argv[])
 	g_test_add_func ("/slack/filter_package_installed", test_filter_package_installed);
 	g_test_add_func ("/slack/filter_package_not_installed", test_filter_package_not_installed);
 	g_test_add_func ("/slack/filter_package_none", test_filter_package_none);
+	g_test_add_func ("/slack/search_index", test_search_index);
 
 	return g_test_run ();
 }
@@ -0,0 +1,164 @@
+#include <string.h>
+#include <string>
+#include <utility>
+#include <vector>
+#include "manifest.h"
+
+using namespace slack;
+
+typedef std::vector<std::pair<std::string, std::string>> FileList;
+
+static gchar *
+read_manifest (gsize *length)
+{
+	g_autofree gchar *path = g_build_filename (TESTDATADIR, "MANIFEST", NULL);
+	gchar *contents = NULL;
+
+	g_assert_true (g_file_get_contents (path, &contents, length, NULL));
+	return contents;
+}
+
+static FileList
+replay_manifest (const gchar *contents, gsize length, gsize chunk_size)
+{
+	ManifestReader reader;
+	FileList files;
+	auto callback = [&files] (const std::string &full_name,
+			const gchar *filename, gsize filename_len) {
+		files.emplace_back (full_name, std::string (filename, filename_len));
+	};
+
+	for (gsize offset = 0; offset < length; offset += chunk_size)
+	{
+		reader.feed (contents + offset, MIN (chunk_size, length - offset), callback);
+	}
+	reader.finish (callback);
+
+	return files;
+}
+
+static void
+slack_test_manifest_parse_package ()
+{
+	std::string full_name = "previous";
+	const gchar *line = "||   Package:  ./a/aaa_base-15.0-x86_64-4.txz";
+
+	g_assert_true (ManifestReader::parse_package (line, strlen (line), full_name));
+	g_assert_cmpstr (full_name.c_str (), ==, "aaa_base-15.0-x86_64-4");
+
+	line = "||   Package:  ./a/kernel-source.tar.bz2";
+	g_assert_true (ManifestReader::parse_package (line, strlen (line), full_name));
+	g_assert_true (full_name.empty ());
+
+	line = "||";
+	full_name = "previous";
+	g_assert_false (ManifestReader::parse_package (line, strlen (line), full_name));
+	g_assert_cmpstr (full_name.c_str (), ==, "previous");
+}
+
+static void
+slack_test_manifest_parse_file ()
+{
+	const gchar *filename;
+	gsize len;
+	const gchar *line = "-rw-r--r-- root/root       186 2021-06-14 20:52 etc/HOSTNAME.new";
+
+	g_assert_true (ManifestReader::parse_file (line, strlen (line), &filename, &len));
+	g_assert_cmpstr (std::string (filename, len).c_str (), ==, "etc/HOSTNAME.new");
+
+	line = "drwxr-xr-x root/root         0 2021-06-14 20:52 ./";
+	g_assert_false (ManifestReader::parse_file (line, strlen (line), &filename, &len));
+	line = "-rw-r--r-- root/root      1139 2021-06-14 20:52 install/doinst.sh";
+	g_assert_false (ManifestReader::parse_file (line, strlen (line), &filename, &len));
+	line = "crw-r--r-- root/root      1,3 2022-01-06 01:16 dev/null";
+	g_assert_false (ManifestReader::parse_file (line, strlen (line), &filename, &len));
+	line = "++========================================";
+	g_assert_false (ManifestReader::parse_file (line, strlen (line), &filename, &len));
+}
+
+static void
+slack_test_manifest_replay ()
+{
+	gsize length;
+	g_autofree gchar *contents = read_manifest (&length);
+	FileList expected = replay_manifest (contents, length, length);
+
+	g_assert_cmpuint (expected.size (), ==, 19);
+	g_assert_cmpstr (expected[0].first.c_str (), ==, "aaa_base-15.0-x86_64-4");
+	g_assert_cmpstr (expected[0].second.c_str (), ==, "etc/");
+	g_assert_cmpstr (expected[7].second.c_str (), ==, "usr/tmp -> ../var/tmp");
+	g_assert_cmpstr (expected[14].first.c_str (), ==, "bash-5.1.016-x86_64-1");
+	g_assert_cmpstr (expected[14].second.c_str (), ==, "usr/bin/suid helper with spaces");
+	g_assert_cmpstr (expected[18].first.c_str (), ==, "xterm-372-x86_64-1");
+	g_assert_cmpstr (expected[18].second.c_str (), ==, "usr/share/xterm/last-line");
+
+	for (gsize chunk_size : { 1, 7, 100 })
+	{
+		FileList files = replay_manifest (contents, length, chunk_size);
+		g_assert_true (files == expected);
+	}
+}
+
+/* Run with -m perf, compares with the regular expressions used before */
+static void
+slack_test_manifest_perf ()
+{
+	const guint rounds = 20000;
+	gsize length;
+	g_autofree gchar *contents = read_manifest (&length);
+	g_auto(GStrv) lines = g_strsplit (contents, "\n", 0);
+	GMatchInfo *match_info;
+	guint matches = 0;
+	gdouble elapsed;
+
+	GTimer *timer = g_timer_new ();
+	for (guint i = 0; i < rounds; i++)
+	{
+		matches += replay_manifest (contents, length, 8192).size ();
+	}
+	elapsed = g_timer_elapsed (timer, NULL);
+	g_test_minimized_result (elapsed, "ManifestReader: %u files in %.3f s", matches, elapsed);
+
+	GRegex *pkg_expr = g_regex_new ("^\\|\\|[[:blank:]]+Package:[[:blank:]]+.+\\/(.+)\\.(t[blxg]z$)?",
+			G_REGEX_OPTIMIZE, static_cast<GRegexMatchFlags> (0), NULL);
+	GRegex *file_expr = g_regex_new ("^[-bcdlps][-r][-w][-xsS][-r][-w][-xsS][-r][-w]"
+			"[-xtT][[:space:]][^[:space:]]+[[:space:]]+"
+			"[[:digit:]]+[[:space:]][[:digit:]-]+[[:space:]]"
+			"[[:digit:]:]+[[:space:]](?!install\\/|\\.)(.*)",
+			G_REGEX_OPTIMIZE, static_cast<GRegexMatchFlags> (0), NULL);
+	matches = 0;
+	g_timer_start (timer);
+	for (guint i = 0; i < rounds; i++)
+	{
+		for (gchar **line = lines; *line; line++)
+		{
+			g_regex_match (pkg_expr, *line, static_cast<GRegexMatchFlags> (0), NULL);
+			if (g_regex_match (file_expr, *line, static_cast<GRegexMatchFlags> (0), &match_info))
+			{
+				matches++;
+			}
+			g_match_info_free (match_info);
+		}
+	}
+	elapsed = g_timer_elapsed (timer, NULL);
+	g_test_message ("GRegex: %u lines matched in %.3f s", matches, elapsed);
+
+	g_regex_unref (file_expr);
+	g_regex_unref (pkg_expr);
+	g_timer_destroy (timer);
+}
+
+int main(int argc, char *argv[])
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/slack/manifest/parse_package", slack_test_manifest_parse_package);
+	g_test_add_func("/slack/manifest/parse_file", slack_test_manifest_parse_file);
+	g_test_add_func("/slack/manifest/replay", slack_test_manifest_replay);
+	if (g_test_perf ())
+	{
+		g_test_add_func("/slack/manifest/perf", slack_test_manifest_perf);
+	}
+
+	return g_test_run();
+}
@@ -0,0 +1,52 @@
+#include <glib/gstdio.h>
+#include <utime.h>
+#include "utils.h"
+
+using namespace slack;
+
+static void
+slack_test_installed_packages ()
+{
+	g_autofree gchar *dir = g_dir_make_tmp ("pk-slack-test.XXXXXX", NULL);
+	g_autofree gchar *pkg1 = g_build_filename (dir, "bash-5.2.015-x86_64-1", NULL);
+	g_autofree gchar *pkg2 = g_build_filename (dir, "xf86-video-vesa-2.6.0-x86_64-1", NULL);
+	struct utimbuf old_mtime = { 1000000000, 1000000000 };
+
+	g_assert_nonnull (dir);
+	g_assert_true (g_file_set_contents (pkg1, "", 0, NULL));
+
+	auto installed = InstalledPackages::get (dir);
+	g_assert_cmpuint (installed->get_packages ().size (), ==, 1);
+	g_assert_cmpstr (installed->get_full_name ("bash"), ==, "bash-5.2.015-x86_64-1");
+	g_assert_null (installed->get_full_name ("xf86-video-vesa"));
+
+	g_assert_cmpint (installed->is_installed ("bash-5.2.015-x86_64-1"), ==, PK_INFO_ENUM_INSTALLED);
+	g_assert_cmpint (installed->is_installed ("bash-5.2.037-x86_64-1"), ==, PK_INFO_ENUM_UPDATING);
+	g_assert_cmpint (installed->is_installed ("bash-completion-2.11-noarch-4"), ==, PK_INFO_ENUM_INSTALLING);
+	g_assert_cmpint (installed->is_installed ("bash"), ==, PK_INFO_ENUM_UNKNOWN);
+
+	/* The snapshot is shared while the directory doesn't change */
+	g_assert_true (InstalledPackages::get (dir) == installed);
+
+	/* Don't depend on the timestamp granularity of the file system */
+	g_assert_true (g_file_set_contents (pkg2, "", 0, NULL));
+	g_assert_cmpint (g_utime (dir, &old_mtime), ==, 0);
+
+	auto updated = InstalledPackages::get (dir);
+	g_assert_true (updated != installed);
+	g_assert_cmpstr (updated->get_full_name ("xf86-video-vesa"), ==, "xf86-video-vesa-2.6.0-x86_64-1");
+
+	g_unlink (pkg1);
+	g_unlink (pkg2);
+	g_rmdir (dir);
+}
+
+int
+main (int argc, char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/slack/utils/installed_packages", slack_test_installed_packages);
+
+	return g_test_run ();
+}
@@ -1,3 +1,6 @@
+#include <errno.h>
+#include <glib/gstdio.h>
+#include <mutex>
 #include <sqlite3.h>
 #include <string.h>
 #include "utils.h"
@@ -66,6 +69,261 @@ get_file (CURL **curl, gchar *source_url, gchar *dest)
 	return ret;
 }
 
+/* Concurrent transfers in get_files(), per host and in total */
+#define SLACK_MAX_HOST_CONNECTIONS 4
+#define SLACK_MAX_CONNECTIONS 8
+
+/* State of a transfer started by get_files() */
+struct FileTransfer
+{
+	FileDownload *download;
+	CURL *curl;
+	gchar *part;
+	FILE *fout;
+	struct curl_slist *headers;
+};
+
+static size_t
+file_transfer_write_cb (char *ptr, size_t size, size_t nmemb, void *userdata)
+{
+	auto transfer = static_cast<FileTransfer *> (userdata);
+
+	/* Opened on the first data, so that a 304 leaves nothing behind */
+	if (transfer->fout == NULL
+	 && (transfer->fout = fopen(transfer->part, "wb")) == NULL)
+	{
+		return 0;
+	}
+	return fwrite(ptr, size, nmemb, transfer->fout);
+}
+
+static size_t
+file_transfer_header_cb (char *buffer, size_t size, size_t nitems, void *userdata)
+{
+	auto download = static_cast<FileTransfer *> (userdata)->download;
+	size_t len = size * nitems;
+	std::string header(buffer, len);
+
+	while (!header.empty() && (header.back() == '\r' || header.back() == '\n'))
+	{
+		header.pop_back();
+	}
+
+	/* Every response of a redirect chain starts with a status line */
+	if (g_str_has_prefix(header.c_str(), "HTTP/"))
+	{
+		download->etag.clear();
+		download->last_modified.clear();
+	}
+	else if (g_ascii_strncasecmp(header.c_str(), "ETag:", 5) == 0)
+	{
+		download->etag = g_strstrip(&header[5]);
+	}
+	else if (g_ascii_strncasecmp(header.c_str(), "Last-Modified:", 14) == 0)
+	{
+		download->last_modified = g_strstrip(&header[14]);
+	}
+	return len;
+}
+
+/* Appends the downloaded part to the destination. Several downloads can
+ * share a destination, e.g. PACKAGES.TXT of every priority */
+static gboolean
+append_file (const gchar *src, const gchar *dest)
+{
+	gchar buf[65536];
+	size_t len;
+	FILE *fin, *fout;
+	gboolean ret = TRUE;
+
+	if ((fin = fopen(src, "rb")) == NULL)
+	{
+		return FALSE;
+	}
+	if ((fout = fopen(dest, "ab")) == NULL)
+	{
+		fclose(fin);
+		return FALSE;
+	}
+	while ((len = fread(buf, 1, sizeof(buf), fin)) > 0)
+	{
+		if (fwrite(buf, 1, len, fout) != len)
+		{
+			ret = FALSE;
+			break;
+		}
+	}
+	fclose(fin);
+	fclose(fout);
+	g_unlink(src);
+
+	return ret;
+}
+
+bool
+FileDownload::is_downloaded () const noexcept
+{
+	return this->result == CURLE_OK && this->response_code != 304;
+}
+
+bool
+FileDownload::is_unchanged () const noexcept
+{
+	return this->result == CURLE_OK && this->response_code == 304;
+}
+
+/**
+ * slack::get_files:
+ * @downloads: Files to download.
+ * @cancellable: A #GCancellable or %NULL.
+ *
+ * Downloads the files concurrently over a curl multi handle, reusing the
+ * connections to the same mirror. Files whose validators still match are
+ * not transferred, they are reported as unchanged instead. Probes succeed
+ * only if the file is there.
+ *
+ * Downloads with the same destination are appended to it in order.
+ * Transfers still running when @cancellable is cancelled fail with
+ * CURLE_ABORTED_BY_CALLBACK.
+ **/
+void
+get_files (std::vector<FileDownload> &downloads, GCancellable *cancellable) noexcept
+{
+	std::vector<FileTransfer> transfers(downloads.size());
+	CURLM *multi;
+	CURLMsg *msg;
+	gint running, msgs_left;
+
+	if (!(multi = curl_multi_init()))
+	{
+		for (auto &download : downloads)
+		{
+			download.result = CURLE_FAILED_INIT;
+		}
+		return;
+	}
+	curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, (glong) SLACK_MAX_HOST_CONNECTIONS);
+	curl_multi_setopt(multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, (glong) SLACK_MAX_CONNECTIONS);
+	curl_multi_setopt(multi, CURLMOPT_PIPELINING, (glong) CURLPIPE_MULTIPLEX);
+
+	for (gsize i = 0; i < downloads.size(); i++)
+	{
+		FileTransfer &transfer = transfers[i];
+		CURL *curl = curl_easy_init();
+
+		transfer.download = &downloads[i];
+		transfer.part = g_strdup_printf("%s.part%" G_GSIZE_FORMAT, downloads[i].dest.c_str(), i);
+
+		if (curl == NULL)
+		{
+			downloads[i].result = CURLE_FAILED_INIT;
+			continue;
+		}
+
+		if (!downloads[i].etag.empty())
+		{
+			std::string header = "If-None-Match: " + downloads[i].etag;
+			transfer.headers = curl_slist_append(transfer.headers, header.c_str());
+		}
+		if (!downloads[i].last_modified.empty())
+		{
+			std::string header = "If-Modified-Since: " + downloads[i].last_modified;
+			transfer.headers = curl_slist_append(transfer.headers, header.c_str());
+		}
+
+		curl_easy_setopt(curl, CURLOPT_URL, downloads[i].url.c_str());
+		curl_easy_setopt(curl, CURLOPT_NOBODY, downloads[i].probe ? 1L : 0L);
+		curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+		curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+		curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+		curl_easy_setopt(curl, CURLOPT_HTTPHEADER, transfer.headers);
+		curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, file_transfer_write_cb);
+		curl_easy_setopt(curl, CURLOPT_WRITEDATA, &transfer);
+		curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, file_transfer_header_cb);
+		curl_easy_setopt(curl, CURLOPT_HEADERDATA, &transfer);
+		curl_easy_setopt(curl, CURLOPT_PRIVATE, &transfer);
+
+		downloads[i].etag.clear();
+		downloads[i].last_modified.clear();
+		downloads[i].result = CURLE_COULDNT_CONNECT; /* Until it's done */
+
+		transfer.curl = curl;
+		curl_multi_add_handle(multi, curl);
+	}
+
+	do
+	{
+		if (g_cancellable_is_cancelled(cancellable)
+		 || curl_multi_perform(multi, &running) != CURLM_OK)
+		{
+			break;
+		}
+
+		while ((msg = curl_multi_info_read(multi, &msgs_left)))
+		{
+			FileTransfer *transfer;
+
+			if (msg->msg != CURLMSG_DONE)
+			{
+				continue;
+			}
+			curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (gchar **) &transfer);
+			curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE, &transfer->download->response_code);
+			transfer->download->result = msg->data.result;
+			if (transfer->download->probe
+			 && transfer->download->result == CURLE_OK
+			 && transfer->download->response_code != 200)
+			{
+				transfer->download->result = CURLE_REMOTE_FILE_NOT_FOUND;
+			}
+
+			if (transfer->fout != NULL)
+			{
+				fclose(transfer->fout);
+				transfer->fout = NULL;
+			}
+			curl_multi_remove_handle(multi, transfer->curl);
+			curl_easy_cleanup(transfer->curl);
+			transfer->curl = NULL;
+		}
+
+		if (running && curl_multi_wait(multi, NULL, 0, 1000, NULL) != CURLM_OK)
+		{
+			break;
+		}
+	}
+	while (running);
+
+	for (gsize i = 0; i < transfers.size(); i++)
+	{
+		FileTransfer &transfer = transfers[i];
+
+		if (transfer.curl != NULL)
+		{
+			curl_multi_remove_handle(multi, transfer.curl);
+			curl_easy_cleanup(transfer.curl);
+			if (g_cancellable_is_cancelled(cancellable))
+			{
+				downloads[i].result = CURLE_ABORTED_BY_CALLBACK;
+			}
+		}
+		if (transfer.fout != NULL)
+		{
+			fclose(transfer.fout);
+		}
+		if (downloads[i].is_downloaded()
+		 && g_file_test(transfer.part, G_FILE_TEST_EXISTS)
+		 && !append_file(transfer.part, downloads[i].dest.c_str()))
+		{
+			downloads[i].result = CURLE_WRITE_ERROR;
+		}
+		g_unlink(transfer.part);
+		curl_slist_free_all(transfer.headers);
+		g_free(transfer.part);
+	}
+	curl_multi_cleanup(multi);
+}
+
 /**
  * slack::split_package_name:
  * Got the name of a package, without version-arch-release data.
@@ -118,103 +376,147 @@ split_package_name (const gchar *pkg_filename)
 	return pkg_tokens;
 }
 
+/* Returns the length of the name part of full_name (without version, arch
+ * and build), or -1 if full_name is malformed. */
+static gssize
+package_name_length (const gchar *pkg_fullname)
+{
+	const gchar *it;
+	guint8 dashes = 0;
+
+	for (it = pkg_fullname + strlen(pkg_fullname); it != pkg_fullname; --it)
+	{
+		if (*it == '-')
+		{
+			if (dashes == 2)
+			{
+				return it - pkg_fullname;
+			}
+			++dashes;
+		}
+	}
+	return -1;
+}
+
 /**
- * slack::is_installed:
+ * slack::InstalledPackages::get:
+ * @dir: package metadata directory.
+ *
+ * Returns the snapshot of the installed packages, reading @dir again only
+ * if its modification time changed since the last call.
+ **/
+std::shared_ptr<const InstalledPackages>
+InstalledPackages::get (const gchar *dir) noexcept
+{
+	static std::mutex lock;
+	static std::shared_ptr<const InstalledPackages> cached;
+	static std::string cached_dir;
+	static struct timespec cached_mtime;
+	GStatBuf st;
+
+	std::lock_guard<std::mutex> guard(lock);
+
+	if (g_stat(dir, &st) != 0)
+	{
+		g_debug("%s: %s", dir, g_strerror(errno));
+		cached.reset();
+		return std::make_shared<const InstalledPackages>();
+	}
+
+	/* Installing and removing packages adds and removes entries,
+	 * which changes the directory mtime */
+	if (cached && cached_dir == dir
+	 && cached_mtime.tv_sec == st.st_mtim.tv_sec
+	 && cached_mtime.tv_nsec == st.st_mtim.tv_nsec)
+	{
+		return cached;
+	}
+
+	auto installed = std::make_shared<InstalledPackages>();
+	GDir *pkg_metadata_dir = g_dir_open(dir, 0, NULL);
+	if (pkg_metadata_dir != NULL)
+	{
+		const gchar *pkg_fullname;
+
+		while ((pkg_fullname = g_dir_read_name(pkg_metadata_dir)))
+		{
+			gssize len = package_name_length(pkg_fullname);
+
+			if (len > 0)
+			{
+				installed->packages.emplace(std::string(pkg_fullname, len), pkg_fullname);
+			}
+		}
+		g_dir_close(pkg_metadata_dir);
+	}
+	g_debug("Read %u installed packages from %s", (guint) installed->packages.size(), dir);
+
+	cached = installed;
+	cached_dir = dir;
+	cached_mtime = st.st_mtim;
+
+	return cached;
+}
+
+/**
+ * slack::InstalledPackages::is_installed:
  * Checks if a package is already installed in the system.
  *
  * Params:
  * 	pkg_fullname = Package name should be looked for.
  *
- * Returns: PK_INFO_ENUM_INSTALLING if pkg_fullname is already installed,
+ * Returns: PK_INFO_ENUM_INSTALLED if pkg_fullname is already installed,
  *          PK_INFO_ENUM_UPDATING if an elder version of pkg_fullname is
- *          installed, PK_INFO_ENUM_UNKNOWN if pkg_fullname is malformed.
+ *          installed, PK_INFO_ENUM_INSTALLING if it isn't installed,
+ *          PK_INFO_ENUM_UNKNOWN if pkg_fullname is malformed.
  **/
 PkInfoEnum
-is_installed (const gchar *pkg_fullname)
+InstalledPackages::is_installed (const gchar *pkg_fullname) const noexcept
 {
-	GFileEnumerator *pkg_metadata_enumerator;
-	GFileInfo *pkg_metadata_file_info;
-	GFile *pkg_metadata_dir;
-	PkInfoEnum ret = PK_INFO_ENUM_INSTALLING;
-    const gchar *it;
-    guint8 dashes = 0;
-	ptrdiff_t pkg_name;
-
 	g_return_val_if_fail(pkg_fullname != NULL, PK_INFO_ENUM_UNKNOWN);
 
-    // We want to find the package name without version for the package we're
-    // looking for.
-    g_debug("Looking if %s is installed", pkg_fullname);
-
-    for (it = pkg_fullname + strlen(pkg_fullname); it != pkg_fullname; --it)
-    {
-        if (*it == '-')
-        {
-            if (dashes == 2)
-            {
-                break;
-            }
-            ++dashes;
-        }
-    }
-	if (dashes < 2)
+	gssize len = package_name_length(pkg_fullname);
+	if (len < 0)
 	{
 		return PK_INFO_ENUM_UNKNOWN;
 	}
-    pkg_name = it - pkg_fullname;
 
-	// Read the package metadata directory and comprare all installed packages
-    // with ones in the cache.
-	pkg_metadata_dir = g_file_new_for_path("/var/log/packages");
-	if (!(pkg_metadata_enumerator = g_file_enumerate_children(pkg_metadata_dir,
-	                                                          "standard::name",
-	                                                          G_FILE_QUERY_INFO_NONE,
-	                                                          NULL,
-	                                                          NULL)))
+	auto it = packages.find(std::string(pkg_fullname, len));
+	if (it == packages.end())
 	{
-		g_object_unref(pkg_metadata_dir);
-		return PK_INFO_ENUM_UNKNOWN;
+		return PK_INFO_ENUM_INSTALLING;
 	}
+	return it->second == pkg_fullname ? PK_INFO_ENUM_INSTALLED : PK_INFO_ENUM_UPDATING;
+}
 
-	while ((pkg_metadata_file_info = g_file_enumerator_next_file(pkg_metadata_enumerator, NULL, NULL)))
-	{
-		const gchar *dir = g_file_info_get_name(pkg_metadata_file_info);
-        dashes = 0;
-
-        if (strcmp(dir, pkg_fullname) == 0)
-        {
-            ret = PK_INFO_ENUM_INSTALLED;
-        }
-		else
-		{
-			for (it = dir + strlen(dir); it != dir; --it)
-			{
-				if (*it == '-')
-				{
-					if (dashes == 2)
-					{
-						break;
-					}
-					++dashes;
-				}
-			}
-			if (pkg_name == (it - dir) && strncmp(pkg_fullname, dir, pkg_name) == 0)
-			{
-				ret = PK_INFO_ENUM_UPDATING;
-			}
+/**
+ * slack::InstalledPackages::get_full_name:
+ *
+ * Returns: The full name of the installed package named pkg_name, or NULL.
+ **/
+const gchar *
+InstalledPackages::get_full_name (const gchar *pkg_name) const noexcept
+{
+	auto it = packages.find(pkg_name);
 
-		}
-		g_object_unref(pkg_metadata_file_info);
+	return it == packages.end() ? NULL : it->second.c_str();
+}
 
-		if (ret != PK_INFO_ENUM_INSTALLING) /* If installed */
-		{
-			break;
-		}
-	}
-	g_object_unref(pkg_metadata_enumerator);
-	g_object_unref(pkg_metadata_dir);
+const InstalledPackages::Map &
+InstalledPackages::get_packages () const noexcept
+{
+	return packages;
+}
 
-	return ret;
+/**
+ * slack::is_installed:
+ * Checks if a package is already installed in the system. Prefer
+ * InstalledPackages::get() when checking more than one package.
+ **/
+PkInfoEnum
+is_installed (const gchar *pkg_fullname)
+{
+	return InstalledPackages::get()->is_installed(pkg_fullname);
 }
 
 /**
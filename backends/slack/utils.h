@@ -2,6 +2,10 @@
 #define __SLACK_UTILS_H
 
 #include <curl/curl.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include <pk-backend.h>
 #include <pk-backend-job.h>
 
@@ -17,8 +21,54 @@ struct JobData
 
 CURLcode get_file (CURL **curl, gchar *source_url, gchar *dest);
 
+/**
+ * slack::FileDownload:
+ * One file for get_files(). etag and last_modified are sent as validators
+ * if set and replaced with the ones the server returned. A probe only asks
+ * for the headers to check that the file exists, nothing is written.
+ **/
+struct FileDownload
+{
+	std::string url;
+	std::string dest;
+	std::string etag;
+	std::string last_modified;
+	bool probe = false;
+
+	CURLcode result = CURLE_OK;
+	glong response_code = 0;
+
+	bool is_downloaded () const noexcept;
+	bool is_unchanged () const noexcept;
+};
+
+void get_files (std::vector<FileDownload> &downloads,
+		GCancellable *cancellable = NULL) noexcept;
+
 gchar **split_package_name (const gchar *pkg_filename);
 
+/**
+ * slack::InstalledPackages:
+ * Snapshot of /var/log/packages, mapping package names to the full names of
+ * the installed packages. The snapshot is shared until the directory changes,
+ * so a job should get it once and use it for all of its rows.
+ **/
+class InstalledPackages
+{
+public:
+	typedef std::unordered_map<std::string, std::string> Map;
+
+	static std::shared_ptr<const InstalledPackages> get (
+			const gchar *dir = "/var/log/packages") noexcept;
+
+	PkInfoEnum is_installed (const gchar *pkg_fullname) const noexcept;
+	const gchar *get_full_name (const gchar *pkg_name) const noexcept;
+	const Map &get_packages () const noexcept;
+
+private:
+	Map packages;
+};
+
 PkInfoEnum is_installed (const gchar *pkg_fullname);
 
 extern "C" {
@@ -0,0 +1,363 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 PackageKit contributors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * A backend that emits synthetic results as fast as it can, so the cost of
+ * the transaction pipeline between the backend and the client can be
+ * measured, e.g. with pk-bench.
+ *
+ * The defaults are read from the [Bench] group of PackageKit.conf:
+ *
+ *   Packages=1000		packages emitted by GetPackages and searches
+ *   SummarySize=64		bytes in each summary, descriptions are 4x
+ *   Files=20			files emitted per package by GetFiles
+ *   Plural=true		emit the Packages and UpdateDetails signals
+ *				rather than one signal per item
+ *   Batch=100			items per plural signal
+ *   Delay=0			us to sleep between two signals or batches
+ *
+ * Searches can override these per transaction with search terms such as
+ * "packages=10000" or "plural=false".
+ */
+
+#include <gmodule.h>
+#include <glib.h>
+#include <string.h>
+#include <pk-backend.h>
+
+typedef struct {
+	guint		 packages;
+	guint		 summary_size;
+	guint		 files;
+	gboolean	 plural;
+	guint		 batch;
+	guint		 delay;
+} PkBackendBenchConfig;
+
+static PkBackendBenchConfig defaults = { 1000, 64, 20, TRUE, 100, 0 };
+
+const gchar *
+pk_backend_get_description (PkBackend *backend)
+{
+	return "Test-Bench";
+}
+
+const gchar *
+pk_backend_get_author (PkBackend *backend)
+{
+	return "PackageKit contributors";
+}
+
+static void
+pk_backend_bench_config_set (PkBackendBenchConfig *config,
+			     const gchar *key,
+			     const gchar *value)
+{
+	guint64 tmp;
+
+	if (g_ascii_strcasecmp (key, "plural") == 0) {
+		config->plural = g_ascii_strcasecmp (value, "true") == 0;
+		return;
+	}
+	if (!g_ascii_string_to_unsigned (value, 10, 0, G_MAXUINT, &tmp, NULL)) {
+		g_warning ("invalid value for %s: %s", key, value);
+		return;
+	}
+	if (g_ascii_strcasecmp (key, "packages") == 0)
+		config->packages = tmp;
+	else if (g_ascii_strcasecmp (key, "summary-size") == 0 ||
+		 g_ascii_strcasecmp (key, "summarysize") == 0)
+		config->summary_size = tmp;
+	else if (g_ascii_strcasecmp (key, "files") == 0)
+		config->files = tmp;
+	else if (g_ascii_strcasecmp (key, "batch") == 0)
+		config->batch = MAX (tmp, 1);
+	else if (g_ascii_strcasecmp (key, "delay") == 0)
+		config->delay = tmp;
+	else
+		g_warning ("unknown setting %s", key);
+}
+
+void
+pk_backend_initialize (GKeyFile *conf, PkBackend *backend)
+{
+	g_auto(GStrv) keys = NULL;
+
+	keys = g_key_file_get_keys (conf, "Bench", NULL, NULL);
+	for (guint i = 0; keys != NULL && keys[i] != NULL; i++) {
+		g_autofree gchar *value = g_key_file_get_value (conf, "Bench", keys[i], NULL);
+		pk_backend_bench_config_set (&defaults, keys[i], value);
+	}
+	g_debug ("backend: emitting %u packages, %s, in batches of %u",
+		 defaults.packages, defaults.plural ? "plural" : "single", defaults.batch);
+}
+
+void
+pk_backend_destroy (PkBackend *backend)
+{
+}
+
+gboolean
+pk_backend_supports_parallelization (PkBackend *backend)
+{
+	return TRUE;
+}
+
+PkBitfield
+pk_backend_get_filters (PkBackend *backend)
+{
+	return pk_bitfield_from_enums (PK_FILTER_ENUM_INSTALLED, -1);
+}
+
+gchar **
+pk_backend_get_mime_types (PkBackend *backend)
+{
+	const gchar *mime_types[] = { NULL };
+	return g_strdupv ((gchar **) mime_types);
+}
+
+void
+pk_backend_cancel (PkBackend *backend, PkBackendJob *job)
+{
+	/* the threads check the cancellable */
+}
+
+static gchar *
+pk_backend_bench_get_package_id (guint i)
+{
+	return g_strdup_printf ("bench-%06u;1.0.%u;x86_64;bench", i, i % 10);
+}
+
+static gchar *
+pk_backend_bench_get_text (const gchar *package_id, guint size)
+{
+	GString *string = g_string_sized_new (size + 1);
+	g_string_append (string, package_id);
+	while (string->len < size)
+		g_string_append (string, " lorem ipsum");
+	g_string_truncate (string, size);
+	return g_string_free (string, FALSE);
+}
+
+/* between two signals or batches */
+static gboolean
+pk_backend_bench_next (PkBackendJob *job, const PkBackendBenchConfig *config)
+{
+	if (config->delay > 0)
+		g_usleep (config->delay);
+	return !g_cancellable_is_cancelled (pk_backend_job_get_cancellable (job));
+}
+
+static void
+pk_backend_bench_emit_packages (PkBackendJob *job,
+				const PkBackendBenchConfig *config,
+				PkInfoEnum info)
+{
+	g_autoptr(GPtrArray) array = NULL;
+
+	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
+	array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	for (guint i = 0; i < config->packages; i++) {
+		g_autofree gchar *package_id = pk_backend_bench_get_package_id (i);
+		g_autofree gchar *summary = pk_backend_bench_get_text (package_id, config->summary_size);
+
+		if (!config->plural) {
+			pk_backend_job_package (job, info, package_id, summary);
+		} else {
+			PkPackage *package = pk_package_new ();
+			pk_package_set_id (package, package_id, NULL);
+			pk_package_set_info (package, info);
+			pk_package_set_summary (package, summary);
+			g_ptr_array_add (array, package);
+			if (array->len < config->batch && i + 1 < config->packages)
+				continue;
+			/* the job keeps a reference until it is emitted */
+			pk_backend_job_packages (job, array);
+			g_ptr_array_unref (array);
+			array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+		}
+		if (!pk_backend_bench_next (job, config))
+			return;
+	}
+}
+
+static void
+pk_backend_get_packages_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
+{
+	pk_backend_bench_emit_packages (job, &defaults, PK_INFO_ENUM_INSTALLED);
+}
+
+void
+pk_backend_get_packages (PkBackend *backend, PkBackendJob *job, PkBitfield filters)
+{
+	pk_backend_job_thread_create (job, pk_backend_get_packages_thread, NULL, NULL);
+}
+
+static void
+pk_backend_search_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
+{
+	PkBackendBenchConfig config = defaults;
+	PkBitfield filters;
+	g_autofree gchar **search = NULL;
+
+	/* terms like "packages=10000" change what is emitted */
+	g_variant_get (params, "(t^a&s)", &filters, &search);
+	for (guint i = 0; search[i] != NULL; i++) {
+		g_auto(GStrv) split = g_strsplit (search[i], "=", 2);
+		if (g_strv_length (split) == 2)
+			pk_backend_bench_config_set (&config, split[0], split[1]);
+	}
+	pk_backend_bench_emit_packages (job, &config, PK_INFO_ENUM_AVAILABLE);
+}
+
+void
+pk_backend_search_names (PkBackend *backend, PkBackendJob *job, PkBitfield filters, gchar **values)
+{
+	pk_backend_job_thread_create (job, pk_backend_search_thread, NULL, NULL);
+}
+
+void
+pk_backend_search_details (PkBackend *backend, PkBackendJob *job, PkBitfield filters, gchar **values)
+{
+	pk_backend_job_thread_create (job, pk_backend_search_thread, NULL, NULL);
+}
+
+static void
+pk_backend_get_updates_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
+{
+	pk_backend_bench_emit_packages (job, &defaults, PK_INFO_ENUM_NORMAL);
+}
+
+void
+pk_backend_get_updates (PkBackend *backend, PkBackendJob *job, PkBitfield filters)
+{
+	pk_backend_job_thread_create (job, pk_backend_get_updates_thread, NULL, NULL);
+}
+
+static void
+pk_backend_get_details_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
+{
+	g_autofree gchar **package_ids = NULL;
+
+	g_variant_get (params, "(^a&s)", &package_ids);
+	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
+	for (guint i = 0; package_ids[i] != NULL; i++) {
+		g_autofree gchar *summary = NULL;
+		g_autofree gchar *description = NULL;
+
+		summary = pk_backend_bench_get_text (package_ids[i], defaults.summary_size);
+		description = pk_backend_bench_get_text (package_ids[i], defaults.summary_size * 4);
+		pk_backend_job_details (job, package_ids[i], summary, "GPL-2.0+",
+					PK_GROUP_ENUM_OTHER, description,
+					"https://www.freedesktop.org/software/PackageKit/",
+					1024 * 1024);
+		if (!pk_backend_bench_next (job, &defaults))
+			return;
+	}
+}
+
+void
+pk_backend_get_details (PkBackend *backend, PkBackendJob *job, gchar **package_ids)
+{
+	pk_backend_job_thread_create (job, pk_backend_get_details_thread, NULL, NULL);
+}
+
+static void
+pk_backend_get_files_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
+{
+	g_autofree gchar **package_ids = NULL;
+	g_auto(GStrv) files = NULL;
+
+	g_variant_get (params, "(^a&s)", &package_ids);
+	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
+	files = g_new0 (gchar *, defaults.files + 1);
+	for (guint i = 0; package_ids[i] != NULL; i++) {
+		g_auto(GStrv) split = pk_package_id_split (package_ids[i]);
+		for (guint j = 0; j < defaults.files; j++) {
+			g_free (files[j]);
+			files[j] = g_strdup_printf ("/usr/share/%s/file-%04u",
+						    split[PK_PACKAGE_ID_NAME], j);
+		}
+		pk_backend_job_files (job, package_ids[i], files);
+		if (!pk_backend_bench_next (job, &defaults))
+			return;
+	}
+}
+
+void
+pk_backend_get_files (PkBackend *backend, PkBackendJob *job, gchar **package_ids)
+{
+	pk_backend_job_thread_create (job, pk_backend_get_files_thread, NULL, NULL);
+}
+
+static void
+pk_backend_get_update_detail_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
+{
+	g_autofree gchar **package_ids = NULL;
+	g_autoptr(GPtrArray) array = NULL;
+	guint len;
+
+	g_variant_get (params, "(^a&s)", &package_ids);
+	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
+	len = g_strv_length (package_ids);
+	array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	for (guint i = 0; i < len; i++) {
+		g_autofree gchar *update_text = NULL;
+		g_autofree gchar *changelog = NULL;
+		gchar *updates[] = { package_ids[i], NULL };
+
+		update_text = pk_backend_bench_get_text (package_ids[i], defaults.summary_size * 4);
+		changelog = pk_backend_bench_get_text (package_ids[i], defaults.summary_size * 4);
+		if (!defaults.plural) {
+			pk_backend_job_update_detail (job, package_ids[i], updates, NULL,
+						      NULL, NULL, NULL,
+						      PK_RESTART_ENUM_NONE,
+						      update_text, changelog,
+						      PK_UPDATE_STATE_ENUM_STABLE,
+						      "2026-01-01T00:00:00Z", NULL);
+		} else {
+			PkUpdateDetail *item = pk_update_detail_new ();
+			g_object_set (item,
+				      "package-id", package_ids[i],
+				      "updates", updates,
+				      "restart", PK_RESTART_ENUM_NONE,
+				      "update-text", update_text,
+				      "changelog", changelog,
+				      "state", PK_UPDATE_STATE_ENUM_STABLE,
+				      "issued", "2026-01-01T00:00:00Z",
+				      NULL);
+			g_ptr_array_add (array, item);
+			if (array->len < defaults.batch && i + 1 < len)
+				continue;
+			pk_backend_job_update_details (job, array);
+			g_ptr_array_unref (array);
+			array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+		}
+		if (!pk_backend_bench_next (job, &defaults))
+			return;
+	}
+}
+
+void
+pk_backend_get_update_detail (PkBackend *backend, PkBackendJob *job, gchar **package_ids)
+{
+	pk_backend_job_thread_create (job, pk_backend_get_update_detail_thread, NULL, NULL);
+}
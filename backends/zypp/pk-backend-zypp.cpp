@@ -705,40 +705,54 @@ zypp_is_valid_repo (PkBackendJob *job, RepoInfo repo)
 	return TRUE;
 }
 
+/**
+ * Checksum of the metadata each repo in the pool was loaded from, by alias.
+ */
+static map<string, string> loaded_repos;
+
+/**
+ * Load a repo's solv cache into the pool, unless the pool already holds
+ * the repo as built from the same metadata.
+ */
+static void
+zypp_load_repo (RepoManager &manager, const RepoInfo &repo)
+{
+	string checksum = manager.metadataStatus (repo).checksum ();
+	map<string, string>::const_iterator it = loaded_repos.find (repo.alias ());
+
+	if (it != loaded_repos.end () && it->second == checksum &&
+	    sat::Pool::instance ().reposFind (repo.alias ()) != Repository::noRepository)
+		return;
+
+	MIL << "loading " << repo.alias () << endl;
+	manager.loadFromCache (repo);
+	loaded_repos[repo.alias ()] = checksum;
+}
+
 /**
  * Build and return a ResPool that contains all local resolvables
  * and ones found in the enabled repositories.
+ *
+ * Only repos whose metadata changed since they were loaded get reloaded.
+ * The system repo stays in the pool; callers not interested in installed
+ * packages skip solvables with isSystem() instead of erasing it.
  */
 ResPool
-zypp_build_pool (ZYpp::Ptr zypp, gboolean include_local)
+zypp_build_pool (ZYpp::Ptr zypp)
 {
-	static gboolean repos_loaded = FALSE;
-
-	// the target is loaded or unloaded on request
-	if (include_local) {
-		// FIXME have to wait for fix in zypp (repeated loading of target)
-		if (sat::Pool::instance().reposFind( sat::Pool::systemRepoAlias() ).solvablesEmpty ())
-		{
-			// Add local resolvables
-			Target_Ptr target = zypp->target ();
-			target->load ();
-		}
-	} else {
-		if (!sat::Pool::instance().reposFind( sat::Pool::systemRepoAlias() ).solvablesEmpty ())
-		{
-			// Remove local resolvables
-			Repository repository = sat::Pool::instance ().reposFind (sat::Pool::systemRepoAlias());
-			repository.eraseFromPool ();
-		}
+	// FIXME have to wait for fix in zypp (repeated loading of target)
+	if (sat::Pool::instance().reposFind( sat::Pool::systemRepoAlias() ).solvablesEmpty ())
+	{
+		// Add local resolvables
+		Target_Ptr target = zypp->target ();
+		target->load ();
 	}
 
-	// we only load repositories once.
-	if (repos_loaded)
-		return zypp->pool();
-
 	// Add resolvables from enabled repos
 	RepoManager manager;
 	try {
+		set<string> enabled;
+
 		for (RepoManager::RepoConstIterator it = manager.repoBegin(); it != manager.repoEnd(); ++it) {
 			RepoInfo repo (*it);
 
@@ -750,12 +764,22 @@ zypp_build_pool (ZYpp::Ptr zypp, gboolean include_local)
 				g_warning ("%s is not cached! Do a refresh", repo.alias ().c_str ());
 				continue;
 			}
-			//FIXME see above, skip already cached repos
-			if (sat::Pool::instance().reposFind( repo.alias ()) == Repository::noRepository)
-				manager.loadFromCache (repo);
 
+			enabled.insert (repo.alias ());
+			zypp_load_repo (manager, repo);
+		}
+
+		// drop repos removed or disabled since they were loaded
+		for (map<string, string>::iterator it = loaded_repos.begin (); it != loaded_repos.end ();) {
+			if (enabled.count (it->first) > 0) {
+				++it;
+				continue;
+			}
+			Repository repository = sat::Pool::instance ().reposFind (it->first);
+			if (repository != Repository::noRepository)
+				repository.eraseFromPool ();
+			loaded_repos.erase (it++);
 		}
-		repos_loaded = true;
 	} catch (const repo::RepoNoAliasException &ex) {
 		g_error ("Can't figure an alias to look in cache");
 	} catch (const repo::RepoNotCachedException &ex) {
@@ -868,7 +892,7 @@ zypp_get_packages_by_file (ZYpp::Ptr zypp,
 			   const gchar *search_file,
 			   vector<sat::Solvable> &ret)
 {
-	ResPool pool = zypp_build_pool (zypp, TRUE);
+	ResPool pool = zypp_build_pool (zypp);
 
 	string file (search_file);
 
@@ -1032,7 +1056,7 @@ zypp_refresh_meta_and_cache (RepoManager &manager, RepoInfo &repo, bool force =
 				    RepoManager::BuildIfNeeded);
 		try
 		{
-			manager.loadFromCache (repo);
+			zypp_load_repo (manager, repo);
 		}
 		catch (const Exception &exp)
 		{
@@ -1041,7 +1065,8 @@ zypp_refresh_meta_and_cache (RepoManager &manager, RepoInfo &repo, bool force =
 			manager.buildCache (repo, force ?
 					    RepoManager::BuildForced :
 					    RepoManager::BuildIfNeeded);
-			manager.loadFromCache (repo);
+			loaded_repos.erase (repo.alias ());
+			zypp_load_repo (manager, repo);
 		}
 		return TRUE;
 	} catch (const AbortTransactionException &ex) {
@@ -1895,7 +1920,7 @@ backend_required_by_thread (PkBackendJob *job, GVariant *params, gpointer user_d
 
 	pk_backend_job_set_percentage (job, 10);
 
-	ResPool pool = zypp_build_pool (zypp, true);
+	ResPool pool = zypp_build_pool (zypp);
 	PoolStatusSaver saver;
 	for (uint i = 0; package_ids[i]; i++) {
 		sat::Solvable solvable = zypp_get_package_by_id (package_ids[i]);
@@ -2158,7 +2183,7 @@ backend_get_details_thread (PkBackendJob *job, GVariant *params, gpointer user_d
 		return;
 	}
 
-	zypp_build_pool (zypp, true);
+	zypp_build_pool (zypp);
 
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 
@@ -2469,7 +2494,7 @@ backend_get_updates_thread (PkBackendJob *job, GVariant *params, gpointer user_d
 		return;
 	}
 
-	ResPool pool = zypp_build_pool (zypp, TRUE);
+	ResPool pool = zypp_build_pool (zypp);
 	pk_backend_job_set_percentage (job, 40);
 
 	set<PoolItem> candidates;
@@ -2589,7 +2614,7 @@ backend_install_files_thread (PkBackendJob *job, GVariant *params, gpointer user
 			  job, PK_ERROR_ENUM_INTERNAL_ERROR, "Can't refresh repositories");
 			return;
 		}
-		zypp_build_pool (zypp, true);
+		zypp_build_pool (zypp);
 
 	} catch (const Exception &ex) {
 		zypp_backend_finished_error (
@@ -2648,7 +2673,7 @@ backend_get_update_detail_thread (PkBackendJob *job, GVariant *params, gpointer
 	}
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 
-	zypp_build_pool (zypp, TRUE);
+	zypp_build_pool (zypp);
 
 	for (uint i = 0; package_ids[i]; i++) {
 		sat::Solvable solvable = zypp_get_package_by_id (package_ids[i]);
@@ -2755,7 +2780,7 @@ backend_install_packages_thread (PkBackendJob *job, GVariant *params, gpointer u
 
 	try
 	{
-		ResPool pool = zypp_build_pool (zypp, TRUE);
+		ResPool pool = zypp_build_pool (zypp);
 		PoolStatusSaver saver;
 		pk_backend_job_set_percentage (job, 10);
 		vector<PoolItem> items;
@@ -3017,7 +3042,7 @@ backend_resolve_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 
-	zypp_build_pool (zypp, TRUE);
+	zypp_build_pool (zypp);
 
 	for (uint i = 0; search[i]; i++) {
 		MIL << search[i] << " " << pk_filter_bitfield_to_string(_filters) << endl;
@@ -3138,7 +3163,7 @@ backend_find_packages_thread (PkBackendJob *job, GVariant *params, gpointer user
 
 	switch (role) {
 	case PK_ROLE_ENUM_SEARCH_NAME:
-		zypp_build_pool (zypp, TRUE); // seems to be necessary?
+		zypp_build_pool (zypp); // seems to be necessary?
 		q.addKind( ResKind::package );
 		q.addKind( ResKind::srcpackage );
 		q.addAttribute( sat::SolvAttr::name );
@@ -3147,7 +3172,7 @@ backend_find_packages_thread (PkBackendJob *job, GVariant *params, gpointer user
 		// two separate queries.
 		break;
 	case PK_ROLE_ENUM_SEARCH_DETAILS:
-		zypp_build_pool (zypp, TRUE); // seems to be necessary?
+		zypp_build_pool (zypp); // seems to be necessary?
 		q.addKind( ResKind::package );
 		//q.addKind( ResKind::srcpackage );
 		q.addAttribute( sat::SolvAttr::name );
@@ -3158,7 +3183,7 @@ backend_find_packages_thread (PkBackendJob *job, GVariant *params, gpointer user
 	case PK_ROLE_ENUM_SEARCH_FILE: {
 		q.setCaseSensitive( true ); // [<>] But we probably want case sensitive search for the file searches.
 
-		zypp_build_pool (zypp, TRUE);
+		zypp_build_pool (zypp);
 		q.addKind( ResKind::package );
 		q.addAttribute( sat::SolvAttr::name );
 		q.addAttribute( sat::SolvAttr::description );
@@ -3219,7 +3244,7 @@ backend_search_group_thread (PkBackendJob *job, GVariant *params, gpointer user_
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 	pk_backend_job_set_percentage (job, 0);
 
-	ResPool pool = zypp_build_pool (zypp, true);
+	ResPool pool = zypp_build_pool (zypp);
 
 	pk_backend_job_set_percentage (job, 30);
 
@@ -3357,7 +3382,7 @@ backend_get_files_thread (PkBackendJob *job, GVariant *params, gpointer user_dat
 		return;
 	}
 
-	zypp_build_pool (zypp, true);
+	zypp_build_pool (zypp);
 
 	for (uint i = 0; package_ids[i]; i++) {
 		pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
@@ -3429,7 +3454,7 @@ backend_get_packages_thread (PkBackendJob *job, GVariant *params, gpointer user_
 
 	vector<sat::Solvable> v;
 
-	zypp_build_pool (zypp, TRUE);
+	zypp_build_pool (zypp);
 	ResPool pool = ResPool::instance ();
 	for (ResPool::byKind_iterator it = pool.byKindBegin (ResKind::package); it != pool.byKindEnd (ResKind::package); ++it) {
 		v.push_back (it->satSolvable ());
@@ -3495,7 +3520,7 @@ backend_update_packages_thread (PkBackendJob *job, GVariant *params, gpointer us
 		return;
 	}
 
-	ResPool pool = zypp_build_pool (zypp, TRUE);
+	ResPool pool = zypp_build_pool (zypp);
 	PkRestartEnum restart = PK_RESTART_ENUM_NONE;
 	PoolStatusSaver saver;
 
@@ -3572,7 +3597,7 @@ pk_backend_upgrade_system_thread (PkBackendJob *job,
 		return;
 	}
 
-	ResPool pool = zypp_build_pool (zypp, TRUE);
+	ResPool pool = zypp_build_pool (zypp);
 	PkRestartEnum restart = PK_RESTART_ENUM_NONE;
 	PoolStatusSaver saver;
 
@@ -3792,7 +3817,7 @@ backend_what_provides_thread (PkBackendJob *job, GVariant *params, gpointer user
 	}
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 
-	ResPool pool = zypp_build_pool (zypp, true);
+	ResPool pool = zypp_build_pool (zypp);
 
 	if(g_ascii_strcasecmp("drivers_for_attached_hardware", values[0]) == 0) {
 		// solver run
@@ -3909,13 +3934,14 @@ backend_download_packages_thread (PkBackendJob *job, GVariant *params, gpointer
 
 	try
 	{
-		ResPool pool = zypp_build_pool (zypp, FALSE);
+		ResPool pool = zypp_build_pool (zypp);
 
 		pk_backend_job_set_status (job, PK_STATUS_ENUM_DOWNLOAD);
 		for (guint i = 0; package_ids[i]; i++) {
 			sat::Solvable solvable = zypp_get_package_by_id (package_ids[i]);
 
-			if (zypp_is_no_solvable(solvable)) {
+			// installed packages can't be downloaded
+			if (zypp_is_no_solvable(solvable) || solvable.isSystem ()) {
 				zypp_backend_finished_error (job, PK_ERROR_ENUM_PACKAGE_NOT_FOUND,
 							     "couldn't find package");
 				return;
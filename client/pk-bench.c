@@ -0,0 +1,377 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 PackageKit contributors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Drives concurrent transactions against the daemon and reports latency
+ * and throughput. Run the daemon with the test_bench backend so the
+ * numbers measure the transaction pipeline rather than a package manager:
+ *
+ *   packagekitd --backend=test_bench
+ *   pk-bench --role=search-names --transactions=200 --concurrency=8 --packages=5000
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <locale.h>
+#include <string.h>
+#include <glib.h>
+#include <packagekit-glib2/packagekit.h>
+
+typedef struct {
+	GMainLoop	*loop;
+	PkClient	*client;
+	PkRoleEnum	 role;
+	guint		 transactions;
+	guint		 started;
+	guint		 finished;
+	guint		 failed;
+	guint		 packages;
+	guint		 ids;
+	GPtrArray	*settings;	/* search terms for the backend */
+	guint64		 items;
+	GArray		*latencies;	/* gint64, us */
+} PkBench;
+
+typedef struct {
+	PkBench		*bench;
+	gint64		 start;
+} PkBenchItem;
+
+static void pk_bench_start (PkBench *bench);
+
+/* the bench backend uses the same package IDs */
+static gchar **
+pk_bench_get_package_ids (PkBench *bench, guint offset)
+{
+	gchar **package_ids = g_new0 (gchar *, bench->ids + 1);
+	for (guint i = 0; i < bench->ids; i++) {
+		guint j = offset + i;
+		package_ids[i] = g_strdup_printf ("bench-%06u;1.0.%u;x86_64;bench", j, j % 10);
+	}
+	return package_ids;
+}
+
+static guint
+pk_bench_count_items (PkBench *bench, PkResults *results)
+{
+	g_autoptr(GPtrArray) array = NULL;
+
+	switch (bench->role) {
+	case PK_ROLE_ENUM_GET_DETAILS:
+		array = pk_results_get_details_array (results);
+		break;
+	case PK_ROLE_ENUM_GET_FILES:
+		array = pk_results_get_files_array (results);
+		break;
+	case PK_ROLE_ENUM_GET_UPDATE_DETAIL:
+		array = pk_results_get_update_detail_array (results);
+		break;
+	default:
+		array = pk_results_get_package_array (results);
+		break;
+	}
+	return array->len;
+}
+
+static void
+pk_bench_finished_cb (GObject *object, GAsyncResult *res, gpointer user_data)
+{
+	PkBenchItem *item = user_data;
+	PkBench *bench = item->bench;
+	gint64 latency = g_get_monotonic_time () - item->start;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(PkResults) results = NULL;
+
+	g_free (item);
+	bench->finished++;
+	results = pk_client_generic_finish (PK_CLIENT (object), res, &error);
+	if (results == NULL) {
+		g_printerr ("transaction failed: %s\n", error->message);
+		bench->failed++;
+	} else if (pk_results_get_exit_code (results) != PK_EXIT_ENUM_SUCCESS) {
+		g_printerr ("transaction failed: %s\n",
+			    pk_exit_enum_to_string (pk_results_get_exit_code (results)));
+		bench->failed++;
+	} else {
+		g_array_append_val (bench->latencies, latency);
+		bench->items += pk_bench_count_items (bench, results);
+	}
+
+	if (bench->finished == bench->transactions) {
+		g_main_loop_quit (bench->loop);
+		return;
+	}
+	pk_bench_start (bench);
+}
+
+static void
+pk_bench_start (PkBench *bench)
+{
+	PkBenchItem *item;
+	g_auto(GStrv) values = NULL;
+	g_auto(GStrv) package_ids = NULL;
+	guint n = bench->started++;
+
+	if (n >= bench->transactions)
+		return;
+
+	item = g_new0 (PkBenchItem, 1);
+	item->bench = bench;
+	item->start = g_get_monotonic_time ();
+
+	switch (bench->role) {
+	case PK_ROLE_ENUM_SEARCH_NAME:
+	case PK_ROLE_ENUM_SEARCH_DETAILS:
+		/* the transaction number keeps the results cache out of it */
+		values = g_new0 (gchar *, bench->settings->len + 2);
+		values[0] = g_strdup_printf ("bench-%u", n);
+		for (guint i = 0; i < bench->settings->len; i++)
+			values[i + 1] = g_strdup (g_ptr_array_index (bench->settings, i));
+		if (bench->role == PK_ROLE_ENUM_SEARCH_NAME) {
+			pk_client_search_names_async (bench->client, 0, values, NULL,
+						      NULL, NULL, pk_bench_finished_cb, item);
+		} else {
+			pk_client_search_details_async (bench->client, 0, values, NULL,
+							NULL, NULL, pk_bench_finished_cb, item);
+		}
+		break;
+	case PK_ROLE_ENUM_GET_DETAILS:
+		package_ids = pk_bench_get_package_ids (bench, n * bench->ids);
+		pk_client_get_details_async (bench->client, package_ids, NULL,
+					     NULL, NULL, pk_bench_finished_cb, item);
+		break;
+	case PK_ROLE_ENUM_GET_FILES:
+		package_ids = pk_bench_get_package_ids (bench, n * bench->ids);
+		pk_client_get_files_async (bench->client, package_ids, NULL,
+					   NULL, NULL, pk_bench_finished_cb, item);
+		break;
+	case PK_ROLE_ENUM_GET_UPDATE_DETAIL:
+		package_ids = pk_bench_get_package_ids (bench, n * bench->ids);
+		pk_client_get_update_detail_async (bench->client, package_ids, NULL,
+						   NULL, NULL, pk_bench_finished_cb, item);
+		break;
+	case PK_ROLE_ENUM_GET_UPDATES:
+		pk_client_get_updates_async (bench->client, 0, NULL,
+					     NULL, NULL, pk_bench_finished_cb, item);
+		break;
+	default:
+		pk_client_get_packages_async (bench->client, 0, NULL,
+					      NULL, NULL, pk_bench_finished_cb, item);
+		break;
+	}
+}
+
+static guint
+pk_bench_get_daemon_pid (void)
+{
+	g_autoptr(GDBusConnection) connection = NULL;
+	g_autoptr(GVariant) value = NULL;
+	guint pid;
+
+	connection = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, NULL);
+	if (connection == NULL)
+		return 0;
+	value = g_dbus_connection_call_sync (connection,
+					     "org.freedesktop.DBus",
+					     "/org/freedesktop/DBus",
+					     "org.freedesktop.DBus",
+					     "GetConnectionUnixProcessID",
+					     g_variant_new ("(s)", PK_DBUS_SERVICE),
+					     G_VARIANT_TYPE ("(u)"),
+					     G_DBUS_CALL_FLAGS_NONE,
+					     -1, NULL, NULL);
+	if (value == NULL)
+		return 0;
+	g_variant_get (value, "(u)", &pid);
+	return pid;
+}
+
+/* in kB, from /proc/$pid/status */
+static guint64
+pk_bench_get_memory (guint pid, const gchar *key)
+{
+	g_autofree gchar *filename = NULL;
+	g_autofree gchar *contents = NULL;
+	g_auto(GStrv) lines = NULL;
+
+	if (pid == 0)
+		return 0;
+	filename = g_strdup_printf ("/proc/%u/status", pid);
+	if (!g_file_get_contents (filename, &contents, NULL, NULL))
+		return 0;
+	lines = g_strsplit (contents, "\n", -1);
+	for (guint i = 0; lines[i] != NULL; i++) {
+		if (g_str_has_prefix (lines[i], key))
+			return g_ascii_strtoull (lines[i] + strlen (key), NULL, 10);
+	}
+	return 0;
+}
+
+static gint
+pk_bench_sort_cb (gconstpointer a, gconstpointer b)
+{
+	gint64 x = *((const gint64 *) a);
+	gint64 y = *((const gint64 *) b);
+	return (x > y) - (x < y);
+}
+
+/* nearest rank */
+static gdouble
+pk_bench_get_percentile (GArray *latencies, guint percentile)
+{
+	guint idx;
+	if (latencies->len == 0)
+		return 0.f;
+	idx = (latencies->len * percentile + 99) / 100;
+	idx = CLAMP (idx, 1, latencies->len) - 1;
+	return g_array_index (latencies, gint64, idx) / 1000.f;
+}
+
+int
+main (int argc, char *argv[])
+{
+	PkBench bench = { 0 };
+	gboolean program_version = FALSE;
+	GOptionContext *context;
+	gint retval = EXIT_SUCCESS;
+	gint64 start;
+	gdouble elapsed;
+	gint concurrency = 4;
+	gint transactions = 100;
+	gint ids = 100;
+	gint packages = 0;
+	guint pid;
+	guint64 rss_before;
+	g_autofree gchar *role = NULL;
+	g_auto(GStrv) settings = NULL;
+	g_autoptr(PkControl) control = NULL;
+	g_autoptr(GError) error = NULL;
+
+	const GOptionEntry options[] = {
+		{ "version", '\0', 0, G_OPTION_ARG_NONE, &program_version,
+			"Show the program version and exit", NULL},
+		{ "role", '\0', 0, G_OPTION_ARG_STRING, &role,
+			"The transaction to run, e.g. search-name, get-details, get-files, "
+			"get-update-detail, get-packages or get-updates", "ROLE"},
+		{ "transactions", 'n', 0, G_OPTION_ARG_INT, &transactions,
+			"The number of transactions to run", "NUMBER"},
+		{ "concurrency", 'c', 0, G_OPTION_ARG_INT, &concurrency,
+			"The number of transactions to run at the same time", "NUMBER"},
+		{ "packages", '\0', 0, G_OPTION_ARG_INT, &packages,
+			"The number of packages a search emits", "NUMBER"},
+		{ "ids", '\0', 0, G_OPTION_ARG_INT, &ids,
+			"The number of package IDs passed to get-details, get-files "
+			"and get-update-detail", "NUMBER"},
+		{ "set", '\0', 0, G_OPTION_ARG_STRING_ARRAY, &settings,
+			"Another setting for searches, e.g. plural=false", "KEY=VALUE"},
+		{ NULL}
+	};
+
+	setlocale (LC_ALL, "");
+
+	context = g_option_context_new (NULL);
+	g_option_context_set_summary (context, "PackageKit Benchmark");
+	g_option_context_set_description (context,
+		"Run packagekitd with --backend=test_bench. The results of get-packages "
+		"and get-updates are shared between identical queries unless "
+		"QueryCacheTimeout is 0.");
+	g_option_context_add_main_entries (context, options, NULL);
+	g_option_context_add_group (context, pk_debug_get_option_group ());
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("Failed to parse options: %s\n", error->message);
+		g_option_context_free (context);
+		return EXIT_FAILURE;
+	}
+	g_option_context_free (context);
+
+	if (program_version) {
+		g_print (VERSION "\n");
+		return EXIT_SUCCESS;
+	}
+
+	bench.role = pk_role_enum_from_string (role != NULL ? role : "search-name");
+	if (bench.role == PK_ROLE_ENUM_UNKNOWN) {
+		g_printerr ("Unknown role %s\n", role);
+		return EXIT_FAILURE;
+	}
+	if (transactions <= 0 || ids <= 0 || concurrency <= 0 || packages < 0) {
+		g_printerr ("Numbers have to be positive\n");
+		return EXIT_FAILURE;
+	}
+	bench.transactions = transactions;
+	bench.ids = ids;
+	bench.settings = g_ptr_array_new_with_free_func (g_free);
+	if (packages > 0)
+		g_ptr_array_add (bench.settings, g_strdup_printf ("packages=%i", packages));
+	for (guint i = 0; settings != NULL && settings[i] != NULL; i++)
+		g_ptr_array_add (bench.settings, g_strdup (settings[i]));
+
+	/* start the daemon so its startup is not measured */
+	control = pk_control_new ();
+	if (!pk_control_get_properties (control, NULL, &error)) {
+		g_printerr ("Failed to contact PackageKit: %s\n", error->message);
+		return EXIT_FAILURE;
+	}
+	pid = pk_bench_get_daemon_pid ();
+	rss_before = pk_bench_get_memory (pid, "VmRSS:");
+
+	bench.loop = g_main_loop_new (NULL, FALSE);
+	bench.client = pk_client_new ();
+	pk_client_set_background (bench.client, FALSE);
+	bench.latencies = g_array_new (FALSE, FALSE, sizeof (gint64));
+
+	start = g_get_monotonic_time ();
+	for (gint i = 0; i < concurrency; i++)
+		pk_bench_start (&bench);
+	g_main_loop_run (bench.loop);
+	elapsed = (gdouble) (g_get_monotonic_time () - start) / G_USEC_PER_SEC;
+
+	g_array_sort (bench.latencies, pk_bench_sort_cb);
+	g_print ("role:            %s\n", pk_role_enum_to_string (bench.role));
+	g_print ("transactions:    %u (%u failed), %i at a time\n",
+		 bench.transactions, bench.failed, concurrency);
+	g_print ("elapsed:         %.3f s\n", elapsed);
+	g_print ("throughput:      %.1f transactions/s, %.0f items/s\n",
+		 bench.transactions / elapsed, bench.items / elapsed);
+	g_print ("latency:         p50 %.1f ms, p90 %.1f ms, p99 %.1f ms, max %.1f ms\n",
+		 pk_bench_get_percentile (bench.latencies, 50),
+		 pk_bench_get_percentile (bench.latencies, 90),
+		 pk_bench_get_percentile (bench.latencies, 99),
+		 pk_bench_get_percentile (bench.latencies, 100));
+	if (pid != 0) {
+		g_print ("daemon RSS:      %" G_GUINT64_FORMAT " kB before, %" G_GUINT64_FORMAT
+			 " kB after, %" G_GUINT64_FORMAT " kB peak\n",
+			 rss_before,
+			 pk_bench_get_memory (pid, "VmRSS:"),
+			 pk_bench_get_memory (pid, "VmHWM:"));
+	} else {
+		g_print ("daemon RSS:      unknown\n");
+	}
+	if (bench.failed > 0)
+		retval = EXIT_FAILURE;
+
+	g_array_unref (bench.latencies);
+	g_object_unref (bench.client);
+	g_main_loop_unref (bench.loop);
+	g_ptr_array_unref (bench.settings);
+	return retval;
+}
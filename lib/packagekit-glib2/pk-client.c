@@ -35,6 +35,7 @@
 #include <glib-object.h>
 #include <locale.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include <packagekit-glib2/pk-client.h>
 #include <packagekit-glib2/pk-client-helper.h>
@@ -107,27 +108,29 @@ pk_client_weak_ref_free (gpointer ptr)
 }
 
 static void
-pk_client_weak_ref_free_gclosure (gpointer ptr,
-				  GClosure *closure)
-{
-	pk_client_weak_ref_free (ptr);
-}
-
-static void
-pk_client_properties_changed_cb (GDBusProxy *proxy,
-				 GVariant *changed_properties,
-				 const gchar* const  *invalidated_properties,
+pk_client_properties_changed_cb (GDBusConnection *connection,
+				 const gchar *sender_name,
+				 const gchar *object_path,
+				 const gchar *interface_name,
+				 const gchar *signal_name,
+				 GVariant *parameters,
 				 gpointer user_data);
 static void
-pk_client_signal_cb (GDBusProxy *proxy,
+pk_client_signal_cb (GDBusConnection *connection,
 		     const gchar *sender_name,
+		     const gchar *object_path,
+		     const gchar *interface_name,
 		     const gchar *signal_name,
 		     GVariant *parameters,
 		     gpointer user_data);
 static void
-pk_client_notify_name_owner_cb (GObject    *obj,
-                                GParamSpec *pspec,
-                                gpointer    user_data);
+pk_client_name_owner_changed_cb (GDBusConnection *connection,
+				 const gchar *sender_name,
+				 const gchar *object_path,
+				 const gchar *interface_name,
+				 const gchar *signal_name,
+				 GVariant *parameters,
+				 gpointer user_data);
 
 struct _PkClientState
 {
@@ -157,7 +160,6 @@ struct _PkClientState
 	gpointer			 user_data;
 	guint				 number;
 	gulong				 cancellable_id;
-	GDBusProxy			*proxy;
 	GDBusProxy			*proxy_props;
 	GCancellable			*cancellable;
 	GCancellable			*cancellable_client;
@@ -173,25 +175,26 @@ struct _PkClientState
 	guint				 refcount;
 	PkClientHelper			*client_helper;
 	gboolean			 waiting_for_finished;
+	guint				 signal_id;
+	guint				 properties_changed_id;
+	guint				 name_owner_changed_id;
 };
 
 G_DEFINE_TYPE (PkClientState, pk_client_state, G_TYPE_OBJECT)
 
 static void
-pk_client_state_unset_proxy (PkClientState *state)
+pk_client_state_unsubscribe (PkClientState *state)
 {
-	if (state->proxy != NULL) {
-		g_signal_handlers_disconnect_by_func (state->proxy,
-						      G_CALLBACK (pk_client_properties_changed_cb),
-						      state);
-		g_signal_handlers_disconnect_by_func (state->proxy,
-						      G_CALLBACK (pk_client_signal_cb),
-						      state);
-		g_signal_handlers_disconnect_by_func (state->proxy,
-						      G_CALLBACK (pk_client_notify_name_owner_cb),
-						      state);
-		g_clear_object (&state->proxy);
-	}
+	GDBusConnection *connection = state->client->priv->connection;
+
+	if (state->signal_id == 0)
+		return;
+	g_dbus_connection_signal_unsubscribe (connection, state->signal_id);
+	g_dbus_connection_signal_unsubscribe (connection, state->properties_changed_id);
+	g_dbus_connection_signal_unsubscribe (connection, state->name_owner_changed_id);
+	state->signal_id = 0;
+	state->properties_changed_id = 0;
+	state->name_owner_changed_id = 0;
 }
 
 static void
@@ -206,6 +209,8 @@ pk_client_state_remove (PkClient *client, PkClientState *state)
 		client->priv->idle = is_idle;
 		g_object_notify (G_OBJECT(client), "idle");
 	}
+
+	pk_client_state_unsubscribe (state);
 }
 
 static void
@@ -234,8 +239,6 @@ pk_client_state_finish (PkClientState *state, const GError *error)
 	g_clear_object (&state->cancellable);
 	g_clear_object (&state->cancellable_client);
 
-	pk_client_state_unset_proxy (state);
-
 	if (state->proxy_props != NULL)
 		g_object_unref (G_OBJECT (state->proxy_props));
 
@@ -311,7 +314,7 @@ pk_client_cancel_cb (GObject *source_object,
 		     GAsyncResult *res,
 		     gpointer user_data)
 {
-	GDBusProxy *proxy = G_DBUS_PROXY (source_object);
+	GDBusConnection *connection = G_DBUS_CONNECTION (source_object);
 	GWeakRef *weak_ref = user_data;
 	g_autoptr(GError) error = NULL;
 	g_autoptr(GVariant) value = NULL;
@@ -322,7 +325,7 @@ pk_client_cancel_cb (GObject *source_object,
 	pk_client_weak_ref_free (weak_ref);
 
 	/* get the result */
-	value = g_dbus_proxy_call_finish (proxy, res, &error);
+	value = g_dbus_connection_call_finish (connection, res, &error);
 	if (value == NULL) {
 		/* Instructing the daemon to cancel failed, so just return an
 		 * error to the client so they don’t wait forever. */
@@ -348,19 +351,50 @@ pk_client_cancellable_cancel_cb (GCancellable *cancellable,
 	}
 
 	/* dbus method has not yet fired */
-	if (state->proxy == NULL) {
-		g_debug ("Cancelled, but no proxy, not sure what to do here");
+	if (state->tid == NULL || state->client->priv->connection == NULL) {
+		g_debug ("Cancelled, but no transaction, not sure what to do here");
 		return;
 	}
 
 	/* takeover the call with the cancel method */
 	g_debug ("cancelling %s", state->tid);
-	g_dbus_proxy_call (state->proxy, "Cancel",
-			   NULL,
-			   G_DBUS_CALL_FLAGS_NONE,
-			   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-			   NULL,
-			   pk_client_cancel_cb, pk_client_weak_ref_new (state));
+	g_dbus_connection_call (state->client->priv->connection,
+				PK_DBUS_SERVICE,
+				state->tid,
+				PK_DBUS_INTERFACE_TRANSACTION,
+				"Cancel",
+				NULL,
+				NULL,
+				G_DBUS_CALL_FLAGS_NONE,
+				PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				NULL,
+				pk_client_cancel_cb, pk_client_weak_ref_new (state));
+}
+
+/*
+ * pk_client_state_call:
+ *
+ * Calls a method on the transaction object directly on the shared
+ * connection; the callback owns a reference to @state.
+ **/
+static void
+pk_client_state_call (PkClientState *state,
+		      const gchar *method_name,
+		      GVariant *parameters,
+		      GAsyncReadyCallback callback)
+{
+	g_dbus_connection_call (state->client->priv->connection,
+				PK_DBUS_SERVICE,
+				state->tid,
+				PK_DBUS_INTERFACE_TRANSACTION,
+				method_name,
+				parameters,
+				NULL,
+				G_DBUS_CALL_FLAGS_NONE,
+				PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				state->cancellable,
+				callback,
+				g_object_ref (state));
 }
 
 static PkClientState *
@@ -818,6 +852,10 @@ pk_client_set_property_value (PkClientState *state,
 		return;
 	}
 
+	/* phase-times, only useful for diagnostics */
+	if (g_strcmp0 (key, "PhaseTimes") == 0)
+		return;
+
 	g_warning ("unhandled property '%s'", key);
 }
 
@@ -837,34 +875,83 @@ pk_client_state_add (PkClient *client, PkClientState *state)
 		client->priv->idle = is_idle;
 		g_object_notify (G_OBJECT(client), "idle");
 	}
+
+	/* subscribe to the signals of just this transaction, in the main
+	 * context of the caller; the match rules are sent before any method
+	 * call so we cannot miss a signal */
+	state->signal_id =
+		g_dbus_connection_signal_subscribe (client->priv->connection,
+						    PK_DBUS_SERVICE,
+						    PK_DBUS_INTERFACE_TRANSACTION,
+						    NULL,
+						    state->tid,
+						    NULL,
+						    G_DBUS_SIGNAL_FLAGS_NONE,
+						    pk_client_signal_cb,
+						    pk_client_weak_ref_new (state),
+						    pk_client_weak_ref_free);
+	state->properties_changed_id =
+		g_dbus_connection_signal_subscribe (client->priv->connection,
+						    PK_DBUS_SERVICE,
+						    "org.freedesktop.DBus.Properties",
+						    "PropertiesChanged",
+						    state->tid,
+						    PK_DBUS_INTERFACE_TRANSACTION,
+						    G_DBUS_SIGNAL_FLAGS_NONE,
+						    pk_client_properties_changed_cb,
+						    pk_client_weak_ref_new (state),
+						    pk_client_weak_ref_free);
+	state->name_owner_changed_id =
+		g_dbus_connection_signal_subscribe (client->priv->connection,
+						    "org.freedesktop.DBus",
+						    "org.freedesktop.DBus",
+						    "NameOwnerChanged",
+						    "/org/freedesktop/DBus",
+						    PK_DBUS_SERVICE,
+						    G_DBUS_SIGNAL_FLAGS_NONE,
+						    pk_client_name_owner_changed_cb,
+						    pk_client_weak_ref_new (state),
+						    pk_client_weak_ref_free);
 }
 
 /*
- * pk_client_properties_changed_cb:
+ * pk_client_state_set_properties:
  **/
 static void
-pk_client_properties_changed_cb (GDBusProxy *proxy,
-				 GVariant *changed_properties,
-				 const gchar* const  *invalidated_properties,
-				 gpointer user_data)
+pk_client_state_set_properties (PkClientState *state, GVariant *properties)
 {
 	const gchar *key;
-	GVariantIter *iter;
+	GVariantIter iter;
 	GVariant *value;
+
+	g_variant_iter_init (&iter, properties);
+	while (g_variant_iter_loop (&iter, "{&sv}", &key, &value))
+		pk_client_set_property_value (state, key, value);
+}
+
+/*
+ * pk_client_properties_changed_cb:
+ **/
+static void
+pk_client_properties_changed_cb (GDBusConnection *connection,
+				 const gchar *sender_name,
+				 const gchar *object_path,
+				 const gchar *interface_name,
+				 const gchar *signal_name,
+				 GVariant *parameters,
+				 gpointer user_data)
+{
 	GWeakRef *weak_ref = user_data;
 	g_autoptr(PkClientState) state = g_weak_ref_get (weak_ref);
+	g_autoptr(GVariant) changed_properties = NULL;
 
 	if (!state)
 		return;
+	if (!g_variant_is_of_type (parameters, G_VARIANT_TYPE ("(sa{sv}as)")))
+		return;
 
-	if (g_variant_n_children (changed_properties) > 0) {
-		g_variant_get (changed_properties,
-				"a{sv}",
-				&iter);
-		while (g_variant_iter_loop (iter, "{&sv}", &key, &value))
-			pk_client_set_property_value (state, key, value);
-		g_variant_iter_free (iter);
-	}
+	changed_properties = g_variant_get_child_value (parameters, 1);
+	pk_client_state_set_properties (state, changed_properties);
 }
 
 /*
@@ -1224,17 +1311,13 @@ results_add_update_detail_from_variant (PkResults   *results,
 }
 
 /*
- * pk_client_signal_cb:
+ * pk_client_state_signal:
  **/
 static void
-pk_client_signal_cb (GDBusProxy *proxy,
-		     const gchar *sender_name,
-		     const gchar *signal_name,
-		     GVariant *parameters,
-		     gpointer user_data)
+pk_client_state_signal (PkClientState *state,
+			const gchar *signal_name,
+			GVariant *parameters)
 {
-	GWeakRef *weak_ref = user_data;
-	g_autoptr(PkClientState) state = g_weak_ref_get (weak_ref);
 	gchar *tmp_str[12];
 	gboolean tmp_bool;
 	gboolean ret;
@@ -1242,9 +1325,6 @@ pk_client_signal_cb (GDBusProxy *proxy,
 	guint tmp_uint2;
 	guint tmp_uint3;
 
-	if (!state)
-		return;
-
 	if (g_strcmp0 (signal_name, "Finished") == 0) {
 		g_variant_get (parameters,
 			       "(uu)",
@@ -1586,17 +1666,50 @@ pk_client_signal_cb (GDBusProxy *proxy,
 		return;
 }
 
+/*
+ * pk_client_signal_cb:
+ **/
+static void
+pk_client_signal_cb (GDBusConnection *connection,
+		     const gchar *sender_name,
+		     const gchar *object_path,
+		     const gchar *interface_name,
+		     const gchar *signal_name,
+		     GVariant *parameters,
+		     gpointer user_data)
+{
+	GWeakRef *weak_ref = user_data;
+	g_autoptr(PkClientState) state = g_weak_ref_get (weak_ref);
+
+	if (!state)
+		return;
+	pk_client_state_signal (state, signal_name, parameters);
+}
+
+/*
+ * pk_client_name_owner_changed_cb:
+ **/
 static void
-pk_client_notify_name_owner_cb (GObject *obj,
-				GParamSpec *pspec,
-				gpointer user_data)
+pk_client_name_owner_changed_cb (GDBusConnection *connection,
+				 const gchar *sender_name,
+				 const gchar *object_path,
+				 const gchar *interface_name,
+				 const gchar *signal_name,
+				 GVariant *parameters,
+				 gpointer user_data)
 {
 	GWeakRef *weak_ref = user_data;
 	g_autoptr(PkClientState) state = g_weak_ref_get (weak_ref);
+	const gchar *new_owner = NULL;
 
 	if (!state)
 		return;
 
+	/* only interested in the daemon going away */
+	g_variant_get (parameters, "(&s&s&s)", NULL, NULL, &new_owner);
+	if (new_owner[0] != '\0')
+		return;
+
 	if (state->waiting_for_finished) {
 		g_autoptr(GError) local_error = NULL;
 
@@ -1604,41 +1717,31 @@ pk_client_notify_name_owner_cb (GObject *obj,
 						   "PackageKit daemon disappeared");
 		pk_client_state_finish (state, local_error);
 	} else {
-		pk_client_state_unset_proxy (state);
 		g_cancellable_cancel (state->cancellable);
 	}
 }
 
 /*
- * pk_client_proxy_connect:
+ * pk_client_state_get_properties:
+ *
+ * Only needed for transactions we did not create ourselves.
  **/
 static void
-pk_client_proxy_connect (PkClientState *state)
+pk_client_state_get_properties (PkClientState *state,
+				GAsyncReadyCallback callback)
 {
-	guint i;
-	g_auto(GStrv) props = NULL;
-
-	/* coldplug properties */
-	props = g_dbus_proxy_get_cached_property_names (state->proxy);
-	for (i = 0; props != NULL && props[i] != NULL; i++) {
-		g_autoptr(GVariant) value_tmp = NULL;
-		value_tmp = g_dbus_proxy_get_cached_property (state->proxy,
-							      props[i]);
-		pk_client_set_property_value (state,
-					      props[i],
-					      value_tmp);
-	}
-
-	/* connect up signals */
-	g_signal_connect_data (state->proxy, "g-properties-changed",
-			       G_CALLBACK (pk_client_properties_changed_cb),
-			       pk_client_weak_ref_new (state), pk_client_weak_ref_free_gclosure, 0);
-	g_signal_connect_data (state->proxy, "g-signal",
-			       G_CALLBACK (pk_client_signal_cb),
-			       pk_client_weak_ref_new (state), pk_client_weak_ref_free_gclosure, 0);
-	g_signal_connect_data (state->proxy, "notify::g-name-owner",
-			       G_CALLBACK (pk_client_notify_name_owner_cb),
-			       pk_client_weak_ref_new (state), pk_client_weak_ref_free_gclosure, 0);
+	g_dbus_connection_call (state->client->priv->connection,
+				PK_DBUS_SERVICE,
+				state->tid,
+				"org.freedesktop.DBus.Properties",
+				"GetAll",
+				g_variant_new ("(s)", PK_DBUS_INTERFACE_TRANSACTION),
+				G_VARIANT_TYPE ("(a{sv})"),
+				G_DBUS_CALL_FLAGS_NONE,
+				PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				state->cancellable,
+				callback,
+				g_object_ref (state));
 }
 
 /*
@@ -1649,13 +1752,13 @@ pk_client_method_cb (GObject *source_object,
 		     GAsyncResult *res,
 		     gpointer user_data)
 {
-	GDBusProxy *proxy = G_DBUS_PROXY (source_object);
-	PkClientState *state = (PkClientState *) user_data;
+	GDBusConnection *connection = G_DBUS_CONNECTION (source_object);
+	g_autoptr(PkClientState) state = (PkClientState *) user_data;
 	g_autoptr(GError) error = NULL;
 	g_autoptr(GVariant) value = NULL;
 
 	/* get the result */
-	value = g_dbus_proxy_call_finish (proxy, res, &error);
+	value = g_dbus_connection_call_finish (connection, res, &error);
 	if (value == NULL) {
 		/* fix up the D-Bus error */
 		pk_client_fixup_dbus_error (error);
@@ -1686,27 +1789,45 @@ pk_client_set_role (PkClientState *state, PkRoleEnum role)
 }
 
 /*
- * pk_client_set_hints_cb:
+ * pk_client_role_is_read_only:
+ *
+ * Return value: %TRUE if the daemon only queries the backend for @role
  **/
-static void
-pk_client_set_hints_cb (GObject *source_object,
-			GAsyncResult *res,
-			gpointer user_data)
+static gboolean
+pk_client_role_is_read_only (PkRoleEnum role)
 {
-	GDBusProxy *proxy = G_DBUS_PROXY (source_object);
-	PkClientState *state = (PkClientState *) user_data;
-	g_autoptr(GError) error = NULL;
-	g_autoptr(GVariant) value = NULL;
-
-	/* get the result */
-	value = g_dbus_proxy_call_finish (proxy, res, &error);
-	if (value == NULL) {
-		/* fix up the D-Bus error */
-		pk_client_fixup_dbus_error (error);
-		pk_client_state_finish (state, error);
-		return;
+	switch (role) {
+	case PK_ROLE_ENUM_DEPENDS_ON:
+	case PK_ROLE_ENUM_GET_CATEGORIES:
+	case PK_ROLE_ENUM_GET_DETAILS:
+	case PK_ROLE_ENUM_GET_DETAILS_LOCAL:
+	case PK_ROLE_ENUM_GET_DISTRO_UPGRADES:
+	case PK_ROLE_ENUM_GET_FILES:
+	case PK_ROLE_ENUM_GET_FILES_LOCAL:
+	case PK_ROLE_ENUM_GET_OLD_TRANSACTIONS:
+	case PK_ROLE_ENUM_GET_PACKAGES:
+	case PK_ROLE_ENUM_GET_REPO_LIST:
+	case PK_ROLE_ENUM_GET_UPDATE_DETAIL:
+	case PK_ROLE_ENUM_GET_UPDATES:
+	case PK_ROLE_ENUM_REQUIRED_BY:
+	case PK_ROLE_ENUM_RESOLVE:
+	case PK_ROLE_ENUM_SEARCH_DETAILS:
+	case PK_ROLE_ENUM_SEARCH_FILE:
+	case PK_ROLE_ENUM_SEARCH_GROUP:
+	case PK_ROLE_ENUM_SEARCH_NAME:
+	case PK_ROLE_ENUM_WHAT_PROVIDES:
+		return TRUE;
+	default:
+		return FALSE;
 	}
+}
 
+/*
+ * pk_client_state_call_method:
+ **/
+static void
+pk_client_state_call_method (PkClientState *state)
+{
 	/* we'll have results from now on */
 	state->results = pk_results_new ();
 	g_object_set (state->results,
@@ -1717,362 +1838,279 @@ pk_client_set_hints_cb (GObject *source_object,
 
 	/* do this async, although this should be pretty fast anyway */
 	if (state->role == PK_ROLE_ENUM_RESOLVE) {
-		g_dbus_proxy_call (state->proxy, "Resolve",
-				   g_variant_new ("(t^a&s)",
-						  state->filters,
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "Resolve",
+				      g_variant_new ("(t^a&s)",
+						     state->filters,
+						     state->package_ids),
+				      pk_client_method_cb);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_SEARCH_NAME) {
-		g_dbus_proxy_call (state->proxy, "SearchNames",
-				   g_variant_new ("(t^a&s)",
-						  state->filters,
-						  state->search),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "SearchNames",
+				      g_variant_new ("(t^a&s)",
+						     state->filters,
+						     state->search),
+				      pk_client_method_cb);
 	} else if (state->role == PK_ROLE_ENUM_SEARCH_DETAILS) {
-		g_dbus_proxy_call (state->proxy, "SearchDetails",
-				   g_variant_new ("(t^a&s)",
-						  state->filters,
-						  state->search),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "SearchDetails",
+				      g_variant_new ("(t^a&s)",
+						     state->filters,
+						     state->search),
+				      pk_client_method_cb);
 	} else if (state->role == PK_ROLE_ENUM_SEARCH_GROUP) {
-		g_dbus_proxy_call (state->proxy, "SearchGroups",
-				   g_variant_new ("(t^a&s)",
-						  state->filters,
-						  state->search),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "SearchGroups",
+				      g_variant_new ("(t^a&s)",
+						     state->filters,
+						     state->search),
+				      pk_client_method_cb);
 	} else if (state->role == PK_ROLE_ENUM_SEARCH_FILE) {
-		g_dbus_proxy_call (state->proxy, "SearchFiles",
-				   g_variant_new ("(t^a&s)",
-						  state->filters,
-						  state->search),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "SearchFiles",
+				      g_variant_new ("(t^a&s)",
+						     state->filters,
+						     state->search),
+				      pk_client_method_cb);
 	} else if (state->role == PK_ROLE_ENUM_GET_DETAILS) {
-		g_dbus_proxy_call (state->proxy, "GetDetails",
-				   g_variant_new ("(^a&s)",
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "GetDetails",
+				      g_variant_new ("(^a&s)",
+						     state->package_ids),
+				      pk_client_method_cb);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_GET_DETAILS_LOCAL) {
-		g_dbus_proxy_call (state->proxy, "GetDetailsLocal",
-				   g_variant_new ("(^a&s)",
-						  state->files),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "GetDetailsLocal",
+				      g_variant_new ("(^a&s)",
+						     state->files),
+				      pk_client_method_cb);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->files),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_GET_FILES_LOCAL) {
-		g_dbus_proxy_call (state->proxy, "GetFilesLocal",
-				   g_variant_new ("(^a&s)",
-						  state->files),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "GetFilesLocal",
+				      g_variant_new ("(^a&s)",
+						     state->files),
+				      pk_client_method_cb);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->files),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_GET_UPDATE_DETAIL) {
-		g_dbus_proxy_call (state->proxy, "GetUpdateDetail",
-				   g_variant_new ("(^a&s)",
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "GetUpdateDetail",
+				      g_variant_new ("(^a&s)",
+						     state->package_ids),
+				      pk_client_method_cb);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_GET_OLD_TRANSACTIONS) {
-		g_dbus_proxy_call (state->proxy, "GetOldTransactions",
-				   g_variant_new ("(u)",
-						  state->number),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "GetOldTransactions",
+				      g_variant_new ("(u)",
+						     state->number),
+				      pk_client_method_cb);
 	} else if (state->role == PK_ROLE_ENUM_DOWNLOAD_PACKAGES) {
-		g_dbus_proxy_call (state->proxy, "DownloadPackages",
-				   g_variant_new ("(b^a&s)",
-						  (state->directory == NULL),
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "DownloadPackages",
+				      g_variant_new ("(b^a&s)",
+						     (state->directory == NULL),
+						     state->package_ids),
+				      pk_client_method_cb);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_GET_UPDATES) {
-		g_dbus_proxy_call (state->proxy, "GetUpdates",
-				   g_variant_new ("(t)",
-						  state->filters),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "GetUpdates",
+				      g_variant_new ("(t)",
+						     state->filters),
+				      pk_client_method_cb);
 	} else if (state->role == PK_ROLE_ENUM_DEPENDS_ON) {
-		g_dbus_proxy_call (state->proxy, "DependsOn",
-				   g_variant_new ("(t^a&sb)",
-						  state->filters,
-						  state->package_ids,
-						  state->recursive),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "DependsOn",
+				      g_variant_new ("(t^a&sb)",
+						     state->filters,
+						     state->package_ids,
+						     state->recursive),
+				      pk_client_method_cb);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 
 	} else if (state->role == PK_ROLE_ENUM_REQUIRED_BY) {
-		g_dbus_proxy_call (state->proxy, "RequiredBy",
-				   g_variant_new ("(t^a&sb)",
-						  state->filters,
-						  state->package_ids,
-						  state->recursive),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "RequiredBy",
+				      g_variant_new ("(t^a&sb)",
+						     state->filters,
+						     state->package_ids,
+						     state->recursive),
+				      pk_client_method_cb);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_GET_PACKAGES) {
-		g_dbus_proxy_call (state->proxy, "GetPackages",
-				   g_variant_new ("(t)",
-						  state->filters),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "GetPackages",
+				      g_variant_new ("(t)",
+						     state->filters),
+				      pk_client_method_cb);
 	} else if (state->role == PK_ROLE_ENUM_WHAT_PROVIDES) {
-		g_dbus_proxy_call (state->proxy, "WhatProvides",
-				   g_variant_new ("(t^a&s)",
-						  state->filters,
-						  state->search),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "WhatProvides",
+				      g_variant_new ("(t^a&s)",
+						     state->filters,
+						     state->search),
+				      pk_client_method_cb);
 	} else if (state->role == PK_ROLE_ENUM_GET_DISTRO_UPGRADES) {
-		g_dbus_proxy_call (state->proxy, "GetDistroUpgrades",
-				   NULL,
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "GetDistroUpgrades",
+				      NULL,
+				      pk_client_method_cb);
 	} else if (state->role == PK_ROLE_ENUM_GET_FILES) {
-		g_dbus_proxy_call (state->proxy, "GetFiles",
-				   g_variant_new ("(^a&s)",
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "GetFiles",
+				      g_variant_new ("(^a&s)",
+						     state->package_ids),
+				      pk_client_method_cb);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_GET_CATEGORIES) {
-		g_dbus_proxy_call (state->proxy, "GetCategories",
-				   NULL,
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "GetCategories",
+				      NULL,
+				      pk_client_method_cb);
 	} else if (state->role == PK_ROLE_ENUM_REMOVE_PACKAGES) {
-		g_dbus_proxy_call (state->proxy, "RemovePackages",
-				   g_variant_new ("(t^a&sbb)",
-						  state->transaction_flags,
-						  state->package_ids,
-						  state->allow_deps,
-						  state->autoremove),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "RemovePackages",
+				      g_variant_new ("(t^a&sbb)",
+						     state->transaction_flags,
+						     state->package_ids,
+						     state->allow_deps,
+						     state->autoremove),
+				      pk_client_method_cb);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_REFRESH_CACHE) {
-		g_dbus_proxy_call (state->proxy, "RefreshCache",
-				   g_variant_new ("(b)",
-						  state->force),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "RefreshCache",
+				      g_variant_new ("(b)",
+						     state->force),
+				      pk_client_method_cb);
 	} else if (state->role == PK_ROLE_ENUM_INSTALL_PACKAGES) {
-		g_dbus_proxy_call (state->proxy, "InstallPackages",
-				   g_variant_new ("(t^a&s)",
-						  state->transaction_flags,
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "InstallPackages",
+				      g_variant_new ("(t^a&s)",
+						     state->transaction_flags,
+						     state->package_ids),
+				      pk_client_method_cb);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_INSTALL_SIGNATURE) {
-		g_dbus_proxy_call (state->proxy, "InstallSignature",
-				   g_variant_new ("(uss)",
-						  state->type,
-						  state->key_id,
-						  state->package_id),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "InstallSignature",
+				      g_variant_new ("(uss)",
+						     state->type,
+						     state->key_id,
+						     state->package_id),
+				      pk_client_method_cb);
 	} else if (state->role == PK_ROLE_ENUM_UPDATE_PACKAGES) {
-		g_dbus_proxy_call (state->proxy, "UpdatePackages",
-				   g_variant_new ("(t^a&s)",
-						  state->transaction_flags,
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "UpdatePackages",
+				      g_variant_new ("(t^a&s)",
+						     state->transaction_flags,
+						     state->package_ids),
+				      pk_client_method_cb);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_INSTALL_FILES) {
-		g_dbus_proxy_call (state->proxy, "InstallFiles",
-				   g_variant_new ("(t^a&s)",
-						  state->transaction_flags,
-						  state->files),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "InstallFiles",
+				      g_variant_new ("(t^a&s)",
+						     state->transaction_flags,
+						     state->files),
+				      pk_client_method_cb);
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->files),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_ACCEPT_EULA) {
-		g_dbus_proxy_call (state->proxy, "AcceptEula",
-				   g_variant_new ("(s)",
-						  state->eula_id),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "AcceptEula",
+				      g_variant_new ("(s)",
+						     state->eula_id),
+				      pk_client_method_cb);
 	} else if (state->role == PK_ROLE_ENUM_GET_REPO_LIST) {
-		g_dbus_proxy_call (state->proxy, "GetRepoList",
-				   g_variant_new ("(t)",
-						  state->filters),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "GetRepoList",
+				      g_variant_new ("(t)",
+						     state->filters),
+				      pk_client_method_cb);
 	} else if (state->role == PK_ROLE_ENUM_REPO_ENABLE) {
-		g_dbus_proxy_call (state->proxy, "RepoEnable",
-				   g_variant_new ("(sb)",
-						  state->repo_id,
-						  state->enabled),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "RepoEnable",
+				      g_variant_new ("(sb)",
+						     state->repo_id,
+						     state->enabled),
+				      pk_client_method_cb);
 	} else if (state->role == PK_ROLE_ENUM_REPO_SET_DATA) {
-		g_dbus_proxy_call (state->proxy, "RepoSetData",
-				   g_variant_new ("(sss)",
-						  state->repo_id,
-						  state->parameter ? state->parameter : "",
-						  state->value ? state->value : ""),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "RepoSetData",
+				      g_variant_new ("(sss)",
+						     state->repo_id,
+						     state->parameter ? state->parameter : "",
+						     state->value ? state->value : ""),
+				      pk_client_method_cb);
 	} else if (state->role == PK_ROLE_ENUM_REPO_REMOVE) {
-		g_dbus_proxy_call (state->proxy, "RepoRemove",
-				   g_variant_new ("(tsb)",
-						  state->transaction_flags,
-						  state->repo_id,
-						  state->autoremove),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "RepoRemove",
+				      g_variant_new ("(tsb)",
+						     state->transaction_flags,
+						     state->repo_id,
+						     state->autoremove),
+				      pk_client_method_cb);
 	} else if (state->role == PK_ROLE_ENUM_UPGRADE_SYSTEM) {
-		g_dbus_proxy_call (state->proxy, "UpgradeSystem",
-				   g_variant_new ("(tsu)",
-						  state->transaction_flags,
-						  state->distro_id,
-						  state->upgrade_kind),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "UpgradeSystem",
+				      g_variant_new ("(tsu)",
+						     state->transaction_flags,
+						     state->distro_id,
+						     state->upgrade_kind),
+				      pk_client_method_cb);
 	} else if (state->role == PK_ROLE_ENUM_REPAIR_SYSTEM) {
-		g_dbus_proxy_call (state->proxy, "RepairSystem",
-				   g_variant_new ("(t)",
-						  state->transaction_flags),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "RepairSystem",
+				      g_variant_new ("(t)",
+						     state->transaction_flags),
+				      pk_client_method_cb);
 	} else {
 		g_assert_not_reached ();
 	}
 }
 
+/*
+ * pk_client_set_hints_cb:
+ **/
+static void
+pk_client_set_hints_cb (GObject *source_object,
+			GAsyncResult *res,
+			gpointer user_data)
+{
+	GDBusConnection *connection = G_DBUS_CONNECTION (source_object);
+	g_autoptr(PkClientState) state = (PkClientState *) user_data;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GVariant) value = NULL;
+
+	/* get the result */
+	value = g_dbus_connection_call_finish (connection, res, &error);
+	if (value == NULL) {
+		/* the method call may already have been sent, so make sure
+		 * the daemon does not go on with a transaction nobody watches */
+		if (pk_client_role_is_read_only (state->role) &&
+		    !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			g_debug ("failed to set hints, cancelling %s", state->tid);
+			g_dbus_connection_call (connection,
+						PK_DBUS_SERVICE,
+						state->tid,
+						PK_DBUS_INTERFACE_TRANSACTION,
+						"Cancel",
+						NULL,
+						NULL,
+						G_DBUS_CALL_FLAGS_NONE,
+						PK_CLIENT_DBUS_METHOD_TIMEOUT,
+						NULL, NULL, NULL);
+		}
+
+		/* fix up the D-Bus error */
+		pk_client_fixup_dbus_error (error);
+		pk_client_state_finish (state, error);
+		return;
+	}
+
+	/* anything that changes the system waits for the hints, e.g. so
+	 * that it can't run without the frontend socket it needs */
+	if (!pk_client_role_is_read_only (state->role))
+		pk_client_state_call_method (state);
+}
+
 /*
  * pk_client_bool_to_string:
  **/
@@ -2226,24 +2264,44 @@ pk_client_create_helper_socket (PkClientState *state)
 }
 
 /*
- * pk_client_get_proxy_cb:
+ * pk_client_get_bus_finish:
+ *
+ * All the transactions of a client are watched on the one connection.
+ **/
+static gboolean
+pk_client_get_bus_finish (PkClient *client, GAsyncResult *res, GError **error)
+{
+	g_autoptr(GDBusConnection) connection = NULL;
+
+	connection = g_bus_get_finish (res, error);
+	if (connection == NULL)
+		return FALSE;
+	if (client->priv->connection == NULL)
+		client->priv->connection = g_object_ref (connection);
+	return TRUE;
+}
+
+/*
+ * pk_client_state_start:
  **/
 static void
-pk_client_get_proxy_cb (GObject *object,
-			GAsyncResult *res,
-			gpointer user_data)
+pk_client_state_start (PkClientState *state)
 {
 	gchar *hint;
-	PkClientState *state = (PkClientState *) user_data;
-	g_autoptr(GError) error = NULL;
 	g_autoptr(GPtrArray) array = NULL;
+	g_autoptr(GVariant) uid = NULL;
+	g_autoptr(GVariant) sender = NULL;
 
-	state->proxy = g_dbus_proxy_new_for_bus_finish (res, &error);
-	if (state->proxy == NULL)
-		g_error ("Cannot connect to PackageKit on %s", state->tid);
+	/* track state, which also subscribes to the transaction signals */
+	pk_client_state_add (state->client, state);
 
-	/* connect */
-	pk_client_proxy_connect (state);
+	/* we created the transaction on this connection, so there is nothing
+	 * to coldplug apart from the properties the daemon never changes; the
+	 * uid is the one the bus reports for us, which is the effective one */
+	uid = g_variant_ref_sink (g_variant_new_uint32 (geteuid ()));
+	pk_client_set_property_value (state, "Uid", uid);
+	sender = g_variant_ref_sink (g_variant_new_string (g_dbus_connection_get_unique_name (state->client->priv->connection)));
+	pk_client_set_property_value (state, "Sender", sender);
 
 	/* get hints */
 	array = g_ptr_array_new_with_free_func (g_free);
@@ -2284,19 +2342,34 @@ pk_client_get_proxy_cb (GObject *object,
 			g_ptr_array_add (array, hint);
 	}
 
-	/* set hints */
+	/* set hints; queries send the method straight after without waiting
+	 * for the reply, as the daemon handles the messages of one connection
+	 * in order and so always sees the hints first */
 	g_ptr_array_add (array, NULL);
-	g_dbus_proxy_call (state->proxy, "SetHints",
-			   g_variant_new ("(^a&s)",
-					  array->pdata),
-			   G_DBUS_CALL_FLAGS_NONE,
-			   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-			   state->cancellable,
-			   pk_client_set_hints_cb,
-			   state);
-
-	/* track state */
-	g_ptr_array_add (state->client->priv->calls, state);
+	pk_client_state_call (state, "SetHints",
+			      g_variant_new ("(^a&s)",
+					     array->pdata),
+			      pk_client_set_hints_cb);
+	if (pk_client_role_is_read_only (state->role))
+		pk_client_state_call_method (state);
+}
+
+/*
+ * pk_client_get_bus_cb:
+ **/
+static void
+pk_client_get_bus_cb (GObject *object,
+		      GAsyncResult *res,
+		      gpointer user_data)
+{
+	PkClientState *state = (PkClientState *) user_data;
+	g_autoptr(GError) error = NULL;
+
+	if (!pk_client_get_bus_finish (state->client, res, &error)) {
+		pk_client_state_finish (state, error);
+		return;
+	}
+	pk_client_state_start (state);
 }
 
 /*
@@ -2316,16 +2389,15 @@ pk_client_get_tid_cb (GObject *object, GAsyncResult *res, PkClientState *state)
 
 	pk_progress_set_transaction_id (state->progress, state->tid);
 
-	/* get a connection to the transaction interface */
-	g_dbus_proxy_new_for_bus (G_BUS_TYPE_SYSTEM,
-				  G_DBUS_PROXY_FLAGS_NONE,
-				  NULL,
-				  PK_DBUS_SERVICE,
-				  state->tid,
-				  PK_DBUS_INTERFACE_TRANSACTION,
-				  state->cancellable,
-				  pk_client_get_proxy_cb,
-				  state);
+	/* skip straight to the D-Bus methods if already connected */
+	if (state->client->priv->connection != NULL) {
+		pk_client_state_start (state);
+		return;
+	}
+	g_bus_get (G_BUS_TYPE_SYSTEM,
+		   state->cancellable,
+		   pk_client_get_bus_cb,
+		   state);
 }
 
 /**
@@ -4182,24 +4254,50 @@ pk_client_repair_system_async (PkClient *client,
 /**********************************************************************/
 
 /*
- * pk_client_adopt_get_proxy_cb:
+ * pk_client_adopt_get_properties_cb:
  **/
 static void
-pk_client_adopt_get_proxy_cb (GObject *object,
-			      GAsyncResult *res,
-			      gpointer user_data)
+pk_client_adopt_get_properties_cb (GObject *source_object,
+				   GAsyncResult *res,
+				   gpointer user_data)
+{
+	GDBusConnection *connection = G_DBUS_CONNECTION (source_object);
+	g_autoptr(PkClientState) state = (PkClientState *) user_data;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GVariant) value = NULL;
+	g_autoptr(GVariant) properties = NULL;
+
+	value = g_dbus_connection_call_finish (connection, res, &error);
+	if (value == NULL) {
+		pk_client_fixup_dbus_error (error);
+		pk_client_state_finish (state, error);
+		return;
+	}
+
+	/* coldplug properties */
+	properties = g_variant_get_child_value (value, 0);
+	pk_client_state_set_properties (state, properties);
+}
+
+/*
+ * pk_client_adopt_get_bus_cb:
+ **/
+static void
+pk_client_adopt_get_bus_cb (GObject *object,
+			    GAsyncResult *res,
+			    gpointer user_data)
 {
 	g_autoptr(GError) error = NULL;
 	PkClientState *state = (PkClientState *) user_data;
 
-	state->proxy = g_dbus_proxy_new_for_bus_finish (res, &error);
-	if (state->proxy == NULL) {
+	if (!pk_client_get_bus_finish (state->client, res, &error)) {
 		pk_client_state_finish (state, error);
 		return;
 	}
 
-	/* connect */
-	pk_client_proxy_connect (state);
+	/* track state, then get the properties we may have missed */
+	pk_client_state_add (state->client, state);
+	pk_client_state_get_properties (state, pk_client_adopt_get_properties_cb);
 }
 
 /**
@@ -4255,19 +4353,16 @@ pk_client_adopt_async (PkClient *client,
 	pk_client_set_role (state, state->role);
 	pk_progress_set_transaction_id (state->progress, state->tid);
 
-	/* get a connection to the transaction interface */
-	g_dbus_proxy_new_for_bus (G_BUS_TYPE_SYSTEM,
-				  G_DBUS_PROXY_FLAGS_NONE,
-				  NULL,
-				  PK_DBUS_SERVICE,
-				  state->tid,
-				  PK_DBUS_INTERFACE_TRANSACTION,
-				  state->cancellable,
-				  pk_client_adopt_get_proxy_cb,
-				  state);
-
-	/* track state */
-	pk_client_state_add (client, state);
+	/* skip straight to the D-Bus method if already connected */
+	if (client->priv->connection != NULL) {
+		pk_client_state_add (client, state);
+		pk_client_state_get_properties (state, pk_client_adopt_get_properties_cb);
+		return;
+	}
+	g_bus_get (G_BUS_TYPE_SYSTEM,
+		   state->cancellable,
+		   pk_client_adopt_get_bus_cb,
+		   state);
 }
 
 /**********************************************************************/
@@ -4313,8 +4408,6 @@ pk_client_get_progress_state_finish (PkClientState *state, const GError *error)
 	g_clear_object (&state->cancellable);
 	g_clear_object (&state->cancellable_client);
 
-	pk_client_state_unset_proxy (state);
-
 	if (state->proxy_props != NULL)
 		g_object_unref (G_OBJECT (state->proxy_props));
 
@@ -4344,22 +4437,46 @@ pk_client_get_progress_cb (GObject *source_object,
 			   GAsyncResult *res,
 			   gpointer user_data)
 {
+	GDBusConnection *connection = G_DBUS_CONNECTION (source_object);
+	g_autoptr(PkClientState) state = (PkClientState *) user_data;
 	g_autoptr(GError) error = NULL;
-	PkClientState *state = (PkClientState *) user_data;
+	g_autoptr(GVariant) value = NULL;
+	g_autoptr(GVariant) properties = NULL;
 
-	state->proxy = g_dbus_proxy_new_for_bus_finish (res, &error);
-	if (state->proxy == NULL) {
+	value = g_dbus_connection_call_finish (connection, res, &error);
+	if (value == NULL) {
+		pk_client_fixup_dbus_error (error);
 		pk_client_get_progress_state_finish (state, error);
 		return;
 	}
 
-	/* connect */
-	pk_client_proxy_connect (state);
+	/* coldplug properties */
+	properties = g_variant_get_child_value (value, 0);
+	pk_client_state_set_properties (state, properties);
 
 	state->ret = TRUE;
 	pk_client_get_progress_state_finish (state, NULL);
 }
 
+/*
+ * pk_client_get_progress_get_bus_cb:
+ **/
+static void
+pk_client_get_progress_get_bus_cb (GObject *object,
+				   GAsyncResult *res,
+				   gpointer user_data)
+{
+	g_autoptr(GError) error = NULL;
+	PkClientState *state = (PkClientState *) user_data;
+
+	if (!pk_client_get_bus_finish (state->client, res, &error)) {
+		pk_client_get_progress_state_finish (state, error);
+		return;
+	}
+	pk_client_state_add (state->client, state);
+	pk_client_state_get_properties (state, pk_client_get_progress_cb);
+}
+
 /**
  * pk_client_get_progress_async:
  * @client: a valid #PkClient instance
@@ -4401,19 +4518,16 @@ pk_client_get_progress_async (PkClient *client,
 	/* identify */
 	pk_progress_set_transaction_id (state->progress, state->tid);
 
-	/* get a connection to the transaction interface */
-	g_dbus_proxy_new_for_bus (G_BUS_TYPE_SYSTEM,
-				  G_DBUS_PROXY_FLAGS_NONE,
-				  NULL,
-				  PK_DBUS_SERVICE,
-				  state->tid,
-				  PK_DBUS_INTERFACE_TRANSACTION,
-				  state->cancellable,
-				  pk_client_get_progress_cb,
-				  state);
-
-	/* track state */
-	pk_client_state_add (client, state);
+	/* skip straight to the D-Bus method if already connected */
+	if (client->priv->connection != NULL) {
+		pk_client_state_add (client, state);
+		pk_client_state_get_properties (state, pk_client_get_progress_cb);
+		return;
+	}
+	g_bus_get (G_BUS_TYPE_SYSTEM,
+		   state->cancellable,
+		   pk_client_get_progress_get_bus_cb,
+		   state);
 }
 
 /**********************************************************************/
@@ -4432,7 +4546,7 @@ pk_client_cancel_all_dbus_methods (PkClient *client)
 	array = client->priv->calls;
 	for (i = 0; i < array->len; i++) {
 		state = g_ptr_array_index (array, i);
-		if (state->proxy == NULL)
+		if (state->tid == NULL)
 			continue;
 		g_debug ("cancel in flight call");
 		g_cancellable_cancel (state->cancellable);
@@ -4712,6 +4826,7 @@ pk_client_finalize (GObject *object)
 	/* ensure we cancel any in-flight DBus calls */
 	pk_client_cancel_all_dbus_methods (client);
 
+	g_clear_object (&priv->connection);
 	g_free (client->priv->locale);
 	g_object_unref (priv->control);
 	g_ptr_array_unref (priv->calls);
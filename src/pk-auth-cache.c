@@ -0,0 +1,283 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 PackageKit contributors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * The auth cache remembers positive polkit decisions for a short time so
+ * that a client sending many small privileged transactions does not cause
+ * a CheckAuthorization round trip for each one of them.
+ *
+ * Decisions are keyed by uid, session, action and transaction flags, and
+ * are only kept for AuthCacheTimeout seconds. Everything is forgotten when
+ * polkit reports that its actions or rules have changed. The cache is
+ * disabled by default.
+ **/
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "pk-auth-cache.h"
+
+static void     pk_auth_cache_finalize	(GObject        *object);
+
+#define PK_AUTH_CACHE_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_AUTH_CACHE, PkAuthCachePrivate))
+
+/* the number of different decisions we remember */
+#define PK_AUTH_CACHE_MAX_ITEMS		256
+
+struct PkAuthCachePrivate
+{
+	GHashTable		*items;
+	guint			 timeout;
+	PolkitAuthority		*authority;
+	guint			 authority_changed_id;
+};
+
+G_DEFINE_TYPE (PkAuthCache, pk_auth_cache, G_TYPE_OBJECT)
+
+static gchar *
+pk_auth_cache_get_key (guint uid,
+		       const gchar *session,
+		       const gchar *action_id,
+		       PkBitfield transaction_flags)
+{
+	g_autofree gchar *flags = pk_transaction_flag_bitfield_to_string (transaction_flags);
+	return g_strdup_printf ("%u;%s;%s;%s", uid, session, action_id, flags);
+}
+
+gboolean
+pk_auth_cache_get_enabled (PkAuthCache *cache)
+{
+	g_return_val_if_fail (PK_IS_AUTH_CACHE (cache), FALSE);
+	return cache->priv->timeout > 0;
+}
+
+static void
+pk_auth_cache_authority_changed_cb (PolkitAuthority *authority, PkAuthCache *cache)
+{
+	g_debug ("polkit configuration changed, forgetting %u decisions",
+		 g_hash_table_size (cache->priv->items));
+	pk_auth_cache_invalidate (cache);
+}
+
+/**
+ * pk_auth_cache_watch_authority:
+ * @authority: the polkit authority the decisions come from
+ *
+ * Forgets all decisions when the actions or rules of @authority change.
+ * This is done lazily so the daemon does not connect to polkit at startup.
+ **/
+void
+pk_auth_cache_watch_authority (PkAuthCache *cache, PolkitAuthority *authority)
+{
+	g_return_if_fail (PK_IS_AUTH_CACHE (cache));
+	g_return_if_fail (POLKIT_IS_AUTHORITY (authority));
+
+	if (cache->priv->authority == authority)
+		return;
+	if (cache->priv->authority != NULL) {
+		g_signal_handler_disconnect (cache->priv->authority,
+					     cache->priv->authority_changed_id);
+		g_object_unref (cache->priv->authority);
+	}
+	pk_auth_cache_invalidate (cache);
+	cache->priv->authority = g_object_ref (authority);
+	cache->priv->authority_changed_id =
+		g_signal_connect (authority, "changed",
+				  G_CALLBACK (pk_auth_cache_authority_changed_cb), cache);
+}
+
+/**
+ * pk_auth_cache_lookup:
+ * @uid: the uid of the caller
+ * @session: the session of the caller
+ * @action_id: the polkit action
+ * @transaction_flags: the flags of the transaction
+ *
+ * Returns: %TRUE if the action was recently authorized for the caller
+ **/
+gboolean
+pk_auth_cache_lookup (PkAuthCache *cache,
+		      guint uid,
+		      const gchar *session,
+		      const gchar *action_id,
+		      PkBitfield transaction_flags)
+{
+	gint64 *expires;
+	g_autofree gchar *key = NULL;
+
+	g_return_val_if_fail (PK_IS_AUTH_CACHE (cache), FALSE);
+	g_return_val_if_fail (session != NULL, FALSE);
+	g_return_val_if_fail (action_id != NULL, FALSE);
+
+	if (cache->priv->timeout == 0)
+		return FALSE;
+
+	key = pk_auth_cache_get_key (uid, session, action_id, transaction_flags);
+	expires = g_hash_table_lookup (cache->priv->items, key);
+	if (expires == NULL)
+		return FALSE;
+	if (*expires <= g_get_monotonic_time ()) {
+		g_hash_table_remove (cache->priv->items, key);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static gboolean
+pk_auth_cache_item_expired_cb (gpointer key, gpointer value, gpointer user_data)
+{
+	gint64 *expires = value;
+	gint64 *now = user_data;
+	return *expires <= *now;
+}
+
+/**
+ * pk_auth_cache_result_is_reusable:
+ * @result: the polkit decision
+ * @flags: the flags the authorization was checked with
+ *
+ * A check that allowed user interaction may have shown an authentication
+ * dialog, and the user would not expect the password they just typed to
+ * be remembered, so only decisions polkit made on its own are reused.
+ *
+ * Returns: %TRUE if the decision can be added to the cache
+ **/
+gboolean
+pk_auth_cache_result_is_reusable (PolkitAuthorizationResult *result,
+				  PolkitCheckAuthorizationFlags flags)
+{
+	g_return_val_if_fail (POLKIT_IS_AUTHORIZATION_RESULT (result), FALSE);
+
+	if (flags & POLKIT_CHECK_AUTHORIZATION_FLAGS_ALLOW_USER_INTERACTION)
+		return FALSE;
+	if (!polkit_authorization_result_get_is_authorized (result))
+		return FALSE;
+	if (polkit_authorization_result_get_is_challenge (result))
+		return FALSE;
+	return polkit_authorization_result_get_temporary_authorization_id (result) == NULL;
+}
+
+/**
+ * pk_auth_cache_add:
+ * @uid: the uid of the caller
+ * @session: the session of the caller
+ * @action_id: the polkit action
+ * @transaction_flags: the flags of the transaction
+ *
+ * Remembers that polkit authorized the action for the caller.
+ **/
+void
+pk_auth_cache_add (PkAuthCache *cache,
+		   guint uid,
+		   const gchar *session,
+		   const gchar *action_id,
+		   PkBitfield transaction_flags)
+{
+	gint64 *expires;
+	gint64 now;
+
+	g_return_if_fail (PK_IS_AUTH_CACHE (cache));
+	g_return_if_fail (session != NULL);
+	g_return_if_fail (action_id != NULL);
+
+	if (cache->priv->timeout == 0)
+		return;
+
+	/* drop the expired decisions first, then everything */
+	now = g_get_monotonic_time ();
+	if (g_hash_table_size (cache->priv->items) >= PK_AUTH_CACHE_MAX_ITEMS) {
+		g_hash_table_foreach_remove (cache->priv->items,
+					     pk_auth_cache_item_expired_cb,
+					     &now);
+	}
+	if (g_hash_table_size (cache->priv->items) >= PK_AUTH_CACHE_MAX_ITEMS)
+		pk_auth_cache_invalidate (cache);
+
+	expires = g_new (gint64, 1);
+	*expires = now + (gint64) cache->priv->timeout * G_USEC_PER_SEC;
+	g_hash_table_replace (cache->priv->items,
+			      pk_auth_cache_get_key (uid, session, action_id, transaction_flags),
+			      expires);
+}
+
+void
+pk_auth_cache_invalidate (PkAuthCache *cache)
+{
+	g_return_if_fail (PK_IS_AUTH_CACHE (cache));
+	g_hash_table_remove_all (cache->priv->items);
+}
+
+guint
+pk_auth_cache_get_size (PkAuthCache *cache)
+{
+	g_return_val_if_fail (PK_IS_AUTH_CACHE (cache), 0);
+	return g_hash_table_size (cache->priv->items);
+}
+
+static void
+pk_auth_cache_class_init (PkAuthCacheClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = pk_auth_cache_finalize;
+	g_type_class_add_private (klass, sizeof (PkAuthCachePrivate));
+}
+
+static void
+pk_auth_cache_init (PkAuthCache *cache)
+{
+	cache->priv = PK_AUTH_CACHE_GET_PRIVATE (cache);
+	cache->priv->items = g_hash_table_new_full (g_str_hash, g_str_equal,
+						    g_free, g_free);
+}
+
+static void
+pk_auth_cache_finalize (GObject *object)
+{
+	PkAuthCache *cache;
+	g_return_if_fail (PK_IS_AUTH_CACHE (object));
+	cache = PK_AUTH_CACHE (object);
+
+	if (cache->priv->authority != NULL) {
+		g_signal_handler_disconnect (cache->priv->authority,
+					     cache->priv->authority_changed_id);
+		g_object_unref (cache->priv->authority);
+	}
+	g_hash_table_unref (cache->priv->items);
+
+	G_OBJECT_CLASS (pk_auth_cache_parent_class)->finalize (object);
+}
+
+PkAuthCache *
+pk_auth_cache_new (GKeyFile *conf)
+{
+	PkAuthCache *cache;
+	g_autoptr(GError) error = NULL;
+	gint timeout;
+
+	cache = g_object_new (PK_TYPE_AUTH_CACHE, NULL);
+
+	/* 0, the default, disables the cache */
+	timeout = g_key_file_get_integer (conf, "Daemon", "AuthCacheTimeout", &error);
+	if (error == NULL)
+		cache->priv->timeout = MAX (timeout, 0);
+	return PK_AUTH_CACHE (cache);
+}
@@ -60,6 +60,9 @@
  */
 #define PK_BACKEND_CANCEL_ACTION_TIMEOUT	2000 /* ms */
 
+/* how often a paused job checks if it was cancelled */
+#define PK_BACKEND_JOB_PAUSE_POLL_INTERVAL	250 /* ms */
+
 typedef struct {
 	gboolean		 enabled;
 	PkBackendJobVFunc	 vfunc;
@@ -83,6 +86,8 @@ struct PkBackendJobPrivate
 	gchar			*proxy_https;
 	gchar			*proxy_socks;
 	gpointer		 user_data;
+	gpointer		 solved_plan;
+	GDestroyNotify		 solved_plan_destroy;
 	guint64			 download_size_remaining;
 	guint			 cache_age;
 	guint			 download_files;
@@ -106,7 +111,12 @@ struct PkBackendJobPrivate
 	PkRoleEnum		 role;
 	PkStatusEnum		 status;
 	GTimer			*timer;
+	guint64			 emit_time;
 	gboolean		 started;
+	gboolean		 pausable;
+	gboolean		 paused;
+	GMutex			 pause_mutex;
+	GCond			 pause_cond;
 };
 
 G_DEFINE_TYPE (PkBackendJob, pk_backend_job, G_TYPE_OBJECT)
@@ -454,6 +464,64 @@ pk_backend_job_set_user_data (PkBackendJob *job, gpointer user_data)
 	job->priv->user_data = user_data;
 }
 
+/**
+ * pk_backend_job_set_solved_plan:
+ * @plan: the backend specific result of the dependency resolution
+ * @destroy: the function to free @plan, or %NULL
+ *
+ * Backends call this at the end of a successful simulation so that the
+ * daemon can hand @plan back to the job of the following real transaction
+ * with the same parameters, where it can be retrieved with
+ * pk_backend_job_get_solved_plan(). Any previous plan is freed.
+ *
+ * This function can be called on any thread.
+ **/
+void
+pk_backend_job_set_solved_plan (PkBackendJob *job, gpointer plan, GDestroyNotify destroy)
+{
+	g_return_if_fail (PK_IS_BACKEND_JOB (job));
+
+	if (job->priv->solved_plan != NULL &&
+	    job->priv->solved_plan_destroy != NULL)
+		job->priv->solved_plan_destroy (job->priv->solved_plan);
+	job->priv->solved_plan = plan;
+	job->priv->solved_plan_destroy = destroy;
+}
+
+/**
+ * pk_backend_job_get_solved_plan:
+ *
+ * Returns: (transfer none): the plan set by the simulation of this
+ * transaction, or %NULL if the dependencies have to be resolved again
+ **/
+gpointer
+pk_backend_job_get_solved_plan (PkBackendJob *job)
+{
+	g_return_val_if_fail (PK_IS_BACKEND_JOB (job), NULL);
+	return job->priv->solved_plan;
+}
+
+/**
+ * pk_backend_job_steal_solved_plan:
+ * @destroy: (out): the function to free the plan
+ *
+ * Returns: (transfer full): the plan, which the job no longer owns
+ **/
+gpointer
+pk_backend_job_steal_solved_plan (PkBackendJob *job, GDestroyNotify *destroy)
+{
+	gpointer plan;
+
+	g_return_val_if_fail (PK_IS_BACKEND_JOB (job), NULL);
+	g_return_val_if_fail (destroy != NULL, NULL);
+
+	plan = job->priv->solved_plan;
+	*destroy = job->priv->solved_plan_destroy;
+	job->priv->solved_plan = NULL;
+	job->priv->solved_plan_destroy = NULL;
+	return plan;
+}
+
 gboolean
 pk_backend_job_get_background (PkBackendJob *job)
 {
@@ -501,6 +569,19 @@ pk_backend_job_get_runtime (PkBackendJob *job)
 	return g_timer_elapsed (job->priv->timer, NULL) * 1000;
 }
 
+/**
+ * pk_backend_job_get_emit_time:
+ *
+ * Return value: the time spent on the main thread processing the signals
+ * of the backend, in us
+ */
+guint64
+pk_backend_job_get_emit_time (PkBackendJob *job)
+{
+	g_return_val_if_fail (PK_IS_BACKEND_JOB (job), 0);
+	return job->priv->emit_time;
+}
+
 gboolean
 pk_backend_job_get_is_finished (PkBackendJob *job)
 {
@@ -589,7 +670,9 @@ pk_backend_job_call_vfunc_idle_cb (gpointer user_data)
 	/* call transaction vfunc on main thread */
 	item = &helper->job->priv->vfunc_items[helper->signal_kind];
 	if (item != NULL && item->vfunc != NULL) {
+		gint64 start = g_get_monotonic_time ();
 		item->vfunc (helper->job, helper->object, item->user_data);
+		helper->job->priv->emit_time += g_get_monotonic_time () - start;
 	} else {
 		g_warning ("tried to do signal %s when no longer connected",
 			   pk_backend_job_signal_to_string (helper->signal_kind));
@@ -639,6 +722,104 @@ pk_backend_job_call_vfunc (PkBackendJob *job,
 	g_source_attach (source, NULL);
 }
 
+/**
+ * pk_backend_job_set_pausable:
+ *
+ * Backends set this when they call pk_backend_job_wait_while_paused()
+ * regularly, at points where other jobs can safely read the package
+ * database. The daemon then pauses the job rather than cancelling it
+ * when a foreground query has to run first.
+ **/
+void
+pk_backend_job_set_pausable (PkBackendJob *job, gboolean pausable)
+{
+	g_return_if_fail (PK_IS_BACKEND_JOB (job));
+	job->priv->pausable = pausable;
+}
+
+gboolean
+pk_backend_job_get_pausable (PkBackendJob *job)
+{
+	g_return_val_if_fail (PK_IS_BACKEND_JOB (job), FALSE);
+	return job->priv->pausable;
+}
+
+/**
+ * pk_backend_job_set_paused:
+ *
+ * Asks the backend to stop at its next checkpoint, or lets it carry on.
+ **/
+void
+pk_backend_job_set_paused (PkBackendJob *job, gboolean paused)
+{
+	g_return_if_fail (PK_IS_BACKEND_JOB (job));
+
+	g_mutex_lock (&job->priv->pause_mutex);
+	job->priv->paused = paused;
+	g_cond_broadcast (&job->priv->pause_cond);
+	g_mutex_unlock (&job->priv->pause_mutex);
+}
+
+gboolean
+pk_backend_job_get_paused (PkBackendJob *job)
+{
+	gboolean paused;
+
+	g_return_val_if_fail (PK_IS_BACKEND_JOB (job), FALSE);
+
+	g_mutex_lock (&job->priv->pause_mutex);
+	paused = job->priv->paused;
+	g_mutex_unlock (&job->priv->pause_mutex);
+	return paused;
+}
+
+/**
+ * pk_backend_job_wait_while_paused:
+ *
+ * Blocks the calling backend thread for as long as the daemon keeps the
+ * job paused.
+ *
+ * Return value: %FALSE if the job was cancelled
+ **/
+gboolean
+pk_backend_job_wait_while_paused (PkBackendJob *job)
+{
+	gint64 end_time;
+
+	g_return_val_if_fail (PK_IS_BACKEND_JOB (job), FALSE);
+
+	g_mutex_lock (&job->priv->pause_mutex);
+	if (!job->priv->paused) {
+		g_mutex_unlock (&job->priv->pause_mutex);
+		return !pk_backend_job_is_cancelled (job);
+	}
+
+	/* tell the daemon that nothing is in progress now */
+	g_debug ("job paused");
+	pk_backend_job_call_vfunc (job,
+				   PK_BACKEND_SIGNAL_STATUS_CHANGED,
+				   GUINT_TO_POINTER (PK_STATUS_ENUM_WAIT),
+				   NULL);
+	while (job->priv->paused && !pk_backend_job_is_cancelled (job)) {
+		end_time = g_get_monotonic_time () +
+			   PK_BACKEND_JOB_PAUSE_POLL_INTERVAL * G_TIME_SPAN_MILLISECOND;
+		g_cond_wait_until (&job->priv->pause_cond,
+				   &job->priv->pause_mutex,
+				   end_time);
+	}
+	g_mutex_unlock (&job->priv->pause_mutex);
+	g_debug ("job resumed");
+
+	/* show what we were doing before */
+	if (job->priv->status != PK_STATUS_ENUM_UNKNOWN) {
+		pk_backend_job_call_vfunc (job,
+					   PK_BACKEND_SIGNAL_STATUS_CHANGED,
+					   GUINT_TO_POINTER (job->priv->status),
+					   NULL);
+	}
+	return !pk_backend_job_is_cancelled (job);
+}
+
 /**
  * pk_backend_job_set_vfunc:
  * @job: A valid PkBackendJob
@@ -1773,12 +1954,15 @@ pk_backend_job_finalize (GObject *object)
 	g_free (job->priv->cmdline);
 	g_free (job->priv->locale);
 	g_free (job->priv->frontend_socket);
+	pk_backend_job_set_solved_plan (job, NULL, NULL);
 	g_hash_table_unref (job->priv->emitted);
 	if (job->priv->params != NULL)
 		g_variant_unref (job->priv->params);
 	g_timer_destroy (job->priv->timer);
 	g_key_file_unref (job->priv->conf);
 	g_object_unref (job->priv->cancellable);
+	g_mutex_clear (&job->priv->pause_mutex);
+	g_cond_clear (&job->priv->pause_cond);
 
 	G_OBJECT_CLASS (pk_backend_job_parent_class)->finalize (object);
 }
@@ -1804,6 +1988,8 @@ pk_backend_job_init (PkBackendJob *job)
 	job->priv->exit = PK_EXIT_ENUM_UNKNOWN;
 	job->priv->role = PK_ROLE_ENUM_UNKNOWN;
 	job->priv->status = PK_STATUS_ENUM_UNKNOWN;
+	g_mutex_init (&job->priv->pause_mutex);
+	g_cond_init (&job->priv->pause_cond);
 	job->priv->emitted = g_hash_table_new_full (g_str_hash, g_str_equal,
 	                                            g_free, (GDestroyNotify) g_object_unref);
 }
@@ -92,6 +92,12 @@ gboolean	 pk_backend_job_is_cancelled		(PkBackendJob	*job);
 gpointer	 pk_backend_job_get_user_data		(PkBackendJob	*job);
 void		 pk_backend_job_set_user_data		(PkBackendJob	*job,
 							 gpointer	 user_data);
+void		 pk_backend_job_set_solved_plan		(PkBackendJob	*job,
+							 gpointer	 plan,
+							 GDestroyNotify	 destroy);
+gpointer	 pk_backend_job_get_solved_plan		(PkBackendJob	*job);
+gpointer	 pk_backend_job_steal_solved_plan	(PkBackendJob	*job,
+							 GDestroyNotify	*destroy);
 PkBitfield	 pk_backend_job_get_transaction_flags	(PkBackendJob	*job);
 void		 pk_backend_job_set_transaction_flags	(PkBackendJob	*job,
 							 PkBitfield	 transaction_flags);
@@ -99,6 +105,13 @@ GVariant	*pk_backend_job_get_parameters		(PkBackendJob	*job);
 void		 pk_backend_job_set_parameters		(PkBackendJob	*job,
 							 GVariant	*params);
 gboolean	 pk_backend_job_get_background		(PkBackendJob	*job);
+void		 pk_backend_job_set_pausable		(PkBackendJob	*job,
+							 gboolean	 pausable);
+gboolean	 pk_backend_job_get_pausable		(PkBackendJob	*job);
+void		 pk_backend_job_set_paused		(PkBackendJob	*job,
+							 gboolean	 paused);
+gboolean	 pk_backend_job_get_paused		(PkBackendJob	*job);
+gboolean	 pk_backend_job_wait_while_paused	(PkBackendJob	*job);
 void		 pk_backend_job_set_background		(PkBackendJob	*job,
 							 gboolean	 background);
 gboolean	 pk_backend_job_get_interactive		(PkBackendJob	*job);
@@ -115,6 +128,7 @@ void		 pk_backend_job_set_exit_code		(PkBackendJob	*job,
 							 PkExitEnum	 exit);
 gboolean	 pk_backend_job_has_set_error_code	(PkBackendJob	*job);
 guint		 pk_backend_job_get_runtime		(PkBackendJob	*job);
+guint64		 pk_backend_job_get_emit_time		(PkBackendJob	*job);
 gboolean	 pk_backend_job_get_is_finished		(PkBackendJob	*job);
 gboolean	 pk_backend_job_get_is_error_set	(PkBackendJob	*job);
 gboolean	 pk_backend_job_get_allow_cancel	(PkBackendJob	*job);
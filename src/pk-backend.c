@@ -58,6 +58,9 @@ typedef struct {
 	PkBitfield	(*get_provides)			(PkBackend	*backend);
 	gchar		**(*get_mime_types)		(PkBackend	*backend);
 	gboolean	(*supports_parallelization)	(PkBackend	*backend);
+	PkBitfield	(*get_parallel_roles)		(PkBackend	*backend);
+	const gchar	*(*get_lock_file)		(PkBackend	*backend);
+	gboolean	(*is_lock_held)			(PkBackend	*backend);
 	void		(*job_start)			(PkBackend	*backend,
 							 PkBackendJob	*job);
 	void		(*job_stop)			(PkBackend	*backend,
@@ -203,6 +206,11 @@ struct PkBackendPrivate
 	guint			 repo_list_changed_id;
 	guint			 installed_db_changed_id;
 	guint			 updates_changed_id;
+	gint			 state_generation;	/* atomic */
+	gchar			*solved_plan_key;
+	guint			 solved_plan_generation;
+	gpointer		 solved_plan;
+	GDestroyNotify		 solved_plan_destroy;
 };
 
 G_DEFINE_TYPE (PkBackend, pk_backend, G_TYPE_OBJECT)
@@ -252,6 +260,71 @@ pk_backend_supports_parallelization (PkBackend	*backend)
 	return backend->priv->desc->supports_parallelization (backend);
 }
 
+/**
+ * pk_backend_get_parallel_roles:
+ *
+ * Gets the roles that are safe to run at the same time as each other and
+ * as any other running transaction, including one that changes the system,
+ * for backends that do not support parallelization in general.
+ * For instance, queries that only read a snapshot of the package database.
+ *
+ * Return value: a #PkBitfield of #PkRoleEnum
+ **/
+PkBitfield
+pk_backend_get_parallel_roles (PkBackend *backend)
+{
+	g_return_val_if_fail (PK_IS_BACKEND (backend), 0);
+
+	/* not compulsory */
+	if (backend->priv->desc->get_parallel_roles == NULL)
+		return 0;
+	return backend->priv->desc->get_parallel_roles (backend);
+}
+
+/**
+ * pk_backend_get_lock_file:
+ *
+ * Gets the file the package manager locks when something outside of
+ * PackageKit is using it, so that transactions that failed with
+ * %PK_ERROR_ENUM_LOCK_REQUIRED can be retried as soon as it is released.
+ *
+ * Return value: the path of the lock file, or %NULL
+ **/
+const gchar *
+pk_backend_get_lock_file (PkBackend *backend)
+{
+	g_return_val_if_fail (PK_IS_BACKEND (backend), NULL);
+
+	/* not compulsory */
+	if (backend->priv->desc->get_lock_file == NULL)
+		return NULL;
+	return backend->priv->desc->get_lock_file (backend);
+}
+
+/**
+ * pk_backend_is_lock_held:
+ *
+ * Asks the backend whether another process is holding the lock file right
+ * now. A lock file nobody holds, e.g. one left behind by a crashed
+ * program, is not worth waiting for.
+ *
+ * This is called from a worker thread, so that backends can afford to
+ * look through every process.
+ *
+ * Return value: %FALSE if nobody holds the lock, %TRUE if somebody does or
+ * the backend cannot tell
+ **/
+gboolean
+pk_backend_is_lock_held (PkBackend *backend)
+{
+	g_return_val_if_fail (PK_IS_BACKEND (backend), TRUE);
+
+	/* not compulsory */
+	if (backend->priv->desc->is_lock_held == NULL)
+		return TRUE;
+	return backend->priv->desc->is_lock_held (backend);
+}
+
 void
 pk_backend_thread_start (PkBackend *backend, PkBackendJob *job, gpointer func)
 {
@@ -512,6 +585,9 @@ pk_backend_load (PkBackend *backend, GError **error)
 		g_module_symbol (handle, "pk_backend_get_groups", (gpointer *)&desc->get_groups);
 		g_module_symbol (handle, "pk_backend_get_mime_types", (gpointer *)&desc->get_mime_types);
 		g_module_symbol (handle, "pk_backend_supports_parallelization", (gpointer *)&desc->supports_parallelization);
+		g_module_symbol (handle, "pk_backend_get_parallel_roles", (gpointer *)&desc->get_parallel_roles);
+		g_module_symbol (handle, "pk_backend_get_lock_file", (gpointer *)&desc->get_lock_file);
+		g_module_symbol (handle, "pk_backend_is_lock_held", (gpointer *)&desc->is_lock_held);
 		g_module_symbol (handle, "pk_backend_get_packages", (gpointer *)&desc->get_packages);
 		g_module_symbol (handle, "pk_backend_get_repo_list", (gpointer *)&desc->get_repo_list);
 		g_module_symbol (handle, "pk_backend_required_by", (gpointer *)&desc->required_by);
@@ -573,6 +649,17 @@ pk_backend_load (PkBackend *backend, GError **error)
 	return TRUE;
 }
 
+static void
+pk_backend_clear_solved_plan (PkBackend *backend)
+{
+	if (backend->priv->solved_plan != NULL &&
+	    backend->priv->solved_plan_destroy != NULL)
+		backend->priv->solved_plan_destroy (backend->priv->solved_plan);
+	backend->priv->solved_plan = NULL;
+	backend->priv->solved_plan_destroy = NULL;
+	g_clear_pointer (&backend->priv->solved_plan_key, g_free);
+}
+
 /**
  * pk_backend_unload:
  *
@@ -597,6 +684,10 @@ pk_backend_unload (PkBackend *backend)
 		g_warning ("not yet loaded backend, try pk_backend_load()");
 		return FALSE;
 	}
+
+	/* the plan may refer to backend state */
+	pk_backend_clear_solved_plan (backend);
+
 	if (backend->priv->desc->destroy != NULL)
 		backend->priv->desc->destroy (backend);
 	backend->priv->loaded = FALSE;
@@ -614,12 +705,105 @@ pk_backend_repo_list_changed_cb (gpointer user_data)
 	return FALSE;
 }
 
+/**
+ * pk_backend_get_state_generation:
+ *
+ * Gets a counter that changes every time the backend reports that the
+ * available updates, the repo list or the installed package database may
+ * have changed. Results of queries can be reused as long as it stays the
+ * same.
+ *
+ * This function can be called on any thread.
+ **/
+guint
+pk_backend_get_state_generation (PkBackend *backend)
+{
+	g_return_val_if_fail (PK_IS_BACKEND (backend), 0);
+	return (guint) g_atomic_int_get (&backend->priv->state_generation);
+}
+
+/**
+ * pk_backend_state_changed:
+ *
+ * Invalidates the results of all previous queries without emitting any
+ * signals, e.g. when a transaction may have changed the system.
+ *
+ * This function can be called on any thread.
+ **/
+void
+pk_backend_state_changed (PkBackend *backend)
+{
+	g_return_if_fail (PK_IS_BACKEND (backend));
+	g_atomic_int_inc (&backend->priv->state_generation);
+}
+
+/**
+ * pk_backend_keep_solved_plan:
+ * @job: a job that finished simulating a transaction
+ * @key: the parameters of the transaction, without the simulate flag
+ *
+ * Takes the plan the backend set on @job, if any, so that it can be given
+ * to the real transaction later. Only the most recent plan is kept.
+ **/
+void
+pk_backend_keep_solved_plan (PkBackend *backend, PkBackendJob *job, const gchar *key)
+{
+	GDestroyNotify destroy = NULL;
+	gpointer plan;
+
+	g_return_if_fail (PK_IS_BACKEND (backend));
+	g_return_if_fail (PK_IS_BACKEND_JOB (job));
+	g_return_if_fail (key != NULL);
+
+	plan = pk_backend_job_steal_solved_plan (job, &destroy);
+	if (plan == NULL)
+		return;
+
+	pk_backend_clear_solved_plan (backend);
+	backend->priv->solved_plan_key = g_strdup (key);
+	backend->priv->solved_plan_generation = pk_backend_get_state_generation (backend);
+	backend->priv->solved_plan = plan;
+	backend->priv->solved_plan_destroy = destroy;
+}
+
+/**
+ * pk_backend_restore_solved_plan:
+ * @job: a job that is about to run a real transaction
+ * @key: the parameters of the transaction
+ *
+ * Gives the kept plan to @job if it was made for the same parameters and
+ * nothing has changed since. A plan is only ever used once.
+ **/
+void
+pk_backend_restore_solved_plan (PkBackend *backend, PkBackendJob *job, const gchar *key)
+{
+	g_return_if_fail (PK_IS_BACKEND (backend));
+	g_return_if_fail (PK_IS_BACKEND_JOB (job));
+	g_return_if_fail (key != NULL);
+
+	if (backend->priv->solved_plan == NULL)
+		return;
+	if (g_strcmp0 (backend->priv->solved_plan_key, key) == 0 &&
+	    backend->priv->solved_plan_generation == pk_backend_get_state_generation (backend)) {
+		g_debug ("reusing solved plan for %s", key);
+		pk_backend_job_set_solved_plan (job,
+						backend->priv->solved_plan,
+						backend->priv->solved_plan_destroy);
+		backend->priv->solved_plan = NULL;
+		backend->priv->solved_plan_destroy = NULL;
+	}
+	pk_backend_clear_solved_plan (backend);
+}
+
 void
 pk_backend_repo_list_changed (PkBackend *backend)
 {
 	g_return_if_fail (PK_IS_BACKEND (backend));
 	g_return_if_fail (backend->priv->loaded);
 
+	/* queries started from now on must not use old results */
+	pk_backend_state_changed (backend);
+
 	/* already scheduled */
 	if (backend->priv->repo_list_changed_id != 0)
 		return;
@@ -635,6 +819,8 @@ pk_backend_updates_changed (PkBackend *backend)
 	g_return_val_if_fail (PK_IS_BACKEND (backend), FALSE);
 	g_return_val_if_fail (pk_is_thread_default (), FALSE);
 
+	pk_backend_state_changed (backend);
+
 	g_debug ("emitting updates-changed");
 	g_signal_emit (backend, signals [SIGNAL_UPDATES_CHANGED], 0);
 	return TRUE;
@@ -654,6 +840,9 @@ pk_backend_updates_changed_delay (PkBackend *backend, guint timeout)
 {
 	g_return_val_if_fail (PK_IS_BACKEND (backend), FALSE);
 
+	/* do not wait for the signal to stop using old results */
+	pk_backend_state_changed (backend);
+
 	/* check if we did this more than once */
 	if (backend->priv->updates_changed_id != 0)
 		return FALSE;
@@ -704,6 +893,9 @@ pk_backend_installed_db_changed (PkBackend *backend)
 	g_return_if_fail (PK_IS_BACKEND (backend));
 	g_return_if_fail (backend->priv->loaded);
 
+	/* even if a transaction is in progress, the packages have changed */
+	pk_backend_state_changed (backend);
+
 	/* already scheduled */
 	if (backend->priv->installed_db_changed_id != 0)
 		return;
@@ -1066,6 +1258,7 @@ pk_backend_finalize (GObject *object)
 	g_return_if_fail (PK_IS_BACKEND (object));
 	backend = PK_BACKEND (object);
 
+	pk_backend_clear_solved_plan (backend);
 	g_free (backend->priv->name);
 
 	g_key_file_unref (backend->priv->conf);
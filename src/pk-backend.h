@@ -87,6 +87,14 @@ gboolean	 pk_backend_is_implemented		(PkBackend	*backend,
 gchar		*pk_backend_get_accepted_eula_string	(PkBackend	*backend);
 void		 pk_backend_repo_list_changed		(PkBackend      *backend);
 void		 pk_backend_installed_db_changed	(PkBackend      *backend);
+guint		 pk_backend_get_state_generation	(PkBackend	*backend);
+void		 pk_backend_state_changed		(PkBackend	*backend);
+void		 pk_backend_keep_solved_plan		(PkBackend	*backend,
+							 PkBackendJob	*job,
+							 const gchar	*key);
+void		 pk_backend_restore_solved_plan		(PkBackend	*backend,
+							 PkBackendJob	*job,
+							 const gchar	*key);
 
 
 gboolean	 pk_backend_updates_changed		(PkBackend	*backend);
@@ -121,6 +129,9 @@ PkBitfield	 pk_backend_get_filters			(PkBackend	*backend);
 PkBitfield	 pk_backend_get_roles			(PkBackend	*backend);
 gchar		**pk_backend_get_mime_types		(PkBackend	*backend);
 gboolean	 pk_backend_supports_parallelization	(PkBackend	*backend);
+PkBitfield	 pk_backend_get_parallel_roles		(PkBackend	*backend);
+const gchar	*pk_backend_get_lock_file		(PkBackend	*backend);
+gboolean	 pk_backend_is_lock_held		(PkBackend	*backend);
 void		 pk_backend_initialize			(GKeyFile		*conf,
 							 PkBackend	*backend);
 void		 pk_backend_destroy			(PkBackend	*backend);
@@ -0,0 +1,271 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 PackageKit contributors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * The metrics keep a histogram of the time finished transactions spent in
+ * each phase, per role, and write them in the Prometheus text format to
+ * the file set with MetricsFile, e.g. for the textfile collector of the
+ * node exporter. Nothing is collected when MetricsFile is not set.
+ **/
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "pk-metrics.h"
+
+static void     pk_metrics_finalize	(GObject        *object);
+
+#define PK_METRICS_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_METRICS, PkMetricsPrivate))
+
+/* do not rewrite the file for every transaction in a burst */
+#define PK_METRICS_WRITE_DELAY		5 /* s */
+
+/* upper bounds of the histogram buckets, the last one is +Inf */
+static const guint64 pk_metrics_buckets[] = {
+	1000, 5000, 10000, 50000, 100000, 500000,		/* us */
+	1000000, 5000000, 10000000, 30000000, 60000000,
+	300000000, 900000000 };
+
+#define PK_METRICS_N_BUCKETS		G_N_ELEMENTS (pk_metrics_buckets)
+
+typedef struct {
+	guint64			 counts[PK_METRICS_N_BUCKETS + 1];
+	guint64			 sum;
+} PkMetricsHistogram;
+
+struct PkMetricsPrivate
+{
+	gchar			*filename;
+	guint			 write_id;
+	PkMetricsHistogram	*roles[PK_ROLE_ENUM_LAST];
+};
+
+G_DEFINE_TYPE (PkMetrics, pk_metrics, G_TYPE_OBJECT)
+
+gboolean
+pk_metrics_get_enabled (PkMetrics *metrics)
+{
+	g_return_val_if_fail (PK_IS_METRICS (metrics), FALSE);
+	return metrics->priv->filename != NULL;
+}
+
+/**
+ * pk_metrics_observe:
+ * @role: the role of the transaction
+ * @phase: the phase of the transaction
+ * @time_us: the time spent in @phase
+ **/
+void
+pk_metrics_observe (PkMetrics *metrics,
+		    PkRoleEnum role,
+		    PkTransactionPhase phase,
+		    guint64 time_us)
+{
+	PkMetricsHistogram *histogram;
+	guint i;
+
+	g_return_if_fail (PK_IS_METRICS (metrics));
+	g_return_if_fail (role < PK_ROLE_ENUM_LAST);
+	g_return_if_fail (phase < PK_TRANSACTION_PHASE_LAST);
+
+	if (metrics->priv->roles[role] == NULL)
+		metrics->priv->roles[role] = g_new0 (PkMetricsHistogram, PK_TRANSACTION_PHASE_LAST);
+	histogram = &metrics->priv->roles[role][phase];
+
+	for (i = 0; i < PK_METRICS_N_BUCKETS; i++) {
+		if (time_us <= pk_metrics_buckets[i])
+			break;
+	}
+	histogram->counts[i]++;
+	histogram->sum += time_us;
+}
+
+static gboolean
+pk_metrics_write_cb (gpointer user_data)
+{
+	PkMetrics *metrics = PK_METRICS (user_data);
+	g_autoptr(GError) error = NULL;
+
+	metrics->priv->write_id = 0;
+	if (!pk_metrics_write (metrics, &error))
+		g_warning ("failed to write metrics: %s", error->message);
+	return G_SOURCE_REMOVE;
+}
+
+/**
+ * pk_metrics_add_transaction:
+ * @transaction: a finished transaction
+ *
+ * Adds the phase times of @transaction and schedules writing the file.
+ **/
+void
+pk_metrics_add_transaction (PkMetrics *metrics, PkTransaction *transaction)
+{
+	PkRoleEnum role;
+	guint i;
+
+	g_return_if_fail (PK_IS_METRICS (metrics));
+	g_return_if_fail (PK_IS_TRANSACTION (transaction));
+
+	if (metrics->priv->filename == NULL)
+		return;
+
+	role = pk_transaction_get_role (transaction);
+	for (i = 0; i < PK_TRANSACTION_PHASE_LAST; i++) {
+		pk_metrics_observe (metrics, role, i,
+				    pk_transaction_get_phase_time (transaction, i));
+	}
+
+	if (metrics->priv->write_id == 0) {
+		metrics->priv->write_id = g_timeout_add_seconds (PK_METRICS_WRITE_DELAY,
+								 pk_metrics_write_cb,
+								 metrics);
+		g_source_set_name_by_id (metrics->priv->write_id, "[PkMetrics] write");
+	}
+}
+
+/* independent of the locale, unlike printf */
+static void
+pk_metrics_append_seconds (GString *string, const gchar *format, guint64 time_us)
+{
+	gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+	g_string_append (string, g_ascii_formatd (buf, sizeof (buf), format,
+						  (gdouble) time_us / G_USEC_PER_SEC));
+}
+
+/**
+ * pk_metrics_to_string:
+ *
+ * Returns: the histograms in the Prometheus text exposition format
+ **/
+gchar *
+pk_metrics_to_string (PkMetrics *metrics)
+{
+	GString *string;
+	guint i, j, k;
+
+	g_return_val_if_fail (PK_IS_METRICS (metrics), NULL);
+
+	string = g_string_new ("# HELP packagekit_transaction_phase_seconds "
+			       "Time spent by finished transactions in each phase.\n"
+			       "# TYPE packagekit_transaction_phase_seconds histogram\n");
+	for (i = 0; i < PK_ROLE_ENUM_LAST; i++) {
+		if (metrics->priv->roles[i] == NULL)
+			continue;
+		for (j = 0; j < PK_TRANSACTION_PHASE_LAST; j++) {
+			PkMetricsHistogram *histogram = &metrics->priv->roles[i][j];
+			g_autofree gchar *labels = NULL;
+			guint64 count = 0;
+
+			labels = g_strdup_printf ("role=\"%s\",phase=\"%s\"",
+						  pk_role_enum_to_string (i),
+						  pk_transaction_phase_to_string (j));
+			for (k = 0; k <= PK_METRICS_N_BUCKETS; k++) {
+				count += histogram->counts[k];
+				g_string_append_printf (string,
+							"packagekit_transaction_phase_seconds_bucket{%s,le=\"",
+							labels);
+				if (k < PK_METRICS_N_BUCKETS)
+					pk_metrics_append_seconds (string, "%g", pk_metrics_buckets[k]);
+				else
+					g_string_append (string, "+Inf");
+				g_string_append_printf (string, "\"} %" G_GUINT64_FORMAT "\n", count);
+			}
+			g_string_append_printf (string,
+						"packagekit_transaction_phase_seconds_sum{%s} ",
+						labels);
+			pk_metrics_append_seconds (string, "%.6f", histogram->sum);
+			g_string_append_printf (string,
+						"\npackagekit_transaction_phase_seconds_count{%s} %" G_GUINT64_FORMAT "\n",
+						labels, count);
+		}
+	}
+	return g_string_free (string, FALSE);
+}
+
+/**
+ * pk_metrics_write:
+ *
+ * Replaces the metrics file atomically, so the collector never sees a
+ * partial file.
+ **/
+gboolean
+pk_metrics_write (PkMetrics *metrics, GError **error)
+{
+	g_autofree gchar *data = NULL;
+
+	g_return_val_if_fail (PK_IS_METRICS (metrics), FALSE);
+
+	if (metrics->priv->filename == NULL)
+		return TRUE;
+	data = pk_metrics_to_string (metrics);
+	return g_file_set_contents (metrics->priv->filename, data, -1, error);
+}
+
+static void
+pk_metrics_class_init (PkMetricsClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = pk_metrics_finalize;
+	g_type_class_add_private (klass, sizeof (PkMetricsPrivate));
+}
+
+static void
+pk_metrics_init (PkMetrics *metrics)
+{
+	metrics->priv = PK_METRICS_GET_PRIVATE (metrics);
+}
+
+static void
+pk_metrics_finalize (GObject *object)
+{
+	PkMetrics *metrics;
+	guint i;
+	g_return_if_fail (PK_IS_METRICS (object));
+	metrics = PK_METRICS (object);
+
+	/* do not lose the last transactions */
+	if (metrics->priv->write_id != 0) {
+		g_source_remove (metrics->priv->write_id);
+		pk_metrics_write_cb (metrics);
+	}
+	for (i = 0; i < PK_ROLE_ENUM_LAST; i++)
+		g_free (metrics->priv->roles[i]);
+	g_free (metrics->priv->filename);
+
+	G_OBJECT_CLASS (pk_metrics_parent_class)->finalize (object);
+}
+
+PkMetrics *
+pk_metrics_new (GKeyFile *conf)
+{
+	PkMetrics *metrics;
+	g_autofree gchar *filename = NULL;
+
+	metrics = g_object_new (PK_TYPE_METRICS, NULL);
+
+	/* not set disables the metrics */
+	filename = g_key_file_get_string (conf, "Daemon", "MetricsFile", NULL);
+	if (filename != NULL && filename[0] != '\0')
+		metrics->priv->filename = g_steal_pointer (&filename);
+	return PK_METRICS (metrics);
+}
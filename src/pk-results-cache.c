@@ -0,0 +1,255 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 PackageKit contributors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * The results cache holds the PkResults of finished read-only queries so
+ * that an identical query can be answered without calling into the backend.
+ *
+ * Each entry is tagged with the backend state generation it was created
+ * in; the generation is bumped whenever the backend reports that updates,
+ * the repo list or the installed package database have changed, which
+ * makes all older entries stale. Entries also expire after
+ * QueryCacheTimeout seconds, as not all backends notice changes made
+ * outside of PackageKit.
+ *
+ * Entries also remember the cache-age hint of the query that produced
+ * them, and only answer queries that accept metadata at least that old.
+ **/
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "pk-results-cache.h"
+
+static void     pk_results_cache_finalize	(GObject        *object);
+
+#define PK_RESULTS_CACHE_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_RESULTS_CACHE, PkResultsCachePrivate))
+
+/* the number of different queries we remember */
+#define PK_RESULTS_CACHE_MAX_ITEMS		64
+
+/* how long entries are valid when not set in the config file */
+#define PK_RESULTS_CACHE_TIMEOUT_DEFAULT	30 /* s */
+
+typedef struct {
+	gchar			*key;
+	guint			 generation;
+	guint			 cache_age;
+	gint64			 created;
+	PkResults		*results;
+	GList			*link;
+} PkResultsCacheItem;
+
+struct PkResultsCachePrivate
+{
+	GHashTable		*items;
+	GQueue			 lru;
+	guint			 timeout;
+};
+
+G_DEFINE_TYPE (PkResultsCache, pk_results_cache, G_TYPE_OBJECT)
+
+static void
+pk_results_cache_item_free (PkResultsCacheItem *item)
+{
+	g_free (item->key);
+	g_object_unref (item->results);
+	g_free (item);
+}
+
+static void
+pk_results_cache_remove_item (PkResultsCache *cache, PkResultsCacheItem *item)
+{
+	g_queue_delete_link (&cache->priv->lru, item->link);
+	g_hash_table_remove (cache->priv->items, item->key);
+}
+
+/* drops the entries no lookup can return anymore, so that large result
+ * sets don't stay around until they are the least recently used */
+static void
+pk_results_cache_remove_stale (PkResultsCache *cache, guint generation)
+{
+	gint64 now = g_get_monotonic_time ();
+	GList *l = cache->priv->lru.head;
+
+	while (l != NULL) {
+		PkResultsCacheItem *item = l->data;
+		gint64 age = (now - item->created) / G_USEC_PER_SEC;
+
+		l = l->next;
+		if (item->generation != generation || age >= cache->priv->timeout)
+			pk_results_cache_remove_item (cache, item);
+	}
+}
+
+gboolean
+pk_results_cache_get_enabled (PkResultsCache *cache)
+{
+	g_return_val_if_fail (PK_IS_RESULTS_CACHE (cache), FALSE);
+	return cache->priv->timeout > 0;
+}
+
+/**
+ * pk_results_cache_lookup:
+ * @key: the query, as built by the transaction
+ * @generation: the current backend state generation
+ * @cache_age: the cache-age hint of the query, or %G_MAXUINT
+ *
+ * Returns: (transfer full): the cached results, or %NULL if there are none
+ * or they are no longer valid
+ **/
+PkResults *
+pk_results_cache_lookup (PkResultsCache *cache,
+			 const gchar *key,
+			 guint generation,
+			 guint cache_age)
+{
+	PkResultsCacheItem *item;
+	gint64 age;
+
+	g_return_val_if_fail (PK_IS_RESULTS_CACHE (cache), NULL);
+	g_return_val_if_fail (key != NULL, NULL);
+
+	item = g_hash_table_lookup (cache->priv->items, key);
+	if (item == NULL)
+		return NULL;
+
+	/* the backend state has changed, or the entry is too old */
+	age = (g_get_monotonic_time () - item->created) / G_USEC_PER_SEC;
+	if (item->generation != generation ||
+	    age >= cache->priv->timeout) {
+		g_debug ("dropping stale results for %s", key);
+		pk_results_cache_remove_item (cache, item);
+		return NULL;
+	}
+
+	/* the results may come from older metadata than the client wants */
+	if (item->cache_age > cache_age)
+		return NULL;
+
+	/* most recently used goes to the front */
+	g_queue_unlink (&cache->priv->lru, item->link);
+	g_queue_push_head_link (&cache->priv->lru, item->link);
+	return g_object_ref (item->results);
+}
+
+/**
+ * pk_results_cache_add:
+ * @key: the query, as built by the transaction
+ * @generation: the backend state generation when the query was started
+ * @cache_age: the cache-age hint the query was run with
+ * @results: the results of the finished query
+ **/
+void
+pk_results_cache_add (PkResultsCache *cache,
+		      const gchar *key,
+		      guint generation,
+		      guint cache_age,
+		      PkResults *results)
+{
+	PkResultsCacheItem *item;
+
+	g_return_if_fail (PK_IS_RESULTS_CACHE (cache));
+	g_return_if_fail (key != NULL);
+	g_return_if_fail (PK_IS_RESULTS (results));
+
+	if (cache->priv->timeout == 0)
+		return;
+
+	/* the generation only ever grows, older entries are stale */
+	pk_results_cache_remove_stale (cache, generation);
+
+	/* replace any older results for the same query */
+	item = g_hash_table_lookup (cache->priv->items, key);
+	if (item != NULL)
+		pk_results_cache_remove_item (cache, item);
+
+	item = g_new0 (PkResultsCacheItem, 1);
+	item->key = g_strdup (key);
+	item->generation = generation;
+	item->cache_age = cache_age;
+	item->created = g_get_monotonic_time ();
+	item->results = g_object_ref (results);
+	g_queue_push_head (&cache->priv->lru, item);
+	item->link = cache->priv->lru.head;
+	g_hash_table_insert (cache->priv->items, item->key, item);
+
+	/* forget the least recently used queries */
+	while (g_queue_get_length (&cache->priv->lru) > PK_RESULTS_CACHE_MAX_ITEMS) {
+		item = g_queue_peek_tail (&cache->priv->lru);
+		pk_results_cache_remove_item (cache, item);
+	}
+}
+
+guint
+pk_results_cache_get_size (PkResultsCache *cache)
+{
+	g_return_val_if_fail (PK_IS_RESULTS_CACHE (cache), 0);
+	return g_hash_table_size (cache->priv->items);
+}
+
+static void
+pk_results_cache_class_init (PkResultsCacheClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = pk_results_cache_finalize;
+	g_type_class_add_private (klass, sizeof (PkResultsCachePrivate));
+}
+
+static void
+pk_results_cache_init (PkResultsCache *cache)
+{
+	cache->priv = PK_RESULTS_CACHE_GET_PRIVATE (cache);
+	cache->priv->items = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+						    (GDestroyNotify) pk_results_cache_item_free);
+	g_queue_init (&cache->priv->lru);
+	cache->priv->timeout = PK_RESULTS_CACHE_TIMEOUT_DEFAULT;
+}
+
+static void
+pk_results_cache_finalize (GObject *object)
+{
+	PkResultsCache *cache;
+	g_return_if_fail (PK_IS_RESULTS_CACHE (object));
+	cache = PK_RESULTS_CACHE (object);
+
+	g_queue_clear (&cache->priv->lru);
+	g_hash_table_unref (cache->priv->items);
+
+	G_OBJECT_CLASS (pk_results_cache_parent_class)->finalize (object);
+}
+
+PkResultsCache *
+pk_results_cache_new (GKeyFile *conf)
+{
+	PkResultsCache *cache;
+	g_autoptr(GError) error = NULL;
+	gint timeout;
+
+	cache = g_object_new (PK_TYPE_RESULTS_CACHE, NULL);
+
+	/* 0 disables the cache */
+	timeout = g_key_file_get_integer (conf, "Daemon", "QueryCacheTimeout", &error);
+	if (error == NULL)
+		cache->priv->timeout = MAX (timeout, 0);
+	return PK_RESULTS_CACHE (cache);
+}
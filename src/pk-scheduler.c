@@ -23,19 +23,32 @@
  * Transaction Commit Logic:
  *
  * State = COMMIT
- * Transaction.Run()
+ * IF an identical read-only query is queued or running
+ * 	Wait for it as a follower
+ * ELSE
+ * 	IF foreground AND a background transaction is running
+ * 		IF read-only query AND all running background transactions are pausable
+ * 			Pause them at their next checkpoint, run when they got there
+ * 		ELSE
+ * 			Cancel them
+ * 	Transaction.Run()
  * WHEN transaction finished:
  * 	IF error = LOCK_REQUIRED
  * 		IF number_of_tries > 4
  * 			Fail the transaction with CANNOT_GET_LOCK
  * 			Remove the transaction from the FIFO queue
  * 		ELSE
+ * 			IF the backend has a lock file
+ * 				Wait until the lock file is released, then commit again,
+ * 				or right away if a thread finds that nobody holds it
  * 			Reset transaction
  * 			Transaction.Exclusive = TRUE
  * 			number_of_tries++
  * 			Leave transaction in the FIFO queue
  *	ELSE
  * 		State = Finished
+ * 		Run all followers with the results of this transaction
+ * 		Resume paused background transactions if no foreground query is left
  * 		IF Transaction.Exclusive
  * 			Take the first PK_TRANSACTION_STATE_READY transaction which has Transaction.Exclusive == TRUE
  * 			from the list and run it. If there's none, just do nothing
@@ -62,6 +75,9 @@
 #include <glib/gi18n.h>
 #include <packagekit-glib2/pk-common.h>
 
+#include "pk-auth-cache.h"
+#include "pk-metrics.h"
+#include "pk-results-cache.h"
 #include "pk-shared.h"
 #include "pk-transaction.h"
 #include "pk-transaction-private.h"
@@ -80,6 +96,9 @@ static void     pk_scheduler_finalize	(GObject	*object);
 /* how many times we should retry a locked transaction */
 #define PK_SCHEDULER_MAX_LOCK_RETRIES			4
 
+/* how long to wait for the lock file to be released before retrying anyway */
+#define PK_SCHEDULER_LOCK_WAIT_TIMEOUT			30 /* s */
+
 /* how long the transaction is valid before it's destroyed */
 #define PK_SCHEDULER_CREATE_COMMIT_TIMEOUT		300 /* s */
 
@@ -92,6 +111,9 @@ struct PkSchedulerPrivate
 	guint			 unwedge_id;
 	GKeyFile		*conf;
 	PkBackend		*backend;
+	PkResultsCache		*results_cache;
+	PkAuthCache		*auth_cache;
+	PkMetrics		*metrics;
 	GDBusNodeInfo		*introspection;
 };
 
@@ -105,10 +127,21 @@ typedef struct {
 	gulong			 finished_id;
 	gulong			 state_changed_id;
 	gulong			 allow_cancel_changed_id;
+	gulong			 paused_id;
 	guint			 uid;
 	guint			 tries;
+	gchar			*leader_tid;
+	GFileMonitor		*lock_monitor;
+	guint			 lock_timeout_id;
+	GCancellable		*lock_cancellable;
+	gboolean		 paused;
 } PkSchedulerItem;
 
+static void	pk_scheduler_release_followers	(PkScheduler		*scheduler,
+						 PkSchedulerItem	*leader);
+static void	pk_scheduler_commit		(PkScheduler		*scheduler,
+						 const gchar		*tid);
+
 enum {
 	PK_SCHEDULER_CHANGED,
 	PK_SCHEDULER_LAST_SIGNAL
@@ -188,6 +221,25 @@ pk_scheduler_role_present (PkScheduler *scheduler, PkRoleEnum role)
 	return FALSE;
 }
 
+/* stops waiting for the package manager lock */
+static void
+pk_scheduler_item_stop_lock_wait (PkSchedulerItem *item)
+{
+	if (item->lock_monitor != NULL) {
+		g_signal_handlers_disconnect_by_data (item->lock_monitor, item);
+		g_file_monitor_cancel (item->lock_monitor);
+		g_clear_object (&item->lock_monitor);
+	}
+	if (item->lock_timeout_id != 0) {
+		g_source_remove (item->lock_timeout_id);
+		item->lock_timeout_id = 0;
+	}
+	if (item->lock_cancellable != NULL) {
+		g_cancellable_cancel (item->lock_cancellable);
+		g_clear_object (&item->lock_cancellable);
+	}
+}
+
 static void
 pk_scheduler_item_free (PkSchedulerItem *item)
 {
@@ -198,6 +250,8 @@ pk_scheduler_item_free (PkSchedulerItem *item)
 		g_signal_handler_disconnect (item->transaction, item->state_changed_id);
 	if (item->allow_cancel_changed_id != 0)
 		g_signal_handler_disconnect (item->transaction, item->allow_cancel_changed_id);
+	if (item->paused_id != 0)
+		g_signal_handler_disconnect (item->transaction, item->paused_id);
 	g_object_unref (item->transaction);
 	if (item->commit_id != 0)
 		g_source_remove (item->commit_id);
@@ -205,8 +259,10 @@ pk_scheduler_item_free (PkSchedulerItem *item)
 		g_source_remove (item->idle_id);
 	if (item->remove_id != 0)
 		g_source_remove (item->remove_id);
+	pk_scheduler_item_stop_lock_wait (item);
 	g_object_unref (item->scheduler);
 	g_free (item->tid);
+	g_free (item->leader_tid);
 	g_free (item);
 }
 
@@ -230,6 +286,9 @@ pk_scheduler_remove_internal (PkScheduler *scheduler, PkSchedulerItem *item)
 		g_warning ("could not remove %p as not present in list", item);
 		return FALSE;
 	}
+
+	/* anything still waiting for us has to run on its own */
+	pk_scheduler_release_followers (scheduler, item);
 	pk_scheduler_item_free (item);
 
 	return TRUE;
@@ -360,6 +419,10 @@ pk_scheduler_get_exclusive_running (PkScheduler *scheduler)
 	for (i = 0; i < array->len; i++) {
 		item = (PkSchedulerItem *) g_ptr_array_index (array, i);
 
+		/* paused at a checkpoint, so not using the backend */
+		if (item->paused)
+			continue;
+
 		/* check if a transaction is running in exclusive */
 		if (pk_transaction_is_exclusive (item->transaction)) {
 			/* should never be more that one, but we count them for sanity checks */
@@ -392,6 +455,220 @@ pk_scheduler_get_background_running (PkScheduler *scheduler)
 	return FALSE;
 }
 
+/**
+ * pk_scheduler_can_run:
+ *
+ * Return value: %TRUE if @item does not have to wait for a running
+ * exclusive transaction to finish. A paused background transaction
+ * only lets read-only queries run.
+ **/
+static gboolean
+pk_scheduler_can_run (PkScheduler *scheduler, PkSchedulerItem *item)
+{
+	GPtrArray *array = scheduler->priv->array;
+
+	if (!pk_transaction_is_exclusive (item->transaction))
+		return TRUE;
+	if (pk_scheduler_get_exclusive_running (scheduler) > 0)
+		return FALSE;
+	if (pk_transaction_get_query_key (item->transaction) != NULL)
+		return TRUE;
+	for (guint i = 0; i < array->len; i++) {
+		PkSchedulerItem *tmp = g_ptr_array_index (array, i);
+		if (tmp->paused)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * pk_scheduler_pause_background:
+ *
+ * Asks all running background transactions to stop at their next
+ * checkpoint, so that a foreground query can run in the meantime.
+ *
+ * Return value: %FALSE if any of them cannot be paused
+ **/
+static gboolean
+pk_scheduler_pause_background (PkScheduler *scheduler)
+{
+	GPtrArray *array = scheduler->priv->array;
+	PkBackendJob *job;
+
+	for (guint i = 0; i < array->len; i++) {
+		PkSchedulerItem *item = g_ptr_array_index (array, i);
+		if (pk_transaction_get_state (item->transaction) != PK_TRANSACTION_STATE_RUNNING ||
+		    !pk_transaction_get_background (item->transaction))
+			continue;
+		job = pk_transaction_get_backend_job (item->transaction);
+		if (!pk_backend_job_get_pausable (job))
+			return FALSE;
+	}
+	for (guint i = 0; i < array->len; i++) {
+		PkSchedulerItem *item = g_ptr_array_index (array, i);
+		if (pk_transaction_get_state (item->transaction) != PK_TRANSACTION_STATE_RUNNING ||
+		    !pk_transaction_get_background (item->transaction))
+			continue;
+		g_debug ("pausing running background transaction %s", item->tid);
+		job = pk_transaction_get_backend_job (item->transaction);
+		pk_backend_job_set_paused (job, TRUE);
+	}
+	return TRUE;
+}
+
+static void
+pk_scheduler_resume_item (PkSchedulerItem *item)
+{
+	PkBackendJob *job = pk_transaction_get_backend_job (item->transaction);
+
+	if (!pk_backend_job_get_paused (job))
+		return;
+	g_debug ("resuming background transaction %s", item->tid);
+	item->paused = FALSE;
+	pk_backend_job_set_paused (job, FALSE);
+}
+
+/**
+ * pk_scheduler_resume_background:
+ *
+ * Lets paused background transactions carry on once no foreground
+ * transaction is running or waiting for them to pause any more.
+ **/
+static void
+pk_scheduler_resume_background (PkScheduler *scheduler)
+{
+	GPtrArray *array = scheduler->priv->array;
+
+	for (guint i = 0; i < array->len; i++) {
+		PkSchedulerItem *item = g_ptr_array_index (array, i);
+		PkTransactionState state = pk_transaction_get_state (item->transaction);
+
+		if (pk_transaction_get_background (item->transaction))
+			continue;
+		if (state == PK_TRANSACTION_STATE_RUNNING)
+			return;
+		if (state == PK_TRANSACTION_STATE_READY &&
+		    pk_transaction_get_query_key (item->transaction) != NULL)
+			return;
+	}
+	for (guint i = 0; i < array->len; i++) {
+		PkSchedulerItem *item = g_ptr_array_index (array, i);
+		if (pk_transaction_get_state (item->transaction) == PK_TRANSACTION_STATE_RUNNING)
+			pk_scheduler_resume_item (item);
+	}
+}
+
+/**
+ * pk_scheduler_check_exclusive:
+ *
+ * Treats the transaction as exclusive, unless the backend can run it in
+ * parallel with everything else.
+ **/
+static void
+pk_scheduler_check_exclusive (PkScheduler *scheduler, PkSchedulerItem *item)
+{
+	PkBackend *backend = scheduler->priv->backend;
+	PkBitfield parallel_roles;
+
+	if (pk_backend_supports_parallelization (backend))
+		return;
+	parallel_roles = pk_backend_get_parallel_roles (backend);
+	if (pk_bitfield_contain (parallel_roles, pk_transaction_get_role (item->transaction)))
+		return;
+	pk_transaction_make_exclusive (item->transaction);
+}
+
+/**
+ * pk_scheduler_get_leader:
+ *
+ * Return value: the unfinished transaction that does the same query as
+ * @item, and whose results @item is waiting for, or %NULL
+ **/
+static PkSchedulerItem *
+pk_scheduler_get_leader (PkScheduler *scheduler, PkSchedulerItem *item)
+{
+	PkSchedulerItem *leader;
+
+	if (item->leader_tid == NULL)
+		return NULL;
+	leader = pk_scheduler_get_from_tid (scheduler, item->leader_tid);
+	if (leader == NULL ||
+	    pk_transaction_get_state (leader->transaction) == PK_TRANSACTION_STATE_FINISHED)
+		return NULL;
+	return leader;
+}
+
+/**
+ * pk_scheduler_find_leader:
+ *
+ * Return value: a queued or running transaction doing exactly the same
+ * read-only query as @item, with metadata at least as fresh, or %NULL
+ **/
+static PkSchedulerItem *
+pk_scheduler_find_leader (PkScheduler *scheduler, PkSchedulerItem *item)
+{
+	GPtrArray *array = scheduler->priv->array;
+	const gchar *key;
+
+	key = pk_transaction_get_query_key (item->transaction);
+	if (key == NULL)
+		return NULL;
+
+	for (guint i = 0; i < array->len; i++) {
+		PkSchedulerItem *leader = g_ptr_array_index (array, i);
+		PkTransactionState state;
+
+		if (leader == item || leader->leader_tid != NULL)
+			continue;
+		state = pk_transaction_get_state (leader->transaction);
+		if (state != PK_TRANSACTION_STATE_READY &&
+		    state != PK_TRANSACTION_STATE_RUNNING)
+			continue;
+
+		/* don't wait for something that is going to be cancelled */
+		if (pk_transaction_get_background (leader->transaction) &&
+		    !pk_transaction_get_background (item->transaction))
+			continue;
+		if (pk_transaction_can_follow (item->transaction, leader->transaction))
+			return leader;
+	}
+	return NULL;
+}
+
+/**
+ * pk_scheduler_release_followers:
+ *
+ * Hands the results of the finished @leader to all the transactions that
+ * were waiting for the same query, or lets them run on their own if the
+ * results cannot be used.
+ **/
+static void
+pk_scheduler_release_followers (PkScheduler *scheduler, PkSchedulerItem *leader)
+{
+	GPtrArray *array = scheduler->priv->array;
+
+	for (guint i = 0; i < array->len; i++) {
+		PkSchedulerItem *item = g_ptr_array_index (array, i);
+
+		if (g_strcmp0 (item->leader_tid, leader->tid) != 0)
+			continue;
+		g_clear_pointer (&item->leader_tid, g_free);
+		if (pk_transaction_get_state (item->transaction) != PK_TRANSACTION_STATE_READY)
+			continue;
+
+		if (pk_transaction_share_results (item->transaction, leader->transaction)) {
+			g_debug ("%s uses the results of %s", item->tid, leader->tid);
+			pk_scheduler_run_item (scheduler, item);
+			continue;
+		}
+
+		/* run it like any other transaction */
+		pk_scheduler_check_exclusive (scheduler, item);
+		if (pk_scheduler_can_run (scheduler, item))
+			pk_scheduler_run_item (scheduler, item);
+	}
+}
+
 static PkSchedulerItem *
 pk_scheduler_get_next_item (PkScheduler *scheduler)
 {
@@ -399,26 +676,26 @@ pk_scheduler_get_next_item (PkScheduler *scheduler)
 	GPtrArray *array;
 	guint i;
 	PkTransactionState state;
-	gboolean exclusive_running;
 
 	array = scheduler->priv->array;
 
-	/* check for running exclusive transaction */
-	exclusive_running = pk_scheduler_get_exclusive_running (scheduler) > 0;
-
 	/* first try the waiting non-background transactions */
 	for (i = 0; i < array->len; i++) {
 		item = (PkSchedulerItem *) g_ptr_array_index (array, i);
 		state = pk_transaction_get_state (item->transaction);
 
+		/* waiting for an identical query to finish */
+		if (pk_scheduler_get_leader (scheduler, item) != NULL)
+			continue;
+
+		/* waiting for the package manager lock */
+		if (item->lock_monitor != NULL || item->lock_timeout_id != 0)
+			continue;
+
 		if ((state == PK_TRANSACTION_STATE_READY) && (!pk_transaction_get_background (item->transaction))) {
 			/* check if we can run the transaction now or if we need to wait for lock release */
-			if (pk_transaction_is_exclusive (item->transaction)) {
-				if (!exclusive_running)
-					goto out;
-			} else {
+			if (pk_scheduler_can_run (scheduler, item))
 				goto out;
-			}
 		}
 	}
 
@@ -427,14 +704,18 @@ pk_scheduler_get_next_item (PkScheduler *scheduler)
 		item = (PkSchedulerItem *) g_ptr_array_index (array, i);
 		state = pk_transaction_get_state (item->transaction);
 
+		/* waiting for an identical query to finish */
+		if (pk_scheduler_get_leader (scheduler, item) != NULL)
+			continue;
+
+		/* waiting for the package manager lock */
+		if (item->lock_monitor != NULL || item->lock_timeout_id != 0)
+			continue;
+
 		if (state == PK_TRANSACTION_STATE_READY) {
 			/* check if we can run the transaction now or if we need to wait for lock release */
-			if (pk_transaction_is_exclusive (item->transaction)) {
-				if (!exclusive_running)
-					goto out;
-			} else {
+			if (pk_scheduler_can_run (scheduler, item))
 				goto out;
-			}
 		}
 	}
 
@@ -448,6 +729,7 @@ static void
 pk_scheduler_commit (PkScheduler *scheduler, const gchar *tid)
 {
 	PkSchedulerItem *item;
+	PkSchedulerItem *leader;
 
 	g_return_if_fail (PK_IS_SCHEDULER (scheduler));
 	g_return_if_fail (tid != NULL);
@@ -458,10 +740,6 @@ pk_scheduler_commit (PkScheduler *scheduler, const gchar *tid)
 		return;
 	}
 
-	/* treat all transactions as exclusive if backend does not support parallelization */
-	if (!pk_backend_supports_parallelization (scheduler->priv->backend))
-		pk_transaction_make_exclusive (item->transaction);
-
 	/* we've been 'used' */
 	if (item->commit_id != 0) {
 		g_source_remove (item->commit_id);
@@ -471,18 +749,43 @@ pk_scheduler_commit (PkScheduler *scheduler, const gchar *tid)
 	/* we will changed what is running */
 	g_signal_emit (scheduler, signals [PK_SCHEDULER_CHANGED], 0);
 
+	/* something outside of PackageKit still has the lock */
+	if (item->lock_monitor != NULL || item->lock_timeout_id != 0) {
+		g_debug ("%s is waiting for the lock to be released", item->tid);
+		return;
+	}
+
+	/* the same query is already queued or running, so just wait for its
+	 * results; this never touches the backend so does not need to be
+	 * exclusive */
+	leader = pk_scheduler_find_leader (scheduler, item);
+	if (leader != NULL) {
+		g_debug ("%s is waiting for the results of %s", item->tid, leader->tid);
+		item->leader_tid = g_strdup (leader->tid);
+		return;
+	}
+
+	/* treat transactions as exclusive if the backend cannot run them in parallel */
+	pk_scheduler_check_exclusive (scheduler, item);
+
 	/* is one of the current running transactions background, and this new
-	 * transaction foreground? */
+	 * transaction foreground? A read-only query only needs them to stand
+	 * aside for a moment, everything else has to cancel them */
 	if (!pk_transaction_get_background (item->transaction) &&
 	    pk_scheduler_get_background_running (scheduler)) {
-		g_debug ("cancelling running background transactions and instead running %s",
-			item->tid);
-		pk_scheduler_cancel_background (scheduler);
+		if (pk_transaction_get_query_key (item->transaction) != NULL &&
+		    pk_scheduler_pause_background (scheduler)) {
+			g_debug ("pausing running background transactions to run %s",
+				 item->tid);
+		} else {
+			g_debug ("cancelling running background transactions and instead running %s",
+				 item->tid);
+			pk_scheduler_cancel_background (scheduler);
+		}
 	}
 
 	/* do the transaction now, if possible */
-	if (pk_transaction_is_exclusive (item->transaction) == FALSE ||
-	    pk_scheduler_get_exclusive_running (scheduler) == 0)
+	if (pk_scheduler_can_run (scheduler, item))
 		pk_scheduler_run_item (scheduler, item);
 }
 
@@ -511,6 +814,152 @@ pk_scheduler_transaction_state_changed_cb (PkTransaction *transaction,
 	}
 }
 
+static void
+pk_scheduler_transaction_paused_cb (PkTransaction *transaction,
+				    PkScheduler *scheduler)
+{
+	PkSchedulerItem *item;
+
+	item = pk_scheduler_get_from_tid (scheduler, pk_transaction_get_tid (transaction));
+	if (item == NULL)
+		return;
+	item->paused = TRUE;
+
+	/* let the queries we paused for run now */
+	while ((item = pk_scheduler_get_next_item (scheduler)) != NULL) {
+		g_debug ("running %s while background transactions are paused", item->tid);
+		pk_scheduler_run_item (scheduler, item);
+	}
+
+	/* they may all have finished while we were waiting for the checkpoint */
+	pk_scheduler_resume_background (scheduler);
+	g_signal_emit (scheduler, signals [PK_SCHEDULER_CHANGED], 0);
+}
+
+static void
+pk_scheduler_lock_released (PkSchedulerItem *item)
+{
+	pk_scheduler_item_stop_lock_wait (item);
+	if (pk_transaction_get_state (item->transaction) == PK_TRANSACTION_STATE_READY)
+		pk_scheduler_commit (item->scheduler, item->tid);
+}
+
+static void
+pk_scheduler_lock_changed_cb (GFileMonitor *monitor,
+			      GFile *file,
+			      GFile *other_file,
+			      GFileMonitorEvent event_type,
+			      PkSchedulerItem *item)
+{
+	/* lock files are either removed, or closed by the process holding
+	 * a fcntl() lock on them */
+	if (event_type != G_FILE_MONITOR_EVENT_DELETED &&
+	    event_type != G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT)
+		return;
+	g_debug ("lock file released, retrying %s", item->tid);
+	pk_scheduler_lock_released (item);
+}
+
+static gboolean
+pk_scheduler_lock_timeout_cb (gpointer user_data)
+{
+	PkSchedulerItem *item = (PkSchedulerItem *) user_data;
+	g_debug ("lock file not released in time, retrying %s anyway", item->tid);
+	item->lock_timeout_id = 0;
+	pk_scheduler_lock_released (item);
+	return FALSE;
+}
+
+static void
+pk_scheduler_lock_held_thread (GTask *task,
+			       gpointer source_object,
+			       gpointer task_data,
+			       GCancellable *cancellable)
+{
+	PkBackend *backend = PK_BACKEND (task_data);
+	g_task_return_boolean (task, pk_backend_is_lock_held (backend));
+}
+
+static void
+pk_scheduler_lock_held_cb (GObject *source_object,
+			   GAsyncResult *res,
+			   gpointer user_data)
+{
+	PkSchedulerItem *item = (PkSchedulerItem *) user_data;
+	gboolean held;
+	g_autoptr(GError) error = NULL;
+
+	/* the item may have been freed if it stopped waiting */
+	held = g_task_propagate_boolean (G_TASK (res), &error);
+	if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+		return;
+	if (held)
+		return;
+
+	/* left behind by a program that is no longer running, or released
+	 * before we started watching, so waiting would not help */
+	g_debug ("nobody holds the lock, retrying %s", item->tid);
+	pk_scheduler_lock_released (item);
+}
+
+/**
+ * pk_scheduler_wait_for_lock:
+ *
+ * Makes @item wait until the lock file of the backend is released by
+ * whoever is holding it, rather than retrying straight away.
+ **/
+static void
+pk_scheduler_wait_for_lock (PkScheduler *scheduler, PkSchedulerItem *item)
+{
+	GPtrArray *array = scheduler->priv->array;
+	const gchar *lock_file;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GFile) file = NULL;
+	g_autoptr(GTask) task = NULL;
+
+	lock_file = pk_backend_get_lock_file (scheduler->priv->backend);
+	if (lock_file == NULL)
+		return;
+
+	/* one of our own transactions has the lock, and we run the next
+	 * one when it finishes */
+	for (guint i = 0; i < array->len; i++) {
+		PkSchedulerItem *other = g_ptr_array_index (array, i);
+		if (other != item &&
+		    pk_transaction_get_state (other->transaction) == PK_TRANSACTION_STATE_RUNNING &&
+		    pk_transaction_is_exclusive (other->transaction))
+			return;
+	}
+
+	/* already gone, so waiting would not help */
+	if (!g_file_test (lock_file, G_FILE_TEST_EXISTS))
+		return;
+
+	file = g_file_new_for_path (lock_file);
+	item->lock_monitor = g_file_monitor_file (file, G_FILE_MONITOR_NONE, NULL, &error);
+	if (item->lock_monitor == NULL) {
+		g_warning ("failed to watch %s: %s", lock_file, error->message);
+		return;
+	}
+	g_signal_connect (item->lock_monitor, "changed",
+			  G_CALLBACK (pk_scheduler_lock_changed_cb), item);
+	item->lock_timeout_id = g_timeout_add_seconds (PK_SCHEDULER_LOCK_WAIT_TIMEOUT,
+						       pk_scheduler_lock_timeout_cb,
+						       item);
+	g_source_set_name_by_id (item->lock_timeout_id, "[PkScheduler] lock-wait");
+	g_debug ("%s is waiting for %s to be released", item->tid, lock_file);
+
+	/* finding out who holds the lock can mean looking through every
+	 * process, so don't block the daemon on it; this is done after we
+	 * started watching, so a release in the meantime is not missed */
+	item->lock_cancellable = g_cancellable_new ();
+	task = g_task_new (scheduler, item->lock_cancellable,
+			   pk_scheduler_lock_held_cb, item);
+	g_task_set_task_data (task, g_object_ref (scheduler->priv->backend),
+			      (GDestroyNotify) g_object_unref);
+	g_task_run_in_thread (task, pk_scheduler_lock_held_thread);
+}
+
 static void
 pk_scheduler_transaction_finished_cb (PkTransaction *transaction,
 				      PkScheduler *scheduler)
@@ -535,6 +984,10 @@ pk_scheduler_transaction_finished_cb (PkTransaction *transaction,
 	}
 
 	if (pk_transaction_is_finished_with_lock_required (item->transaction)) {
+		/* don't retry before the lock has been released */
+		if (item->tries < PK_SCHEDULER_MAX_LOCK_RETRIES)
+			pk_scheduler_wait_for_lock (scheduler, item);
+
 		pk_transaction_reset_after_lock_error (item->transaction);
 
 		/* increase the number of tries */
@@ -555,18 +1008,25 @@ pk_scheduler_transaction_finished_cb (PkTransaction *transaction,
 			return;
 		}
 	} else {
+		/* e.g. cancelled while waiting for the lock */
+		pk_scheduler_item_stop_lock_wait (item);
+
 		/* we've been 'used' */
 		if (item->commit_id != 0) {
 			g_source_remove (item->commit_id);
 			item->commit_id = 0;
 		}
 		pk_transaction_set_state (item->transaction, PK_TRANSACTION_STATE_FINISHED);
+		pk_metrics_add_transaction (scheduler->priv->metrics, item->transaction);
 
 		/* give the client a few seconds to still query the runner */
 		item->remove_id = g_timeout_add_seconds (PK_TRANSACTION_KEEP_FINISHED_TIMOUT,
 							 pk_scheduler_remove_item_cb,
 							 item);
 		g_source_set_name_by_id (item->remove_id, "[PkScheduler] remove");
+
+		/* everyone doing the same query can finish now */
+		pk_scheduler_release_followers (scheduler, item);
 	}
 
 	/* try to run the next transaction, if possible */
@@ -576,6 +1036,9 @@ pk_scheduler_transaction_finished_cb (PkTransaction *transaction,
 		pk_scheduler_run_item (scheduler, item);
 	}
 
+	/* nothing is in the way of paused background transactions now */
+	pk_scheduler_resume_background (scheduler);
+
 	/* we have changed what is running */
 	g_signal_emit (scheduler, signals [PK_SCHEDULER_CHANGED], 0);
 }
@@ -648,6 +1111,10 @@ pk_scheduler_create (PkScheduler *scheduler,
 		g_signal_connect_after (item->transaction, "allow-cancel-changed",
 					G_CALLBACK (pk_scheduler_transaction_allow_cancel_changed_cb),
 					scheduler);
+	item->paused_id =
+		g_signal_connect_after (item->transaction, "paused",
+					G_CALLBACK (pk_scheduler_transaction_paused_cb),
+					scheduler);
 
 	/* set transaction state */
 	pk_transaction_set_state (item->transaction, PK_TRANSACTION_STATE_NEW);
@@ -674,6 +1141,14 @@ pk_scheduler_create (PkScheduler *scheduler,
 					    scheduler->priv->backend);
 	}
 
+	/* identical queries share their results */
+	pk_transaction_set_results_cache (item->transaction,
+					  scheduler->priv->results_cache);
+
+	/* bursts of privileged transactions share polkit decisions */
+	pk_transaction_set_auth_cache (item->transaction,
+				       scheduler->priv->auth_cache);
+
 	/* get the uid for the transaction */
 	item->uid = pk_transaction_get_uid (item->transaction);
 
@@ -784,6 +1259,7 @@ pk_scheduler_cancel_background (PkScheduler *scheduler)
 			continue;
 		g_debug ("cancelling running background transaction %s",
 			 item->tid);
+		pk_scheduler_resume_item (item);
 		pk_transaction_cancel_bg (item->transaction);
 	}
 }
@@ -1056,6 +1532,12 @@ pk_scheduler_finalize (GObject *object)
 	g_key_file_unref (scheduler->priv->conf);
 	if (scheduler->priv->backend != NULL)
 		g_object_unref (scheduler->priv->backend);
+	if (scheduler->priv->results_cache != NULL)
+		g_object_unref (scheduler->priv->results_cache);
+	if (scheduler->priv->auth_cache != NULL)
+		g_object_unref (scheduler->priv->auth_cache);
+	if (scheduler->priv->metrics != NULL)
+		g_object_unref (scheduler->priv->metrics);
 
 	G_OBJECT_CLASS (pk_scheduler_parent_class)->finalize (object);
 }
@@ -1065,6 +1547,9 @@ pk_scheduler_new (GKeyFile *conf)
 {
 	PkScheduler *scheduler = PK_SCHEDULER (g_object_new (PK_TYPE_SCHEDULER, NULL));
 	scheduler->priv->conf = g_key_file_ref (conf);
+	scheduler->priv->results_cache = pk_results_cache_new (conf);
+	scheduler->priv->auth_cache = pk_auth_cache_new (conf);
+	scheduler->priv->metrics = pk_metrics_new (conf);
 	return scheduler;
 }
 
@@ -29,6 +29,9 @@
 #include "pk-backend-spawn.h"
 #include "pk-dbus.h"
 #include "pk-engine.h"
+#include "pk-auth-cache.h"
+#include "pk-metrics.h"
+#include "pk-results-cache.h"
 #include "pk-spawn.h"
 #include "pk-transaction-db.h"
 #include "pk-transaction.h"
@@ -753,6 +756,150 @@ pk_test_transaction_func (void)
 	g_dbus_node_info_unref (introspection);
 }
 
+static void
+pk_test_results_cache_func (void)
+{
+	g_autoptr(GKeyFile) conf = NULL;
+	g_autoptr(PkResultsCache) cache = NULL;
+	g_autoptr(PkResults) results = NULL;
+	g_autoptr(PkResults) tmp = NULL;
+
+	conf = g_key_file_new ();
+	cache = pk_results_cache_new (conf);
+	g_assert (pk_results_cache_get_enabled (cache));
+	results = pk_results_new ();
+
+	/* nothing cached yet */
+	tmp = pk_results_cache_lookup (cache, "get-updates", 1, G_MAXUINT);
+	g_assert (tmp == NULL);
+
+	/* same query in the same state */
+	pk_results_cache_add (cache, "get-updates", 1, G_MAXUINT, results);
+	tmp = pk_results_cache_lookup (cache, "get-updates", 1, G_MAXUINT);
+	g_assert (tmp == results);
+	g_clear_object (&tmp);
+
+	/* different query */
+	tmp = pk_results_cache_lookup (cache, "get-packages", 1, G_MAXUINT);
+	g_assert (tmp == NULL);
+
+	/* client wants newer metadata */
+	tmp = pk_results_cache_lookup (cache, "get-updates", 1, 0);
+	g_assert (tmp == NULL);
+	g_assert_cmpint (pk_results_cache_get_size (cache), ==, 1);
+
+	/* results from fresh metadata answer clients that accept older */
+	pk_results_cache_add (cache, "get-updates", 1, 60, results);
+	tmp = pk_results_cache_lookup (cache, "get-updates", 1, 3600);
+	g_assert (tmp == results);
+	g_clear_object (&tmp);
+	tmp = pk_results_cache_lookup (cache, "get-updates", 1, G_MAXUINT);
+	g_assert (tmp == results);
+	g_clear_object (&tmp);
+	tmp = pk_results_cache_lookup (cache, "get-updates", 1, 30);
+	g_assert (tmp == NULL);
+
+	/* the backend state changed */
+	pk_results_cache_add (cache, "get-updates", 1, G_MAXUINT, results);
+	tmp = pk_results_cache_lookup (cache, "get-updates", 2, G_MAXUINT);
+	g_assert (tmp == NULL);
+	g_assert_cmpint (pk_results_cache_get_size (cache), ==, 0);
+
+	/* stale entries are dropped when new results are added */
+	pk_results_cache_add (cache, "get-packages", 1, G_MAXUINT, results);
+	pk_results_cache_add (cache, "get-updates", 2, G_MAXUINT, results);
+	g_assert_cmpint (pk_results_cache_get_size (cache), ==, 1);
+
+	/* disabled */
+	g_key_file_set_integer (conf, "Daemon", "QueryCacheTimeout", 0);
+	g_clear_object (&cache);
+	cache = pk_results_cache_new (conf);
+	g_assert (!pk_results_cache_get_enabled (cache));
+	pk_results_cache_add (cache, "get-updates", 1, G_MAXUINT, results);
+	g_assert_cmpint (pk_results_cache_get_size (cache), ==, 0);
+}
+
+static void
+pk_test_auth_cache_func (void)
+{
+	g_autoptr(GKeyFile) conf = NULL;
+	g_autoptr(PkAuthCache) cache = NULL;
+	g_autoptr(PolkitDetails) details = NULL;
+	g_autoptr(PolkitAuthorizationResult) result = NULL;
+	PkBitfield flags = pk_bitfield_value (PK_TRANSACTION_FLAG_ENUM_ONLY_TRUSTED);
+
+	/* disabled by default */
+	conf = g_key_file_new ();
+	cache = pk_auth_cache_new (conf);
+	g_assert (!pk_auth_cache_get_enabled (cache));
+	pk_auth_cache_add (cache, 500, "xxx", "org.freedesktop.packagekit.package-install", flags);
+	g_assert (!pk_auth_cache_lookup (cache, 500, "xxx", "org.freedesktop.packagekit.package-install", flags));
+
+	g_key_file_set_integer (conf, "Daemon", "AuthCacheTimeout", 60);
+	g_clear_object (&cache);
+	cache = pk_auth_cache_new (conf);
+	g_assert (pk_auth_cache_get_enabled (cache));
+
+	/* same caller and action */
+	pk_auth_cache_add (cache, 500, "xxx", "org.freedesktop.packagekit.package-install", flags);
+	g_assert (pk_auth_cache_lookup (cache, 500, "xxx", "org.freedesktop.packagekit.package-install", flags));
+
+	/* different uid, session, action or flags */
+	g_assert (!pk_auth_cache_lookup (cache, 501, "xxx", "org.freedesktop.packagekit.package-install", flags));
+	g_assert (!pk_auth_cache_lookup (cache, 500, "yyy", "org.freedesktop.packagekit.package-install", flags));
+	g_assert (!pk_auth_cache_lookup (cache, 500, "xxx", "org.freedesktop.packagekit.package-remove", flags));
+	g_assert (!pk_auth_cache_lookup (cache, 500, "xxx", "org.freedesktop.packagekit.package-install", 0));
+
+	/* only decisions made without a dialog are reused */
+	details = polkit_details_new ();
+	result = polkit_authorization_result_new (TRUE, FALSE, details);
+	g_assert (pk_auth_cache_result_is_reusable (result, POLKIT_CHECK_AUTHORIZATION_FLAGS_NONE));
+	g_assert (!pk_auth_cache_result_is_reusable (result, POLKIT_CHECK_AUTHORIZATION_FLAGS_ALLOW_USER_INTERACTION));
+	g_clear_object (&result);
+	result = polkit_authorization_result_new (FALSE, TRUE, details);
+	g_assert (!pk_auth_cache_result_is_reusable (result, POLKIT_CHECK_AUTHORIZATION_FLAGS_NONE));
+	g_clear_object (&result);
+	polkit_details_insert (details, "polkit.temporary_authorization_id", "tmpauthz0");
+	result = polkit_authorization_result_new (TRUE, FALSE, details);
+	g_assert (!pk_auth_cache_result_is_reusable (result, POLKIT_CHECK_AUTHORIZATION_FLAGS_NONE));
+
+	/* polkit configuration changed */
+	pk_auth_cache_invalidate (cache);
+	g_assert_cmpint (pk_auth_cache_get_size (cache), ==, 0);
+	g_assert (!pk_auth_cache_lookup (cache, 500, "xxx", "org.freedesktop.packagekit.package-install", flags));
+}
+
+static void
+pk_test_metrics_func (void)
+{
+	g_autoptr(GKeyFile) conf = NULL;
+	g_autoptr(PkMetrics) metrics = NULL;
+	g_autofree gchar *text = NULL;
+
+	/* disabled by default */
+	conf = g_key_file_new ();
+	metrics = pk_metrics_new (conf);
+	g_assert (!pk_metrics_get_enabled (metrics));
+
+	/* nothing observed yet */
+	text = pk_metrics_to_string (metrics);
+	g_assert (g_strstr_len (text, -1, "# TYPE packagekit_transaction_phase_seconds histogram\n") != NULL);
+	g_assert (g_strstr_len (text, -1, "_bucket{") == NULL);
+	g_clear_pointer (&text, g_free);
+
+	/* buckets are cumulative */
+	pk_metrics_observe (metrics, PK_ROLE_ENUM_INSTALL_PACKAGES, PK_TRANSACTION_PHASE_QUEUE, 2000);
+	pk_metrics_observe (metrics, PK_ROLE_ENUM_INSTALL_PACKAGES, PK_TRANSACTION_PHASE_QUEUE, 5000);
+	pk_metrics_observe (metrics, PK_ROLE_ENUM_INSTALL_PACKAGES, PK_TRANSACTION_PHASE_QUEUE, 2000000);
+	text = pk_metrics_to_string (metrics);
+	g_assert (g_strstr_len (text, -1, "packagekit_transaction_phase_seconds_bucket{role=\"install-packages\",phase=\"queue\",le=\"0.001\"} 0\n") != NULL);
+	g_assert (g_strstr_len (text, -1, "packagekit_transaction_phase_seconds_bucket{role=\"install-packages\",phase=\"queue\",le=\"0.005\"} 2\n") != NULL);
+	g_assert (g_strstr_len (text, -1, "packagekit_transaction_phase_seconds_bucket{role=\"install-packages\",phase=\"queue\",le=\"+Inf\"} 3\n") != NULL);
+	g_assert (g_strstr_len (text, -1, "packagekit_transaction_phase_seconds_sum{role=\"install-packages\",phase=\"queue\"} 2.007000\n") != NULL);
+	g_assert (g_strstr_len (text, -1, "packagekit_transaction_phase_seconds_count{role=\"install-packages\",phase=\"queue\"} 3\n") != NULL);
+	g_assert (g_strstr_len (text, -1, "role=\"remove-packages\"") == NULL);
+}
+
 static void
 pk_test_transaction_db_func (void)
 {
@@ -1214,6 +1361,203 @@ pk_test_scheduler_func (void)
 	g_object_unref (db);
 }
 
+static guint _paused_count = 0;
+
+static void
+pk_test_scheduler_paused_cb (PkTransaction *transaction, gpointer user_data)
+{
+	PkTransaction *query = PK_TRANSACTION (user_data);
+
+	/* the scheduler has already started the query it paused for */
+	g_assert_cmpint (pk_transaction_get_state (query), ==, PK_TRANSACTION_STATE_RUNNING);
+	_paused_count++;
+}
+
+static void
+pk_test_scheduler_pause_func (void)
+{
+	gboolean ret;
+	gchar **array;
+	PkBackendJob *job;
+	PkTransaction *transaction1;
+	PkTransaction *transaction2;
+	GError *error = NULL;
+	g_autofree gchar *tid_item1 = NULL;
+	g_autofree gchar *tid_item2 = NULL;
+	g_autoptr(GKeyFile) conf = NULL;
+	g_autoptr(PkBackend) backend = NULL;
+	g_autoptr(PkScheduler) tlist = NULL;
+
+	db = pk_transaction_db_new ();
+	ret = pk_transaction_db_load (db, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* try to load a valid backend */
+	conf = g_key_file_new ();
+	g_key_file_set_string (conf, "Daemon", "MaximumPackagesToProcess", "1000");
+	g_key_file_set_string (conf, "Daemon", "DefaultBackend", "dummy");
+	backend = pk_backend_new (conf);
+	ret = pk_backend_load (backend, NULL);
+	g_assert (ret);
+
+	/* get a transaction list object */
+	tlist = pk_scheduler_new (conf);
+	g_assert (tlist != NULL);
+	pk_scheduler_set_backend (tlist, backend);
+
+	tid_item1 = pk_test_scheduler_create_transaction (tlist);
+	tid_item2 = pk_test_scheduler_create_transaction (tlist);
+	transaction1 = pk_scheduler_get_transaction (tlist, tid_item1);
+	transaction2 = pk_scheduler_get_transaction (tlist, tid_item2);
+	g_signal_connect (transaction1, "finished",
+			  G_CALLBACK (pk_test_scheduler_finished_cb), NULL);
+	g_signal_connect (transaction2, "finished",
+			  G_CALLBACK (pk_test_scheduler_finished_cb), NULL);
+	g_signal_connect (transaction1, "paused",
+			  G_CALLBACK (pk_test_scheduler_paused_cb), transaction2);
+
+	/* start a refresh in the background */
+	job = pk_transaction_get_backend_job (transaction1);
+	pk_backend_job_set_background (job, TRUE);
+	pk_transaction_skip_auth_checks (transaction1, TRUE);
+	pk_transaction_refresh_cache (transaction1,
+				      g_variant_new ("(b)", FALSE),
+				      NULL);
+	g_assert_cmpint (pk_transaction_get_state (transaction1), ==, PK_TRANSACTION_STATE_RUNNING);
+
+	/* let the backend thread start */
+	_g_test_loop_wait (100);
+	g_assert (pk_backend_job_get_pausable (job));
+	g_assert (!pk_backend_job_get_paused (job));
+
+	/* an interactive query pauses it */
+	_paused_count = 0;
+	array = g_strsplit ("power", " ", -1);
+	pk_transaction_search_names (transaction2,
+				     g_variant_new ("(t^as)",
+						    pk_bitfield_value (PK_FILTER_ENUM_NONE),
+						    array),
+				     NULL);
+	g_strfreev (array);
+	g_assert (pk_backend_job_get_paused (job));
+	g_assert_cmpint (pk_transaction_get_state (transaction1), ==, PK_TRANSACTION_STATE_RUNNING);
+
+	/* the refresh stops at its next checkpoint, and is resumed once
+	 * the query has finished */
+	_g_test_loop_run_with_timeout (5000);
+	g_assert_cmpint (_paused_count, ==, 1);
+	g_assert_cmpint (pk_transaction_get_state (transaction2), ==, PK_TRANSACTION_STATE_FINISHED);
+	g_assert_cmpint (pk_transaction_get_state (transaction1), ==, PK_TRANSACTION_STATE_RUNNING);
+	g_assert (!pk_backend_job_get_paused (job));
+
+	/* and completes as if nothing happened */
+	_g_test_loop_run_with_timeout (10000);
+	g_assert_cmpint (pk_transaction_get_state (transaction1), ==, PK_TRANSACTION_STATE_FINISHED);
+	g_assert_cmpint (pk_results_get_exit_code (pk_transaction_get_results (transaction1)), ==, PK_EXIT_ENUM_SUCCESS);
+	g_assert_cmpint (_paused_count, ==, 1);
+
+	g_object_unref (db);
+}
+
+static guint _finished_count = 0;
+
+static void
+pk_test_scheduler_coalesce_finished_cb (PkTransaction *transaction, const gchar *exit_text, guint time, gpointer user_data)
+{
+	if (++_finished_count == 2)
+		_g_test_loop_quit ();
+}
+
+static void
+pk_test_scheduler_coalesce_func (void)
+{
+	gboolean ret;
+	gchar **array;
+	PkTransaction *transaction1;
+	PkTransaction *transaction2;
+	GError *error = NULL;
+	g_autofree gchar *tid_item1 = NULL;
+	g_autofree gchar *tid_item2 = NULL;
+	g_autoptr(GKeyFile) conf = NULL;
+	g_autoptr(GPtrArray) packages1 = NULL;
+	g_autoptr(GPtrArray) packages2 = NULL;
+	g_autoptr(PkBackend) backend = NULL;
+	g_autoptr(PkScheduler) tlist = NULL;
+
+	db = pk_transaction_db_new ();
+	ret = pk_transaction_db_load (db, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* try to load a valid backend */
+	conf = g_key_file_new ();
+	g_key_file_set_string (conf, "Daemon", "MaximumPackagesToProcess", "1000");
+	g_key_file_set_string (conf, "Daemon", "DefaultBackend", "dummy");
+	backend = pk_backend_new (conf);
+	ret = pk_backend_load (backend, NULL);
+	g_assert (ret);
+
+	/* get a transaction list object */
+	tlist = pk_scheduler_new (conf);
+	g_assert (tlist != NULL);
+	pk_scheduler_set_backend (tlist, backend);
+
+	tid_item1 = pk_test_scheduler_create_transaction (tlist);
+	tid_item2 = pk_test_scheduler_create_transaction (tlist);
+	transaction1 = pk_scheduler_get_transaction (tlist, tid_item1);
+	g_signal_connect (transaction1, "finished",
+			  G_CALLBACK (pk_test_scheduler_coalesce_finished_cb), NULL);
+	transaction2 = pk_scheduler_get_transaction (tlist, tid_item2);
+	g_signal_connect (transaction2, "finished",
+			  G_CALLBACK (pk_test_scheduler_coalesce_finished_cb), NULL);
+
+	/* this starts the backend */
+	array = g_strsplit ("power", " ", -1);
+	pk_transaction_search_names (transaction1,
+				     g_variant_new ("(t^as)",
+						    pk_bitfield_value (PK_FILTER_ENUM_NONE),
+						    array),
+				     NULL);
+
+	/* the same query again, which waits for the first one */
+	pk_transaction_search_names (transaction2,
+				     g_variant_new ("(t^as)",
+						    pk_bitfield_value (PK_FILTER_ENUM_NONE),
+						    array),
+				     NULL);
+	g_strfreev (array);
+	g_assert (pk_transaction_can_follow (transaction2, transaction1));
+	g_assert_cmpint (pk_transaction_get_state (transaction1), ==, PK_TRANSACTION_STATE_RUNNING);
+	g_assert_cmpint (pk_transaction_get_state (transaction2), ==, PK_TRANSACTION_STATE_READY);
+
+	/* only the first one was handed to the backend */
+	_g_test_loop_wait (500);
+	g_assert (pk_backend_job_get_started (pk_transaction_get_backend_job (transaction1)));
+	g_assert (!pk_backend_job_get_started (pk_transaction_get_backend_job (transaction2)));
+	g_assert_cmpint (pk_transaction_get_state (transaction2), ==, PK_TRANSACTION_STATE_READY);
+
+	/* the results are replayed once the first one finishes */
+	_finished_count = 0;
+	_g_test_loop_run_with_timeout (5000);
+	g_assert_cmpint (pk_transaction_get_state (transaction1), ==, PK_TRANSACTION_STATE_FINISHED);
+	g_assert_cmpint (pk_transaction_get_state (transaction2), ==, PK_TRANSACTION_STATE_FINISHED);
+	g_assert_cmpint (pk_results_get_exit_code (pk_transaction_get_results (transaction2)), ==, PK_EXIT_ENUM_SUCCESS);
+
+	/* with exactly the same packages */
+	packages1 = pk_results_get_package_array (pk_transaction_get_results (transaction1));
+	packages2 = pk_results_get_package_array (pk_transaction_get_results (transaction2));
+	g_assert_cmpint (packages1->len, >, 0);
+	g_assert_cmpint (packages1->len, ==, packages2->len);
+	for (guint i = 0; i < packages1->len; i++) {
+		PkPackage *pkg1 = g_ptr_array_index (packages1, i);
+		PkPackage *pkg2 = g_ptr_array_index (packages2, i);
+		g_assert_cmpstr (pk_package_get_id (pkg1), ==, pk_package_get_id (pkg2));
+	}
+
+	g_object_unref (db);
+}
+
 static void
 pk_test_scheduler_parallel_func (void)
 {
@@ -1442,7 +1786,12 @@ main (int argc, char **argv)
 	g_test_add_func ("/packagekit/spawn", pk_test_spawn_func);
 	g_test_add_func ("/packagekit/scheduler", pk_test_scheduler_func);
 	g_test_add_func ("/packagekit/scheduler-parallel", pk_test_scheduler_parallel_func);
+	g_test_add_func ("/packagekit/scheduler-coalesce", pk_test_scheduler_coalesce_func);
+	g_test_add_func ("/packagekit/scheduler-pause", pk_test_scheduler_pause_func);
 	g_test_add_func ("/packagekit/transaction-db", pk_test_transaction_db_func);
+	g_test_add_func ("/packagekit/results-cache", pk_test_results_cache_func);
+	g_test_add_func ("/packagekit/auth-cache", pk_test_auth_cache_func);
+	g_test_add_func ("/packagekit/metrics", pk_test_metrics_func);
 
 	/* backend stuff */
 	g_test_add_func ("/packagekit/backend", pk_test_backend_func);
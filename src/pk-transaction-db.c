@@ -451,6 +451,49 @@ pk_transaction_db_set_finished (PkTransactionDb *tdb, const gchar *tid, gboolean
 	return pk_transaction_db_step (tdb->priv->db, statement);
 }
 
+/**
+ * pk_transaction_db_set_phase_times:
+ *
+ * Saves where the duration of the transaction went, all times in ms.
+ **/
+gboolean
+pk_transaction_db_set_phase_times (PkTransactionDb *tdb,
+				   const gchar *tid,
+				   guint queue_time,
+				   guint auth_time,
+				   guint lock_time,
+				   guint run_time,
+				   guint emit_time)
+{
+	g_autoptr (sqlite3_stmt) statement = NULL;
+	const guint times[] = { queue_time, auth_time, lock_time, run_time, emit_time };
+	gint rc = 0;
+	guint i;
+
+	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
+	g_return_val_if_fail (tdb->priv->db != NULL, FALSE);
+	g_return_val_if_fail (tid != NULL, FALSE);
+
+	if (!pk_transaction_db_prepare (tdb, "UPDATE transactions SET queue_time=?1, auth_time=?2, "
+					"lock_time=?3, run_time=?4, emit_time=?5 WHERE transaction_id=?6",
+					&statement))
+		return FALSE;
+
+	for (i = 0; i < G_N_ELEMENTS (times); i++) {
+		if ((rc = sqlite3_bind_int (statement, i + 1, times[i])) != SQLITE_OK) {
+			g_warning ("bind int%u error: %d: %s", i + 1, rc, sqlite3_errmsg (tdb->priv->db));
+			return FALSE;
+		}
+	}
+
+	if ((rc = sqlite3_bind_text (statement, 6, tid, -1, SQLITE_STATIC)) != SQLITE_OK) {
+		g_warning ("bind text error: %d: %s", rc, sqlite3_errmsg (tdb->priv->db));
+		return FALSE;
+	}
+
+	return pk_transaction_db_step (tdb->priv->db, statement);
+}
+
 gboolean
 pk_transaction_db_print (PkTransactionDb *tdb)
 {
@@ -969,6 +1012,20 @@ pk_transaction_db_load (PkTransactionDb *tdb, GError **error)
 			return FALSE;
 	}
 
+	/* where the duration of a transaction went */
+	if (!pk_transaction_db_execute (tdb, "SELECT queue_time FROM transactions LIMIT 1", &error_local)) {
+		const gchar *columns[] = { "queue_time", "auth_time", "lock_time", "run_time", "emit_time", NULL };
+		g_debug ("adding phase times: %s", error_local->message);
+		g_clear_error (&error_local);
+		for (guint i = 0; columns[i] != NULL; i++) {
+			g_autofree gchar *alter = NULL;
+			alter = g_strdup_printf ("ALTER TABLE transactions ADD COLUMN %s INTEGER DEFAULT 0;",
+						 columns[i]);
+			if (!pk_transaction_db_execute (tdb, alter, error))
+				return FALSE;
+		}
+	}
+
 	/* try to set correct permissions */
 	g_chmod (PK_DB_DIR "/transactions.db", 0644);
 
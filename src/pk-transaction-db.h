@@ -72,6 +72,13 @@ gboolean	 pk_transaction_db_set_finished		(PkTransactionDb	*tdb,
 							 const gchar		*tid,
 							 gboolean		 success,
 							 guint			 runtime);
+gboolean	 pk_transaction_db_set_phase_times	(PkTransactionDb	*tdb,
+							 const gchar		*tid,
+							 guint			 queue_time,
+							 guint			 auth_time,
+							 guint			 lock_time,
+							 guint			 run_time,
+							 guint			 emit_time);
 gboolean	 pk_transaction_db_set_data		(PkTransactionDb	*tdb,
 							 const gchar		*tid,
 							 const gchar		*data);
@@ -106,6 +106,8 @@ struct PkTransactionPrivate
 	PkDbus			*dbus;
 	PolkitAuthority		*authority;
 	PolkitSubject		*subject;
+	PkAuthCache		*auth_cache;
+	gchar			*auth_session;
 	GCancellable		*cancellable;
 	gboolean		 skip_auth_check;
 	gboolean		 client_supports_plural_signals;
@@ -121,6 +123,14 @@ struct PkTransactionPrivate
 	gchar			*cmdline;
 	PkResults		*results;
 	PkTransactionDb		*transaction_db;
+	PkResultsCache		*results_cache;
+	gint64			 state_time;
+	gint64			 lock_time;
+	guint64			 phase_time[PK_TRANSACTION_PHASE_LAST];
+	gchar			*results_cache_key;
+	guint			 results_cache_generation;
+	gboolean		 results_from_cache;
+	PkResults		*shared_results;
 
 	/* cached */
 	gboolean		 cached_force;
@@ -177,6 +187,7 @@ enum {
 	SIGNAL_FINISHED,
 	SIGNAL_STATE_CHANGED,
 	SIGNAL_ALLOW_CANCEL_CHANGED,
+	SIGNAL_PAUSED,
 	SIGNAL_LAST
 };
 
@@ -275,6 +286,291 @@ pk_transaction_get_background (PkTransaction *transaction)
 	return pk_backend_job_get_background (transaction->priv->job);
 }
 
+/* queries that only read the package state, so their results are
+ * valid as long as the backend state generation does not change */
+static gboolean
+pk_transaction_role_is_cacheable (PkRoleEnum role)
+{
+	switch (role) {
+	case PK_ROLE_ENUM_DEPENDS_ON:
+	case PK_ROLE_ENUM_GET_CATEGORIES:
+	case PK_ROLE_ENUM_GET_DETAILS:
+	case PK_ROLE_ENUM_GET_FILES:
+	case PK_ROLE_ENUM_GET_PACKAGES:
+	case PK_ROLE_ENUM_GET_REPO_LIST:
+	case PK_ROLE_ENUM_GET_UPDATE_DETAIL:
+	case PK_ROLE_ENUM_GET_UPDATES:
+	case PK_ROLE_ENUM_REQUIRED_BY:
+	case PK_ROLE_ENUM_RESOLVE:
+	case PK_ROLE_ENUM_SEARCH_DETAILS:
+	case PK_ROLE_ENUM_SEARCH_FILE:
+	case PK_ROLE_ENUM_SEARCH_GROUP:
+	case PK_ROLE_ENUM_SEARCH_NAME:
+	case PK_ROLE_ENUM_WHAT_PROVIDES:
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+/* length prefixed, so that no separator can make two queries look alike */
+static void
+pk_transaction_results_cache_key_add (GString *key, const gchar *value)
+{
+	if (value == NULL) {
+		g_string_append (key, "-;");
+		return;
+	}
+	g_string_append_printf (key, "%" G_GSIZE_FORMAT ":%s;", strlen (value), value);
+}
+
+static void
+pk_transaction_results_cache_key_add_strv (GString *key, gchar **values)
+{
+	if (values == NULL) {
+		g_string_append (key, "-;");
+		return;
+	}
+	g_string_append_printf (key, "%u:", g_strv_length (values));
+	for (guint i = 0; values[i] != NULL; i++)
+		pk_transaction_results_cache_key_add (key, values[i]);
+}
+
+static gchar *
+pk_transaction_results_cache_get_key (PkTransaction *transaction)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+	GString *key = g_string_new (NULL);
+	g_autofree gchar *filters = NULL;
+
+	filters = pk_filter_bitfield_to_string (priv->cached_filters);
+	pk_transaction_results_cache_key_add (key, pk_role_enum_to_string (priv->role));
+	/* backends like nix answer from the profile of the caller */
+	g_string_append_printf (key, "%u;", priv->client_uid);
+	pk_transaction_results_cache_key_add (key, filters);
+	pk_transaction_results_cache_key_add (key, pk_backend_job_get_locale (priv->job));
+	pk_transaction_results_cache_key_add (key, pk_backend_bool_to_string (priv->cached_force));
+	pk_transaction_results_cache_key_add_strv (key, priv->cached_package_ids);
+	pk_transaction_results_cache_key_add_strv (key, priv->cached_values);
+	return g_string_free (key, FALSE);
+}
+
+/**
+ * pk_transaction_get_solved_plan_key:
+ *
+ * Returns: a key that is the same for a simulation and the real
+ * transaction that follows it, or %NULL if the role resolves no
+ * dependencies
+ **/
+static gchar *
+pk_transaction_get_solved_plan_key (PkTransaction *transaction)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+	PkBitfield transaction_flags = priv->cached_transaction_flags;
+	GString *key;
+	g_autofree gchar *flags = NULL;
+
+	if (priv->role != PK_ROLE_ENUM_INSTALL_PACKAGES &&
+	    priv->role != PK_ROLE_ENUM_REMOVE_PACKAGES &&
+	    priv->role != PK_ROLE_ENUM_UPDATE_PACKAGES)
+		return NULL;
+
+	pk_bitfield_remove (transaction_flags, PK_TRANSACTION_FLAG_ENUM_SIMULATE);
+	flags = pk_transaction_flag_bitfield_to_string (transaction_flags);
+	key = g_string_new (NULL);
+	pk_transaction_results_cache_key_add (key, pk_role_enum_to_string (priv->role));
+	pk_transaction_results_cache_key_add (key, flags);
+	pk_transaction_results_cache_key_add (key, pk_backend_bool_to_string (priv->cached_allow_deps));
+	pk_transaction_results_cache_key_add (key, pk_backend_bool_to_string (priv->cached_autoremove));
+	pk_transaction_results_cache_key_add_strv (key, priv->cached_package_ids);
+	return g_string_free (key, FALSE);
+}
+
+/**
+ * pk_transaction_get_query_key:
+ *
+ * Returns: a key that is the same for all transactions doing the same
+ * read-only query, or %NULL if the role changes or downloads something
+ **/
+const gchar *
+pk_transaction_get_query_key (PkTransaction *transaction)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+
+	g_return_val_if_fail (PK_IS_TRANSACTION (transaction), NULL);
+
+	if (!pk_transaction_role_is_cacheable (priv->role))
+		return NULL;
+	if (priv->results_cache_key == NULL)
+		priv->results_cache_key = pk_transaction_results_cache_get_key (transaction);
+	return priv->results_cache_key;
+}
+
+/**
+ * pk_transaction_can_follow:
+ * @transaction: a transaction that has not been run yet
+ * @leader: a transaction doing the same query
+ *
+ * The query key includes the uid of the caller, so results are never
+ * handed to another user. The cache-age hint is not part of the key, so
+ * @leader may only be followed if it asked for metadata at least as fresh
+ * as @transaction.
+ *
+ * Returns: %TRUE if the results of @leader answer @transaction
+ **/
+gboolean
+pk_transaction_can_follow (PkTransaction *transaction, PkTransaction *leader)
+{
+	const gchar *key;
+
+	g_return_val_if_fail (PK_IS_TRANSACTION (transaction), FALSE);
+	g_return_val_if_fail (PK_IS_TRANSACTION (leader), FALSE);
+
+	key = pk_transaction_get_query_key (transaction);
+	if (key == NULL || g_strcmp0 (key, pk_transaction_get_query_key (leader)) != 0)
+		return FALSE;
+	return pk_backend_job_get_cache_age (leader->priv->job) <=
+	       pk_backend_job_get_cache_age (transaction->priv->job);
+}
+
+/**
+ * pk_transaction_share_results:
+ * @transaction: a transaction that has not been run yet
+ * @leader: a finished transaction that did the same query
+ *
+ * Makes @transaction emit the results of @leader when it is run, rather
+ * than asking the backend again.
+ *
+ * Returns: %FALSE if the results of @leader cannot be used
+ **/
+gboolean
+pk_transaction_share_results (PkTransaction *transaction, PkTransaction *leader)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+
+	g_return_val_if_fail (PK_IS_TRANSACTION (transaction), FALSE);
+	g_return_val_if_fail (PK_IS_TRANSACTION (leader), FALSE);
+
+	if (!leader->priv->finished ||
+	    pk_results_get_exit_code (leader->priv->results) != PK_EXIT_ENUM_SUCCESS)
+		return FALSE;
+	if (!pk_transaction_can_follow (transaction, leader))
+		return FALSE;
+
+	/* something changed while the leader was running */
+	if (leader->priv->results_cache_generation != pk_backend_get_state_generation (leader->priv->backend))
+		return FALSE;
+
+	if (priv->shared_results != NULL)
+		g_object_unref (priv->shared_results);
+	priv->shared_results = g_object_ref (leader->priv->results);
+	return TRUE;
+}
+
+/**
+ * pk_transaction_results_cache_lookup:
+ *
+ * Returns: (transfer full): the results of an identical query that was
+ * run while the backend was in the same state, or %NULL
+ **/
+static PkResults *
+pk_transaction_results_cache_lookup (PkTransaction *transaction)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+	PkResults *results;
+
+	if (!pk_transaction_role_is_cacheable (priv->role))
+		return NULL;
+
+	/* the results will describe the state we are in now */
+	priv->results_cache_generation = pk_backend_get_state_generation (priv->backend);
+
+	/* an identical query finished while we were waiting for it */
+	if (priv->shared_results != NULL) {
+		g_debug ("using shared results for %s", priv->tid);
+		return g_object_ref (priv->shared_results);
+	}
+
+	if (priv->results_cache == NULL ||
+	    !pk_results_cache_get_enabled (priv->results_cache))
+		return NULL;
+
+	/* the client may want results from fresher metadata than we keep */
+	results = pk_results_cache_lookup (priv->results_cache,
+					   pk_transaction_get_query_key (transaction),
+					   priv->results_cache_generation,
+					   pk_backend_job_get_cache_age (priv->job));
+	if (results != NULL)
+		g_debug ("using cached results for %s", priv->tid);
+	return results;
+}
+
+/* emits the cached results through the job, just like the backend would */
+static void
+pk_transaction_results_cache_replay (PkTransaction *transaction, PkResults *results)
+{
+	PkBackendJob *job = transaction->priv->job;
+	g_autoptr(GPtrArray) packages = NULL;
+	g_autoptr(GPtrArray) details = NULL;
+	g_autoptr(GPtrArray) update_details = NULL;
+	g_autoptr(GPtrArray) files = NULL;
+	g_autoptr(GPtrArray) repo_details = NULL;
+	g_autoptr(GPtrArray) categories = NULL;
+
+	transaction->priv->results_from_cache = TRUE;
+	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
+
+	packages = pk_results_get_package_array (results);
+	pk_backend_job_packages (job, packages);
+
+	details = pk_results_get_details_array (results);
+	for (guint i = 0; i < details->len; i++) {
+		PkDetails *item = g_ptr_array_index (details, i);
+		pk_backend_job_details_full (job,
+					     pk_details_get_package_id (item),
+					     pk_details_get_summary (item),
+					     pk_details_get_license (item),
+					     pk_details_get_group (item),
+					     pk_details_get_description (item),
+					     pk_details_get_url (item),
+					     pk_details_get_size (item),
+					     pk_details_get_download_size (item));
+	}
+
+	update_details = pk_results_get_update_detail_array (results);
+	pk_backend_job_update_details (job, update_details);
+
+	files = pk_results_get_files_array (results);
+	for (guint i = 0; i < files->len; i++) {
+		PkFiles *item = g_ptr_array_index (files, i);
+		pk_backend_job_files (job,
+				      pk_files_get_package_id (item),
+				      pk_files_get_files (item));
+	}
+
+	repo_details = pk_results_get_repo_detail_array (results);
+	for (guint i = 0; i < repo_details->len; i++) {
+		PkRepoDetail *item = g_ptr_array_index (repo_details, i);
+		pk_backend_job_repo_detail (job,
+					    pk_repo_detail_get_id (item),
+					    pk_repo_detail_get_description (item),
+					    pk_repo_detail_get_enabled (item));
+	}
+
+	categories = pk_results_get_category_array (results);
+	for (guint i = 0; i < categories->len; i++) {
+		PkCategory *item = g_ptr_array_index (categories, i);
+		pk_backend_job_category (job,
+					 pk_category_get_parent_id (item),
+					 pk_category_get_id (item),
+					 pk_category_get_name (item),
+					 pk_category_get_summary (item),
+					 pk_category_get_icon (item));
+	}
+
+	pk_backend_job_finished (job);
+}
+
 static gboolean
 pk_transaction_finish_invalidate_caches (PkTransaction *transaction)
 {
@@ -661,6 +957,11 @@ pk_transaction_error_code_cb (PkBackendJob *job,
 		/* the backend failed to get lock for this action, this means this transaction has to be run in exclusive mode */
 		g_debug ("changing transaction to exclusive mode (after failing with lock-required)");
 		transaction->priv->exclusive = TRUE;
+	} else if (code == PK_ERROR_ENUM_LOCK_REQUIRED &&
+		   pk_backend_get_lock_file (transaction->priv->backend) != NULL) {
+		/* something outside of PackageKit has the lock, and the
+		 * scheduler will retry when it is released */
+		g_debug ("exclusive transaction failed with lock-required");
 	} else {
 		/* emit, as it is not the internally-handled LOCK_REQUIRED code */
 		pk_transaction_error_code_emit (transaction, code, details);
@@ -858,6 +1159,129 @@ pk_transaction_state_to_string (PkTransactionState state)
 	return NULL;
 }
 
+const gchar *
+pk_transaction_phase_to_string (PkTransactionPhase phase)
+{
+	if (phase == PK_TRANSACTION_PHASE_AUTH)
+		return "auth";
+	if (phase == PK_TRANSACTION_PHASE_QUEUE)
+		return "queue";
+	if (phase == PK_TRANSACTION_PHASE_LOCK)
+		return "lock";
+	if (phase == PK_TRANSACTION_PHASE_RUN)
+		return "run";
+	if (phase == PK_TRANSACTION_PHASE_EMIT)
+		return "emit";
+	return NULL;
+}
+
+/**
+ * pk_transaction_get_phase_time:
+ *
+ * Return value: the time spent in @phase so far, in us
+ **/
+guint64
+pk_transaction_get_phase_time (PkTransaction *transaction, PkTransactionPhase phase)
+{
+	g_return_val_if_fail (PK_IS_TRANSACTION (transaction), 0);
+	g_return_val_if_fail (phase < PK_TRANSACTION_PHASE_LAST, 0);
+	return transaction->priv->phase_time[phase];
+}
+
+static GVariant *
+pk_transaction_get_phase_times_variant (PkTransaction *transaction)
+{
+	GVariantBuilder builder;
+	guint i;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{st}"));
+	for (i = 0; i < PK_TRANSACTION_PHASE_LAST; i++) {
+		g_variant_builder_add (&builder, "{st}",
+				       pk_transaction_phase_to_string (i),
+				       transaction->priv->phase_time[i]);
+	}
+	return g_variant_builder_end (&builder);
+}
+
+/* adds the time since the last state change to the phase of the state */
+static void
+pk_transaction_account_state_time (PkTransaction *transaction)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+	gint64 now = g_get_monotonic_time ();
+
+	/* already done by pk_transaction_account_finished() */
+	if (priv->finished)
+		return;
+
+	if (priv->state == PK_TRANSACTION_STATE_WAITING_FOR_AUTH)
+		priv->phase_time[PK_TRANSACTION_PHASE_AUTH] += now - priv->state_time;
+	else if (priv->state == PK_TRANSACTION_STATE_READY)
+		priv->phase_time[PK_TRANSACTION_PHASE_QUEUE] += now - priv->state_time;
+	else if (priv->state == PK_TRANSACTION_STATE_RUNNING)
+		priv->phase_time[PK_TRANSACTION_PHASE_RUN] += now - priv->state_time;
+	priv->state_time = now;
+}
+
+/* the backend reports waiting for a lock with its status */
+static void
+pk_transaction_account_lock_time (PkTransaction *transaction, PkStatusEnum status)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+
+	if (status == PK_STATUS_ENUM_WAITING_FOR_LOCK) {
+		if (priv->lock_time == 0)
+			priv->lock_time = g_get_monotonic_time ();
+		return;
+	}
+	if (priv->lock_time != 0) {
+		priv->phase_time[PK_TRANSACTION_PHASE_LOCK] += g_get_monotonic_time () - priv->lock_time;
+		priv->lock_time = 0;
+	}
+}
+
+/* called when the backend has finished */
+static void
+pk_transaction_account_finished (PkTransaction *transaction)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+	guint64 *phase_time = priv->phase_time;
+
+	pk_transaction_account_lock_time (transaction, PK_STATUS_ENUM_FINISHED);
+	if (priv->state == PK_TRANSACTION_STATE_RUNNING)
+		phase_time[PK_TRANSACTION_PHASE_RUN] += g_get_monotonic_time () - priv->state_time;
+
+	/* the lock wait is part of the time the backend was running */
+	phase_time[PK_TRANSACTION_PHASE_RUN] -= MIN (phase_time[PK_TRANSACTION_PHASE_RUN],
+						     phase_time[PK_TRANSACTION_PHASE_LOCK]);
+	phase_time[PK_TRANSACTION_PHASE_EMIT] = pk_backend_job_get_emit_time (priv->job);
+
+	g_debug ("%s spent %" G_GUINT64_FORMAT "ms in auth, %" G_GUINT64_FORMAT "ms queued, "
+		 "%" G_GUINT64_FORMAT "ms waiting for locks, %" G_GUINT64_FORMAT "ms running "
+		 "and %" G_GUINT64_FORMAT "ms emitting",
+		 priv->tid,
+		 phase_time[PK_TRANSACTION_PHASE_AUTH] / 1000,
+		 phase_time[PK_TRANSACTION_PHASE_QUEUE] / 1000,
+		 phase_time[PK_TRANSACTION_PHASE_LOCK] / 1000,
+		 phase_time[PK_TRANSACTION_PHASE_RUN] / 1000,
+		 phase_time[PK_TRANSACTION_PHASE_EMIT] / 1000);
+
+	/* only the roles that were added to the database have a row */
+	if (priv->role == PK_ROLE_ENUM_REMOVE_PACKAGES ||
+	    priv->role == PK_ROLE_ENUM_INSTALL_PACKAGES ||
+	    priv->role == PK_ROLE_ENUM_UPDATE_PACKAGES) {
+		pk_transaction_db_set_phase_times (priv->transaction_db, priv->tid,
+						   phase_time[PK_TRANSACTION_PHASE_QUEUE] / 1000,
+						   phase_time[PK_TRANSACTION_PHASE_AUTH] / 1000,
+						   phase_time[PK_TRANSACTION_PHASE_LOCK] / 1000,
+						   phase_time[PK_TRANSACTION_PHASE_RUN] / 1000,
+						   phase_time[PK_TRANSACTION_PHASE_EMIT] / 1000);
+	}
+	pk_transaction_emit_property_changed (transaction,
+					      "PhaseTimes",
+					      pk_transaction_get_phase_times_variant (transaction));
+}
+
 /**
  * pk_transaction_set_state:
  *
@@ -893,6 +1317,7 @@ pk_transaction_set_state (PkTransaction *transaction, PkTransactionState state)
 	}
 
 	g_debug ("transaction now %s", pk_transaction_state_to_string (state));
+	pk_transaction_account_state_time (transaction);
 	priv->state = state;
 	g_signal_emit (transaction, signals[SIGNAL_STATE_CHANGED], 0, state);
 
@@ -988,6 +1413,32 @@ pk_transaction_set_backend (PkTransaction *transaction,
 	pk_transaction_setup_mime_types (transaction);
 }
 
+void
+pk_transaction_set_results_cache (PkTransaction *transaction,
+				  PkResultsCache *results_cache)
+{
+	g_return_if_fail (PK_IS_TRANSACTION (transaction));
+	g_return_if_fail (PK_IS_RESULTS_CACHE (results_cache));
+
+	/* save a reference */
+	if (transaction->priv->results_cache != NULL)
+		g_object_unref (transaction->priv->results_cache);
+	transaction->priv->results_cache = g_object_ref (results_cache);
+}
+
+void
+pk_transaction_set_auth_cache (PkTransaction *transaction,
+			       PkAuthCache *auth_cache)
+{
+	g_return_if_fail (PK_IS_TRANSACTION (transaction));
+	g_return_if_fail (PK_IS_AUTH_CACHE (auth_cache));
+
+	/* save a reference */
+	if (transaction->priv->auth_cache != NULL)
+		g_object_unref (transaction->priv->auth_cache);
+	transaction->priv->auth_cache = g_object_ref (auth_cache);
+}
+
 /**
 * pk_transaction_get_backend_job:
 *
@@ -1000,6 +1451,18 @@ pk_transaction_get_backend_job (PkTransaction *transaction)
 	return transaction->priv->job;
 }
 
+/**
+* pk_transaction_get_results:
+*
+* Returns: (transfer none): the results emitted by this transaction so far
+**/
+PkResults *
+pk_transaction_get_results (PkTransaction *transaction)
+{
+	g_return_val_if_fail (PK_IS_TRANSACTION (transaction), NULL);
+	return transaction->priv->results;
+}
+
 /**
  * pk_transaction_is_finished_with_lock_required:
  **/
@@ -1199,9 +1662,39 @@ pk_transaction_finished_cb (PkBackendJob *job, PkExitEnum exit_enum, PkTransacti
 	if (exit_enum == PK_EXIT_ENUM_SUCCESS)
 		pk_transaction_finish_invalidate_caches (transaction);
 
+	/* anything but a query may have changed the system, even on failure */
+	if (!pk_transaction_role_is_cacheable (transaction->priv->role) &&
+	    !pk_bitfield_contain (transaction_flags, PK_TRANSACTION_FLAG_ENUM_SIMULATE))
+		pk_backend_state_changed (transaction->priv->backend);
+
+	/* the real transaction can reuse the dependency resolution */
+	if (exit_enum == PK_EXIT_ENUM_SUCCESS &&
+	    pk_bitfield_contain (transaction_flags, PK_TRANSACTION_FLAG_ENUM_SIMULATE)) {
+		g_autofree gchar *plan_key = NULL;
+		plan_key = pk_transaction_get_solved_plan_key (transaction);
+		if (plan_key != NULL)
+			pk_backend_keep_solved_plan (transaction->priv->backend,
+						     transaction->priv->job,
+						     plan_key);
+	}
+
+	/* identical queries can use these results until something changes */
+	if (exit_enum == PK_EXIT_ENUM_SUCCESS &&
+	    transaction->priv->results_cache != NULL &&
+	    pk_transaction_get_query_key (transaction) != NULL &&
+	    !transaction->priv->results_from_cache &&
+	    transaction->priv->results_cache_generation == pk_backend_get_state_generation (transaction->priv->backend)) {
+		pk_results_cache_add (transaction->priv->results_cache,
+				      pk_transaction_get_query_key (transaction),
+				      transaction->priv->results_cache_generation,
+				      pk_backend_job_get_cache_age (transaction->priv->job),
+				      transaction->priv->results);
+	}
+
 	/* find the length of time we have been running */
 	time_ms = pk_transaction_get_runtime (transaction);
 	g_debug ("backend was running for %i ms", time_ms);
+	pk_transaction_account_finished (transaction);
 
 	/* add to the database if we are going to log it */
 	if (transaction->priv->role == PK_ROLE_ENUM_UPDATE_PACKAGES ||
@@ -1276,8 +1769,9 @@ pk_transaction_finished_cb (PkBackendJob *job, PkExitEnum exit_enum, PkTransacti
 	/* this disconnects any pending signals */
 	pk_backend_job_disconnect_vfuncs (transaction->priv->job);
 
-	/* destroy the job */
-	pk_backend_stop_job (transaction->priv->backend, transaction->priv->job);
+	/* destroy the job, unless the backend never saw it */
+	if (!transaction->priv->results_from_cache)
+		pk_backend_stop_job (transaction->priv->backend, transaction->priv->job);
 
 	/* we emit last, as other backends will be running very soon after us, and we don't want to be notified */
 	pk_transaction_finished_emit (transaction, exit_enum, time_ms);
@@ -1753,9 +2247,15 @@ pk_transaction_status_changed_cb (PkBackendJob *job,
 	g_return_if_fail (PK_IS_TRANSACTION (transaction));
 	g_return_if_fail (transaction->priv->tid != NULL);
 
+	pk_transaction_account_lock_time (transaction, status);
+
 	/* don't proxy this on the bus, just for use internal */
-	if (status == PK_STATUS_ENUM_WAIT)
+	if (status == PK_STATUS_ENUM_WAIT) {
+		/* the backend stopped at a checkpoint as we asked it to */
+		if (pk_backend_job_get_paused (job))
+			g_signal_emit (transaction, signals[SIGNAL_PAUSED], 0);
 		return;
+	}
 
 	/* have we already been marked as finished? */
 	if (transaction->priv->finished) {
@@ -2034,6 +2534,7 @@ pk_transaction_run (PkTransaction *transaction)
 	GError *error = NULL;
 	PkExitEnum exit_status;
 	PkTransactionPrivate *priv = PK_TRANSACTION_GET_PRIVATE (transaction);
+	g_autoptr(PkResults) cached_results = NULL;
 
 	g_return_val_if_fail (PK_IS_TRANSACTION (transaction), FALSE);
 	g_return_val_if_fail (priv->tid != NULL, FALSE);
@@ -2056,8 +2557,12 @@ pk_transaction_run (PkTransaction *transaction)
 		return TRUE;
 	}
 
+	/* an identical query may already have been answered */
+	cached_results = pk_transaction_results_cache_lookup (transaction);
+
 	/* run the job */
-	pk_backend_start_job (priv->backend, priv->job);
+	if (cached_results == NULL)
+		pk_backend_start_job (priv->backend, priv->job);
 
 	/* is an error code set? */
 	if (pk_backend_job_get_is_error_set (priv->job)) {
@@ -2171,6 +2676,21 @@ pk_transaction_run (PkTransaction *transaction)
 				  PK_BACKEND_JOB_VFUNC (pk_transaction_category_cb),
 				  transaction);
 
+	/* nothing has changed since, so the backend does not need to know */
+	if (cached_results != NULL) {
+		pk_transaction_results_cache_replay (transaction, cached_results);
+		return TRUE;
+	}
+
+	/* the simulation may already have resolved the dependencies */
+	if (!pk_bitfield_contain (priv->cached_transaction_flags,
+				  PK_TRANSACTION_FLAG_ENUM_SIMULATE)) {
+		g_autofree gchar *plan_key = NULL;
+		plan_key = pk_transaction_get_solved_plan_key (transaction);
+		if (plan_key != NULL)
+			pk_backend_restore_solved_plan (priv->backend, priv->job, plan_key);
+	}
+
 	/* do the correct action with the cached parameters */
 	switch (priv->role) {
 	case PK_ROLE_ENUM_DEPENDS_ON:
@@ -2561,6 +3081,8 @@ struct AuthorizeActionsData {
 	/** Array of policy actions to authorize. They will are processed sequentially,
 	 * which can result in several chained callbacks. */
 	GPtrArray *actions;
+	PolkitDetails *details;
+	PolkitCheckAuthorizationFlags flags;
 };
 
 static gboolean
@@ -2568,6 +3090,35 @@ pk_transaction_authorize_actions (PkTransaction *transaction,
 				  PkRoleEnum role,
 				  GPtrArray *actions);
 
+/**
+ * pk_transaction_get_auth_session:
+ *
+ * Callers outside of a logind session, e.g. system services, only share
+ * decisions between the transactions of the same connection. Unique bus
+ * names start with ':' so they never look like a session.
+ *
+ * Returns: the session of the caller if polkit decisions can be shared
+ * with other transactions, or %NULL
+ **/
+static const gchar *
+pk_transaction_get_auth_session (PkTransaction *transaction)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+
+	if (priv->auth_cache == NULL ||
+	    !pk_auth_cache_get_enabled (priv->auth_cache) ||
+	    priv->sender == NULL)
+		return NULL;
+
+	/* only look it up once, it warns when there is no session */
+	if (priv->auth_session == NULL) {
+		priv->auth_session = pk_dbus_get_session (priv->dbus, priv->sender);
+		if (priv->auth_session == NULL)
+			priv->auth_session = g_strdup (priv->sender);
+	}
+	return priv->auth_session;
+}
+
 /**
  * pk_transaction_authorize_actions_finished_cb:
  *
@@ -2620,6 +3171,25 @@ pk_transaction_authorize_actions_finished_cb (GObject *source_object,
 		goto out;
 	}
 
+	/* we only asked polkit whether it can decide without a dialog, so
+	 * ask again allowing the dialog; the answer will not be reused */
+	if (!polkit_authorization_result_get_is_authorized (result) &&
+	    polkit_authorization_result_get_is_challenge (result) &&
+	    (data->flags & POLKIT_CHECK_AUTHORIZATION_FLAGS_ALLOW_USER_INTERACTION) == 0 &&
+	    pk_backend_job_get_interactive (priv->job)) {
+		g_debug ("authorizing action %s interactively", action_id);
+		data->flags |= POLKIT_CHECK_AUTHORIZATION_FLAGS_ALLOW_USER_INTERACTION;
+		polkit_authority_check_authorization (priv->authority,
+						      priv->subject,
+						      action_id,
+						      data->details,
+						      data->flags,
+						      priv->cancellable,
+						      (GAsyncReadyCallback) pk_transaction_authorize_actions_finished_cb,
+						      data);
+		return;
+	}
+
 	/* did not auth */
 	if (!polkit_authorization_result_get_is_authorized (result)) {
 		priv->waiting_for_auth = FALSE;
@@ -2632,6 +3202,16 @@ pk_transaction_authorize_actions_finished_cb (GObject *source_object,
 		goto out;
 	}
 
+	/* share the decision if polkit made it without asking anybody */
+	if (pk_transaction_get_auth_session (data->transaction) != NULL &&
+	    pk_auth_cache_result_is_reusable (result, data->flags)) {
+		pk_auth_cache_add (priv->auth_cache,
+				   priv->client_uid,
+				   priv->auth_session,
+				   action_id,
+				   priv->cached_transaction_flags);
+	}
+
 	if (data->actions->len <= 1) {
 		/* authentication finished successfully */
 		priv->waiting_for_auth = FALSE;
@@ -2649,6 +3229,7 @@ pk_transaction_authorize_actions_finished_cb (GObject *source_object,
 out:
 	g_object_unref (data->transaction);
 	g_ptr_array_unref (data->actions);
+	g_object_unref (data->details);
 	g_free (data);
 }
 
@@ -2677,6 +3258,21 @@ pk_transaction_authorize_actions (PkTransaction *transaction,
 	struct AuthorizeActionsData *data = NULL;
 	PolkitCheckAuthorizationFlags flags;
 
+	/* skip the actions polkit has recently authorized for this caller */
+	while (actions->len > 0 && pk_transaction_get_auth_session (transaction) != NULL) {
+		action_id = g_ptr_array_index (actions, 0);
+		if (!pk_auth_cache_lookup (priv->auth_cache,
+					   priv->client_uid,
+					   priv->auth_session,
+					   action_id,
+					   priv->cached_transaction_flags))
+			break;
+		syslog (LOG_AUTH | LOG_INFO,
+			"uid %i reused auth for %s",
+			priv->client_uid, action_id);
+		g_ptr_array_remove_index (actions, 0);
+	}
+
 	if (actions->len <= 0) {
 		g_debug ("No authentication required");
 		pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
@@ -2761,6 +3357,7 @@ pk_transaction_authorize_actions (PkTransaction *transaction,
 	data->transaction = g_object_ref (transaction);
 	data->role = role;
 	data->actions = g_ptr_array_ref (actions);
+	data->details = g_object_ref (details);
 
 	/* create if required */
 	if (priv->authority == NULL) {
@@ -2771,10 +3368,16 @@ pk_transaction_authorize_actions (PkTransaction *transaction,
 			return FALSE;
 		}
 	}
+	if (priv->auth_cache != NULL)
+		pk_auth_cache_watch_authority (priv->auth_cache, priv->authority);
 
+	/* when decisions are shared, first find out if polkit can decide
+	 * without a dialog, as only those decisions can be reused */
 	flags = POLKIT_CHECK_AUTHORIZATION_FLAGS_NONE;
-	if (pk_backend_job_get_interactive (priv->job))
+	if (pk_backend_job_get_interactive (priv->job) &&
+	    pk_transaction_get_auth_session (transaction) == NULL)
 		flags |= POLKIT_CHECK_AUTHORIZATION_FLAGS_ALLOW_USER_INTERACTION;
+	data->flags = flags;
 
 	g_debug ("authorizing action %s", action_id);
 	/* do authorization async */
@@ -4199,7 +4802,7 @@ out:
 	pk_transaction_dbus_return (context, error);
 }
 
-static void
+void
 pk_transaction_refresh_cache (PkTransaction *transaction,
 			      GVariant *params,
 			      GDBusMethodInvocation *context)
@@ -5212,6 +5815,8 @@ pk_transaction_get_property (GDBusConnection *connection_, const gchar *sender,
 		return g_variant_new_uint64 (priv->download_size_remaining);
 	if (g_strcmp0 (property_name, "TransactionFlags") == 0)
 		return g_variant_new_uint64 (priv->cached_transaction_flags);
+	if (g_strcmp0 (property_name, "PhaseTimes") == 0)
+		return pk_transaction_get_phase_times_variant (transaction);
 	return NULL;
 }
 
@@ -5422,6 +6027,7 @@ pk_transaction_reset_after_lock_error (PkTransaction *transaction)
 
 	/* reset transaction state */
 	/* first set state manually, otherwise set_state will refuse to switch to an earlier stage */
+	pk_transaction_account_state_time (transaction);
 	priv->state = PK_TRANSACTION_STATE_READY;
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 
@@ -5450,6 +6056,11 @@ pk_transaction_class_init (PkTransactionClass *klass)
 			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
 			      0, NULL, NULL, g_cclosure_marshal_VOID__UINT,
 			      G_TYPE_NONE, 1, G_TYPE_UINT);
+	signals[SIGNAL_PAUSED] =
+		g_signal_new ("paused",
+			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
+			      0, NULL, NULL, g_cclosure_marshal_VOID__VOID,
+			      G_TYPE_NONE, 0);
 
 	g_type_class_add_private (klass, sizeof (PkTransactionPrivate));
 }
@@ -5470,6 +6081,7 @@ pk_transaction_init (PkTransaction *transaction)
 	transaction->priv->status = PK_STATUS_ENUM_WAIT;
 	transaction->priv->percentage = PK_BACKEND_PERCENTAGE_INVALID;
 	transaction->priv->state = PK_TRANSACTION_STATE_UNKNOWN;
+	transaction->priv->state_time = g_get_monotonic_time ();
 	transaction->priv->dbus = pk_dbus_new ();
 	transaction->priv->results = pk_results_new ();
 	transaction->priv->supported_content_types = g_ptr_array_new_with_free_func (g_free);
@@ -5561,6 +6173,14 @@ pk_transaction_finalize (GObject *object)
 	g_object_unref (transaction->priv->job);
 	g_object_unref (transaction->priv->transaction_db);
 	g_object_unref (transaction->priv->results);
+	if (transaction->priv->results_cache != NULL)
+		g_object_unref (transaction->priv->results_cache);
+	g_free (transaction->priv->results_cache_key);
+	if (transaction->priv->auth_cache != NULL)
+		g_object_unref (transaction->priv->auth_cache);
+	g_free (transaction->priv->auth_session);
+	if (transaction->priv->shared_results != NULL)
+		g_object_unref (transaction->priv->shared_results);
 	if (transaction->priv->authority != NULL)
 		g_object_unref (transaction->priv->authority);
 	g_object_unref (transaction->priv->cancellable);
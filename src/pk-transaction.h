@@ -26,7 +26,9 @@
 #include <packagekit-glib2/pk-enum.h>
 #include <packagekit-glib2/pk-results.h>
 
+#include "pk-auth-cache.h"
 #include "pk-backend.h"
+#include "pk-results-cache.h"
 
 G_BEGIN_DECLS
 
@@ -63,6 +65,16 @@ typedef enum {
 	PK_TRANSACTION_STATE_UNKNOWN
 } PkTransactionState;
 
+/* where the time of a transaction went */
+typedef enum {
+	PK_TRANSACTION_PHASE_AUTH,	/* waiting for polkit */
+	PK_TRANSACTION_PHASE_QUEUE,	/* ready, waiting for the scheduler */
+	PK_TRANSACTION_PHASE_LOCK,	/* running, waiting for a backend lock */
+	PK_TRANSACTION_PHASE_RUN,	/* running, without the lock wait */
+	PK_TRANSACTION_PHASE_EMIT,	/* processing backend signals */
+	PK_TRANSACTION_PHASE_LAST
+} PkTransactionPhase;
+
 GQuark		 pk_transaction_error_quark			(void);
 GType		 pk_transaction_get_type			(void);
 PkTransaction	*pk_transaction_new				(GKeyFile		*conf,
@@ -78,11 +90,24 @@ PkRoleEnum	 pk_transaction_get_role			(PkTransaction	*transaction);
 guint		 pk_transaction_get_uid				(PkTransaction	*transaction);
 void		 pk_transaction_set_backend			(PkTransaction	*transaction,
 								 PkBackend	*backend);
+void		 pk_transaction_set_results_cache		(PkTransaction	*transaction,
+								 PkResultsCache	*results_cache);
+void		 pk_transaction_set_auth_cache			(PkTransaction	*transaction,
+								 PkAuthCache	*auth_cache);
+const gchar	*pk_transaction_get_query_key			(PkTransaction	*transaction);
+gboolean	 pk_transaction_can_follow			(PkTransaction	*transaction,
+								 PkTransaction	*leader);
+gboolean	 pk_transaction_share_results			(PkTransaction	*transaction,
+								 PkTransaction	*leader);
 PkBackendJob	*pk_transaction_get_backend_job 		(PkTransaction	*transaction);
+PkResults	*pk_transaction_get_results			(PkTransaction	*transaction);
 PkTransactionState pk_transaction_get_state			(PkTransaction	*transaction);
 void		 pk_transaction_set_state			(PkTransaction	*transaction,
 								 PkTransactionState state);
 const gchar	*pk_transaction_state_to_string			(PkTransactionState state);
+const gchar	*pk_transaction_phase_to_string			(PkTransactionPhase phase);
+guint64		 pk_transaction_get_phase_time			(PkTransaction	*transaction,
+								 PkTransactionPhase phase);
 const gchar	*pk_transaction_get_tid				(PkTransaction	*transaction);
 gboolean	 pk_transaction_is_exclusive			(PkTransaction	*transaction);
 gboolean	 pk_transaction_is_finished_with_lock_required	(PkTransaction *transaction);